@@ -0,0 +1,140 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <inttypes.h>
+
+#include "table.h"
+
+// Compares insert, point lookup and full scan times across page sizes.
+// Usage: bench_page_size [rows]
+
+#define DEFAULT_ROWS 100000
+#define BENCH_FILE "bench_page_size.db"
+
+
+static double now_ms(void)
+{
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+// Keys in a fixed pseudo-random order, so every page size sees the same workload
+static uint64_t* shuffled_keys(uint64_t num_rows)
+{
+	uint64_t* keys = malloc(num_rows * sizeof(uint64_t));
+	if (!keys)
+	{
+		perror("malloc error");
+		exit(EXIT_FAILURE);
+	}
+
+	for (uint64_t i = 0; i < num_rows; ++i)
+		keys[i] = i + 1;
+
+	uint64_t state = 88172645463325252ull;
+	for (uint64_t i = num_rows - 1; i > 0; --i)
+	{
+		state ^= state << 13;
+		state ^= state >> 7;
+		state ^= state << 17;
+		uint64_t j = state % (i + 1);
+		uint64_t key = keys[i];
+		keys[i] = keys[j];
+		keys[j] = key;
+	}
+	return keys;
+}
+
+static void run(uint32_t page_size, const uint64_t* keys, uint64_t num_rows)
+{
+	DbOptions options = {0};
+	options.page_size = page_size;
+
+	remove(BENCH_FILE);
+	Table* table = db_open_with_options(BENCH_FILE, &options);
+
+	double start = now_ms();
+	for (uint64_t i = 0; i < num_rows; ++i)
+	{
+		Row row = {0};
+		row.id = keys[i];
+		snprintf(row.username, sizeof(row.username), "user%" PRIu64, keys[i]);
+		snprintf(row.email, sizeof(row.email), "user%" PRIu64 "@example.com", keys[i]);
+
+		Cursor* cursor = table_find(table, row.id);
+		leaf_node_insert(cursor, row.id, &row);
+		free(cursor);
+	}
+	double insert_ms = now_ms() - start;
+	uint32_t depth = table_depth(table);
+	uint64_t num_pages = table->pager->num_pages;
+	db_close(table);
+
+	// lookups and the scan start from a cold page cache
+	table = db_open(BENCH_FILE);
+	start = now_ms();
+	for (uint64_t i = 0; i < num_rows; ++i)
+	{
+		Row row;
+		Cursor* cursor = table_find(table, keys[num_rows - 1 - i]);
+		cursor_read_row(cursor, &row, COLUMN_BIT(COLUMN_ID));
+		if (row.id != keys[num_rows - 1 - i])
+		{
+			fprintf(stderr, "Error: Lookup of %" PRIu64 " failed.\n", keys[num_rows - 1 - i]);
+			exit(EXIT_FAILURE);
+		}
+		free(cursor);
+	}
+	double lookup_ms = now_ms() - start;
+	db_close(table);
+
+	table = db_open(BENCH_FILE);
+	start = now_ms();
+	uint64_t scanned = 0;
+	uint64_t checksum = 0;
+	Cursor* cursor = table_start(table);
+	while (!cursor->end_of_table)
+	{
+		Row row;
+		cursor_read_row(cursor, &row, COLUMN_BIT(COLUMN_ID));
+		checksum += row.id;
+		scanned++;
+		cursor_advance(cursor);
+	}
+	free(cursor);
+	double scan_ms = now_ms() - start;
+	db_close(table);
+
+	if (scanned != num_rows || checksum != num_rows * (num_rows + 1) / 2)
+	{
+		fprintf(stderr, "Error: Scan returned %" PRIu64 " rows.\n", scanned);
+		exit(EXIT_FAILURE);
+	}
+
+	printf("%9" PRIu32 " %6" PRIu32 " %9" PRIu64 " %11.1f %11.1f %11.1f\n",
+		page_size, depth, num_pages, insert_ms, lookup_ms, scan_ms);
+}
+
+int main(int argc, char* argv[])
+{
+	uint64_t num_rows = argc > 1 ? strtoull(argv[1], NULL, 10) : DEFAULT_ROWS;
+	if (num_rows == 0)
+	{
+		fprintf(stderr, "Usage: %s [rows]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	uint64_t* keys = shuffled_keys(num_rows);
+
+	printf("%" PRIu64 " rows\n", num_rows);
+	printf("%9s %6s %9s %11s %11s %11s\n", "page_size", "depth", "pages", "insert_ms", "lookup_ms", "scan_ms");
+	for (uint32_t page_size = MIN_PAGE_SIZE; page_size <= MAX_PAGE_SIZE; page_size *= 2)
+		run(page_size, keys, num_rows);
+
+	remove(BENCH_FILE);
+	free(keys);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,113 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <inttypes.h>
+
+#include "scan.h"
+#include "table.h"
+#include "thread.h"
+
+// Measures full-scan throughput of table_parallel_scan from 1 to N threads on a cached table.
+// Usage: bench_scan [rows] [max_threads]
+
+#define DEFAULT_ROWS 500000
+#define BENCH_FILE "bench_scan.db"
+#define SCAN_REPEATS 3
+
+
+typedef struct
+{
+	Mutex lock;
+	uint64_t rows;
+	uint64_t checksum;
+} ScanTotals;
+
+static double now_ms(void)
+{
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static void count_rows(Row* rows, uint32_t num_rows, void* context)
+{
+	ScanTotals* totals = context;
+	uint64_t checksum = 0;
+	for (uint32_t i = 0; i < num_rows; ++i)
+		checksum += rows[i].id;
+
+	mutex_lock(&totals->lock);
+	totals->rows += num_rows;
+	totals->checksum += checksum;
+	mutex_unlock(&totals->lock);
+}
+
+static void fill_table(uint64_t num_rows)
+{
+	remove(BENCH_FILE);
+	Table* table = db_open(BENCH_FILE);
+	for (uint64_t i = 1; i <= num_rows; ++i)
+	{
+		Row row = {0};
+		row.id = i;
+		snprintf(row.username, sizeof(row.username), "user%" PRIu64, i);
+		snprintf(row.email, sizeof(row.email), "user%" PRIu64 "@example.com", i);
+
+		Cursor* cursor = table_find(table, row.id);
+		leaf_node_insert(cursor, row.id, &row);
+		free(cursor);
+	}
+	db_close(table);
+}
+
+int main(int argc, char* argv[])
+{
+	uint64_t num_rows = argc > 1 ? strtoull(argv[1], NULL, 10) : DEFAULT_ROWS;
+	uint32_t max_threads = argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 10) : cpu_count();
+	if (num_rows == 0 || max_threads == 0 || max_threads > MAX_SCAN_THREADS)
+	{
+		fprintf(stderr, "Usage: %s [rows] [max_threads]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	fill_table(num_rows);
+	Table* table = db_open(BENCH_FILE);
+	pager_load_all(table->pager);
+
+	printf("%" PRIu64 " rows, %" PRIu32 " cpus\n", num_rows, cpu_count());
+	printf("%7s %9s %10s %8s\n", "threads", "scan_ms", "mrows_s", "speedup");
+
+	double single_ms = 0;
+	for (uint32_t threads = 1; threads <= max_threads; ++threads)
+	{
+		double best_ms = 0;
+		for (uint32_t repeat = 0; repeat < SCAN_REPEATS; ++repeat)
+		{
+			ScanTotals totals = {0};
+			mutex_init(&totals.lock);
+
+			double start = now_ms();
+			table_parallel_scan(table, threads, ALL_COLUMNS, false, count_rows, &totals);
+			double elapsed = now_ms() - start;
+			mutex_destroy(&totals.lock);
+
+			if (totals.rows != num_rows || totals.checksum != num_rows * (num_rows + 1) / 2)
+			{
+				fprintf(stderr, "Error: Scan returned %" PRIu64 " rows.\n", totals.rows);
+				exit(EXIT_FAILURE);
+			}
+			if (repeat == 0 || elapsed < best_ms)
+				best_ms = elapsed;
+		}
+
+		if (threads == 1)
+			single_ms = best_ms;
+		printf("%7" PRIu32 " %9.1f %10.2f %7.2fx\n", threads, best_ms, num_rows / best_ms / 1000.0, single_ms / best_ms);
+	}
+
+	db_close(table);
+	remove(BENCH_FILE);
+	return EXIT_SUCCESS;
+}
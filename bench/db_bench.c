@@ -0,0 +1,457 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "aggregate.h"
+#include "parser.h"
+#include "stats.h"
+#include "table.h"
+
+// Engine microbenchmarks in the spirit of LevelDB's db_bench. Results go to
+// stdout as one JSON document. Cold runs reopen the database so every page
+// comes through the pager again; the operating system's file cache stays warm.
+//
+// Usage: db_bench [--benchmarks=a,b,...] [--num=N] [--reads=N] [--deletes=N]
+//                 [--value_size=N] [--scan_length=N] [--read_percent=N]
+//                 [--page_size=N] [--memtable=N] [--seed=N] [--db=path]
+
+#define DEFAULT_BENCHMARKS "fillseq,fillrandom,readrandom_cold,readrandom,readhot,readseq,scanrange,deleterandom,readrandomwriterandom"
+#define DEFAULT_DB "db_bench.db"
+
+
+typedef struct
+{
+	const char* benchmarks;
+	const char* db_path;
+	uint64_t num;
+	uint64_t reads;
+	uint64_t deletes;
+	uint32_t value_size;
+	uint32_t scan_length;
+	uint32_t read_percent;
+	uint32_t page_size;
+	uint64_t memtable_entries; // 0 inserts straight into the tree
+	uint64_t seed;
+} BenchOptions;
+
+typedef struct
+{
+	BenchOptions* options;
+	Table* table;
+	uint64_t num_keys; // keys 1..num_keys were inserted by the last fill
+	uint64_t random_state;
+	Histogram latency;
+	uint64_t ops;
+	uint64_t elapsed_ns;
+	bool first_result;
+} Bench;
+
+typedef void (*BenchFunction)(Bench* bench);
+
+typedef struct
+{
+	const char* name;
+	BenchFunction run;
+} BenchEntry;
+
+
+static uint64_t next_random(Bench* bench)
+{
+	// xorshift64*, so a given seed always replays the same workload
+	bench->random_state ^= bench->random_state >> 12;
+	bench->random_state ^= bench->random_state << 25;
+	bench->random_state ^= bench->random_state >> 27;
+	return bench->random_state * 2685821657736338717ull;
+}
+
+static uint64_t random_key(Bench* bench)
+{
+	return bench->num_keys ? next_random(bench) % bench->num_keys + 1 : 1;
+}
+
+static void make_row(Bench* bench, uint64_t id, Row* row)
+{
+	memset(row, 0, sizeof(Row));
+	row->id = id;
+	snprintf(row->username, sizeof(row->username), "user%" PRIu64, id);
+	uint32_t length = (uint32_t)snprintf(row->email, sizeof(row->email), "%" PRIu64 "@", id);
+	memset(row->email + length, 'x', bench->options->value_size > length ? bench->options->value_size - length : 0);
+}
+
+static void use_memtable(Bench* bench)
+{
+	Memtable* memtable = &bench->table->pager->memtable;
+	memtable_free(memtable);
+	memtable_init(memtable, bench->options->memtable_entries, ROW_SIZE);
+}
+
+static void open_fresh(Bench* bench)
+{
+	if (bench->table)
+		db_close(bench->table);
+	remove(bench->options->db_path);
+
+	DbOptions options = {0};
+	options.page_size = bench->options->page_size;
+	bench->table = db_open_with_options(bench->options->db_path, &options);
+	use_memtable(bench);
+	bench->num_keys = 0;
+}
+
+static void reopen(Bench* bench)
+{
+	if (bench->table)
+		db_close(bench->table);
+	bench->table = db_open(bench->options->db_path);
+	use_memtable(bench);
+}
+
+static void time_op_start(uint64_t* start)
+{
+	*start = stats_now_ns();
+}
+
+static void time_op_end(Bench* bench, uint64_t start)
+{
+	uint64_t elapsed = stats_now_ns() - start;
+	histogram_record(&bench->latency, elapsed);
+	bench->elapsed_ns += elapsed;
+	bench->ops++;
+}
+
+static void insert_key(Bench* bench, uint64_t id)
+{
+	Statement statement = {0};
+	statement.type = STATEMENT_INSERT;
+	statement.insert_or_replace = true;
+	make_row(bench, id, &statement.row_to_insert);
+
+	uint64_t start;
+	time_op_start(&start);
+	execute_statement(&statement, bench->table);
+	time_op_end(bench, start);
+}
+
+static bool lookup_key(Bench* bench, uint64_t id)
+{
+	uint64_t start;
+	time_op_start(&start);
+	Row row;
+	MemtableEntry* entry = memtable_find(&bench->table->pager->memtable, bench->table->root_page_num, id);
+	if (entry)
+	{
+		deserialize_row(memtable_entry_value(entry), &row);
+		time_op_end(bench, start);
+		return true;
+	}
+
+	Cursor* cursor = table_find(bench->table, id);
+	void* node = get_page(bench->table->pager, cursor->page_num);
+	bool found = cursor->cell_num < *leaf_node_num_cells(node) && *leaf_node_key(node, cursor->cell_num) == id;
+	if (found)
+		cursor_read_row(cursor, &row, ALL_COLUMNS);
+	free(cursor);
+	time_op_end(bench, start);
+	return found;
+}
+
+// Rows a write benchmark leaves buffered count toward its time, and the scans read only the tree
+static void merge_memtable(Bench* bench)
+{
+	uint64_t start = stats_now_ns();
+	pager_merge_memtable(bench->table->pager);
+	bench->elapsed_ns += stats_now_ns() - start;
+}
+
+// Fills
+
+static void fill_seq(Bench* bench)
+{
+	open_fresh(bench);
+	for (uint64_t id = 1; id <= bench->options->num; ++id)
+		insert_key(bench, id);
+	merge_memtable(bench);
+	bench->num_keys = bench->options->num;
+}
+
+static void fill_random(Bench* bench)
+{
+	open_fresh(bench);
+
+	// a shuffled permutation, so every key 1..num is inserted exactly once
+	uint64_t* keys = malloc(bench->options->num * sizeof(uint64_t));
+	if (!keys)
+	{
+		perror("malloc error");
+		exit(EXIT_FAILURE);
+	}
+	for (uint64_t i = 0; i < bench->options->num; ++i)
+		keys[i] = i + 1;
+	for (uint64_t i = bench->options->num; i > 1; --i)
+	{
+		uint64_t j = next_random(bench) % i;
+		uint64_t key = keys[i - 1];
+		keys[i - 1] = keys[j];
+		keys[j] = key;
+	}
+
+	for (uint64_t i = 0; i < bench->options->num; ++i)
+		insert_key(bench, keys[i]);
+	merge_memtable(bench);
+	bench->num_keys = bench->options->num;
+	free(keys);
+}
+
+// Reads
+
+static void read_random(Bench* bench)
+{
+	pager_load_all(bench->table->pager);
+	for (uint64_t i = 0; i < bench->options->reads; ++i)
+		lookup_key(bench, random_key(bench));
+}
+
+static void read_random_cold(Bench* bench)
+{
+	reopen(bench);
+	for (uint64_t i = 0; i < bench->options->reads; ++i)
+		lookup_key(bench, random_key(bench));
+}
+
+// 80% of the reads go to the hottest 1% of the keys, which are spread over the whole table
+static void read_hot(Bench* bench)
+{
+	pager_load_all(bench->table->pager);
+	uint64_t num_hot = bench->num_keys / 100 ? bench->num_keys / 100 : 1;
+	for (uint64_t i = 0; i < bench->options->reads; ++i)
+	{
+		uint64_t id = random_key(bench);
+		if (next_random(bench) % 100 < 80)
+			id = (id % num_hot) * (bench->num_keys / num_hot) + 1;
+		lookup_key(bench, id);
+	}
+}
+
+static void read_seq(Bench* bench)
+{
+	Row row;
+	Cursor* cursor = table_start(bench->table);
+	while (!cursor->end_of_table)
+	{
+		uint64_t start;
+		time_op_start(&start);
+		if (!cursor_is_deleted(cursor))
+			cursor_read_row(cursor, &row, ALL_COLUMNS);
+		cursor_advance(cursor);
+		time_op_end(bench, start);
+	}
+	free(cursor);
+}
+
+static void scan_range(Bench* bench)
+{
+	uint64_t num_scans = bench->options->reads / bench->options->scan_length;
+	if (num_scans == 0)
+		num_scans = 1;
+
+	Row row;
+	for (uint64_t i = 0; i < num_scans; ++i)
+	{
+		uint64_t start;
+		time_op_start(&start);
+		Cursor* cursor = table_find(bench->table, random_key(bench));
+		void* node = get_page(bench->table->pager, cursor->page_num);
+		cursor->end_of_table = cursor->cell_num >= *leaf_node_num_cells(node);
+		for (uint32_t j = 0; j < bench->options->scan_length && !cursor->end_of_table; ++j)
+		{
+			cursor_read_row(cursor, &row, ALL_COLUMNS);
+			cursor_advance(cursor);
+		}
+		free(cursor);
+		time_op_end(bench, start);
+	}
+}
+
+// Writes mixed with reads
+
+static void delete_random(Bench* bench)
+{
+	for (uint64_t i = 0; i < bench->options->deletes; ++i)
+	{
+		Statement statement = {0};
+		statement.type = STATEMENT_DELETE;
+		statement.id_to_delete = random_key(bench);
+
+		uint64_t start;
+		time_op_start(&start);
+		execute_statement(&statement, bench->table);
+		time_op_end(bench, start);
+	}
+}
+
+static void read_random_write_random(Bench* bench)
+{
+	for (uint64_t i = 0; i < bench->options->reads; ++i)
+	{
+		uint64_t id = random_key(bench);
+		if (next_random(bench) % 100 < bench->options->read_percent)
+			lookup_key(bench, id);
+		else
+			insert_key(bench, id);
+	}
+	merge_memtable(bench);
+}
+
+static const BenchEntry benchmarks[] = {
+	{"fillseq", fill_seq},
+	{"fillrandom", fill_random},
+	{"readrandom", read_random},
+	{"readrandom_cold", read_random_cold},
+	{"readhot", read_hot},
+	{"readseq", read_seq},
+	{"scanrange", scan_range},
+	{"deleterandom", delete_random},
+	{"readrandomwriterandom", read_random_write_random},
+};
+
+static void print_result(Bench* bench, const char* name)
+{
+	double seconds = bench->elapsed_ns / 1e9;
+	printf("%s\n    {\"name\": \"%s\", \"ops\": %" PRIu64 ", \"ops_per_sec\": %.1f, \"p50_ns\": %" PRIu64
+		", \"p99_ns\": %" PRIu64 ", \"p999_ns\": %" PRIu64 ", \"max_ns\": %" PRIu64 "}",
+		bench->first_result ? "" : ",", name, bench->ops, seconds > 0 ? bench->ops / seconds : 0.0,
+		histogram_percentile(&bench->latency, 50), histogram_percentile(&bench->latency, 99),
+		histogram_percentile(&bench->latency, 99.9), bench->latency.max);
+	bench->first_result = false;
+}
+
+static void run_benchmark(Bench* bench, const char* name)
+{
+	for (size_t i = 0; i < sizeof(benchmarks) / sizeof(benchmarks[0]); ++i)
+	{
+		if (strcmp(name, benchmarks[i].name) != 0)
+			continue;
+
+		memset(&bench->latency, 0, sizeof(Histogram));
+		bench->ops = 0;
+		bench->elapsed_ns = 0;
+		// without a fill in this run, reuse whatever --db already holds
+		if (!bench->table)
+		{
+			reopen(bench);
+			table_max_key(bench->table, &bench->num_keys);
+		}
+
+		benchmarks[i].run(bench);
+		print_result(bench, name);
+		return;
+	}
+
+	fprintf(stderr, "Error: Unknown benchmark '%s'.\n", name);
+	exit(EXIT_FAILURE);
+}
+
+static bool parse_flag(const char* arg, const char* name, const char** value)
+{
+	size_t length = strlen(name);
+	if (strncmp(arg, name, length) != 0 || arg[length] != '=')
+		return false;
+	*value = arg + length + 1;
+	return true;
+}
+
+int main(int argc, char* argv[])
+{
+	BenchOptions options = {
+		.benchmarks = DEFAULT_BENCHMARKS,
+		.db_path = DEFAULT_DB,
+		.num = 100000,
+		.value_size = 100,
+		.scan_length = 100,
+		.read_percent = 90,
+		.seed = 301,
+	};
+	bool reads_set = false;
+	bool deletes_set = false;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const char* value;
+		if (parse_flag(argv[i], "--benchmarks", &value))
+			options.benchmarks = value;
+		else if (parse_flag(argv[i], "--db", &value))
+			options.db_path = value;
+		else if (parse_flag(argv[i], "--num", &value))
+			options.num = strtoull(value, NULL, 10);
+		else if (parse_flag(argv[i], "--reads", &value))
+		{
+			options.reads = strtoull(value, NULL, 10);
+			reads_set = true;
+		}
+		else if (parse_flag(argv[i], "--deletes", &value))
+		{
+			options.deletes = strtoull(value, NULL, 10);
+			deletes_set = true;
+		}
+		else if (parse_flag(argv[i], "--value_size", &value))
+			options.value_size = (uint32_t)strtoul(value, NULL, 10);
+		else if (parse_flag(argv[i], "--scan_length", &value))
+			options.scan_length = (uint32_t)strtoul(value, NULL, 10);
+		else if (parse_flag(argv[i], "--read_percent", &value))
+			options.read_percent = (uint32_t)strtoul(value, NULL, 10);
+		else if (parse_flag(argv[i], "--page_size", &value))
+			options.page_size = (uint32_t)strtoul(value, NULL, 10);
+		else if (parse_flag(argv[i], "--memtable", &value))
+			options.memtable_entries = strtoull(value, NULL, 10);
+		else if (parse_flag(argv[i], "--seed", &value))
+			options.seed = strtoull(value, NULL, 10);
+		else
+		{
+			fprintf(stderr, "Error: Unknown flag '%s'.\n", argv[i]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	// deletes still scan for their row, so they default to a smaller count
+	if (!reads_set)
+		options.reads = options.num;
+	if (!deletes_set)
+		options.deletes = options.num / 100 ? options.num / 100 : 1;
+
+	if (options.num == 0 || options.scan_length == 0 || options.read_percent > 100 || options.seed == 0
+		|| options.value_size > COLUMN_EMAIL_SIZE || (options.page_size && !is_valid_page_size(options.page_size)))
+	{
+		fprintf(stderr, "Error: Invalid options.\n");
+		return EXIT_FAILURE;
+	}
+
+	Bench bench = {0};
+	bench.options = &options;
+	bench.random_state = options.seed;
+	bench.first_result = true;
+
+	printf("{\"num\": %" PRIu64 ", \"reads\": %" PRIu64 ", \"value_size\": %" PRIu32 ", \"page_size\": %" PRIu32
+		", \"seed\": %" PRIu64 ", \"results\": [",
+		options.num, options.reads, options.value_size, options.page_size ? options.page_size : DEFAULT_PAGE_SIZE, options.seed);
+
+	char* list = malloc(strlen(options.benchmarks) + 1);
+	if (!list)
+	{
+		perror("malloc error");
+		exit(EXIT_FAILURE);
+	}
+	strcpy(list, options.benchmarks);
+	for (char* name = strtok(list, ","); name; name = strtok(NULL, ","))
+		run_benchmark(&bench, name);
+	free(list);
+
+	printf("\n]}\n");
+
+	if (bench.table)
+		db_close(bench.table);
+	remove(options.db_path);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,115 @@
+#include "aggregate.h"
+
+#include <stdlib.h>
+
+#include "stats.h"
+
+
+bool table_min_key(Table* table, uint64_t* key)
+{
+	Cursor* cursor = table_start(table);
+	bool found = false;
+
+	// deleted rows keep their cells, so skip forward to the first live one
+	while (!cursor->end_of_table)
+	{
+		void* node = get_page(table->pager, cursor->page_num);
+		stats_increment(STAT_ROWS_EXAMINED);
+		if (!leaf_node_is_deleted(node, cursor->cell_num))
+		{
+			*key = *leaf_node_key(node, cursor->cell_num);
+			found = true;
+			break;
+		}
+		cursor_advance(cursor);
+	}
+
+	free(cursor);
+	return found;
+}
+
+bool table_max_key(Table* table, uint64_t* key)
+{
+	// the search for the largest possible key ends in the rightmost leaf, and deleted
+	// rows keep their cells, so step back to the last live one
+	Cursor* cursor = table_find_last(table, UINT64_MAX);
+	bool found = false;
+
+	while (!cursor->end_of_table)
+	{
+		stats_increment(STAT_ROWS_EXAMINED);
+		if (!cursor_is_deleted(cursor))
+		{
+			*key = *leaf_node_key(get_page(table->pager, cursor->page_num), cursor->cell_num);
+			found = true;
+			break;
+		}
+		cursor_retreat(cursor);
+	}
+
+	free(cursor);
+	return found;
+}
+
+void table_count_and_sum(Table* table, uint64_t* count, uint64_t* sum)
+{
+	Cursor* cursor = table_start(table);
+	uint64_t page_num = cursor->end_of_table ? 0 : cursor->page_num;
+	free(cursor);
+
+	*count = 0;
+	*sum = 0;
+	while (page_num != 0)
+	{
+		void* node = get_page(table->pager, page_num);
+		uint32_t num_cells = *leaf_node_num_cells(node);
+		stats_add(STAT_ROWS_EXAMINED, num_cells);
+		for (uint32_t i = 0; i < num_cells; ++i)
+		{
+			if (leaf_node_is_deleted(node, i))
+				continue;
+			(*count)++;
+			*sum += *leaf_node_key(node, i);
+		}
+		page_num = *leaf_node_next_leaf(node);
+	}
+}
+
+void table_aggregate(Table* table, const AggregateFunction* functions, uint32_t num_functions, TableAggregates* result)
+{
+	bool needs_count = false;
+	bool needs_sum = false;
+	bool needs_min = false;
+	bool needs_max = false;
+	for (uint32_t i = 0; i < num_functions; ++i)
+	{
+		switch (functions[i])
+		{
+		case AGGREGATE_COUNT:
+			needs_count = true;
+			break;
+		case AGGREGATE_SUM:
+			needs_sum = true;
+			break;
+		case AGGREGATE_MIN:
+			needs_min = true;
+			break;
+		case AGGREGATE_MAX:
+			needs_max = true;
+			break;
+		}
+	}
+
+	*result = (TableAggregates){0};
+	// sum needs the leaves, while count(*) alone reads the root's child counts
+	if (needs_sum)
+		table_count_and_sum(table, &result->count, &result->sum);
+	else if (needs_count)
+		result->count = table_row_count(table);
+
+	result->has_rows = needs_sum || needs_count ? result->count > 0 : true;
+	if (needs_min && result->has_rows)
+		result->has_rows = table_min_key(table, &result->min);
+	if (needs_max && result->has_rows)
+		result->has_rows = table_max_key(table, &result->max);
+}
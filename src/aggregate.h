@@ -0,0 +1,40 @@
+#ifndef AGGREGATE_H
+#define AGGREGATE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "table.h"
+
+// Aggregates answered from the tree structure: min and max descend one edge of the
+// tree, count reads the root's child row counts, and sum walks the leaf chain
+// reading only cell counts and keys.
+
+#define MAX_AGGREGATES 8
+
+typedef enum
+{
+	AGGREGATE_COUNT,
+	AGGREGATE_MIN,
+	AGGREGATE_MAX,
+	AGGREGATE_SUM
+} AggregateFunction;
+
+typedef struct
+{
+	uint64_t count;
+	uint64_t sum; // wraps modulo 2^64
+	uint64_t min;
+	uint64_t max;
+	bool has_rows; // min and max are unset without live rows
+} TableAggregates;
+
+// Return false when the table has no live rows
+bool table_min_key(Table* table, uint64_t* key);
+bool table_max_key(Table* table, uint64_t* key);
+void table_count_and_sum(Table* table, uint64_t* count, uint64_t* sum);
+
+// Computes only what the requested functions need
+void table_aggregate(Table* table, const AggregateFunction* functions, uint32_t num_functions, TableAggregates* result);
+
+#endif // AGGREGATE_H
@@ -0,0 +1,181 @@
+#if !defined(_WIN32)
+#define _FILE_OFFSET_BITS 64
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "backup.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <io.h>
+#define file_seek _fseeki64
+#define file_truncate(file_ptr, length) _chsize_s(_fileno(file_ptr), (int64_t)(length))
+#else
+#include <unistd.h>
+#define file_seek fseeko
+#define file_truncate(file_ptr, length) ftruncate(fileno(file_ptr), (off_t)(length))
+#endif
+
+
+static bool read_previous_backup(Pager* pager, FILE* file_ptr, void* page, uint64_t* change_counter);
+static void write_at(FILE* file_ptr, uint64_t offset, const void* data, uint64_t length);
+
+
+Backup* backup_start(Table* table, const char* filename)
+{
+	Pager* pager = table->pager;
+	Backup* backup = calloc(1, sizeof(Backup));
+	void* page = malloc(pager->page_size);
+	if (!backup || !page)
+	{
+		perror("malloc error");
+		exit(EXIT_FAILURE);
+	}
+
+	FILE* file_ptr = fopen(filename, "r+b");
+	if (!file_ptr)
+		file_ptr = fopen(filename, "w+b");
+	if (!file_ptr)
+	{
+		perror("fopen error");
+		exit(EXIT_FAILURE);
+	}
+
+	backup->pager = pager;
+	backup->file_ptr = file_ptr;
+	backup->page = page;
+	backup->pass_start = pager_record_changes(pager);
+	backup->next_page = FILE_HEADER_PAGE_NUM + 1;
+	backup->copy_all = !read_previous_backup(pager, file_ptr, page, &backup->since);
+	return backup;
+}
+
+bool backup_step(Backup* backup, uint64_t max_pages)
+{
+	Pager* pager = backup->pager;
+	uint64_t copied = 0;
+
+	while (copied < max_pages)
+	{
+		if (backup->next_page >= pager->num_pages)
+		{
+			// pages changed while the pass ran are copied by another pass
+			uint64_t change_counter = pager_record_changes(pager);
+			if (change_counter == backup->pass_start)
+				return true;
+
+			backup->copy_all = false;
+			backup->since = backup->pass_start;
+			backup->pass_start = change_counter;
+			backup->next_page = FILE_HEADER_PAGE_NUM + 1;
+			continue;
+		}
+
+		uint64_t page_num = backup->next_page++;
+		if (!backup->copy_all && pager->page_changes[page_num] <= backup->since)
+			continue;
+
+		pager_copy_page(pager, page_num, backup->page);
+		write_at(backup->file_ptr, page_num * pager->page_size, backup->page, pager->page_size);
+		backup->pages_copied++;
+		copied++;
+	}
+	return false;
+}
+
+uint64_t backup_finish(Backup* backup)
+{
+	Pager* pager = backup->pager;
+	while (!backup_step(backup, UINT64_MAX))
+		;
+
+	// the copy is always uncompressed, with its change map trailing the pages
+	FileHeader header;
+	pager_file_header(pager, &header);
+	header.flags &= ~FILE_FLAG_COMPRESSED;
+	header.map_offset = 0;
+	header.map_capacity = 0;
+	header.change_counter = backup->pass_start;
+	header.change_map_offset = pager->num_pages * pager->page_size;
+	header.change_map_capacity = pager->num_pages * sizeof(uint64_t);
+	header.key_filter_offset = header.change_map_offset + header.change_map_capacity;
+	header.key_filter_capacity = header.key_filter_length;
+
+	write_at(backup->file_ptr, header.change_map_offset, pager->page_changes, header.change_map_capacity);
+
+	// the filter holds every key inserted so far, so it covers the rows just copied
+	if (header.key_filter_length > 0)
+	{
+		void* key_filter = malloc(header.key_filter_length);
+		if (!key_filter)
+		{
+			perror("malloc error");
+			exit(EXIT_FAILURE);
+		}
+		bloom_serialize(&pager->key_filter, key_filter);
+		write_at(backup->file_ptr, header.key_filter_offset, key_filter, header.key_filter_length);
+		free(key_filter);
+	}
+	write_header_page(backup->file_ptr, &header, pager->page_size);
+
+	// an earlier, longer backup (say from before a vacuum) leaves its tail behind otherwise
+	uint64_t file_length = header.key_filter_offset + header.key_filter_capacity;
+	if (fflush(backup->file_ptr) != 0 || file_truncate(backup->file_ptr, file_length) != 0)
+	{
+		perror("backup truncate error");
+		exit(EXIT_FAILURE);
+	}
+	if (fclose(backup->file_ptr))
+	{
+		perror("fclose error");
+		exit(EXIT_FAILURE);
+	}
+
+	uint64_t pages_copied = backup->pages_copied;
+	free(backup->page);
+	free(backup);
+	return pages_copied;
+}
+
+uint64_t table_backup(Table* table, const char* filename)
+{
+	Backup* backup = backup_start(table, filename);
+	while (!backup_step(backup, BACKUP_STEP_PAGES))
+		;
+	return backup_finish(backup);
+}
+
+// An earlier backup of this database only needs the pages changed after it was taken, as long
+// as its counter comes from this session or from what the file held when it was opened; an open
+// that never closed may have reached the same counter with other pages.
+static bool read_previous_backup(Pager* pager, FILE* file_ptr, void* page, uint64_t* change_counter)
+{
+	FileHeader header;
+	if (file_seek(file_ptr, 0, SEEK_SET) != 0 || fread(page, 1, pager->page_size, file_ptr) < pager->page_size)
+		return false;
+	if (page_checksum(page, pager->page_size) != *(uint32_t*)((uint8_t*)page + PAGE_CHECKSUM_OFFSET))
+		return false;
+
+	memcpy(&header, (uint8_t*)page + PAGE_HEADER_SIZE, sizeof(header));
+	if (header.magic != FILE_MAGIC || header.format_version != FILE_FORMAT_VERSION || (header.flags & FILE_FLAG_COMPRESSED)
+		|| header.page_size != pager->page_size || header.file_id != pager->file_id
+		|| header.change_counter > pager->change_counter)
+		return false;
+	if (header.session_id != pager->session_id
+		&& (header.session_id != pager->opened_session_id || header.change_counter > pager->opened_change_counter))
+		return false;
+
+	*change_counter = header.change_counter;
+	return true;
+}
+
+static void write_at(FILE* file_ptr, uint64_t offset, const void* data, uint64_t length)
+{
+	if (file_seek(file_ptr, (int64_t)offset, SEEK_SET) != 0 || fwrite(data, 1, length, file_ptr) < length)
+	{
+		perror("backup write error");
+		exit(EXIT_FAILURE);
+	}
+}
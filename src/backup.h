@@ -0,0 +1,38 @@
+#ifndef BACKUP_H
+#define BACKUP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "table.h"
+
+// Online backups. Pages are copied a chunk at a time while the database stays
+// open; statements may run between steps, and pages they change are copied
+// again before the backup completes. When the destination already holds a
+// backup of the same database, only pages changed since then are copied.
+
+#define BACKUP_STEP_PAGES 256
+
+typedef struct
+{
+	Pager* pager;
+	FILE* file_ptr;
+	void* page;
+	bool copy_all;       // first pass of a full backup
+	uint64_t since;      // pages changed after this counter are copied
+	uint64_t pass_start; // change counter when the current pass began
+	uint64_t next_page;
+	uint64_t pages_copied;
+} Backup;
+
+Backup* backup_start(Table* table, const char* filename);
+// Copies up to max_pages pages; returns true once the destination is consistent
+bool backup_step(Backup* backup, uint64_t max_pages);
+// Writes the file header and closes the destination; returns the number of pages copied
+uint64_t backup_finish(Backup* backup);
+
+// Runs a whole backup in steps of BACKUP_STEP_PAGES
+uint64_t table_backup(Table* table, const char* filename);
+
+#endif // BACKUP_H
@@ -0,0 +1,262 @@
+#include "batch.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "search.h"
+#include "stats.h"
+
+// One tight loop per operator; the comparison result advances the output
+// position instead of branching, so the compiler can vectorize the compares.
+#define FILTER_LOOP(batch, compare)                                     \
+	do                                                                  \
+	{                                                                   \
+		uint32_t selected = 0;                                          \
+		for (uint32_t i = 0; i < (batch)->num_selected; ++i)            \
+		{                                                               \
+			uint32_t row = (batch)->selection[i];                       \
+			uint64_t id = (batch)->ids[row];                            \
+			(batch)->selection[selected] = row;                         \
+			selected += (compare);                                      \
+		}                                                               \
+		(batch)->num_selected = selected;                               \
+	} while (0)
+
+
+RowBatch* batch_new(uint32_t columns)
+{
+	RowBatch* batch = calloc(1, sizeof(RowBatch));
+	if (!batch)
+	{
+		perror("calloc error");
+		exit(EXIT_FAILURE);
+	}
+
+	batch->columns = columns;
+	if (columns & COLUMN_BIT(COLUMN_USERNAME))
+		batch->usernames = malloc(BATCH_SIZE * sizeof(*batch->usernames));
+	if (columns & COLUMN_BIT(COLUMN_EMAIL))
+		batch->emails = malloc(BATCH_SIZE * sizeof(*batch->emails));
+	if (((columns & COLUMN_BIT(COLUMN_USERNAME)) && !batch->usernames) ||
+		((columns & COLUMN_BIT(COLUMN_EMAIL)) && !batch->emails))
+	{
+		perror("malloc error");
+		exit(EXIT_FAILURE);
+	}
+	return batch;
+}
+
+void batch_free(RowBatch* batch)
+{
+	free(batch->usernames);
+	free(batch->emails);
+	free(batch);
+}
+
+void batch_scan_start(BatchScan* scan, Table* table)
+{
+	batch_scan_start_range(scan, table, 0, UINT64_MAX);
+}
+
+void batch_scan_start_range(BatchScan* scan, Table* table, uint64_t first_key, uint64_t last_key)
+{
+	Cursor* cursor = table_find(table, first_key);
+	void* node = get_page(table->pager, cursor->page_num);
+	uint32_t num_cells = *leaf_node_num_cells(node);
+
+	scan->table = table;
+	scan->page_num = num_cells > 0 ? cursor->page_num : 0;
+	scan->cell_num = cursor->cell_num;
+	scan->last_key = last_key;
+	scan->batch_size = 0;
+	free(cursor);
+
+	// the seek lands past the last cell when every key in its leaf is smaller
+	if (scan->page_num != 0 && scan->cell_num == num_cells)
+	{
+		scan->page_num = *leaf_node_next_leaf(node);
+		scan->cell_num = 0;
+	}
+}
+
+void batch_scan_start_at(BatchScan* scan, Cursor* cursor, uint64_t last_key)
+{
+	scan->table = cursor->table;
+	scan->page_num = cursor->end_of_table ? 0 : cursor->page_num;
+	scan->cell_num = cursor->cell_num;
+	scan->last_key = last_key;
+	scan->batch_size = 0;
+}
+
+bool batch_scan_next(BatchScan* scan, RowBatch* batch)
+{
+	uint32_t batch_size = scan->batch_size ? scan->batch_size : BATCH_SIZE;
+	batch->num_rows = 0;
+	batch->num_selected = 0;
+
+	while (scan->page_num != 0 && batch->num_rows < batch_size)
+	{
+		void* node = get_page(scan->table->pager, scan->page_num);
+		uint32_t num_cells = *leaf_node_num_cells(node);
+		uint32_t count = num_cells - scan->cell_num;
+		if (count > batch_size - batch->num_rows)
+			count = batch_size - batch->num_rows;
+
+		bool past_range = false;
+		if (scan->last_key != UINT64_MAX)
+		{
+			uint32_t in_range = key_lower_bound(leaf_node_key(node, scan->cell_num), count, scan->last_key + 1);
+			past_range = in_range < count;
+			count = in_range;
+		}
+
+		// keys are stored contiguously, so the id vector is a straight copy
+		memcpy(batch->ids + batch->num_rows, leaf_node_key(node, scan->cell_num), count * sizeof(uint64_t));
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			uint32_t cell_num = scan->cell_num + i;
+			uint32_t row = batch->num_rows + i;
+			if (batch->usernames)
+				memcpy(batch->usernames[row], leaf_node_column(node, cell_num, COLUMN_USERNAME), sizeof(batch->usernames[row]));
+			if (batch->emails)
+				memcpy(batch->emails[row], leaf_node_column(node, cell_num, COLUMN_EMAIL), sizeof(batch->emails[row]));
+
+			batch->selection[batch->num_selected] = row;
+			batch->num_selected += !leaf_node_is_deleted(node, cell_num);
+		}
+
+		stats_add(STAT_ROWS_EXAMINED, count);
+		batch->num_rows += count;
+		scan->cell_num += count;
+		if (past_range)
+			scan->page_num = 0;
+		else if (scan->cell_num == num_cells)
+		{
+			scan->page_num = *leaf_node_next_leaf(node);
+			scan->cell_num = 0;
+		}
+	}
+
+	return batch->num_rows > 0;
+}
+
+bool id_filter_matches(const IdFilter* filter, uint64_t id)
+{
+	if (!filter->active)
+		return true;
+
+	switch (filter->op)
+	{
+	case COMPARE_EQUAL:
+		return id == filter->value;
+	case COMPARE_NOT_EQUAL:
+		return id != filter->value;
+	case COMPARE_LESS:
+		return id < filter->value;
+	case COMPARE_LESS_EQUAL:
+		return id <= filter->value;
+	case COMPARE_GREATER:
+		return id > filter->value;
+	case COMPARE_GREATER_EQUAL:
+		return id >= filter->value;
+	}
+	return false;
+}
+
+bool id_filter_range(const IdFilter* filter, uint64_t* first_key, uint64_t* last_key)
+{
+	*first_key = 0;
+	*last_key = UINT64_MAX;
+	if (!filter->active)
+		return true;
+
+	switch (filter->op)
+	{
+	case COMPARE_EQUAL:
+		*first_key = filter->value;
+		*last_key = filter->value;
+		break;
+	case COMPARE_NOT_EQUAL:
+		break;
+	case COMPARE_LESS:
+		if (filter->value == 0)
+			return false;
+		*last_key = filter->value - 1;
+		break;
+	case COMPARE_LESS_EQUAL:
+		*last_key = filter->value;
+		break;
+	case COMPARE_GREATER:
+		if (filter->value == UINT64_MAX)
+			return false;
+		*first_key = filter->value + 1;
+		break;
+	case COMPARE_GREATER_EQUAL:
+		*first_key = filter->value;
+		break;
+	}
+	return true;
+}
+
+void batch_filter(RowBatch* batch, const IdFilter* filter)
+{
+	if (!filter->active)
+		return;
+
+	uint64_t value = filter->value;
+	switch (filter->op)
+	{
+	case COMPARE_EQUAL:
+		FILTER_LOOP(batch, id == value);
+		break;
+	case COMPARE_NOT_EQUAL:
+		FILTER_LOOP(batch, id != value);
+		break;
+	case COMPARE_LESS:
+		FILTER_LOOP(batch, id < value);
+		break;
+	case COMPARE_LESS_EQUAL:
+		FILTER_LOOP(batch, id <= value);
+		break;
+	case COMPARE_GREATER:
+		FILTER_LOOP(batch, id > value);
+		break;
+	case COMPARE_GREATER_EQUAL:
+		FILTER_LOOP(batch, id >= value);
+		break;
+	}
+}
+
+uint32_t batch_skip(RowBatch* batch, uint64_t count)
+{
+	uint32_t skipped = count < batch->num_selected ? (uint32_t)count : batch->num_selected;
+	memmove(batch->selection, batch->selection + skipped, (batch->num_selected - skipped) * sizeof(uint32_t));
+	batch->num_selected -= skipped;
+	return skipped;
+}
+
+void batch_aggregate(const RowBatch* batch, TableAggregates* aggregates)
+{
+	if (batch->num_selected == 0)
+		return;
+
+	uint64_t sum = 0;
+	uint64_t min = UINT64_MAX;
+	uint64_t max = 0;
+	for (uint32_t i = 0; i < batch->num_selected; ++i)
+	{
+		uint64_t id = batch->ids[batch->selection[i]];
+		sum += id;
+		min = id < min ? id : min;
+		max = id > max ? id : max;
+	}
+
+	if (!aggregates->has_rows || min < aggregates->min)
+		aggregates->min = min;
+	if (!aggregates->has_rows || max > aggregates->max)
+		aggregates->max = max;
+	aggregates->count += batch->num_selected;
+	aggregates->sum += sum;
+	aggregates->has_rows = true;
+}
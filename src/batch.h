@@ -0,0 +1,74 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "aggregate.h"
+#include "table.h"
+
+// Vectorized execution. A scan fills a RowBatch with up to BATCH_SIZE rows stored
+// as column vectors, and kernels narrow or consume its selection vector, which
+// lists the positions of the rows still in play.
+
+#define BATCH_SIZE 1024
+
+typedef enum
+{
+	COMPARE_EQUAL,
+	COMPARE_NOT_EQUAL,
+	COMPARE_LESS,
+	COMPARE_LESS_EQUAL,
+	COMPARE_GREATER,
+	COMPARE_GREATER_EQUAL
+} CompareOperator;
+
+// where id <operator> value
+typedef struct
+{
+	bool active;
+	CompareOperator op;
+	uint64_t value;
+} IdFilter;
+
+typedef struct
+{
+	uint32_t columns; // ids are always filled, the strings only when requested
+	uint32_t num_rows;
+	uint32_t num_selected;
+	uint32_t selection[BATCH_SIZE];
+	uint64_t ids[BATCH_SIZE];
+	char (*usernames)[COLUMN_USERNAME_SIZE + 1];
+	char (*emails)[COLUMN_EMAIL_SIZE + 1];
+} RowBatch;
+
+typedef struct
+{
+	Table* table;
+	uint64_t page_num; // 0 once the last leaf is consumed
+	uint32_t cell_num;
+	uint64_t last_key;
+	uint32_t batch_size; // rows per batch, BATCH_SIZE when 0, so a small limit reads no further than it needs
+} BatchScan;
+
+RowBatch* batch_new(uint32_t columns);
+void batch_free(RowBatch* batch);
+
+void batch_scan_start(BatchScan* scan, Table* table);
+// Seeks to first_key and stops after last_key
+void batch_scan_start_range(BatchScan* scan, Table* table, uint64_t first_key, uint64_t last_key);
+// Starts at the cursor's row and stops after last_key
+void batch_scan_start_at(BatchScan* scan, Cursor* cursor, uint64_t last_key);
+// Fills the next batch, selecting the live rows; returns false when the table is exhausted
+bool batch_scan_next(BatchScan* scan, RowBatch* batch);
+
+bool id_filter_matches(const IdFilter* filter, uint64_t id);
+// The key range a filter can match; false when it matches nothing
+bool id_filter_range(const IdFilter* filter, uint64_t* first_key, uint64_t* last_key);
+void batch_filter(RowBatch* batch, const IdFilter* filter);
+// Drops up to count rows from the front of the selection; returns how many were dropped
+uint32_t batch_skip(RowBatch* batch, uint64_t count);
+// Folds the selected rows into running totals
+void batch_aggregate(const RowBatch* batch, TableAggregates* aggregates);
+
+#endif // BATCH_H
@@ -0,0 +1,200 @@
+#include "bloom.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Odd constants from the Parquet split block Bloom filter, one per word
+static const uint32_t block_salts[BLOOM_BLOCK_WORDS] = {
+	0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+	0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U,
+};
+
+typedef struct
+{
+	uint64_t num_blocks;
+	uint64_t num_keys;
+	uint64_t capacity;
+} BloomLayerHeader;
+
+
+static void layer_add(BloomLayer* layer, uint64_t hash);
+static bool layer_may_contain(const BloomLayer* layer, uint64_t hash);
+static BloomBlock* layer_block(const BloomLayer* layer, uint64_t hash);
+static bool layer_allocate(BloomLayer* layer, uint64_t capacity);
+
+
+void bloom_init(BloomFilter* filter, uint64_t capacity)
+{
+	memset(filter, 0, sizeof(*filter));
+	filter->valid = true;
+	filter->first_capacity = capacity < BLOOM_MIN_CAPACITY ? BLOOM_MIN_CAPACITY : capacity;
+}
+
+void bloom_invalidate(BloomFilter* filter)
+{
+	bloom_free(filter);
+	filter->valid = false;
+}
+
+void bloom_free(BloomFilter* filter)
+{
+	for (uint32_t i = 0; i < filter->num_layers; ++i)
+		free(filter->layers[i].blocks);
+	filter->num_layers = 0;
+}
+
+// splitmix64 finalizer
+uint64_t bloom_hash(uint64_t seed, uint64_t key)
+{
+	uint64_t hash = key ^ (seed * 0x9E3779B97F4A7C15ULL);
+	hash = (hash ^ (hash >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	hash = (hash ^ (hash >> 27)) * 0x94D049BB133111EBULL;
+	return hash ^ (hash >> 31);
+}
+
+void bloom_add(BloomFilter* filter, uint64_t hash)
+{
+	if (!filter->valid)
+		return;
+
+	BloomLayer* layer = filter->num_layers ? &filter->layers[filter->num_layers - 1] : NULL;
+	if (!layer || layer->num_keys >= layer->capacity)
+	{
+		// out of layers, the filter can no longer keep its false positive rate
+		if (filter->num_layers == BLOOM_MAX_LAYERS)
+		{
+			bloom_invalidate(filter);
+			return;
+		}
+
+		uint64_t capacity = layer ? layer->capacity * BLOOM_GROWTH : filter->first_capacity;
+		layer = &filter->layers[filter->num_layers++];
+		if (!layer_allocate(layer, capacity))
+		{
+			perror("calloc error");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	layer_add(layer, hash);
+	layer->num_keys++;
+}
+
+bool bloom_may_contain(const BloomFilter* filter, uint64_t hash)
+{
+	if (!filter->valid)
+		return true;
+
+	for (uint32_t i = 0; i < filter->num_layers; ++i)
+		if (layer_may_contain(&filter->layers[i], hash))
+			return true;
+	return false;
+}
+
+size_t bloom_serialized_size(const BloomFilter* filter)
+{
+	if (!filter->valid)
+		return 0;
+
+	size_t size = 2 * sizeof(uint64_t);
+	for (uint32_t i = 0; i < filter->num_layers; ++i)
+		size += sizeof(BloomLayerHeader) + filter->layers[i].num_blocks * sizeof(BloomBlock);
+	return size;
+}
+
+// first capacity and layer count, then each layer's header and blocks
+void bloom_serialize(const BloomFilter* filter, void* buffer)
+{
+	uint8_t* position = buffer;
+	uint64_t counts[2] = {filter->first_capacity, filter->num_layers};
+	memcpy(position, counts, sizeof(counts));
+	position += sizeof(counts);
+
+	for (uint32_t i = 0; i < filter->num_layers; ++i)
+	{
+		const BloomLayer* layer = &filter->layers[i];
+		BloomLayerHeader header = {layer->num_blocks, layer->num_keys, layer->capacity};
+		memcpy(position, &header, sizeof(header));
+		position += sizeof(header);
+		memcpy(position, layer->blocks, layer->num_blocks * sizeof(BloomBlock));
+		position += layer->num_blocks * sizeof(BloomBlock);
+	}
+}
+
+bool bloom_deserialize(BloomFilter* filter, const void* buffer, size_t length)
+{
+	const uint8_t* position = buffer;
+	const uint8_t* end = position + length;
+	uint64_t counts[2];
+	if (length < sizeof(counts))
+		return false;
+	memcpy(counts, position, sizeof(counts));
+	position += sizeof(counts);
+	if (counts[1] > BLOOM_MAX_LAYERS)
+		return false;
+
+	bloom_init(filter, counts[0]);
+	for (uint32_t i = 0; i < counts[1]; ++i)
+	{
+		BloomLayerHeader header;
+		if ((size_t)(end - position) < sizeof(header))
+			break;
+		memcpy(&header, position, sizeof(header));
+		position += sizeof(header);
+
+		BloomLayer* layer = &filter->layers[filter->num_layers];
+		if (header.num_blocks == 0 || header.num_blocks > (size_t)(end - position) / sizeof(BloomBlock)
+			|| !layer_allocate(layer, header.capacity) || layer->num_blocks != header.num_blocks)
+			break;
+		filter->num_layers++;
+
+		memcpy(layer->blocks, position, header.num_blocks * sizeof(BloomBlock));
+		layer->num_keys = header.num_keys;
+		position += header.num_blocks * sizeof(BloomBlock);
+	}
+
+	if (filter->num_layers != counts[1] || position != end)
+	{
+		bloom_invalidate(filter);
+		return false;
+	}
+	return true;
+}
+
+static void layer_add(BloomLayer* layer, uint64_t hash)
+{
+	BloomBlock* block = layer_block(layer, hash);
+	uint32_t key = (uint32_t)hash;
+	for (uint32_t i = 0; i < BLOOM_BLOCK_WORDS; ++i)
+		block->words[i] |= 1u << ((key * block_salts[i]) >> 27);
+}
+
+static bool layer_may_contain(const BloomLayer* layer, uint64_t hash)
+{
+	const BloomBlock* block = layer_block(layer, hash);
+	uint32_t key = (uint32_t)hash;
+	for (uint32_t i = 0; i < BLOOM_BLOCK_WORDS; ++i)
+		if (!(block->words[i] & (1u << ((key * block_salts[i]) >> 27))))
+			return false;
+	return true;
+}
+
+// The upper half of the hash picks the block without a division
+static BloomBlock* layer_block(const BloomLayer* layer, uint64_t hash)
+{
+	return &layer->blocks[((hash >> 32) * layer->num_blocks) >> 32];
+}
+
+static bool layer_allocate(BloomLayer* layer, uint64_t capacity)
+{
+	uint64_t num_blocks = (capacity * BLOOM_BITS_PER_KEY + sizeof(BloomBlock) * 8 - 1) / (sizeof(BloomBlock) * 8);
+	if (capacity == 0 || num_blocks > UINT32_MAX)
+		return false;
+
+	layer->blocks = calloc(num_blocks, sizeof(BloomBlock));
+	layer->num_blocks = num_blocks;
+	layer->num_keys = 0;
+	layer->capacity = capacity;
+	return layer->blocks != NULL;
+}
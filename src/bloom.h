@@ -0,0 +1,56 @@
+#ifndef BLOOM_H
+#define BLOOM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Split block Bloom filter over 64-bit hashes. Each hash picks one 256-bit
+// block and sets a bit in each of its eight words, so a lookup touches a single
+// cache line per layer. Keys cannot be rehashed once a layer fills up, so a
+// full layer is kept and a bigger one takes further keys; small databases keep
+// a small filter, and a large one needs only a few layers.
+
+#define BLOOM_BLOCK_WORDS 8
+#define BLOOM_BITS_PER_KEY 16
+#define BLOOM_MIN_CAPACITY 256
+#define BLOOM_GROWTH 4
+#define BLOOM_MAX_LAYERS 12
+
+typedef struct
+{
+	uint32_t words[BLOOM_BLOCK_WORDS];
+} BloomBlock;
+
+typedef struct
+{
+	BloomBlock* blocks;
+	uint64_t num_blocks;
+	uint64_t num_keys;
+	uint64_t capacity;
+} BloomLayer;
+
+typedef struct
+{
+	bool valid; // false when keys may have been added behind its back, so it cannot rule anything out
+	uint64_t first_capacity;
+	uint32_t num_layers;
+	BloomLayer layers[BLOOM_MAX_LAYERS];
+} BloomFilter;
+
+// Layers are allocated as keys arrive; capacity sizes the first one
+void bloom_init(BloomFilter* filter, uint64_t capacity);
+void bloom_invalidate(BloomFilter* filter);
+void bloom_free(BloomFilter* filter);
+
+uint64_t bloom_hash(uint64_t seed, uint64_t key);
+void bloom_add(BloomFilter* filter, uint64_t hash);
+// False means the hash was never added
+bool bloom_may_contain(const BloomFilter* filter, uint64_t hash);
+
+// An invalid filter serializes to nothing
+size_t bloom_serialized_size(const BloomFilter* filter);
+void bloom_serialize(const BloomFilter* filter, void* buffer);
+bool bloom_deserialize(BloomFilter* filter, const void* buffer, size_t length);
+
+#endif // BLOOM_H
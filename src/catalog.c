@@ -0,0 +1,215 @@
+#include "catalog.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "table.h"
+
+
+static bool catalog_open(Table* table, Table* catalog);
+static Cursor* catalog_seek(Table* catalog, const char* name);
+static void decode_entry(Row* row, CatalogEntry* entry);
+static void free_tree(Pager* pager, uint64_t page_num);
+
+
+bool catalog_find_table(Table* table, const char* name, Table* result)
+{
+	Table catalog;
+	if (!catalog_open(table, &catalog))
+		return false;
+
+	Cursor* cursor = catalog_seek(&catalog, name);
+	bool found = !cursor->end_of_table;
+	if (found)
+	{
+		Row row;
+		CatalogEntry entry;
+		cursor_read_row(cursor, &row, ALL_COLUMNS);
+		decode_entry(&row, &entry);
+
+		result->pager = table->pager;
+		result->root_page_num = entry.root_page_num;
+	}
+
+	free(cursor);
+	return found;
+}
+
+bool catalog_create_table(Table* table, const char* name)
+{
+	Pager* pager = table->pager;
+	if (pager->catalog_root_page == 0)
+	{
+		pager->catalog_root_page = get_unused_page_num(pager);
+		void* root = get_page(pager, pager->catalog_root_page);
+		initialize_node(root, NODE_LEAF, pager->page_size);
+		set_node_root(root, true);
+	}
+
+	Table catalog;
+	catalog_open(table, &catalog);
+
+	Cursor* cursor = catalog_seek(&catalog, name);
+	bool exists = !cursor->end_of_table;
+	free(cursor);
+	if (exists)
+		return false;
+
+	// new tables use the leaf layout the database was created with
+	cursor = table_start(table);
+	LeafLayout layout = *leaf_node_layout(get_page(pager, cursor->page_num));
+	free(cursor);
+
+	uint64_t root_page_num = get_unused_page_num(pager);
+	void* root = get_page(pager, root_page_num);
+	initialize_node(root, NODE_LEAF, pager->page_size);
+	set_node_root(root, true);
+	*leaf_node_layout(root) = layout;
+
+	// ids are never reused, and dropped tables keep their key, so the next id follows the last key
+	uint64_t table_id = 1;
+	void* catalog_root = get_page(pager, catalog.root_page_num);
+	if (get_node_type(catalog_root) == NODE_INTERNAL || *leaf_node_num_cells(catalog_root) > 0)
+		table_id = get_node_max_key(pager, catalog_root) + 1;
+
+	Row row = {0};
+	row.id = table_id;
+	strncpy(row.username, name, TABLE_NAME_SIZE);
+	snprintf(row.email, sizeof(row.email), "%" PRIu64 " id integer, username varchar(%d), email varchar(%d)",
+		root_page_num, COLUMN_USERNAME_SIZE, COLUMN_EMAIL_SIZE);
+
+	cursor = table_find(&catalog, table_id);
+	leaf_node_insert(cursor, table_id, &row);
+	free(cursor);
+	return true;
+}
+
+bool catalog_drop_table(Table* table, const char* name)
+{
+	Table catalog;
+	if (!catalog_open(table, &catalog))
+		return false;
+
+	Cursor* cursor = catalog_seek(&catalog, name);
+	if (cursor->end_of_table)
+	{
+		free(cursor);
+		return false;
+	}
+
+	Row row;
+	CatalogEntry entry;
+	cursor_read_row(cursor, &row, ALL_COLUMNS);
+	decode_entry(&row, &entry);
+
+	cursor_delete(cursor);
+	free(cursor);
+
+	free_tree(table->pager, entry.root_page_num);
+	return true;
+}
+
+bool catalog_set_table_root(Table* table, const char* name, uint64_t root_page_num)
+{
+	Table catalog;
+	if (!catalog_open(table, &catalog))
+		return false;
+
+	Cursor* cursor = catalog_seek(&catalog, name);
+	bool found = !cursor->end_of_table;
+	if (found)
+	{
+		Row row;
+		CatalogEntry entry;
+		cursor_read_row(cursor, &row, ALL_COLUMNS);
+		decode_entry(&row, &entry);
+
+		// a longer page number leaves less room for the column definitions
+		int prefix_length = snprintf(NULL, 0, "%" PRIu64 " ", root_page_num);
+		snprintf(row.email, sizeof(row.email), "%" PRIu64 " %.*s", root_page_num,
+			(int)sizeof(row.email) - 1 - prefix_length, entry.columns);
+		cursor_write_row(cursor, &row);
+	}
+
+	free(cursor);
+	return found;
+}
+
+uint32_t catalog_list_tables(Table* table, CatalogEntry** entries)
+{
+	uint32_t num_tables = 0;
+	uint32_t capacity = 0;
+	*entries = NULL;
+
+	Table catalog;
+	if (!catalog_open(table, &catalog))
+		return 0;
+
+	Cursor* cursor = table_start(&catalog);
+	for (; !cursor->end_of_table; cursor_advance(cursor))
+	{
+		if (cursor_is_deleted(cursor))
+			continue;
+
+		if (num_tables == capacity)
+		{
+			capacity = capacity ? capacity * 2 : 8;
+			CatalogEntry* grown = realloc(*entries, capacity * sizeof(CatalogEntry));
+			if (!grown)
+			{
+				perror("realloc error");
+				exit(EXIT_FAILURE);
+			}
+			*entries = grown;
+		}
+
+		Row row;
+		cursor_read_row(cursor, &row, ALL_COLUMNS);
+		decode_entry(&row, &(*entries)[num_tables++]);
+	}
+
+	free(cursor);
+	return num_tables;
+}
+
+static bool catalog_open(Table* table, Table* catalog)
+{
+	catalog->pager = table->pager;
+	catalog->root_page_num = table->pager->catalog_root_page;
+	return catalog->root_page_num != 0;
+}
+
+// Leaves the cursor on the named table, or at the end of the catalog if there is none
+static Cursor* catalog_seek(Table* catalog, const char* name)
+{
+	Cursor* cursor = table_start(catalog);
+	for (; !cursor->end_of_table; cursor_advance(cursor))
+	{
+		Row row;
+		cursor_read_row(cursor, &row, COLUMN_BIT(COLUMN_USERNAME));
+		if (!cursor_is_deleted(cursor) && strcmp(row.username, name) == 0)
+			break;
+	}
+	return cursor;
+}
+
+static void decode_entry(Row* row, CatalogEntry* entry)
+{
+	char* columns;
+	strcpy(entry->name, row->username);
+	entry->root_page_num = strtoull(row->email, &columns, 10);
+	strcpy(entry->columns, *columns == ' ' ? columns + 1 : columns);
+}
+
+static void free_tree(Pager* pager, uint64_t page_num)
+{
+	void* node = get_page(pager, page_num);
+	if (get_node_type(node) == NODE_INTERNAL)
+		for (uint32_t i = 0; i <= *internal_node_num_keys(node); ++i)
+			free_tree(pager, *internal_node_child(node, i));
+
+	pager_free_page(pager, page_num);
+}
@@ -0,0 +1,32 @@
+#ifndef CATALOG_H
+#define CATALOG_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "table.h"
+
+// The catalog is a B+tree whose root is recorded in the file header. Each row
+// describes one table: the key is the table id, the username column holds the
+// name and the email column holds the root page followed by the column definitions.
+// The table opened by db_open is the unnamed default table and is not listed.
+
+#define TABLE_NAME_SIZE COLUMN_USERNAME_SIZE
+
+typedef struct
+{
+	char name[TABLE_NAME_SIZE + 1];
+	uint64_t root_page_num;
+	char columns[COLUMN_EMAIL_SIZE + 1];
+} CatalogEntry;
+
+bool catalog_find_table(Table* table, const char* name, Table* result);
+bool catalog_create_table(Table* table, const char* name);
+bool catalog_drop_table(Table* table, const char* name);
+// Points a table at a new root page, for when its tree has been rebuilt elsewhere
+bool catalog_set_table_root(Table* table, const char* name, uint64_t root_page_num);
+
+// Returns the number of tables; the caller frees *entries
+uint32_t catalog_list_tables(Table* table, CatalogEntry** entries);
+
+#endif // CATALOG_H
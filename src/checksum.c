@@ -0,0 +1,95 @@
+#include "checksum.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "cpu.h"
+#include "thread.h"
+
+#if defined(CPU_X86)
+#include <nmmintrin.h>
+#endif
+
+#if defined(CPU_X86) && defined(__GNUC__)
+#define TARGET_SSE42 __attribute__((target("sse4.2")))
+#else
+#define TARGET_SSE42
+#endif
+
+#define CRC32C_POLYNOMIAL 0x82F63B78
+
+
+static void crc32c_init(void);
+static uint32_t crc32c_software(uint32_t crc, const uint8_t* data, size_t length);
+#if defined(CPU_X86)
+static uint32_t crc32c_hardware(uint32_t crc, const uint8_t* data, size_t length);
+#endif
+
+// Filled once, before the first checksum, so page reads on any thread share them
+static Once crc32c_once = ONCE_INITIALIZER;
+static uint32_t crc32c_table[256];
+static bool has_sse42 = false;
+
+
+uint32_t crc32c(const void* data, size_t length)
+{
+	thread_once(&crc32c_once, crc32c_init);
+
+	uint32_t crc = 0xFFFFFFFF;
+#if defined(CPU_X86)
+	if (has_sse42)
+		return ~crc32c_hardware(crc, data, length);
+#endif
+	return ~crc32c_software(crc, data, length);
+}
+
+static void crc32c_init(void)
+{
+	for (uint32_t i = 0; i < 256; ++i)
+	{
+		uint32_t value = i;
+		for (int bit = 0; bit < 8; ++bit)
+			value = (value & 1) ? (value >> 1) ^ CRC32C_POLYNOMIAL : value >> 1;
+		crc32c_table[i] = value;
+	}
+	has_sse42 = cpu_has_sse42();
+}
+
+static uint32_t crc32c_software(uint32_t crc, const uint8_t* data, size_t length)
+{
+	for (size_t i = 0; i < length; ++i)
+		crc = crc32c_table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+
+	return crc;
+}
+
+#if defined(CPU_X86)
+TARGET_SSE42 static uint32_t crc32c_hardware(uint32_t crc, const uint8_t* data, size_t length)
+{
+#if defined(CPU_X86_64)
+	uint64_t crc64 = crc;
+	while (length >= sizeof(uint64_t))
+	{
+		uint64_t word;
+		memcpy(&word, data, sizeof(word));
+		crc64 = _mm_crc32_u64(crc64, word);
+		data += sizeof(word);
+		length -= sizeof(word);
+	}
+	crc = (uint32_t)crc64;
+#endif
+	while (length >= sizeof(uint32_t))
+	{
+		uint32_t word;
+		memcpy(&word, data, sizeof(word));
+		crc = _mm_crc32_u32(crc, word);
+		data += sizeof(word);
+		length -= sizeof(word);
+	}
+	while (length--)
+		crc = _mm_crc32_u8(crc, *data++);
+
+	return crc;
+}
+#endif
@@ -0,0 +1,83 @@
+#include "compress.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define MAX_RUN_LENGTH 128
+#define MIN_REPEAT_LENGTH 3
+
+
+size_t page_compress(const void* source, size_t length, void* destination)
+{
+	const uint8_t* input = source;
+	uint8_t* output = destination;
+	size_t in = 0;
+	size_t out = 0;
+
+	while (in < length)
+	{
+		size_t run = 1;
+		while (in + run < length && run < MAX_RUN_LENGTH && input[in + run] == input[in])
+			run++;
+
+		if (run >= MIN_REPEAT_LENGTH)
+		{
+			output[out++] = (uint8_t)(257 - run);
+			output[out++] = input[in];
+			in += run;
+			continue;
+		}
+
+		size_t start = in;
+		size_t literal_length = 0;
+		while (in < length && literal_length < MAX_RUN_LENGTH)
+		{
+			if (in + 2 < length && input[in] == input[in + 1] && input[in] == input[in + 2])
+				break;
+			in++;
+			literal_length++;
+		}
+
+		output[out++] = (uint8_t)(literal_length - 1);
+		memcpy(output + out, input + start, literal_length);
+		out += literal_length;
+	}
+
+	return out;
+}
+
+bool page_decompress(const void* source, size_t source_length, void* destination, size_t destination_length)
+{
+	const uint8_t* input = source;
+	uint8_t* output = destination;
+	size_t in = 0;
+	size_t out = 0;
+
+	while (in < source_length)
+	{
+		uint8_t header = input[in++];
+		if (header < 128)
+		{
+			size_t literal_length = (size_t)header + 1;
+			if (in + literal_length > source_length || out + literal_length > destination_length)
+				return false;
+
+			memcpy(output + out, input + in, literal_length);
+			in += literal_length;
+			out += literal_length;
+		}
+		else if (header > 128)
+		{
+			size_t run = 257 - (size_t)header;
+			if (in >= source_length || out + run > destination_length)
+				return false;
+
+			memset(output + out, input[in++], run);
+			out += run;
+		}
+	}
+
+	return out == destination_length;
+}
@@ -0,0 +1,12 @@
+#ifndef COMPRESS_H
+#define COMPRESS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// PackBits run-length coding. The destination of page_compress must hold
+// length + length / 128 + 1 bytes.
+size_t page_compress(const void* source, size_t length, void* destination);
+bool page_decompress(const void* source, size_t source_length, void* destination, size_t destination_length);
+
+#endif // COMPRESS_H
@@ -0,0 +1,36 @@
+#include "cpu.h"
+
+#if defined(CPU_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+
+bool cpu_has_sse42(void)
+{
+#if defined(CPU_X86) && defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 1);
+	return (info[2] & (1 << 20)) != 0;
+#elif defined(CPU_X86) && defined(__GNUC__)
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("sse4.2");
+#else
+	return false;
+#endif
+}
+
+bool cpu_has_avx2(void)
+{
+#if defined(CPU_X86) && defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 1);
+	bool os_saves_ymm = (info[2] & (1 << 27)) && (_xgetbv(0) & 0x6) == 0x6;
+	__cpuidex(info, 7, 0);
+	return os_saves_ymm && (info[1] & (1 << 5)) != 0;
+#elif defined(CPU_X86) && defined(__GNUC__)
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2");
+#else
+	return false;
+#endif
+}
@@ -0,0 +1,17 @@
+#ifndef CPU_H
+#define CPU_H
+
+#include <stdbool.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define CPU_X86 1
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define CPU_X86_64 1
+#endif
+
+bool cpu_has_sse42(void);
+bool cpu_has_avx2(void);
+
+#endif // CPU_H
@@ -0,0 +1,125 @@
+#include "hash_index.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+static HashIndexEntry* index_bucket(HashIndex* index, uint64_t root_page_num, uint64_t key);
+
+
+void hash_index_init(HashIndex* index, uint64_t max_entries)
+{
+	index->entries = NULL;
+	index->num_buckets = 0;
+	index->bucket_bits = 0;
+	if (max_entries < HASH_INDEX_WAYS)
+		return;
+
+	while (((uint64_t)HASH_INDEX_WAYS << (index->bucket_bits + 1)) <= max_entries && index->bucket_bits < 32)
+		index->bucket_bits++;
+	index->num_buckets = (uint64_t)1 << index->bucket_bits;
+
+	index->entries = calloc(index->num_buckets * HASH_INDEX_WAYS, sizeof(HashIndexEntry));
+	if (!index->entries)
+	{
+		perror("calloc error");
+		exit(EXIT_FAILURE);
+	}
+}
+
+void hash_index_free(HashIndex* index)
+{
+	free(index->entries);
+	index->entries = NULL;
+	index->num_buckets = 0;
+}
+
+void hash_index_clear(HashIndex* index)
+{
+	if (index->entries)
+		memset(index->entries, 0, index->num_buckets * HASH_INDEX_WAYS * sizeof(HashIndexEntry));
+}
+
+uint64_t hash_index_capacity(const HashIndex* index)
+{
+	return index->num_buckets * HASH_INDEX_WAYS;
+}
+
+HashIndexEntry* hash_index_find(HashIndex* index, uint64_t root_page_num, uint64_t key)
+{
+	if (!index->entries)
+		return NULL;
+
+	HashIndexEntry* bucket = index_bucket(index, root_page_num, key);
+	for (uint32_t i = 0; i < HASH_INDEX_WAYS; ++i)
+	{
+		HashIndexEntry* entry = &bucket[i];
+		if (entry->page_num != 0 && entry->key == key && entry->root_page_num == root_page_num)
+		{
+			if (entry->hits < HASH_INDEX_MAX_HITS)
+				entry->hits++;
+			return entry;
+		}
+	}
+	return NULL;
+}
+
+void hash_index_record(HashIndex* index, uint64_t root_page_num, uint64_t key, uint64_t page_num, uint32_t cell_num)
+{
+	if (!index->entries)
+		return;
+
+	HashIndexEntry* bucket = index_bucket(index, root_page_num, key);
+	HashIndexEntry* coldest = &bucket[0];
+	for (uint32_t i = 0; i < HASH_INDEX_WAYS; ++i)
+	{
+		HashIndexEntry* entry = &bucket[i];
+		if (entry->page_num != 0 && entry->key == key && entry->root_page_num == root_page_num)
+		{
+			entry->page_num = page_num;
+			entry->cell_num = cell_num;
+			return;
+		}
+		if (entry->page_num == 0 || (coldest->page_num != 0 && entry->hits < coldest->hits))
+			coldest = entry;
+	}
+
+	if (coldest->page_num != 0 && coldest->hits > 0)
+	{
+		coldest->hits--;
+		return;
+	}
+	*coldest = (HashIndexEntry){root_page_num, key, page_num, cell_num, 1};
+}
+
+void hash_index_move(HashIndex* index, uint64_t root_page_num, uint64_t key, uint64_t page_num, uint32_t cell_num)
+{
+	if (!index->entries)
+		return;
+
+	HashIndexEntry* bucket = index_bucket(index, root_page_num, key);
+	for (uint32_t i = 0; i < HASH_INDEX_WAYS; ++i)
+	{
+		HashIndexEntry* entry = &bucket[i];
+		if (entry->page_num != 0 && entry->key == key && entry->root_page_num == root_page_num)
+		{
+			entry->page_num = page_num;
+			entry->cell_num = cell_num;
+			return;
+		}
+	}
+}
+
+void hash_index_remove(HashIndexEntry* entry)
+{
+	memset(entry, 0, sizeof(*entry));
+}
+
+// Fibonacci hashing keeps consecutive ids in different buckets
+static HashIndexEntry* index_bucket(HashIndex* index, uint64_t root_page_num, uint64_t key)
+{
+	uint64_t hash = (key ^ (root_page_num << 48 | root_page_num >> 16)) * 0x9E3779B97F4A7C15ULL;
+	uint64_t bucket = index->bucket_bits ? hash >> (64 - index->bucket_bits) : 0;
+	return &index->entries[bucket * HASH_INDEX_WAYS];
+}
@@ -0,0 +1,47 @@
+#ifndef HASH_INDEX_H
+#define HASH_INDEX_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Adaptive hash index from (tree root, key) to the leaf slot the key was last
+// found in. It only remembers keys, so entries may be stale after cells move
+// and every hit has to be checked against the page. Buckets hold a few entries
+// with small hit counts; a key that misses takes the coldest entry of its
+// bucket only once that entry's count has decayed to zero, so a run of one-off
+// lookups cannot flush the hot keys.
+
+#define HASH_INDEX_WAYS 4
+#define HASH_INDEX_MAX_HITS 15
+#define HASH_INDEX_DEFAULT_ENTRIES 16384
+
+typedef struct
+{
+	uint64_t root_page_num;
+	uint64_t key;
+	uint64_t page_num; // 0 when the entry is empty
+	uint32_t cell_num;
+	uint32_t hits;
+} HashIndexEntry;
+
+typedef struct
+{
+	HashIndexEntry* entries;
+	uint64_t num_buckets;
+	uint32_t bucket_bits;
+} HashIndex;
+
+// Rounds max_entries down to a power of two; 0 turns the index off
+void hash_index_init(HashIndex* index, uint64_t max_entries);
+void hash_index_free(HashIndex* index);
+void hash_index_clear(HashIndex* index);
+uint64_t hash_index_capacity(const HashIndex* index);
+
+HashIndexEntry* hash_index_find(HashIndex* index, uint64_t root_page_num, uint64_t key);
+// Called with the slot a descent found the key in
+void hash_index_record(HashIndex* index, uint64_t root_page_num, uint64_t key, uint64_t page_num, uint32_t cell_num);
+// Repoints an existing entry after its cell moved
+void hash_index_move(HashIndex* index, uint64_t root_page_num, uint64_t key, uint64_t page_num, uint32_t cell_num);
+void hash_index_remove(HashIndexEntry* entry);
+
+#endif // HASH_INDEX_H
@@ -0,0 +1,460 @@
+#include "join.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "stats.h"
+
+#define JOIN_PARTITION_BUFFER_SIZE (64 * 1024)
+
+
+typedef struct
+{
+	uint64_t hash;
+	uint32_t row;
+} JoinEntry;
+
+// Build rows in load order; after build_index the entries are grouped by bucket,
+// bucket b holding entries[bucket_start[b]] up to entries[bucket_start[b + 1]]
+typedef struct
+{
+	Row* rows;
+	JoinEntry* entries;
+	uint32_t* bucket_start;
+	uint32_t num_rows;
+	uint32_t capacity;
+	uint32_t bucket_bits;
+} BuildTable;
+
+// Rows from a table scan, or from a partition file once a join has spilled
+typedef struct
+{
+	FILE* file;
+	BatchScan scan;
+	RowBatch* batch;
+	const IdFilter* filter;
+	uint32_t position;
+} RowSource;
+
+typedef struct
+{
+	Column build_column; // of the right table
+	Column probe_column; // of the left table
+	uint32_t max_rows;
+	JoinRowFunction emit;
+	void* context;
+	Row* probe_rows;
+	uint64_t* probe_hashes;
+	uint32_t* probe_order;
+} HashJoin;
+
+static uint64_t memory_limit = JOIN_DEFAULT_MEMORY;
+
+static void join_sources(HashJoin* join, RowSource* build_source, RowSource* probe_source, uint32_t depth);
+
+
+void join_set_memory_limit(uint64_t bytes)
+{
+	memory_limit = bytes;
+}
+
+uint64_t join_memory_limit(void)
+{
+	return memory_limit;
+}
+
+static void* checked_malloc(size_t size)
+{
+	void* pointer = malloc(size);
+	if (!pointer)
+	{
+		perror("malloc error");
+		exit(EXIT_FAILURE);
+	}
+	return pointer;
+}
+
+// The finalizer of MurmurHash3, so nearby ids land in unrelated buckets and partitions
+static uint64_t mix(uint64_t hash)
+{
+	hash ^= hash >> 33;
+	hash *= 0xFF51AFD7ED558CCDULL;
+	hash ^= hash >> 33;
+	hash *= 0xC4CEB9FE1A85EC53ULL;
+	hash ^= hash >> 33;
+	return hash;
+}
+
+static const char* column_value(const Row* row, Column column)
+{
+	return column == COLUMN_USERNAME ? row->username : row->email;
+}
+
+static uint64_t join_hash(const Row* row, Column column)
+{
+	if (column == COLUMN_ID)
+		return mix(row->id);
+
+	// FNV-1a over the string
+	uint64_t hash = 0xCBF29CE484222325ULL;
+	for (const char* c = column_value(row, column); *c; ++c)
+	{
+		hash ^= (unsigned char)*c;
+		hash *= 0x100000001B3ULL;
+	}
+	return mix(hash);
+}
+
+// Ids only ever join with ids
+static bool join_values_equal(const Row* left, Column left_column, const Row* right, Column right_column)
+{
+	if (left_column == COLUMN_ID)
+		return left->id == right->id;
+	return strcmp(column_value(left, left_column), column_value(right, right_column)) == 0;
+}
+
+// Temporary files are removed when they are closed or the process exits
+static FILE* open_partition(void)
+{
+	FILE* file = tmpfile();
+	if (!file)
+	{
+		perror("tmpfile error");
+		exit(EXIT_FAILURE);
+	}
+	setvbuf(file, NULL, _IOFBF, JOIN_PARTITION_BUFFER_SIZE);
+	return file;
+}
+
+static void write_row(FILE* file, const Row* row)
+{
+	if (fwrite(row, sizeof(Row), 1, file) != 1)
+	{
+		perror("fwrite error");
+		exit(EXIT_FAILURE);
+	}
+}
+
+
+static void source_open_table(RowSource* source, Table* table, const IdFilter* filter, uint32_t columns)
+{
+	memset(source, 0, sizeof(*source));
+	source->batch = batch_new(columns);
+	source->filter = filter;
+
+	uint64_t first_key, last_key;
+	if (id_filter_range(filter, &first_key, &last_key))
+		batch_scan_start_range(&source->scan, table, first_key, last_key);
+}
+
+static void source_open_file(RowSource* source, FILE* file)
+{
+	memset(source, 0, sizeof(*source));
+	source->file = file;
+	rewind(file);
+}
+
+static void source_close(RowSource* source)
+{
+	if (source->batch)
+		batch_free(source->batch);
+}
+
+static bool source_next(RowSource* source, Row* row)
+{
+	if (source->file)
+	{
+		if (fread(row, sizeof(Row), 1, source->file) == 1)
+			return true;
+		if (ferror(source->file))
+		{
+			perror("fread error");
+			exit(EXIT_FAILURE);
+		}
+		return false;
+	}
+
+	RowBatch* batch = source->batch;
+	while (source->position == batch->num_selected)
+	{
+		if (!batch_scan_next(&source->scan, batch))
+			return false;
+		batch_filter(batch, source->filter);
+		source->position = 0;
+	}
+
+	uint32_t index = batch->selection[source->position++];
+	row->id = batch->ids[index];
+	if (batch->usernames)
+		memcpy(row->username, batch->usernames[index], sizeof(row->username));
+	else
+		row->username[0] = '\0';
+	if (batch->emails)
+		memcpy(row->email, batch->emails[index], sizeof(row->email));
+	else
+		row->email[0] = '\0';
+	return true;
+}
+
+
+static void build_add(BuildTable* build, const Row* row, uint64_t hash, uint32_t max_rows)
+{
+	if (build->num_rows == build->capacity)
+	{
+		uint64_t capacity = build->capacity ? (uint64_t)build->capacity * 2 : JOIN_PROBE_ROWS;
+		build->capacity = capacity > max_rows ? max_rows : (uint32_t)capacity;
+		build->rows = realloc(build->rows, (size_t)build->capacity * sizeof(Row));
+		build->entries = realloc(build->entries, (size_t)build->capacity * sizeof(JoinEntry));
+		if (!build->rows || !build->entries)
+		{
+			perror("realloc error");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	build->rows[build->num_rows] = *row;
+	build->entries[build->num_rows] = (JoinEntry){hash, build->num_rows};
+	build->num_rows++;
+}
+
+// Groups the entries by bucket with a counting sort; there are about as many buckets as rows
+static void build_index(BuildTable* build)
+{
+	build->bucket_bits = 0;
+	while (((uint64_t)1 << build->bucket_bits) < build->num_rows)
+		build->bucket_bits++;
+	uint64_t num_buckets = (uint64_t)1 << build->bucket_bits;
+	uint64_t mask = num_buckets - 1;
+
+	build->bucket_start = calloc(num_buckets + 1, sizeof(uint32_t));
+	if (!build->bucket_start)
+	{
+		perror("calloc error");
+		exit(EXIT_FAILURE);
+	}
+	for (uint32_t i = 0; i < build->num_rows; ++i)
+		build->bucket_start[(build->entries[i].hash & mask) + 1]++;
+	for (uint64_t b = 0; b < num_buckets; ++b)
+		build->bucket_start[b + 1] += build->bucket_start[b];
+
+	JoinEntry* sorted = checked_malloc(((size_t)build->capacity + 1) * sizeof(JoinEntry));
+	uint32_t* next = checked_malloc(num_buckets * sizeof(uint32_t));
+	memcpy(next, build->bucket_start, num_buckets * sizeof(uint32_t));
+	for (uint32_t i = 0; i < build->num_rows; ++i)
+		sorted[next[build->entries[i].hash & mask]++] = build->entries[i];
+	free(next);
+
+	free(build->entries);
+	build->entries = sorted;
+}
+
+// Keeps the buffers for the next memory load
+static void build_reset(BuildTable* build)
+{
+	free(build->bucket_start);
+	build->bucket_start = NULL;
+	build->num_rows = 0;
+}
+
+static void build_free(BuildTable* build)
+{
+	free(build->rows);
+	free(build->entries);
+	free(build->bucket_start);
+	memset(build, 0, sizeof(*build));
+}
+
+// Returns true when the source ran out before the memory limit
+static bool load_build(HashJoin* join, BuildTable* build, RowSource* source)
+{
+	Row row;
+	while (build->num_rows < join->max_rows)
+	{
+		if (!source_next(source, &row))
+			return true;
+		build_add(build, &row, join_hash(&row, join->build_column), join->max_rows);
+	}
+	return false;
+}
+
+
+// Probes in radix order of the buckets, so consecutive probes read neighbouring entries
+static void probe_chunk(HashJoin* join, const BuildTable* build, uint32_t num_rows)
+{
+	uint32_t radix_bits = build->bucket_bits < JOIN_RADIX_BITS ? build->bucket_bits : JOIN_RADIX_BITS;
+	uint32_t shift = build->bucket_bits - radix_bits;
+	uint64_t mask = ((uint64_t)1 << build->bucket_bits) - 1;
+
+	uint32_t counts[(1u << JOIN_RADIX_BITS) + 1] = {0};
+	for (uint32_t i = 0; i < num_rows; ++i)
+		counts[((join->probe_hashes[i] & mask) >> shift) + 1]++;
+	for (uint32_t radix = 0; radix < (1u << radix_bits); ++radix)
+		counts[radix + 1] += counts[radix];
+	for (uint32_t i = 0; i < num_rows; ++i)
+		join->probe_order[counts[(join->probe_hashes[i] & mask) >> shift]++] = i;
+
+	for (uint32_t k = 0; k < num_rows; ++k)
+	{
+		uint32_t i = join->probe_order[k];
+		uint64_t hash = join->probe_hashes[i];
+		uint64_t bucket = hash & mask;
+		for (uint32_t e = build->bucket_start[bucket]; e < build->bucket_start[bucket + 1]; ++e)
+		{
+			const JoinEntry* entry = &build->entries[e];
+			const Row* match = &build->rows[entry->row];
+			if (entry->hash == hash && join_values_equal(&join->probe_rows[i], join->probe_column, match, join->build_column))
+				join->emit(&join->probe_rows[i], match, join->context);
+		}
+	}
+}
+
+static void probe_all(HashJoin* join, const BuildTable* build, RowSource* source)
+{
+	if (build->num_rows == 0)
+		return;
+
+	for (;;)
+	{
+		uint32_t num_rows = 0;
+		while (num_rows < JOIN_PROBE_ROWS && source_next(source, &join->probe_rows[num_rows]))
+		{
+			join->probe_hashes[num_rows] = join_hash(&join->probe_rows[num_rows], join->probe_column);
+			num_rows++;
+		}
+		if (num_rows > 0)
+			probe_chunk(join, build, num_rows);
+		if (num_rows < JOIN_PROBE_ROWS)
+			return;
+	}
+}
+
+// Splits both sides by the next bits of the hash and joins each pair of partitions;
+// probe rows whose build partition is empty cannot match and are dropped
+static void partition(HashJoin* join, BuildTable* build, RowSource* build_source, RowSource* probe_source, uint32_t depth)
+{
+	uint32_t shift = 64 - JOIN_GRACE_BITS * (depth + 1);
+	FILE* build_files[JOIN_GRACE_PARTITIONS];
+	FILE* probe_files[JOIN_GRACE_PARTITIONS];
+	uint64_t build_rows[JOIN_GRACE_PARTITIONS] = {0};
+	for (uint32_t p = 0; p < JOIN_GRACE_PARTITIONS; ++p)
+	{
+		build_files[p] = open_partition();
+		probe_files[p] = open_partition();
+	}
+	stats_add(STAT_JOIN_PARTITIONS, JOIN_GRACE_PARTITIONS);
+
+	for (uint32_t i = 0; i < build->num_rows; ++i)
+	{
+		uint32_t p = (build->entries[i].hash >> shift) & (JOIN_GRACE_PARTITIONS - 1);
+		write_row(build_files[p], &build->rows[i]);
+		build_rows[p]++;
+	}
+	build_free(build);
+
+	Row row;
+	while (source_next(build_source, &row))
+	{
+		uint32_t p = (join_hash(&row, join->build_column) >> shift) & (JOIN_GRACE_PARTITIONS - 1);
+		write_row(build_files[p], &row);
+		build_rows[p]++;
+	}
+	while (source_next(probe_source, &row))
+	{
+		uint32_t p = (join_hash(&row, join->probe_column) >> shift) & (JOIN_GRACE_PARTITIONS - 1);
+		if (build_rows[p] > 0)
+			write_row(probe_files[p], &row);
+	}
+
+	for (uint32_t p = 0; p < JOIN_GRACE_PARTITIONS; ++p)
+	{
+		if (build_rows[p] > 0)
+		{
+			RowSource build_partition, probe_partition;
+			source_open_file(&build_partition, build_files[p]);
+			source_open_file(&probe_partition, probe_files[p]);
+			join_sources(join, &build_partition, &probe_partition, depth + 1);
+		}
+		fclose(build_files[p]);
+		fclose(probe_files[p]);
+	}
+}
+
+static void join_sources(HashJoin* join, RowSource* build_source, RowSource* probe_source, uint32_t depth)
+{
+	BuildTable build = {0};
+	bool complete = load_build(join, &build, build_source);
+	if (!complete && depth < JOIN_MAX_GRACE_DEPTH)
+	{
+		partition(join, &build, build_source, probe_source, depth);
+		return;
+	}
+
+	// past the last split the probe side is a partition file, which can be read again
+	for (;;)
+	{
+		build_index(&build);
+		probe_all(join, &build, probe_source);
+		if (complete)
+			break;
+		build_reset(&build);
+		rewind(probe_source->file);
+		complete = load_build(join, &build, build_source);
+	}
+	build_free(&build);
+}
+
+void hash_join(Table* left, Table* right, const IdFilter* filter, Column left_column, Column right_column,
+	uint32_t columns, JoinRowFunction emit, void* context)
+{
+	HashJoin join = {0};
+	join.build_column = right_column;
+	join.probe_column = left_column;
+	join.emit = emit;
+	join.context = context;
+
+	// the bucket entries are copied once while they are grouped
+	uint64_t max_rows = memory_limit / (sizeof(Row) + 2 * sizeof(JoinEntry) + sizeof(uint32_t));
+	join.max_rows = max_rows == 0 ? 1 : max_rows > UINT32_MAX / 2 ? UINT32_MAX / 2 : (uint32_t)max_rows;
+
+	join.probe_rows = checked_malloc(JOIN_PROBE_ROWS * sizeof(Row));
+	join.probe_hashes = checked_malloc(JOIN_PROBE_ROWS * sizeof(uint64_t));
+	join.probe_order = checked_malloc(JOIN_PROBE_ROWS * sizeof(uint32_t));
+
+	RowSource build_source, probe_source;
+	IdFilter no_filter = {0};
+	source_open_table(&build_source, right, &no_filter, columns | COLUMN_BIT(right_column));
+	source_open_table(&probe_source, left, filter, columns | COLUMN_BIT(left_column));
+	join_sources(&join, &build_source, &probe_source, 0);
+	source_close(&build_source);
+	source_close(&probe_source);
+
+	free(join.probe_rows);
+	free(join.probe_hashes);
+	free(join.probe_order);
+}
+
+void index_join(Table* left, Table* right, const IdFilter* filter, uint32_t columns, JoinRowFunction emit, void* context)
+{
+	RowSource outer;
+	source_open_table(&outer, left, filter, columns);
+
+	Row row, match = {0};
+	while (source_next(&outer, &row))
+	{
+		// the key filter rules out most ids the right table never had
+		if (!table_may_contain(right, row.id))
+			continue;
+
+		Cursor* cursor = table_find(right, row.id);
+		void* node = get_page(right->pager, cursor->page_num);
+		if (cursor->cell_num < *leaf_node_num_cells(node) && *leaf_node_key(node, cursor->cell_num) == row.id
+			&& !cursor_is_deleted(cursor))
+		{
+			cursor_read_row(cursor, &match, columns | COLUMN_BIT(COLUMN_ID));
+			emit(&row, &match, context);
+		}
+		free(cursor);
+	}
+	source_close(&outer);
+}
@@ -0,0 +1,41 @@
+#ifndef JOIN_H
+#define JOIN_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "batch.h"
+#include "table.h"
+
+// Equi-joins between two tables. The hash join builds on the right table: its
+// rows are loaded up to the join memory limit and indexed by bucket in one
+// contiguous array, and the left rows probe it in chunks ordered by bucket, so
+// each stretch of the table is visited once per chunk. A build side past the
+// limit is split by hash across temporary files on both sides (grace hash join)
+// and each pair of partitions is joined on its own, splitting again if needed.
+// The index join looks up the left table's ids in the right table's tree.
+
+#define JOIN_DEFAULT_MEMORY (64u << 20)
+#define JOIN_GRACE_BITS 4
+#define JOIN_GRACE_PARTITIONS (1u << JOIN_GRACE_BITS)
+// Partitions still too big at this depth hold few distinct keys; their build
+// side is joined a memory load at a time against the whole probe partition
+#define JOIN_MAX_GRACE_DEPTH 3
+#define JOIN_PROBE_ROWS 4096
+#define JOIN_RADIX_BITS 8
+
+// Called for every pair of matching rows
+typedef void (*JoinRowFunction)(const Row* left, const Row* right, void* context);
+
+// Shared by every join; bytes of build rows a join holds in memory before partitioning
+void join_set_memory_limit(uint64_t bytes);
+uint64_t join_memory_limit(void);
+
+// Joins the left rows whose ids pass the filter to the right rows with an equal
+// join column. Only the given columns and the join columns are filled in.
+void hash_join(Table* left, Table* right, const IdFilter* filter, Column left_column, Column right_column,
+	uint32_t columns, JoinRowFunction emit, void* context);
+// Joins on left.id = right.id by seeking the right tree for each left row
+void index_join(Table* left, Table* right, const IdFilter* filter, uint32_t columns, JoinRowFunction emit, void* context);
+
+#endif // JOIN_H
@@ -2,6 +2,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <inttypes.h>
 
 #include "input.h"
 #include "parser.h"
@@ -14,14 +15,30 @@ static void print_prompt(void)
 
 int main(int argc, char* argv[])
 {   
-    char* file_name;
-    if (argc == 2)
-        file_name = argv[1];
-    else
-        file_name = TABLE_FILE;
+    char* file_name = TABLE_FILE;
+    DbOptions options = {0};
 
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--compress") == 0)
+            options.compress_pages = true;
+        else if (strcmp(argv[i], "--pax") == 0)
+            options.leaf_layout = LEAF_LAYOUT_PAX;
+        else if (strcmp(argv[i], "--page-size") == 0 && i + 1 < argc)
+        {
+            options.page_size = (uint32_t)strtoul(argv[++i], NULL, 10);
+            if (!is_valid_page_size(options.page_size))
+            {
+                fprintf(stderr, "Error: Page size must be a power of two from %d to %d.\n", MIN_PAGE_SIZE, MAX_PAGE_SIZE);
+                exit(EXIT_FAILURE);
+            }
+        }
+        else
+            file_name = argv[i];
+    }
 
-    Table* table = db_open(file_name);
+
+    Table* table = db_open_with_options(file_name, &options);
     InputBuffer* input_buffer = new_input_buffer();
 
     while (true)
@@ -38,6 +55,9 @@ int main(int argc, char* argv[])
             case META_COMMAND_UNRECOGNIZED_COMMAND:
                 fprintf(stderr, "Unrecognized command '%s'\n", input_buffer->buffer);
                 continue;
+            case META_COMMAND_CORRUPT_PAGE:
+                fprintf(stderr, "Error: Checksum mismatch on page %" PRIu64 ". Corrupt file.\n", table->pager->corrupt_page_num);
+                continue;
             }
         }
 
@@ -68,11 +88,18 @@ int main(int argc, char* argv[])
         case EXECUTE_DUPLICATE_KEY:
             printf("Error: Duplicate key.\n");
             break;
-        case EXECUTE_TABLE_FULL:
-            fprintf(stderr, "Error: Table full.\n");
-            break;
         case EXECUTE_ID_NOT_FOUND:
-            fprintf(stderr, "Error: ID %d not found.\n", statement.id_to_delete);
+            fprintf(stderr, "Error: ID %" PRIu64 " not found.\n",
+                statement.type == STATEMENT_UPDATE ? statement.where.value : statement.id_to_delete);
+            break;
+        case EXECUTE_TABLE_NOT_FOUND:
+            fprintf(stderr, "Error: Table %s not found.\n", statement.table_name);
+            break;
+        case EXECUTE_TABLE_EXISTS:
+            fprintf(stderr, "Error: Table %s already exists.\n", statement.table_name);
+            break;
+        case EXECUTE_CORRUPT_PAGE:
+            fprintf(stderr, "Error: Checksum mismatch on page %" PRIu64 ". Corrupt file.\n", table->pager->corrupt_page_num);
             break;
         }
     }
@@ -0,0 +1,163 @@
+#include "memtable.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+static MemtableEntry* find_greater_or_equal(Memtable* memtable, uint64_t root_page_num, uint64_t key, MemtableEntry** previous);
+static uint32_t random_height(Memtable* memtable);
+static void* arena_allocate(Memtable* memtable, size_t size);
+
+
+void memtable_init(Memtable* memtable, uint64_t max_entries, uint32_t value_size)
+{
+	memtable->max_entries = max_entries;
+	memtable->num_entries = 0;
+	memtable->value_size = value_size;
+	memtable->height = 1;
+	memtable->random_state = 0x9E3779B97F4A7C15ULL;
+	memtable->blocks = NULL;
+
+	memtable->head = calloc(1, sizeof(MemtableEntry) + MEMTABLE_MAX_HEIGHT * sizeof(MemtableEntry*));
+	if (!memtable->head)
+	{
+		perror("calloc error");
+		exit(EXIT_FAILURE);
+	}
+	memtable->head->height = MEMTABLE_MAX_HEIGHT;
+}
+
+void memtable_free(Memtable* memtable)
+{
+	memtable_clear(memtable);
+	free(memtable->head);
+	memtable->head = NULL;
+}
+
+void memtable_clear(Memtable* memtable)
+{
+	while (memtable->blocks)
+	{
+		MemtableBlock* previous = memtable->blocks->previous;
+		free(memtable->blocks);
+		memtable->blocks = previous;
+	}
+	memset(memtable->head->next, 0, MEMTABLE_MAX_HEIGHT * sizeof(MemtableEntry*));
+	memtable->num_entries = 0;
+	memtable->height = 1;
+}
+
+bool memtable_full(const Memtable* memtable)
+{
+	return memtable->num_entries >= memtable->max_entries;
+}
+
+MemtableEntry* memtable_find(Memtable* memtable, uint64_t root_page_num, uint64_t key)
+{
+	MemtableEntry* entry = find_greater_or_equal(memtable, root_page_num, key, NULL);
+	return entry && entry->root_page_num == root_page_num && entry->key == key ? entry : NULL;
+}
+
+bool memtable_put(Memtable* memtable, uint64_t root_page_num, uint64_t key, const void* value, bool replace)
+{
+	MemtableEntry* previous[MEMTABLE_MAX_HEIGHT];
+	MemtableEntry* entry = find_greater_or_equal(memtable, root_page_num, key, previous);
+	if (entry && entry->root_page_num == root_page_num && entry->key == key)
+	{
+		if (!replace)
+			return false;
+		entry->replace = true;
+		memcpy(memtable_entry_value(entry), value, memtable->value_size);
+		return true;
+	}
+
+	uint32_t height = random_height(memtable);
+	for (uint32_t level = memtable->height; level < height; ++level)
+		previous[level] = memtable->head;
+	if (height > memtable->height)
+		memtable->height = height;
+
+	entry = arena_allocate(memtable, sizeof(MemtableEntry) + height * sizeof(MemtableEntry*) + memtable->value_size);
+	entry->root_page_num = root_page_num;
+	entry->key = key;
+	entry->replace = replace;
+	entry->height = height;
+	memcpy(memtable_entry_value(entry), value, memtable->value_size);
+	for (uint32_t level = 0; level < height; ++level)
+	{
+		entry->next[level] = previous[level]->next[level];
+		previous[level]->next[level] = entry;
+	}
+	memtable->num_entries++;
+	return true;
+}
+
+MemtableEntry* memtable_first(Memtable* memtable)
+{
+	return memtable->head->next[0];
+}
+
+void* memtable_entry_value(MemtableEntry* entry)
+{
+	return &entry->next[entry->height];
+}
+
+
+static inline bool entry_before(const MemtableEntry* entry, uint64_t root_page_num, uint64_t key)
+{
+	return entry->root_page_num < root_page_num || (entry->root_page_num == root_page_num && entry->key < key);
+}
+
+// Fills previous, when given, with the last entry before the position on every level
+static MemtableEntry* find_greater_or_equal(Memtable* memtable, uint64_t root_page_num, uint64_t key, MemtableEntry** previous)
+{
+	MemtableEntry* entry = memtable->head;
+	for (uint32_t level = memtable->height; level-- > 0;)
+	{
+		while (entry->next[level] && entry_before(entry->next[level], root_page_num, key))
+			entry = entry->next[level];
+		if (previous)
+			previous[level] = entry;
+	}
+	return entry->next[0];
+}
+
+// Each level above the first is kept with probability 1/4, from xorshift64*
+static uint32_t random_height(Memtable* memtable)
+{
+	memtable->random_state ^= memtable->random_state >> 12;
+	memtable->random_state ^= memtable->random_state << 25;
+	memtable->random_state ^= memtable->random_state >> 27;
+	uint64_t bits = memtable->random_state * 0x2545F4914F6CDD1DULL;
+
+	uint32_t height = 1;
+	while (height < MEMTABLE_MAX_HEIGHT && (bits & 3) == 0)
+	{
+		height++;
+		bits >>= 2;
+	}
+	return height;
+}
+
+static void* arena_allocate(Memtable* memtable, size_t size)
+{
+	size = (size + sizeof(max_align_t) - 1) / sizeof(max_align_t) * sizeof(max_align_t);
+	MemtableBlock* block = memtable->blocks;
+	if (!block || block->used + size > MEMTABLE_ARENA_BLOCK_SIZE)
+	{
+		block = malloc(sizeof(MemtableBlock) + MEMTABLE_ARENA_BLOCK_SIZE);
+		if (!block)
+		{
+			perror("malloc error");
+			exit(EXIT_FAILURE);
+		}
+		block->previous = memtable->blocks;
+		block->used = 0;
+		memtable->blocks = block;
+	}
+
+	void* pointer = (char*)block->data + block->used;
+	block->used += size;
+	return pointer;
+}
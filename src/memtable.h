@@ -0,0 +1,58 @@
+#ifndef MEMTABLE_H
+#define MEMTABLE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Write buffer in front of the trees. Inserts land in a skiplist ordered by
+// (tree root, key) instead of a leaf, and the whole list is merged into the
+// trees in key order once it fills up, so consecutive rows mostly go into the
+// leaf the previous one went into. Entries come from an arena that is released
+// all at once after each merge.
+
+#define MEMTABLE_MAX_HEIGHT 12
+#define MEMTABLE_ARENA_BLOCK_SIZE (1024 * 1024)
+
+typedef struct MemtableEntry
+{
+	uint64_t root_page_num;
+	uint64_t key;
+	bool replace; // insert or replace, so the merge overwrites a row the tree already has
+	uint32_t height;
+	struct MemtableEntry* next[]; // followed by the value
+} MemtableEntry;
+
+typedef struct MemtableBlock
+{
+	struct MemtableBlock* previous;
+	size_t used;
+	max_align_t data[];
+} MemtableBlock;
+
+typedef struct
+{
+	uint64_t max_entries; // 0 sends inserts straight to the trees
+	uint64_t num_entries;
+	uint32_t value_size;
+	uint32_t height;
+	uint64_t random_state;
+	MemtableEntry* head;
+	MemtableBlock* blocks;
+} Memtable;
+
+void memtable_init(Memtable* memtable, uint64_t max_entries, uint32_t value_size);
+void memtable_free(Memtable* memtable);
+// Drops every entry and the arena behind them
+void memtable_clear(Memtable* memtable);
+bool memtable_full(const Memtable* memtable);
+
+MemtableEntry* memtable_find(Memtable* memtable, uint64_t root_page_num, uint64_t key);
+// Adds the value, or overwrites the buffered one when replace is set; false when
+// the key is already buffered and replace is not
+bool memtable_put(Memtable* memtable, uint64_t root_page_num, uint64_t key, const void* value, bool replace);
+// Entries in (root, key) order, following next[0]
+MemtableEntry* memtable_first(Memtable* memtable);
+void* memtable_entry_value(MemtableEntry* entry);
+
+#endif // MEMTABLE_H
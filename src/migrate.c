@@ -0,0 +1,150 @@
+#include "migrate.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "table.h"
+
+// Format 1 layout. Its pages were not checksummed and started with the node type.
+#define LEGACY_PAGE_SIZE 4096
+#define LEGACY_BACKUP_SUFFIX ".v1"
+
+#define LEGACY_NODE_TYPE_OFFSET 0
+#define LEGACY_LEAF_NODE_NUM_CELLS_OFFSET 6
+#define LEGACY_LEAF_NODE_NEXT_LEAF_OFFSET 10
+#define LEGACY_LEAF_NODE_CELLS_OFFSET 14
+#define LEGACY_LEAF_NODE_CELL_SIZE 297
+#define LEGACY_LEAF_NODE_MAX_CELLS 13
+#define LEGACY_INTERNAL_NODE_FIRST_CHILD_OFFSET 11
+
+#define LEGACY_KEY_OFFSET 0
+#define LEGACY_ID_OFFSET 4
+#define LEGACY_USERNAME_OFFSET 8
+#define LEGACY_EMAIL_OFFSET (LEGACY_USERNAME_OFFSET + COLUMN_USERNAME_SIZE + 1)
+#define LEGACY_ROW_SIZE (LEGACY_LEAF_NODE_CELL_SIZE - LEGACY_ID_OFFSET)
+
+
+static void read_legacy_page(FILE* file_ptr, uint32_t num_pages, uint32_t page_num, uint8_t* page);
+static uint32_t read_legacy_u32(const uint8_t* page, uint32_t offset);
+
+
+bool legacy_file_detect(const char* filename)
+{
+	FILE* file_ptr = fopen(filename, "rb");
+	if (!file_ptr)
+		return false;
+
+	uint8_t prefix[PAGE_HEADER_SIZE + sizeof(uint32_t)];
+	bool is_legacy = false;
+	if (fread(prefix, 1, sizeof(prefix), file_ptr) == sizeof(prefix))
+	{
+		uint32_t magic;
+		memcpy(&magic, prefix + PAGE_HEADER_SIZE, sizeof(magic));
+		fseek(file_ptr, 0, SEEK_END);
+		is_legacy = (magic != FILE_MAGIC) && (ftell(file_ptr) % LEGACY_PAGE_SIZE == 0);
+	}
+
+	fclose(file_ptr);
+	return is_legacy;
+}
+
+void legacy_file_migrate(const char* filename, DbOptions* options)
+{
+	char* backup_filename = malloc(strlen(filename) + sizeof(LEGACY_BACKUP_SUFFIX));
+	if (!backup_filename)
+	{
+		perror("malloc error");
+		exit(EXIT_FAILURE);
+	}
+	strcpy(backup_filename, filename);
+	strcat(backup_filename, LEGACY_BACKUP_SUFFIX);
+
+	if (rename(filename, backup_filename) != 0)
+	{
+		perror("rename error");
+		exit(EXIT_FAILURE);
+	}
+
+	FILE* file_ptr = fopen(backup_filename, "rb");
+	if (!file_ptr)
+	{
+		perror("fopen error");
+		exit(EXIT_FAILURE);
+	}
+	fseek(file_ptr, 0, SEEK_END);
+	uint32_t num_pages = (uint32_t)(ftell(file_ptr) / LEGACY_PAGE_SIZE);
+
+	Table* table = db_open_with_options(filename, options);
+	uint8_t page[LEGACY_PAGE_SIZE];
+	uint32_t page_num = 0;
+	read_legacy_page(file_ptr, num_pages, page_num, page);
+
+	// format 1 trees chain their leaves, so only the path to the leftmost leaf is needed
+	for (uint32_t depth = 0; page[LEGACY_NODE_TYPE_OFFSET] == NODE_INTERNAL; ++depth)
+	{
+		if (depth >= num_pages)
+		{
+			fprintf(stderr, "Error: Cycle in format 1 DB file. Corrupt file.\n");
+			exit(EXIT_FAILURE);
+		}
+		page_num = read_legacy_u32(page, LEGACY_INTERNAL_NODE_FIRST_CHILD_OFFSET);
+		read_legacy_page(file_ptr, num_pages, page_num, page);
+	}
+
+	for (uint32_t leaves = 1; ; ++leaves)
+	{
+		// the cell count was written through a one byte pointer
+		uint32_t num_cells = page[LEGACY_LEAF_NODE_NUM_CELLS_OFFSET];
+		if (num_cells > LEGACY_LEAF_NODE_MAX_CELLS || leaves > num_pages)
+		{
+			fprintf(stderr, "Error: Invalid leaf %u in format 1 DB file. Corrupt file.\n", page_num);
+			exit(EXIT_FAILURE);
+		}
+
+		for (uint32_t i = 0; i < num_cells; ++i)
+		{
+			static const uint8_t deleted_row[LEGACY_ROW_SIZE] = {0};
+			const uint8_t* cell = page + LEGACY_LEAF_NODE_CELLS_OFFSET + i * LEGACY_LEAF_NODE_CELL_SIZE;
+			if (memcmp(cell + LEGACY_ID_OFFSET, deleted_row, LEGACY_ROW_SIZE) == 0)
+				continue;
+
+			Row row = {0};
+			row.id = read_legacy_u32(cell, LEGACY_ID_OFFSET);
+			memcpy(row.username, cell + LEGACY_USERNAME_OFFSET, COLUMN_USERNAME_SIZE + 1);
+			memcpy(row.email, cell + LEGACY_EMAIL_OFFSET, COLUMN_EMAIL_SIZE + 1);
+
+			uint64_t key = read_legacy_u32(cell, LEGACY_KEY_OFFSET);
+			Cursor* cursor = table_find(table, key);
+			leaf_node_insert(cursor, key, &row);
+			free(cursor);
+		}
+
+		page_num = read_legacy_u32(page, LEGACY_LEAF_NODE_NEXT_LEAF_OFFSET);
+		if (page_num == 0)
+			break;
+		read_legacy_page(file_ptr, num_pages, page_num, page);
+	}
+
+	db_close(table);
+	fclose(file_ptr);
+	free(backup_filename);
+}
+
+static void read_legacy_page(FILE* file_ptr, uint32_t num_pages, uint32_t page_num, uint8_t* page)
+{
+	if (page_num >= num_pages || fseek(file_ptr, (long)page_num * LEGACY_PAGE_SIZE, SEEK_SET) != 0
+		|| fread(page, 1, LEGACY_PAGE_SIZE, file_ptr) < LEGACY_PAGE_SIZE)
+	{
+		fprintf(stderr, "Error: Could not read page %u of format 1 DB file. Corrupt file.\n", page_num);
+		exit(EXIT_FAILURE);
+	}
+}
+
+static uint32_t read_legacy_u32(const uint8_t* page, uint32_t offset)
+{
+	uint32_t value;
+	memcpy(&value, page + offset, sizeof(value));
+	return value;
+}
@@ -0,0 +1,15 @@
+#ifndef MIGRATE_H
+#define MIGRATE_H
+
+#include <stdbool.h>
+
+#include "table.h"
+
+// Files written before the file header existed (format version 1) have 32-bit keys,
+// 32-bit page numbers and no page checksums.
+bool legacy_file_detect(const char* filename);
+
+// Rewrites a format 1 file in the current format. The original is kept as <filename>.v1.
+void legacy_file_migrate(const char* filename, DbOptions* options);
+
+#endif // MIGRATE_H
@@ -1,30 +1,94 @@
 #include "parser.h"
 
+#include <setjmp.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <inttypes.h>
+#include <ctype.h>
 
+#include "backup.h"
+#include "catalog.h"
 #include "input.h"
+#include "join.h"
+#include "scan.h"
+#include "sort.h"
+#include "stats.h"
+#include "vacuum.h"
 
 
-static void print_constants(void);
+// Context for printing rows handed over by a parallel scan
+typedef struct
+{
+	uint32_t columns;
+	const IdFilter* where;
+	bool quiet; // count the rows without printing them
+} SelectOutput;
+
+static MetaCommandResult run_meta_command(InputBuffer* input_buffer, Table* table);
+static void print_constants(uint32_t page_size);
 static void indent(uint32_t level);
-static void print_tree(Pager* pager, uint32_t page_num, uint32_t indent_level);
+static void print_tree(Pager* pager, uint64_t page_num, uint32_t indent_level);
 
+static PrepareResult parse_statement(InputBuffer* input_buffer, Statement* statement);
+static PrepareResult prepare_explain(InputBuffer* input_buffer, Statement* statement);
 static PrepareResult prepare_insert(InputBuffer* input_buffer, Statement* statement);
 static PrepareResult prepare_select(InputBuffer* input_buffer, Statement* statement);
 static PrepareResult prepare_delete(InputBuffer* input_buffer, Statement* statement);
+static PrepareResult prepare_update(InputBuffer* input_buffer, Statement* statement);
+static PrepareResult parse_assignment(char* token, Statement* statement);
+static PrepareResult prepare_table_statement(InputBuffer* input_buffer, Statement* statement, StatementType type);
+static PrepareResult prepare_vacuum(InputBuffer* input_buffer, Statement* statement);
+static PrepareResult parse_table_name(char* name, Statement* statement);
+static PrepareResult parse_join(Statement* statement);
+static bool parse_column(const char* token, Column* column);
+static bool is_aggregate(const char* token);
+static AggregateFunction parse_aggregate(const char* token);
+static PrepareResult parse_id_filter(Statement* statement);
 
+static ExecuteResult guarded_dispatch_statement(Statement* statement, Table* table);
+static ExecuteResult dispatch_statement(Statement* statement, Table* table);
 static ExecuteResult execute_insert(Statement* statement, Table* table);
+static ExecuteResult buffer_insert(Statement* statement, Table* table);
+static bool reads_memtable(Statement* statement);
 static ExecuteResult execute_select(Statement* statement, Table* table);
+static void select_descending(Statement* statement, Table* table, uint32_t columns, bool quiet);
+static void select_sorted(Statement* statement, Table* table, uint32_t columns, bool quiet);
+static ExecuteResult execute_join(Statement* statement, Table* table, uint32_t columns, bool quiet);
+static bool seeks_offset(Statement* statement);
 static ExecuteResult execute_delete(Statement* statement, Table* table);
+static ExecuteResult execute_update(Statement* statement, Table* table);
 
-static bool is_valid_row(void* row);
-static void print_row(Row* row);
+static void print_row(Row* row, uint32_t columns);
+static void print_values(uint64_t id, const char* username, const char* email, uint32_t columns);
+static void print_rows(Row* rows, uint32_t num_rows, void* context);
+static void print_joined_rows(const Row* left, const Row* right, void* context);
+static void print_batch(RowBatch* batch, uint32_t columns);
+static void print_aggregates(Statement* statement, TableAggregates* aggregates);
+static void print_plan(Statement* statement);
+static void print_analysis(Statement* statement, const uint64_t* before, uint64_t elapsed_ns);
 
 
+// A page that fails its checksum ends the command here instead of ending the process
 MetaCommandResult do_meta_command(InputBuffer* input_buffer, Table* table)
+{
+	Pager* pager = table->pager;
+	jmp_buf* outer_page_error = pager->page_error;
+	jmp_buf page_error;
+	if (setjmp(page_error) != 0)
+	{
+		pager->page_error = outer_page_error;
+		return META_COMMAND_CORRUPT_PAGE;
+	}
+
+	pager->page_error = &page_error;
+	MetaCommandResult result = run_meta_command(input_buffer, table);
+	pager->page_error = outer_page_error;
+	return result;
+}
+
+static MetaCommandResult run_meta_command(InputBuffer* input_buffer, Table* table)
 {
 	if (strcmp(input_buffer->buffer, ".exit") == 0)
 	{
@@ -35,13 +99,85 @@ MetaCommandResult do_meta_command(InputBuffer* input_buffer, Table* table)
 	if (strcmp(input_buffer->buffer, ".constants") == 0)
 	{
 		printf("Constants:\n");
-		print_constants();
+		print_constants(table->pager->page_size);
 		return META_COMMAND_SUCCESS;
 	}
 	if (strcmp(input_buffer->buffer, ".btree") == 0)
 	{
+		pager_merge_memtable(table->pager);
 		printf("Tree:\n");
-		print_tree(table->pager, 0, 0);
+		print_tree(table->pager, table->root_page_num, 0);
+		return META_COMMAND_SUCCESS;
+	}
+	if (strcmp(input_buffer->buffer, ".tables") == 0)
+	{
+		CatalogEntry* entries;
+		uint32_t num_tables = catalog_list_tables(table, &entries);
+		printf("Tables:\n");
+		for (uint32_t i = 0; i < num_tables; ++i)
+			printf("- %s (%s)\n", entries[i].name, entries[i].columns);
+		free(entries);
+		return META_COMMAND_SUCCESS;
+	}
+	if (strcmp(input_buffer->buffer, ".stats") == 0 || strcmp(input_buffer->buffer, ".stats json") == 0)
+	{
+		bool json = strcmp(input_buffer->buffer, ".stats json") == 0;
+		if (!json)
+			printf("Stats:\n");
+		stats_print(json);
+		return META_COMMAND_SUCCESS;
+	}
+	if (strcmp(input_buffer->buffer, ".stats reset") == 0)
+	{
+		stats_reset();
+		return META_COMMAND_SUCCESS;
+	}
+	if (strncmp(input_buffer->buffer, ".backup ", 8) == 0 && input_buffer->buffer[8] != '\0')
+	{
+		const char* filename = input_buffer->buffer + 8;
+		pager_merge_memtable(table->pager);
+		uint64_t pages_copied = table_backup(table, filename);
+		printf("Copied %" PRIu64 " page(s) to %s.\n", pages_copied, filename);
+		return META_COMMAND_SUCCESS;
+	}
+	if (strncmp(input_buffer->buffer, ".hashindex ", 11) == 0 && isdigit((unsigned char)input_buffer->buffer[11]))
+	{
+		// 0 turns the index off
+		hash_index_free(&table->pager->hash_index);
+		hash_index_init(&table->pager->hash_index, strtoull(input_buffer->buffer + 11, NULL, 10));
+		printf("Hash index: %" PRIu64 " entries.\n", hash_index_capacity(&table->pager->hash_index));
+		return META_COMMAND_SUCCESS;
+	}
+	if (strncmp(input_buffer->buffer, ".sortmemory ", 12) == 0 && isdigit((unsigned char)input_buffer->buffer[12]))
+	{
+		sort_set_memory_limit(strtoull(input_buffer->buffer + 12, NULL, 10));
+		printf("Sort memory: %" PRIu64 " bytes.\n", sort_memory_limit());
+		return META_COMMAND_SUCCESS;
+	}
+	if (strncmp(input_buffer->buffer, ".joinmemory ", 12) == 0 && isdigit((unsigned char)input_buffer->buffer[12]))
+	{
+		join_set_memory_limit(strtoull(input_buffer->buffer + 12, NULL, 10));
+		printf("Join memory: %" PRIu64 " bytes.\n", join_memory_limit());
+		return META_COMMAND_SUCCESS;
+	}
+	if (strncmp(input_buffer->buffer, ".memtable ", 10) == 0 && isdigit((unsigned char)input_buffer->buffer[10]))
+	{
+		// 0 sends inserts straight to the trees again
+		pager_merge_memtable(table->pager);
+		memtable_free(&table->pager->memtable);
+		memtable_init(&table->pager->memtable, strtoull(input_buffer->buffer + 10, NULL, 10), ROW_SIZE);
+		printf("Memtable: %" PRIu64 " entries.\n", table->pager->memtable.max_entries);
+		return META_COMMAND_SUCCESS;
+	}
+	if (strcmp(input_buffer->buffer, ".check") == 0)
+	{
+		pager_merge_memtable(table->pager);
+		printf("Check:\n");
+		uint32_t problems = table_check(table);
+		if (problems)
+			printf("%d problem(s) found.\n", problems);
+		else
+			printf("ok\n");
 		return META_COMMAND_SUCCESS;
 	}
 	return META_COMMAND_UNRECOGNIZED_COMMAND;
@@ -49,31 +185,92 @@ MetaCommandResult do_meta_command(InputBuffer* input_buffer, Table* table)
 
 PrepareResult prepare_statement(InputBuffer* input_buffer, Statement* statement)
 {
+	uint64_t start = stats_now_ns();
+	PrepareResult result = parse_statement(input_buffer, statement);
+	stats_record_time(STAT_TIME_PREPARE, start);
+	return result;
+}
+
+static PrepareResult parse_statement(InputBuffer* input_buffer, Statement* statement)
+{
+	if (strncmp(input_buffer->buffer, "explain ", 8) == 0)
+		return prepare_explain(input_buffer, statement);
+
 	if (strncmp(input_buffer->buffer, "insert", 6) == 0)
 		return prepare_insert(input_buffer, statement);
 
-	if (strcmp(input_buffer->buffer, "select") == 0)
+	if (strncmp(input_buffer->buffer, "select", 6) == 0)
 		return prepare_select(input_buffer, statement);
 
 	if (strncmp(input_buffer->buffer, "delete", 6) == 0)
 		return prepare_delete(input_buffer, statement);
 
+	if (strncmp(input_buffer->buffer, "update", 6) == 0)
+		return prepare_update(input_buffer, statement);
+
+	if (strncmp(input_buffer->buffer, "create", 6) == 0)
+		return prepare_table_statement(input_buffer, statement, STATEMENT_CREATE_TABLE);
+
+	if (strncmp(input_buffer->buffer, "drop", 4) == 0)
+		return prepare_table_statement(input_buffer, statement, STATEMENT_DROP_TABLE);
+
+	if (strncmp(input_buffer->buffer, "vacuum", 6) == 0)
+		return prepare_vacuum(input_buffer, statement);
+
 	return PREPARE_UNRECOGNIZED_STATEMENT;
 }
 
+// explain [analyze] <statement>
+static PrepareResult prepare_explain(InputBuffer* input_buffer, Statement* statement)
+{
+	ExplainMode mode = EXPLAIN_PLAN;
+	size_t prefix = strlen("explain ");
+	if (strncmp(input_buffer->buffer + prefix, "analyze ", 8) == 0)
+	{
+		mode = EXPLAIN_ANALYZE;
+		prefix += strlen("analyze ");
+	}
+
+	// the statement parsers tokenize from the start of the buffer
+	char* rest = input_buffer->buffer + prefix;
+	memmove(input_buffer->buffer, rest, strlen(rest) + 1);
+	input_buffer->input_length -= prefix;
+	if (strncmp(input_buffer->buffer, "explain", 7) == 0)
+		return PREPARE_SYNTAX_ERROR;
+
+	PrepareResult result = parse_statement(input_buffer, statement);
+	statement->explain = mode;
+	return result;
+}
+
 static PrepareResult prepare_insert(InputBuffer* input_buffer, Statement* statement)
 {
 	strtok(input_buffer->buffer, " ");
 	char* id_string = strtok(NULL, " ");
+	if (id_string && strcmp(id_string, "or") == 0)
+	{
+		char* keyword = strtok(NULL, " ");
+		if (!keyword || strcmp(keyword, "replace") != 0)
+			return PREPARE_SYNTAX_ERROR;
+		statement->insert_or_replace = true;
+		id_string = strtok(NULL, " ");
+	}
+	if (id_string && strcmp(id_string, "into") == 0)
+	{
+		PrepareResult result = parse_table_name(strtok(NULL, " "), statement);
+		if (result != PREPARE_SUCCESS)
+			return result;
+		id_string = strtok(NULL, " ");
+	}
 	char* username = strtok(NULL, " ");
 	char* email = strtok(NULL, " ");
 
 	if (!id_string || !username || !email)
 		return PREPARE_SYNTAX_ERROR;
 
-	int id = atoi(id_string);
-	if (id < 0)
+	if (id_string[0] == '-')
 		return PREPARE_NEGATIVE_ID;
+	uint64_t id = strtoull(id_string, NULL, 10);
 
 	if (strlen(username) > COLUMN_USERNAME_SIZE || strlen(email) > COLUMN_EMAIL_SIZE)
 		return PREPARE_STRING_TOO_LONG;
@@ -88,7 +285,128 @@ static PrepareResult prepare_insert(InputBuffer* input_buffer, Statement* statem
 
 static PrepareResult prepare_select(InputBuffer* input_buffer, Statement* statement)
 {
+	char* keyword = strtok(input_buffer->buffer, " ");
+	if (strcmp(keyword, "select") != 0)
+		return PREPARE_UNRECOGNIZED_STATEMENT;
+
+	uint32_t columns = 0;
+	char* token;
+	for (token = strtok(NULL, " ,"); token; token = strtok(NULL, " ,"))
+	{
+		if (strcmp(token, "*") == 0)
+			columns |= ALL_COLUMNS;
+		else if (strcmp(token, "id") == 0)
+			columns |= COLUMN_BIT(COLUMN_ID);
+		else if (strcmp(token, "username") == 0)
+			columns |= COLUMN_BIT(COLUMN_USERNAME);
+		else if (strcmp(token, "email") == 0)
+			columns |= COLUMN_BIT(COLUMN_EMAIL);
+		else if (is_aggregate(token))
+		{
+			if (statement->num_aggregates == MAX_AGGREGATES)
+				return PREPARE_SYNTAX_ERROR;
+			statement->aggregates[statement->num_aggregates++] = parse_aggregate(token);
+		}
+		else
+			break;
+	}
+
+	// aggregates cannot be mixed with plain columns
+	if (statement->num_aggregates > 0 && columns != 0)
+		return PREPARE_SYNTAX_ERROR;
+
+	if (token && strcmp(token, "from") == 0)
+	{
+		PrepareResult result = parse_table_name(strtok(NULL, " ,"), statement);
+		if (result != PREPARE_SUCCESS)
+			return result;
+		token = strtok(NULL, " ,");
+	}
+
+	if (token && strcmp(token, "join") == 0)
+	{
+		PrepareResult result = parse_join(statement);
+		if (result != PREPARE_SUCCESS)
+			return result;
+		token = strtok(NULL, " ,");
+	}
+
+	if (token && strcmp(token, "where") == 0)
+	{
+		PrepareResult result = parse_id_filter(statement);
+		if (result != PREPARE_SUCCESS)
+			return result;
+		token = strtok(NULL, " ,");
+	}
+
+	// order by <column> [asc | desc]
+	if (token && strcmp(token, "order") == 0)
+	{
+		char* by = strtok(NULL, " ,");
+		char* column = strtok(NULL, " ,");
+		if (!by || strcmp(by, "by") != 0 || !parse_column(column, &statement->order_column))
+			return PREPARE_SYNTAX_ERROR;
+
+		token = strtok(NULL, " ,");
+		if (token && (strcmp(token, "asc") == 0 || strcmp(token, "desc") == 0))
+		{
+			statement->order_descending = strcmp(token, "desc") == 0;
+			token = strtok(NULL, " ,");
+		}
+	}
+
+	if (token && strcmp(token, "limit") == 0)
+	{
+		char* limit = strtok(NULL, " ,");
+		if (!limit || !isdigit((unsigned char)limit[0]))
+			return PREPARE_SYNTAX_ERROR;
+		statement->has_limit = true;
+		statement->limit = strtoull(limit, NULL, 10);
+		token = strtok(NULL, " ,");
+	}
+
+	if (token && strcmp(token, "offset") == 0)
+	{
+		char* offset = strtok(NULL, " ,");
+		if (!offset || !isdigit((unsigned char)offset[0]))
+			return PREPARE_SYNTAX_ERROR;
+		statement->offset = strtoull(offset, NULL, 10);
+		token = strtok(NULL, " ,");
+	}
+
+	// parallel <threads> [unordered]
+	if (token && strcmp(token, "parallel") == 0)
+	{
+		char* threads = strtok(NULL, " ,");
+		if (!threads || !isdigit((unsigned char)threads[0]))
+			return PREPARE_SYNTAX_ERROR;
+		unsigned long num_threads = strtoul(threads, NULL, 10);
+		if (num_threads == 0 || num_threads > MAX_SCAN_THREADS)
+			return PREPARE_SYNTAX_ERROR;
+		statement->scan_threads = (uint32_t)num_threads;
+
+		token = strtok(NULL, " ,");
+		if (token && strcmp(token, "unordered") == 0)
+		{
+			statement->scan_unordered = true;
+			token = strtok(NULL, " ,");
+		}
+	}
+
+	if (token)
+		return PREPARE_SYNTAX_ERROR;
+
+	// the ordered paths walk a single cursor, and aggregates return one row anyway
+	bool ordered = statement->order_column != COLUMN_ID || statement->order_descending
+		|| statement->has_limit || statement->offset > 0;
+	if (ordered && (statement->num_aggregates > 0 || statement->scan_threads > 0))
+		return PREPARE_SYNTAX_ERROR;
+	// joined rows come out in no particular order, one pair at a time
+	if (statement->join_table_name[0] != '\0' && (ordered || statement->num_aggregates > 0 || statement->scan_threads > 0))
+		return PREPARE_SYNTAX_ERROR;
+
 	statement->type = STATEMENT_SELECT;
+	statement->select_columns = columns;
 	return PREPARE_SUCCESS;
 }
 
@@ -96,47 +414,391 @@ static PrepareResult prepare_delete(InputBuffer* input_buffer, Statement* statem
 {
 	strtok(input_buffer->buffer, " ");
 	char* id_string = strtok(NULL, " ");
+	if (id_string && strcmp(id_string, "from") == 0)
+	{
+		PrepareResult result = parse_table_name(strtok(NULL, " "), statement);
+		if (result != PREPARE_SUCCESS)
+			return result;
+		id_string = strtok(NULL, " ");
+	}
 
 	if (!id_string)
 		return PREPARE_SYNTAX_ERROR;
 
-	int id = atoi(id_string);
-	if (id < 0)
+	if (id_string[0] == '-')
 		return PREPARE_NEGATIVE_ID;
+	uint64_t id = strtoull(id_string, NULL, 10);
 
 	statement->type = STATEMENT_DELETE;
 	statement->id_to_delete = id;
 	return PREPARE_SUCCESS;
 }
 
+// update [<table>] set <column>=<value>[, ...] where id = <id>
+static PrepareResult prepare_update(InputBuffer* input_buffer, Statement* statement)
+{
+	strtok(input_buffer->buffer, " ");
+	char* token = strtok(NULL, " ,");
+	if (token && strcmp(token, "set") != 0)
+	{
+		PrepareResult result = parse_table_name(token, statement);
+		if (result != PREPARE_SUCCESS)
+			return result;
+		token = strtok(NULL, " ,");
+	}
+	if (!token || strcmp(token, "set") != 0)
+		return PREPARE_SYNTAX_ERROR;
+
+	for (token = strtok(NULL, " ,"); token && strcmp(token, "where") != 0; token = strtok(NULL, " ,"))
+	{
+		PrepareResult result = parse_assignment(token, statement);
+		if (result != PREPARE_SUCCESS)
+			return result;
+	}
+	if (!token || statement->update_columns == 0)
+		return PREPARE_SYNTAX_ERROR;
+
+	// only single-row updates, so the row is found with one descent
+	PrepareResult result = parse_id_filter(statement);
+	if (result != PREPARE_SUCCESS)
+		return result;
+	if (statement->where.op != COMPARE_EQUAL || strtok(NULL, " ,"))
+		return PREPARE_SYNTAX_ERROR;
+
+	statement->type = STATEMENT_UPDATE;
+	return PREPARE_SUCCESS;
+}
+
+// <column>=<value>, with optional spaces around the '='
+static PrepareResult parse_assignment(char* token, Statement* statement)
+{
+	char* column = token;
+	char* value;
+	char* equals = strchr(token, '=');
+	if (equals)
+	{
+		*equals = '\0';
+		value = equals[1] ? equals + 1 : strtok(NULL, " ,");
+	}
+	else
+	{
+		char* next = strtok(NULL, " ,");
+		if (!next || next[0] != '=')
+			return PREPARE_SYNTAX_ERROR;
+		value = next[1] ? next + 1 : strtok(NULL, " ,");
+	}
+	if (!value)
+		return PREPARE_SYNTAX_ERROR;
+
+	if (strcmp(column, "username") == 0)
+	{
+		if (strlen(value) > COLUMN_USERNAME_SIZE)
+			return PREPARE_STRING_TOO_LONG;
+		strcpy(statement->update_values.username, value);
+		statement->update_columns |= COLUMN_BIT(COLUMN_USERNAME);
+	}
+	else if (strcmp(column, "email") == 0)
+	{
+		if (strlen(value) > COLUMN_EMAIL_SIZE)
+			return PREPARE_STRING_TOO_LONG;
+		strcpy(statement->update_values.email, value);
+		statement->update_columns |= COLUMN_BIT(COLUMN_EMAIL);
+	}
+	else
+		return PREPARE_SYNTAX_ERROR; // the id is the key and cannot change in place
+
+	return PREPARE_SUCCESS;
+}
+
+// create table <name> | drop table <name>
+static PrepareResult prepare_table_statement(InputBuffer* input_buffer, Statement* statement, StatementType type)
+{
+	strtok(input_buffer->buffer, " ");
+	char* keyword = strtok(NULL, " ");
+	if (!keyword || strcmp(keyword, "table") != 0)
+		return PREPARE_SYNTAX_ERROR;
+
+	PrepareResult result = parse_table_name(strtok(NULL, " "), statement);
+	if (result != PREPARE_SUCCESS)
+		return result;
+	if (strtok(NULL, " "))
+		return PREPARE_SYNTAX_ERROR;
+
+	statement->type = type;
+	return PREPARE_SUCCESS;
+}
+
+// vacuum [fill percent]
+static PrepareResult prepare_vacuum(InputBuffer* input_buffer, Statement* statement)
+{
+	char* keyword = strtok(input_buffer->buffer, " ");
+	if (strcmp(keyword, "vacuum") != 0)
+		return PREPARE_UNRECOGNIZED_STATEMENT;
+
+	statement->fill_percent = VACUUM_DEFAULT_FILL_PERCENT;
+	char* fill = strtok(NULL, " ");
+	if (fill)
+	{
+		if (!isdigit((unsigned char)fill[0]))
+			return PREPARE_SYNTAX_ERROR;
+		unsigned long fill_percent = strtoul(fill, NULL, 10);
+		if (fill_percent < VACUUM_MIN_FILL_PERCENT || fill_percent > 100)
+			return PREPARE_SYNTAX_ERROR;
+		statement->fill_percent = (uint32_t)fill_percent;
+	}
+	if (strtok(NULL, " "))
+		return PREPARE_SYNTAX_ERROR;
+
+	statement->type = STATEMENT_VACUUM;
+	return PREPARE_SUCCESS;
+}
+
+static const char* column_names[] = {
+	[COLUMN_ID] = "id",
+	[COLUMN_USERNAME] = "username",
+	[COLUMN_EMAIL] = "email",
+};
+
+static PrepareResult check_table_name(const char* name)
+{
+	if (!name)
+		return PREPARE_SYNTAX_ERROR;
+	if (strlen(name) > TABLE_NAME_SIZE)
+		return PREPARE_STRING_TOO_LONG;
+
+	for (const char* c = name; *c; ++c)
+		if (!isalnum((unsigned char)*c) && *c != '_')
+			return PREPARE_SYNTAX_ERROR;
+	return PREPARE_SUCCESS;
+}
+
+static PrepareResult parse_table_name(char* name, Statement* statement)
+{
+	PrepareResult result = check_table_name(name);
+	if (result == PREPARE_SUCCESS)
+		strcpy(statement->table_name, name);
+	return result;
+}
+
+static bool parse_column(const char* token, Column* column)
+{
+	if (!token)
+		return false;
+	for (Column c = COLUMN_ID; c <= COLUMN_EMAIL; ++c)
+	{
+		if (strcmp(token, column_names[c]) == 0)
+		{
+			*column = c;
+			return true;
+		}
+	}
+	return false;
+}
+
+// join <table> on <left column> = <right column>; ids only join with ids
+static PrepareResult parse_join(Statement* statement)
+{
+	char* name = strtok(NULL, " ,");
+	PrepareResult result = check_table_name(name);
+	if (result != PREPARE_SUCCESS)
+		return result;
+
+	char* on = strtok(NULL, " ,");
+	char* left = strtok(NULL, " ,");
+	char* equals = strtok(NULL, " ,");
+	char* right = strtok(NULL, " ,");
+	if (!on || strcmp(on, "on") != 0 || !equals || strcmp(equals, "=") != 0
+		|| !parse_column(left, &statement->join_left_column) || !parse_column(right, &statement->join_right_column))
+		return PREPARE_SYNTAX_ERROR;
+	if ((statement->join_left_column == COLUMN_ID) != (statement->join_right_column == COLUMN_ID))
+		return PREPARE_SYNTAX_ERROR;
+
+	strcpy(statement->join_table_name, name);
+	return PREPARE_SUCCESS;
+}
+
+static const char* aggregate_names[] = {
+	[AGGREGATE_COUNT] = "count(*)",
+	[AGGREGATE_MIN] = "min(id)",
+	[AGGREGATE_MAX] = "max(id)",
+	[AGGREGATE_SUM] = "sum(id)",
+};
+
+static bool is_aggregate(const char* token)
+{
+	for (AggregateFunction function = AGGREGATE_COUNT; function <= AGGREGATE_SUM; ++function)
+		if (strcmp(token, aggregate_names[function]) == 0)
+			return true;
+	return false;
+}
+
+static AggregateFunction parse_aggregate(const char* token)
+{
+	AggregateFunction function = AGGREGATE_COUNT;
+	while (strcmp(token, aggregate_names[function]) != 0)
+		++function;
+	return function;
+}
+
+static const char* compare_operators[] = {
+	[COMPARE_EQUAL] = "=",
+	[COMPARE_NOT_EQUAL] = "!=",
+	[COMPARE_LESS] = "<",
+	[COMPARE_LESS_EQUAL] = "<=",
+	[COMPARE_GREATER] = ">",
+	[COMPARE_GREATER_EQUAL] = ">=",
+};
+
+// where id <operator> <value>
+static PrepareResult parse_id_filter(Statement* statement)
+{
+	char* column = strtok(NULL, " ,");
+	char* op = strtok(NULL, " ,");
+	char* value = strtok(NULL, " ,");
+	if (!column || !op || !value || strcmp(column, "id") != 0)
+		return PREPARE_SYNTAX_ERROR;
+
+	if (value[0] == '-')
+		return PREPARE_NEGATIVE_ID;
+	if (!isdigit((unsigned char)value[0]))
+		return PREPARE_SYNTAX_ERROR;
+
+	for (CompareOperator compare = COMPARE_EQUAL; compare <= COMPARE_GREATER_EQUAL; ++compare)
+	{
+		if (strcmp(op, compare_operators[compare]) == 0)
+		{
+			statement->where.active = true;
+			statement->where.op = compare;
+			statement->where.value = strtoull(value, NULL, 10);
+			return PREPARE_SUCCESS;
+		}
+	}
+	return PREPARE_SYNTAX_ERROR;
+}
+
+static const StatHistogram statement_timers[] = {
+	[STATEMENT_SELECT] = STAT_TIME_SELECT,
+	[STATEMENT_INSERT] = STAT_TIME_INSERT,
+	[STATEMENT_DELETE] = STAT_TIME_DELETE,
+	[STATEMENT_CREATE_TABLE] = STAT_TIME_CREATE_TABLE,
+	[STATEMENT_DROP_TABLE] = STAT_TIME_DROP_TABLE,
+	[STATEMENT_UPDATE] = STAT_TIME_UPDATE,
+	[STATEMENT_VACUUM] = STAT_TIME_VACUUM,
+};
+
 ExecuteResult execute_statement(Statement* statement, Table* table)
 {
+	if (statement->explain == EXPLAIN_PLAN)
+	{
+		print_plan(statement);
+		return EXECUTE_SUCCESS;
+	}
+
+	uint64_t before[STAT_COUNTER_COUNT];
+	if (statement->explain == EXPLAIN_ANALYZE)
+		stats_snapshot_counters(before);
+
+	uint64_t start = stats_now_ns();
+	ExecuteResult result = guarded_dispatch_statement(statement, table);
+	stats_record_time(statement_timers[statement->type], start);
+
+	if (statement->explain == EXPLAIN_ANALYZE)
+		print_analysis(statement, before, stats_now_ns() - start);
+	return result;
+}
+
+// A page that fails its checksum ends the statement here instead of ending the process
+static ExecuteResult guarded_dispatch_statement(Statement* statement, Table* table)
+{
+	Pager* pager = table->pager;
+	jmp_buf* outer_page_error = pager->page_error;
+	jmp_buf page_error;
+	if (setjmp(page_error) != 0)
+	{
+		pager->page_error = outer_page_error;
+		return EXECUTE_CORRUPT_PAGE;
+	}
+
+	pager->page_error = &page_error;
+	ExecuteResult result = dispatch_statement(statement, table);
+	pager->page_error = outer_page_error;
+	return result;
+}
+
+static ExecuteResult dispatch_statement(Statement* statement, Table* table)
+{
+	// named tables share the pager, so a statement runs against a copy of the handle with their root
+	Table target = *table;
+	bool named = statement->table_name[0] != '\0';
+	if (!reads_memtable(statement))
+		pager_merge_memtable(table->pager);
+
+	switch (statement->type)
+	{
+	case STATEMENT_CREATE_TABLE:
+		return catalog_create_table(table, statement->table_name) ? EXECUTE_SUCCESS : EXECUTE_TABLE_EXISTS;
+	case STATEMENT_DROP_TABLE:
+		return catalog_drop_table(table, statement->table_name) ? EXECUTE_SUCCESS : EXECUTE_TABLE_NOT_FOUND;
+	case STATEMENT_VACUUM:
+		table_vacuum(table, statement->fill_percent);
+		return EXECUTE_SUCCESS;
+	default:
+		break;
+	}
+
+	if (named && !catalog_find_table(table, statement->table_name, &target))
+		return EXECUTE_TABLE_NOT_FOUND;
+
 	switch (statement->type)
 	{
 	case STATEMENT_INSERT:
-		return execute_insert(statement, table);
+		return execute_insert(statement, &target);
 	case STATEMENT_SELECT:
-		return execute_select(statement, table);
+		return execute_select(statement, &target);
 	case STATEMENT_DELETE:
-		return execute_delete(statement, table);
+		return execute_delete(statement, &target);
+	case STATEMENT_UPDATE:
+		return execute_update(statement, &target);
+	default:
+		break;
 	}
 	return 0;
 }
 
+// Inserts and lookups of one key see the buffered rows; every other statement reads the trees
+static bool reads_memtable(Statement* statement)
+{
+	if (statement->type == STATEMENT_INSERT)
+		return true;
+	// key 0 may be a blank row, which the tree stores as deleted
+	return statement->type == STATEMENT_SELECT && statement->where.active && statement->where.op == COMPARE_EQUAL
+		&& statement->where.value != 0 && statement->num_aggregates == 0 && statement->scan_threads == 0
+		&& statement->join_table_name[0] == '\0';
+}
+
 static ExecuteResult execute_insert(Statement* statement, Table* table)
 {
-	void* node = get_page(table->pager, table->root_page_num);
-	uint32_t num_cells = *leaf_node_num_cells(node);
+	if (table->pager->memtable.max_entries > 0)
+		return buffer_insert(statement, table);
 
 	Row* row_to_insert = &(statement->row_to_insert);
-	uint32_t key_to_insert = row_to_insert->id;
+	uint64_t key_to_insert = row_to_insert->id;
 	Cursor* cursor = table_find(table, key_to_insert);
 
+	void* node = get_page(table->pager, cursor->page_num);
+	uint32_t num_cells = *leaf_node_num_cells(node);
+
 	if (cursor->cell_num < num_cells)
 	{
-		uint32_t key_at_index = *leaf_node_key(node, cursor->cell_num);
+		uint64_t key_at_index = *leaf_node_key(node, cursor->cell_num);
 		if (key_at_index == key_to_insert)
-			return EXECUTE_DUPLICATE_KEY;
+		{
+			// replace rewrites the cell in place, which also revives a deleted row
+			if (statement->insert_or_replace)
+				cursor_write_row(cursor, row_to_insert);
+			free(cursor);
+			return statement->insert_or_replace ? EXECUTE_SUCCESS : EXECUTE_DUPLICATE_KEY;
+		}
 	}
 
 	leaf_node_insert(cursor, row_to_insert->id, row_to_insert);
@@ -144,35 +806,283 @@ static ExecuteResult execute_insert(Statement* statement, Table* table)
 	return EXECUTE_SUCCESS;
 }
 
+// Only a key the key filter has seen needs a descent to rule out a duplicate
+static ExecuteResult buffer_insert(Statement* statement, Table* table)
+{
+	Row* row_to_insert = &(statement->row_to_insert);
+	Memtable* memtable = &table->pager->memtable;
+	uint64_t key_to_insert = row_to_insert->id;
+
+	if (!statement->insert_or_replace && table_may_contain(table, key_to_insert))
+	{
+		Cursor* cursor = table_find(table, key_to_insert);
+		void* node = get_page(table->pager, cursor->page_num);
+		bool found = cursor->cell_num < *leaf_node_num_cells(node) && *leaf_node_key(node, cursor->cell_num) == key_to_insert;
+		free(cursor);
+		if (found)
+			return EXECUTE_DUPLICATE_KEY;
+	}
+
+	char value[ROW_SIZE];
+	serialize_row(row_to_insert, value);
+	if (!memtable_put(memtable, table->root_page_num, key_to_insert, value, statement->insert_or_replace))
+		return EXECUTE_DUPLICATE_KEY;
+	if (memtable_full(memtable))
+		pager_merge_memtable(table->pager);
+	return EXECUTE_SUCCESS;
+}
+
 static ExecuteResult execute_select(Statement* statement, Table* table)
 {
-	Cursor* cursor = table_start(table);
-	Row row;
+	uint32_t columns = statement->select_columns ? statement->select_columns : ALL_COLUMNS;
+	bool quiet = statement->explain == EXPLAIN_ANALYZE;
 
-	while (!cursor->end_of_table)
+	if (statement->join_table_name[0] != '\0')
+		return execute_join(statement, table, columns, quiet);
+
+	// a buffered row is newer than the tree's
+	MemtableEntry* entry = reads_memtable(statement)
+		? memtable_find(&table->pager->memtable, table->root_page_num, statement->where.value) : NULL;
+	if (entry)
 	{
-		deserialize_row(cursor_value(cursor), &row);
-		if (is_valid_row(&row))
-			print_row(&row);
+		if (statement->offset == 0 && !(statement->has_limit && statement->limit == 0))
+		{
+			Row row;
+			deserialize_row(memtable_entry_value(entry), &row);
+			stats_increment(STAT_ROWS_RETURNED);
+			if (!quiet)
+				print_row(&row, columns);
+		}
+		return EXECUTE_SUCCESS;
+	}
 
-		cursor_advance(cursor);
+	// without a filter the aggregates come straight from the tree
+	if (statement->num_aggregates > 0 && !statement->where.active)
+	{
+		TableAggregates aggregates;
+		table_aggregate(table, statement->aggregates, statement->num_aggregates, &aggregates);
+		stats_increment(STAT_ROWS_RETURNED);
+		if (!quiet)
+			print_aggregates(statement, &aggregates);
+		return EXECUTE_SUCCESS;
+	}
+
+	if (statement->num_aggregates == 0 && statement->scan_threads > 0)
+	{
+		// the filter needs ids even when they are not printed
+		SelectOutput output = {columns, &statement->where, quiet};
+		uint32_t scan_columns = statement->where.active ? columns | COLUMN_BIT(COLUMN_ID) : columns;
+		table_parallel_scan(table, statement->scan_threads, scan_columns, !statement->scan_unordered, print_rows, &output);
+		return EXECUTE_SUCCESS;
+	}
+
+	if (statement->order_column != COLUMN_ID)
+	{
+		select_sorted(statement, table, columns, quiet);
+		return EXECUTE_SUCCESS;
+	}
+
+	if (statement->order_descending)
+	{
+		select_descending(statement, table, columns, quiet);
+		return EXECUTE_SUCCESS;
+	}
+
+	RowBatch* batch = batch_new(statement->num_aggregates > 0 ? 0 : columns);
+	TableAggregates aggregates = {0};
+	BatchScan scan = {0};
+
+	// range predicates on the key seek to the first match instead of filtering every row,
+	// and a single key the filter has never seen matches nothing
+	uint64_t first_key, last_key;
+	uint64_t skip = statement->offset;
+	if (id_filter_range(&statement->where, &first_key, &last_key)
+		&& (first_key != last_key || table_may_contain(table, first_key)))
+	{
+		if (seeks_offset(statement))
+		{
+			// the row counts lead straight to the first row past the offset
+			uint64_t first_row = table_rank(table, first_key);
+			if (skip < table_row_count(table) - first_row)
+			{
+				Cursor* cursor = table_find_row(table, first_row + skip);
+				batch_scan_start_at(&scan, cursor, last_key);
+				free(cursor);
+			}
+			skip = 0;
+		}
+		else
+			batch_scan_start_range(&scan, table, first_key, last_key);
 	}
 
+	uint64_t remaining = statement->has_limit ? statement->limit : UINT64_MAX;
+	if (remaining < BATCH_SIZE && skip < BATCH_SIZE - remaining)
+		scan.batch_size = (uint32_t)(remaining + skip);
+
+	while (remaining > 0 && batch_scan_next(&scan, batch))
+	{
+		batch_filter(batch, &statement->where);
+		if (statement->num_aggregates > 0)
+			batch_aggregate(batch, &aggregates);
+		else
+		{
+			skip -= batch_skip(batch, skip);
+			if (batch->num_selected > remaining)
+				batch->num_selected = (uint32_t)remaining;
+			remaining -= batch->num_selected;
+			stats_add(STAT_ROWS_RETURNED, batch->num_selected);
+			if (!quiet)
+				print_batch(batch, columns);
+		}
+	}
+
+	batch_free(batch);
+	if (statement->num_aggregates > 0)
+	{
+		stats_increment(STAT_ROWS_RETURNED);
+		if (!quiet)
+			print_aggregates(statement, &aggregates);
+	}
+	return EXECUTE_SUCCESS;
+}
+
+// An offset into a key range is a difference of ranks, except when a filter takes one key out of the middle
+static bool seeks_offset(Statement* statement)
+{
+	return statement->offset > 0 && !(statement->where.active && statement->where.op == COMPARE_NOT_EQUAL);
+}
+
+// Walks back from the end of the key range, so the newest rows cost a descent and the rows returned
+static void select_descending(Statement* statement, Table* table, uint32_t columns, bool quiet)
+{
+	uint64_t first_key, last_key;
+	uint64_t remaining = statement->has_limit ? statement->limit : UINT64_MAX;
+	if (remaining == 0 || !id_filter_range(&statement->where, &first_key, &last_key))
+		return;
+
+	uint64_t skip = statement->offset;
+	Cursor* cursor;
+	if (seeks_offset(statement))
+	{
+		// counting back from the row after the range
+		uint64_t first_row = table_rank(table, first_key);
+		uint64_t end_row = last_key == UINT64_MAX ? table_row_count(table) : table_rank(table, last_key + 1);
+		if (end_row - first_row <= skip)
+			return;
+		cursor = table_find_row(table, end_row - 1 - skip);
+		skip = 0;
+	}
+	else
+		cursor = table_find_last(table, last_key);
+
+	Row row;
+	while (!cursor->end_of_table && remaining > 0)
+	{
+		stats_increment(STAT_ROWS_EXAMINED);
+		// a deleted row has lost its id along with the rest of its values
+		if (cursor_is_deleted(cursor))
+		{
+			cursor_retreat(cursor);
+			continue;
+		}
+
+		cursor_read_row(cursor, &row, columns | COLUMN_BIT(COLUMN_ID));
+		if (row.id < first_key)
+			break;
+		bool matches = id_filter_matches(&statement->where, row.id);
+		if (matches && skip > 0)
+			skip--;
+		else if (matches)
+		{
+			remaining--;
+			stats_increment(STAT_ROWS_RETURNED);
+			if (!quiet)
+				print_row(&row, columns);
+		}
+		cursor_retreat(cursor);
+	}
 	free(cursor);
+}
+
+// Feeds the rows of the key range to an external sort, which holds them in memory up to the sort memory limit
+static void select_sorted(Statement* statement, Table* table, uint32_t columns, bool quiet)
+{
+	uint64_t first_key, last_key;
+	uint64_t remaining = statement->has_limit ? statement->limit : UINT64_MAX;
+	if (remaining == 0 || !id_filter_range(&statement->where, &first_key, &last_key))
+		return;
+
+	Sorter* sorter = sorter_new(statement->order_column, statement->order_descending);
+	RowBatch* batch = batch_new(columns | COLUMN_BIT(statement->order_column));
+	BatchScan scan = {0};
+	if (first_key != last_key || table_may_contain(table, first_key))
+		batch_scan_start_range(&scan, table, first_key, last_key);
+
+	Row row = {0};
+	while (batch_scan_next(&scan, batch))
+	{
+		batch_filter(batch, &statement->where);
+		for (uint32_t i = 0; i < batch->num_selected; ++i)
+		{
+			uint32_t index = batch->selection[i];
+			row.id = batch->ids[index];
+			if (batch->usernames)
+				memcpy(row.username, batch->usernames[index], sizeof(row.username));
+			if (batch->emails)
+				memcpy(row.email, batch->emails[index], sizeof(row.email));
+			sorter_add(sorter, &row);
+		}
+	}
+	batch_free(batch);
+
+	sorter_finish(sorter);
+	uint64_t skip = statement->offset;
+	while (remaining > 0 && sorter_next(sorter, &row))
+	{
+		if (skip > 0)
+		{
+			skip--;
+			continue;
+		}
+		remaining--;
+		stats_increment(STAT_ROWS_RETURNED);
+		if (!quiet)
+			print_row(&row, columns);
+	}
+	sorter_free(sorter);
+}
+
+// The right table is looked up by id when it joins on its key, and hashed otherwise
+static ExecuteResult execute_join(Statement* statement, Table* table, uint32_t columns, bool quiet)
+{
+	Table right = *table;
+	if (!catalog_find_table(table, statement->join_table_name, &right))
+		return EXECUTE_TABLE_NOT_FOUND;
+
+	SelectOutput output = {columns, &statement->where, quiet};
+	if (statement->join_right_column == COLUMN_ID)
+		index_join(table, &right, &statement->where, columns, print_joined_rows, &output);
+	else
+		hash_join(table, &right, &statement->where, statement->join_left_column, statement->join_right_column,
+			columns, print_joined_rows, &output);
 	return EXECUTE_SUCCESS;
 }
 
 static ExecuteResult execute_delete(Statement* statement, Table* table)
 {
+	if (!table_may_contain(table, statement->id_to_delete))
+		return EXECUTE_ID_NOT_FOUND;
+
 	Cursor* cursor = table_start(table);
 	Row row;
 
 	while (!cursor->end_of_table)
 	{
-		deserialize_row(cursor_value(cursor), &row);
-		if (row.id == statement->id_to_delete)
+		stats_increment(STAT_ROWS_EXAMINED);
+		cursor_read_row(cursor, &row, COLUMN_BIT(COLUMN_ID));
+		if (row.id == statement->id_to_delete && !cursor_is_deleted(cursor))
 		{
-			memset(cursor_value(cursor), 0, ROW_SIZE);
+			cursor_delete(cursor);
 			free(cursor);
 			return EXECUTE_SUCCESS;
 		}
@@ -183,27 +1093,272 @@ static ExecuteResult execute_delete(Statement* statement, Table* table)
 	return EXECUTE_ID_NOT_FOUND;
 }
 
+static ExecuteResult execute_update(Statement* statement, Table* table)
+{
+	uint64_t id = statement->where.value;
+	if (!table_may_contain(table, id))
+		return EXECUTE_ID_NOT_FOUND;
+
+	Cursor* cursor = table_find(table, id);
+	void* node = get_page(table->pager, cursor->page_num);
+	uint32_t cell_num = cursor->cell_num;
+	free(cursor);
+	stats_increment(STAT_ROWS_EXAMINED);
+
+	if (cell_num >= *leaf_node_num_cells(node) || *leaf_node_key(node, cell_num) != id || leaf_node_is_deleted(node, cell_num))
+		return EXECUTE_ID_NOT_FOUND;
+
+	Row row;
+	leaf_node_read_row(node, cell_num, &row, ALL_COLUMNS);
+	if (statement->update_columns & COLUMN_BIT(COLUMN_USERNAME))
+		memcpy(row.username, statement->update_values.username, sizeof(row.username));
+	if (statement->update_columns & COLUMN_BIT(COLUMN_EMAIL))
+		memcpy(row.email, statement->update_values.email, sizeof(row.email));
+	leaf_node_write_row(node, cell_num, &row);
+	return EXECUTE_SUCCESS;
+}
+
+
+static void print_row(Row* row, uint32_t columns)
+{
+	print_values(row->id, row->username, row->email, columns);
+}
+
+static void print_values(uint64_t id, const char* username, const char* email, uint32_t columns)
+{
+	const char* separator = "";
+
+	printf("(");
+	if (columns & COLUMN_BIT(COLUMN_ID))
+	{
+		printf("%" PRIu64, id);
+		separator = ", ";
+	}
+	if (columns & COLUMN_BIT(COLUMN_USERNAME))
+	{
+		printf("%s%s", separator, username);
+		separator = ", ";
+	}
+	if (columns & COLUMN_BIT(COLUMN_EMAIL))
+		printf("%s%s", separator, email);
+	printf(")\n");
+}
+
+// One tuple per pair: the selected columns of the left row, then those of the right row
+static void print_joined_rows(const Row* left, const Row* right, void* context)
+{
+	SelectOutput* output = context;
+	stats_increment(STAT_ROWS_RETURNED);
+	if (output->quiet)
+		return;
+
+	const Row* rows[] = {left, right};
+	const char* separator = "";
+	printf("(");
+	for (uint32_t i = 0; i < 2; ++i)
+	{
+		if (output->columns & COLUMN_BIT(COLUMN_ID))
+		{
+			printf("%s%" PRIu64, separator, rows[i]->id);
+			separator = ", ";
+		}
+		if (output->columns & COLUMN_BIT(COLUMN_USERNAME))
+		{
+			printf("%s%s", separator, rows[i]->username);
+			separator = ", ";
+		}
+		if (output->columns & COLUMN_BIT(COLUMN_EMAIL))
+		{
+			printf("%s%s", separator, rows[i]->email);
+			separator = ", ";
+		}
+	}
+	printf(")\n");
+}
+
+static void print_rows(Row* rows, uint32_t num_rows, void* context)
+{
+	SelectOutput* output = context;
+	for (uint32_t i = 0; i < num_rows; ++i)
+	{
+		if (!id_filter_matches(output->where, rows[i].id))
+			continue;
+		stats_increment(STAT_ROWS_RETURNED);
+		if (!output->quiet)
+			print_row(&rows[i], output->columns);
+	}
+}
 
-static bool is_valid_row(void* row)
+static void print_batch(RowBatch* batch, uint32_t columns)
 {
-	static const char test_block[ROW_SIZE] = {0};
-	return memcmp(test_block, row, ROW_SIZE);
+	for (uint32_t i = 0; i < batch->num_selected; ++i)
+	{
+		uint32_t row = batch->selection[i];
+		print_values(batch->ids[row],
+			batch->usernames ? batch->usernames[row] : NULL,
+			batch->emails ? batch->emails[row] : NULL, columns);
+	}
 }
 
-static void print_row(Row* row)
+static void print_aggregates(Statement* statement, TableAggregates* aggregates)
 {
-	printf("(%d, %s, %s)\n", row->id, row->username, row->email);
+	printf("(");
+	for (uint32_t i = 0; i < statement->num_aggregates; ++i)
+	{
+		if (i > 0)
+			printf(", ");
+
+		switch (statement->aggregates[i])
+		{
+		case AGGREGATE_COUNT:
+			printf("%" PRIu64, aggregates->count);
+			break;
+		case AGGREGATE_SUM:
+			printf("%" PRIu64, aggregates->sum);
+			break;
+		case AGGREGATE_MIN:
+			if (aggregates->has_rows)
+				printf("%" PRIu64, aggregates->min);
+			else
+				printf("NULL");
+			break;
+		case AGGREGATE_MAX:
+			if (aggregates->has_rows)
+				printf("%" PRIu64, aggregates->max);
+			else
+				printf("NULL");
+			break;
+		}
+	}
+	printf(")\n");
 }
 
+static void print_plan(Statement* statement)
+{
+	static const char* aggregate_names[] = {
+		[AGGREGATE_COUNT] = "count",
+		[AGGREGATE_MIN] = "min",
+		[AGGREGATE_MAX] = "max",
+		[AGGREGATE_SUM] = "sum",
+	};
+	const char* table_name = statement->table_name[0] ? statement->table_name : "default";
+	const IdFilter* where = &statement->where;
 
-static void print_constants(void)
+	printf("Plan: ");
+	switch (statement->type)
+	{
+	case STATEMENT_CREATE_TABLE:
+		printf("catalog insert of table %s\n", table_name);
+		return;
+	case STATEMENT_DROP_TABLE:
+		printf("catalog delete of table %s\n", table_name);
+		return;
+	case STATEMENT_VACUUM:
+		printf("rebuild of every table, %u%% full nodes\n", statement->fill_percent);
+		return;
+	case STATEMENT_INSERT:
+		printf("key seek on %s for id %" PRIu64 "%s\n", table_name, statement->row_to_insert.id,
+			statement->insert_or_replace ? ", replacing" : "");
+		return;
+	case STATEMENT_UPDATE:
+		printf("key seek on %s for id %" PRIu64 "\n", table_name, where->value);
+		return;
+	case STATEMENT_DELETE:
+		printf("full scan of %s for id %" PRIu64 "\n", table_name, statement->id_to_delete);
+		return;
+	case STATEMENT_SELECT:
+		break;
+	}
+
+	if (statement->join_table_name[0] != '\0')
+	{
+		printf("%s join of %s with %s on %s = %s", statement->join_right_column == COLUMN_ID ? "index" : "hash",
+			table_name, statement->join_table_name, column_names[statement->join_left_column],
+			column_names[statement->join_right_column]);
+		if (where->active)
+			printf(", filter id %s %" PRIu64, compare_operators[where->op], where->value);
+		printf("\n");
+		return;
+	}
+
+	uint64_t first_key, last_key;
+	bool pushdown = statement->num_aggregates > 0 && !where->active;
+	bool parallel = statement->num_aggregates == 0 && statement->scan_threads > 0;
+	bool sorted = statement->order_column != COLUMN_ID;
+	const char* direction = statement->order_descending && !sorted ? "reverse " : "";
+
+	if (pushdown)
+	{
+		// min and max descend one edge of the tree, count and sum walk the leaf headers
+		bool edges_only = true;
+		for (uint32_t i = 0; i < statement->num_aggregates; ++i)
+			if (statement->aggregates[i] == AGGREGATE_COUNT || statement->aggregates[i] == AGGREGATE_SUM)
+				edges_only = false;
+		printf("aggregate pushdown on %s, %s", table_name, edges_only ? "tree edge descent" : "leaf walk");
+	}
+	else if (parallel)
+		printf("parallel full scan of %s, %u threads, %s", table_name, statement->scan_threads,
+			statement->scan_unordered ? "unordered" : "ordered");
+	else if (!id_filter_range(where, &first_key, &last_key))
+		printf("empty range on %s", table_name);
+	else if (!where->active || where->op == COMPARE_NOT_EQUAL)
+		printf("%sfull scan of %s", direction, table_name);
+	else if (where->op == COMPARE_EQUAL)
+		printf("key seek on %s for id %" PRIu64, table_name, where->value);
+	else
+		printf("%srange scan of %s for id %s %" PRIu64, direction, table_name, compare_operators[where->op], where->value);
+
+	if (where->active && (parallel || where->op == COMPARE_NOT_EQUAL))
+		printf(", filter id %s %" PRIu64, compare_operators[where->op], where->value);
+	if (sorted)
+		printf(", external sort by %s%s", column_names[statement->order_column], statement->order_descending ? " desc" : "");
+	if (statement->has_limit)
+		printf(", limit %" PRIu64, statement->limit);
+	if (statement->offset > 0)
+		printf(", offset %" PRIu64, statement->offset);
+
+	if (statement->num_aggregates > 0)
+	{
+		printf(pushdown ? " (" : ", aggregate (");
+		for (uint32_t i = 0; i < statement->num_aggregates; ++i)
+			printf("%s%s", i > 0 ? ", " : "", aggregate_names[statement->aggregates[i]]);
+		printf(")");
+	}
+	printf("\n");
+}
+
+static void print_analysis(Statement* statement, const uint64_t* before, uint64_t elapsed_ns)
 {
+	uint64_t after[STAT_COUNTER_COUNT];
+	stats_snapshot_counters(after);
+
+	uint64_t delta[STAT_COUNTER_COUNT];
+	for (uint32_t i = 0; i < STAT_COUNTER_COUNT; ++i)
+		delta[i] = after[i] - before[i];
+
+	print_plan(statement);
+	printf("Pages: %" PRIu64 " touched, %" PRIu64 " hits, %" PRIu64 " misses, %" PRIu64 " read, %" PRIu64 " written\n",
+		delta[STAT_PAGE_HITS] + delta[STAT_PAGE_MISSES], delta[STAT_PAGE_HITS], delta[STAT_PAGE_MISSES],
+		delta[STAT_PAGES_READ], delta[STAT_PAGES_WRITTEN]);
+	printf("Rows: %" PRIu64 " examined, %" PRIu64 " returned\n", delta[STAT_ROWS_EXAMINED], delta[STAT_ROWS_RETURNED]);
+	printf("Splits: %" PRIu64 " leaf, %" PRIu64 " internal\n", delta[STAT_LEAF_SPLITS], delta[STAT_INTERNAL_SPLITS]);
+	if (statement->type == STATEMENT_SELECT && statement->order_column != COLUMN_ID)
+		printf("Sort: %" PRIu64 " run(s) spilled\n", delta[STAT_SORT_RUNS]);
+	if (statement->type == STATEMENT_SELECT && statement->join_table_name[0] != '\0')
+		printf("Join: %" PRIu64 " partition(s) spilled\n", delta[STAT_JOIN_PARTITIONS]);
+	printf("Time: %.3f ms\n", elapsed_ns / 1e6);
+}
+
+
+static void print_constants(uint32_t page_size)
+{
+	printf("PAGE_SIZE: %d\n", page_size);
 	printf("ROW_SIZE: %lld\n", ROW_SIZE);
 	printf("COMMON_NODE_HEADER_SIZE: %lld\n", COMMON_NODE_HEADER_SIZE);
 	printf("LEAF_NODE_HEADER_SIZE: %lld\n", LEAF_NODE_HEADER_SIZE);
 	printf("LEAF_NODE_CELL_SIZE: %lld\n", LEAF_NODE_CELL_SIZE);
-	printf("LEAF_NODE_SPACE_FOR_CELLS: %lld\n", LEAF_NODE_SPACE_FOR_CELLS);
-	printf("LEAF_NODE_MAX_CELLS: %lld\n", LEAF_NODE_MAX_CELLS);
+	printf("LEAF_NODE_SPACE_FOR_CELLS: %lld\n", LEAF_NODE_SPACE_FOR_CELLS(page_size));
+	printf("LEAF_NODE_MAX_CELLS: %lld\n", LEAF_NODE_MAX_CELLS(page_size));
 }
 
 void indent(uint32_t level)
@@ -212,11 +1367,11 @@ void indent(uint32_t level)
 		printf("  ");
 }
 
-void print_tree(Pager* pager, uint32_t page_num, uint32_t indent_level)
+void print_tree(Pager* pager, uint64_t page_num, uint32_t indent_level)
 {
 	void* node = get_page(pager, page_num);
-	uint8_t num_keys;
-	uint32_t child;
+	uint32_t num_keys;
+	uint64_t child;
 
 	switch (get_node_type(node))
 	{
@@ -228,7 +1383,7 @@ void print_tree(Pager* pager, uint32_t page_num, uint32_t indent_level)
 		for (uint32_t i = 0; i < num_keys; ++i)
 		{
 			indent(indent_level + 1);
-			printf("- %d\n", *leaf_node_key(node, i));
+			printf("- %" PRIu64 "\n", *leaf_node_key(node, i));
 		}
 		break;
 	}
@@ -243,11 +1398,15 @@ void print_tree(Pager* pager, uint32_t page_num, uint32_t indent_level)
 			print_tree(pager, child, indent_level + 1);
 
 			indent(indent_level + 1);
-			printf("- key %d\n", *internal_node_key(node, i));
+			printf("- key %" PRIu64 "\n", *internal_node_key(node, i));
 		}
 		child = *internal_node_right_child(node);
 		print_tree(pager, child, indent_level + 1);
 		break;
 	}
+	case NODE_FREE:
+		indent(indent_level);
+		printf("- free page %" PRIu64 "\n", page_num);
+		break;
 	}
 }
@@ -1,8 +1,12 @@
 #ifndef PARSER_H
 #define PARSER_H
 
+#include <stdbool.h>
 #include <stdint.h>
 
+#include "aggregate.h"
+#include "batch.h"
+#include "catalog.h"
 #include "input.h"
 #include "table.h"
 
@@ -10,7 +14,8 @@
 typedef enum
 {
     META_COMMAND_SUCCESS,
-    META_COMMAND_UNRECOGNIZED_COMMAND
+    META_COMMAND_UNRECOGNIZED_COMMAND,
+    META_COMMAND_CORRUPT_PAGE
 } MetaCommandResult;
 
 MetaCommandResult do_meta_command(InputBuffer* input_buffer, Table* table);
@@ -29,14 +34,45 @@ typedef enum
 {
     STATEMENT_SELECT,
     STATEMENT_INSERT,
-    STATEMENT_DELETE
+    STATEMENT_DELETE,
+    STATEMENT_CREATE_TABLE,
+    STATEMENT_DROP_TABLE,
+    STATEMENT_UPDATE,
+    STATEMENT_VACUUM
 } StatementType;
 
+typedef enum
+{
+    EXPLAIN_NONE,
+    EXPLAIN_PLAN,    // describe the access path without running the statement
+    EXPLAIN_ANALYZE  // run it, discarding the rows, and report what it cost
+} ExplainMode;
+
 typedef struct
 {
     StatementType type;
+    ExplainMode explain;
     Row row_to_insert;
-    uint32_t id_to_delete;
+    bool insert_or_replace;
+    uint64_t id_to_delete;
+    uint32_t select_columns;
+    uint32_t scan_threads; // 0 scans on the calling thread only
+    bool scan_unordered;
+    Column order_column; // COLUMN_ID is the key order the tree keeps, others are sorted
+    bool order_descending;
+    bool has_limit;
+    uint64_t limit;
+    uint64_t offset;
+    AggregateFunction aggregates[MAX_AGGREGATES];
+    uint32_t num_aggregates;
+    IdFilter where;
+    Row update_values;
+    uint32_t update_columns;
+    uint32_t fill_percent; // vacuum
+    char table_name[TABLE_NAME_SIZE + 1]; // empty for the default table
+    char join_table_name[TABLE_NAME_SIZE + 1]; // empty without a join
+    Column join_left_column;
+    Column join_right_column;
 } Statement;
 
 PrepareResult prepare_statement(InputBuffer* input_buffer, Statement* statement);
@@ -45,9 +81,11 @@ PrepareResult prepare_statement(InputBuffer* input_buffer, Statement* statement)
 typedef enum
 {
     EXECUTE_SUCCESS,
-    EXECUTE_TABLE_FULL,
     EXECUTE_ID_NOT_FOUND,
-    EXECUTE_DUPLICATE_KEY
+    EXECUTE_DUPLICATE_KEY,
+    EXECUTE_TABLE_NOT_FOUND,
+    EXECUTE_TABLE_EXISTS,
+    EXECUTE_CORRUPT_PAGE
 } ExecuteResult;
 
 ExecuteResult execute_statement(Statement* statement, Table* table);
@@ -0,0 +1,218 @@
+#include "scan.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "stats.h"
+#include "thread.h"
+
+#define SCAN_BATCH_ROWS 256
+
+
+typedef struct
+{
+	uint64_t* keys;
+	uint32_t count;
+	uint32_t capacity;
+} KeyList;
+
+typedef struct
+{
+	Table* table;
+	ScanRange range;
+	uint32_t columns;
+	bool ordered;
+	ScanCallback callback;
+	void* context;
+	Mutex* output_lock;
+
+	Row* rows;
+	uint64_t num_rows;
+	uint64_t rows_capacity;
+} ScanWorker;
+
+static void collect_separators(Pager* pager, uint64_t page_num, uint32_t depth, KeyList* list);
+static void key_list_push(KeyList* list, uint64_t key);
+static void scan_range(void* worker_ptr);
+static void worker_push_row(ScanWorker* worker, Row* row);
+
+
+uint32_t table_partition(Table* table, uint32_t max_ranges, ScanRange* ranges)
+{
+	KeyList separators = {0};
+	uint32_t internal_levels = table_depth(table) - 1;
+
+	// descend until the separators give enough ranges or the next level is the leaves
+	for (uint32_t depth = 1; depth <= internal_levels && separators.count + 1 < max_ranges; ++depth)
+	{
+		separators.count = 0;
+		collect_separators(table->pager, table->root_page_num, depth, &separators);
+	}
+
+	uint32_t num_ranges = separators.count + 1 < max_ranges ? separators.count + 1 : max_ranges;
+	uint64_t first_key = 0;
+	for (uint32_t i = 0; i < num_ranges; ++i)
+	{
+		// spread the cuts evenly over the available separators
+		ranges[i].first_key = first_key;
+		if (i + 1 == num_ranges)
+			ranges[i].last_key = UINT64_MAX;
+		else
+			ranges[i].last_key = separators.keys[(uint64_t)(i + 1) * (separators.count + 1) / num_ranges - 1];
+		first_key = ranges[i].last_key + 1;
+	}
+
+	free(separators.keys);
+	return num_ranges;
+}
+
+// In-order walk of the internal nodes down to depth, which yields separators in key order
+static void collect_separators(Pager* pager, uint64_t page_num, uint32_t depth, KeyList* list)
+{
+	void* node = get_page(pager, page_num);
+	if (depth == 0 || get_node_type(node) != NODE_INTERNAL)
+		return;
+
+	uint32_t num_keys = *internal_node_num_keys(node);
+	for (uint32_t i = 0; i < num_keys; ++i)
+	{
+		collect_separators(pager, *internal_node_child(node, i), depth - 1, list);
+		key_list_push(list, *internal_node_key(node, i));
+	}
+	collect_separators(pager, *internal_node_right_child(node), depth - 1, list);
+}
+
+static void key_list_push(KeyList* list, uint64_t key)
+{
+	if (list->count == list->capacity)
+	{
+		list->capacity = list->capacity ? list->capacity * 2 : 64;
+		list->keys = realloc(list->keys, list->capacity * sizeof(uint64_t));
+		if (!list->keys)
+		{
+			perror("realloc error");
+			exit(EXIT_FAILURE);
+		}
+	}
+	list->keys[list->count++] = key;
+}
+
+void table_parallel_scan(Table* table, uint32_t num_threads, uint32_t columns, bool ordered,
+	ScanCallback callback, void* context)
+{
+	if (num_threads == 0)
+		num_threads = 1;
+	if (num_threads > MAX_SCAN_THREADS)
+		num_threads = MAX_SCAN_THREADS;
+
+	// workers only read cached pages, so nothing in the pager changes underneath them
+	pager_load_all(table->pager);
+
+	ScanRange ranges[MAX_SCAN_THREADS];
+	uint32_t num_ranges = table_partition(table, num_threads, ranges);
+
+	ScanWorker workers[MAX_SCAN_THREADS];
+	Thread threads[MAX_SCAN_THREADS];
+	Mutex output_lock;
+	mutex_init(&output_lock);
+
+	for (uint32_t i = 0; i < num_ranges; ++i)
+	{
+		workers[i] = (ScanWorker){
+			.table = table,
+			.range = ranges[i],
+			.columns = columns,
+			.ordered = ordered,
+			.callback = callback,
+			.context = context,
+			.output_lock = &output_lock,
+		};
+		// the calling thread takes the first range itself
+		if (i > 0)
+			thread_start(&threads[i], scan_range, &workers[i]);
+	}
+	scan_range(&workers[0]);
+
+	for (uint32_t i = 0; i < num_ranges; ++i)
+	{
+		if (i > 0)
+			thread_join(threads[i]);
+
+		ScanWorker* worker = &workers[i];
+		for (uint64_t offset = 0; offset < worker->num_rows; offset += SCAN_BATCH_ROWS)
+		{
+			uint64_t remaining = worker->num_rows - offset;
+			callback(worker->rows + offset, remaining < SCAN_BATCH_ROWS ? (uint32_t)remaining : SCAN_BATCH_ROWS, context);
+		}
+		free(worker->rows);
+	}
+
+	mutex_destroy(&output_lock);
+}
+
+static void scan_range(void* worker_ptr)
+{
+	ScanWorker* worker = worker_ptr;
+	Table* table = worker->table;
+	Cursor* cursor = table_descend(table, worker->range.first_key);
+
+	// the cursor lands past the last cell when every key in its leaf is smaller
+	void* node = get_page(table->pager, cursor->page_num);
+	uint32_t num_cells = *leaf_node_num_cells(node);
+	cursor->end_of_table = (num_cells == 0);
+	if (num_cells > 0 && cursor->cell_num == num_cells)
+	{
+		cursor->cell_num = num_cells - 1;
+		cursor_advance(cursor);
+	}
+
+	Row row;
+	while (!cursor->end_of_table)
+	{
+		node = get_page(table->pager, cursor->page_num);
+		if (*leaf_node_key(node, cursor->cell_num) > worker->range.last_key)
+			break;
+		stats_increment(STAT_ROWS_EXAMINED);
+
+		if (!leaf_node_is_deleted(node, cursor->cell_num))
+		{
+			leaf_node_read_row(node, cursor->cell_num, &row, worker->columns);
+			worker_push_row(worker, &row);
+		}
+		cursor_advance(cursor);
+	}
+	free(cursor);
+
+	// unordered scans hand over whatever is left; ordered ones wait for the join
+	if (!worker->ordered && worker->num_rows > 0)
+	{
+		mutex_lock(worker->output_lock);
+		worker->callback(worker->rows, (uint32_t)worker->num_rows, worker->context);
+		mutex_unlock(worker->output_lock);
+		worker->num_rows = 0;
+	}
+}
+
+static void worker_push_row(ScanWorker* worker, Row* row)
+{
+	if (!worker->ordered && worker->num_rows == SCAN_BATCH_ROWS)
+	{
+		mutex_lock(worker->output_lock);
+		worker->callback(worker->rows, (uint32_t)worker->num_rows, worker->context);
+		mutex_unlock(worker->output_lock);
+		worker->num_rows = 0;
+	}
+
+	if (worker->num_rows == worker->rows_capacity)
+	{
+		worker->rows_capacity = worker->rows_capacity ? worker->rows_capacity * 2 : SCAN_BATCH_ROWS;
+		worker->rows = realloc(worker->rows, worker->rows_capacity * sizeof(Row));
+		if (!worker->rows)
+		{
+			perror("realloc error");
+			exit(EXIT_FAILURE);
+		}
+	}
+	worker->rows[worker->num_rows++] = *row;
+}
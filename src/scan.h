@@ -0,0 +1,31 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "table.h"
+
+// Parallel full-table scans. The key space is cut at separator keys taken from
+// the top internal levels, and each range is read by its own thread and cursor.
+
+#define MAX_SCAN_THREADS 64
+
+typedef struct
+{
+	uint64_t first_key;
+	uint64_t last_key;
+} ScanRange;
+
+// Receives live rows in batches. Ordered scans call it from the calling thread in
+// key order; unordered scans call it from the workers, one batch at a time.
+typedef void (*ScanCallback)(Row* rows, uint32_t num_rows, void* context);
+
+// Splits the key space into at most max_ranges contiguous ranges covering 0..UINT64_MAX
+uint32_t table_partition(Table* table, uint32_t max_ranges, ScanRange* ranges);
+
+// Ordered scans buffer each range until the ranges before it have been emitted
+void table_parallel_scan(Table* table, uint32_t num_threads, uint32_t columns, bool ordered,
+	ScanCallback callback, void* context);
+
+#endif // SCAN_H
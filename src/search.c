@@ -0,0 +1,111 @@
+#include "search.h"
+
+#include <stdint.h>
+
+#include "cpu.h"
+#include "thread.h"
+
+#if defined(CPU_X86_64)
+#include <immintrin.h>
+#endif
+
+#if defined(CPU_X86_64) && defined(__GNUC__)
+#define TARGET_SSE42 __attribute__((target("sse4.2,popcnt")))
+#define TARGET_AVX2 __attribute__((target("avx2,popcnt")))
+#else
+#define TARGET_SSE42
+#define TARGET_AVX2
+#endif
+
+// Below this many keys a branch-free SIMD count beats further binary search steps
+#define LINEAR_SEARCH_THRESHOLD 32
+#define SIGN_BIT 0x8000000000000000u
+
+
+typedef uint32_t (*CountLessThan)(const uint64_t* keys, uint32_t num_keys, uint64_t key);
+
+static void search_init(void);
+static uint32_t count_less_than_scalar(const uint64_t* keys, uint32_t num_keys, uint64_t key);
+#if defined(CPU_X86_64)
+static uint32_t count_less_than_sse42(const uint64_t* keys, uint32_t num_keys, uint64_t key);
+static uint32_t count_less_than_avx2(const uint64_t* keys, uint32_t num_keys, uint64_t key);
+#endif
+
+// Picked once, before the first search, so scan workers all see the same routine
+static Once search_once = ONCE_INITIALIZER;
+static CountLessThan count_less_than = count_less_than_scalar;
+
+
+uint32_t key_lower_bound(const uint64_t* keys, uint32_t num_keys, uint64_t key)
+{
+	thread_once(&search_once, search_init);
+
+	uint32_t min_index = 0;
+	uint32_t max_index = num_keys;
+	while (max_index - min_index > LINEAR_SEARCH_THRESHOLD)
+	{
+		uint32_t index = (min_index + max_index) / 2;
+		if (keys[index] < key)
+			min_index = index + 1;
+		else
+			max_index = index;
+	}
+
+	return min_index + count_less_than(keys + min_index, max_index - min_index, key);
+}
+
+static void search_init(void)
+{
+#if defined(CPU_X86_64)
+	if (cpu_has_avx2())
+		count_less_than = count_less_than_avx2;
+	else if (cpu_has_sse42())
+		count_less_than = count_less_than_sse42;
+#endif
+}
+
+static uint32_t count_less_than_scalar(const uint64_t* keys, uint32_t num_keys, uint64_t key)
+{
+	uint32_t count = 0;
+	for (uint32_t i = 0; i < num_keys; ++i)
+		count += keys[i] < key;
+	return count;
+}
+
+#if defined(CPU_X86_64)
+// 64-bit lane compares arrive with SSE4.2 and are signed only, so both sides are biased by the sign bit.
+
+TARGET_SSE42 static uint32_t count_less_than_sse42(const uint64_t* keys, uint32_t num_keys, uint64_t key)
+{
+	const __m128i bias = _mm_set1_epi64x((long long)SIGN_BIT);
+	const __m128i target = _mm_xor_si128(_mm_set1_epi64x((long long)key), bias);
+	uint32_t count = 0;
+	uint32_t i = 0;
+
+	for (; i + 2 <= num_keys; i += 2)
+	{
+		__m128i block = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(keys + i)), bias);
+		int mask = _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(target, block)));
+		count += (uint32_t)_mm_popcnt_u32((unsigned int)mask);
+	}
+
+	return count + count_less_than_scalar(keys + i, num_keys - i, key);
+}
+
+TARGET_AVX2 static uint32_t count_less_than_avx2(const uint64_t* keys, uint32_t num_keys, uint64_t key)
+{
+	const __m256i bias = _mm256_set1_epi64x((long long)SIGN_BIT);
+	const __m256i target = _mm256_xor_si256(_mm256_set1_epi64x((long long)key), bias);
+	uint32_t count = 0;
+	uint32_t i = 0;
+
+	for (; i + 4 <= num_keys; i += 4)
+	{
+		__m256i block = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(keys + i)), bias);
+		int mask = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(target, block)));
+		count += (uint32_t)_mm_popcnt_u32((unsigned int)mask);
+	}
+
+	return count + count_less_than_scalar(keys + i, num_keys - i, key);
+}
+#endif
@@ -0,0 +1,10 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <stdint.h>
+
+// Index of the first key that is not less than `key`, or num_keys if there is none.
+// `keys` must be sorted. Uses AVX2 or SSE4.2 compares when available.
+uint32_t key_lower_bound(const uint64_t* keys, uint32_t num_keys, uint64_t key);
+
+#endif // SEARCH_H
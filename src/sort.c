@@ -0,0 +1,455 @@
+#include "sort.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "stats.h"
+
+// Sorts are never smaller than this, so the buffer only grows for big inputs
+#define SORT_INITIAL_RECORDS 1024
+// Below this many records a run is put in order by insertion before merging
+#define SORT_INSERTION_WIDTH 16
+#define SORT_PREFETCH_DISTANCE 8
+
+#if defined(__GNUC__) || defined(__clang__)
+#define PREFETCH(address) __builtin_prefetch(address)
+#else
+#define PREFETCH(address) ((void)(address))
+#endif
+
+
+// The first bytes of a key travel with the record number, so most comparisons
+// during the in-memory sort never touch the records
+typedef struct
+{
+	uint64_t prefix;
+	uint32_t record;
+} SortEntry;
+
+typedef struct
+{
+	FILE* file; // NULL for the rows still in memory
+	SortEntry* next; // position in the in-memory order
+	SortEntry* end;
+	unsigned char* buffer; // holds the current record of a file run
+	unsigned char* record; // the current record, NULL once the source is exhausted
+} MergeSource;
+
+// Loser tree over the sources: tree[0] is the source with the smallest record,
+// every other node holds the source that lost the match played there
+typedef struct
+{
+	MergeSource* sources;
+	uint32_t* tree;
+	uint32_t num_sources;
+	const Sorter* sorter; // sizes, and the rows still in memory
+	bool started;
+} Merge;
+
+struct Sorter
+{
+	Column column;
+	bool descending;
+	uint32_t key_size;
+	uint32_t record_size; // key followed by the row
+	uint32_t max_records;
+	uint32_t capacity;
+	uint32_t num_records;
+	unsigned char* records;
+	SortEntry* order;
+	SortEntry* scratch;
+	FILE** runs;
+	uint32_t num_runs;
+	uint32_t runs_spilled;
+	Merge merge;
+};
+
+static uint64_t memory_limit = SORT_DEFAULT_MEMORY;
+
+static void* checked_realloc(void* pointer, size_t size);
+static FILE* open_run(void);
+static void encode_key(const Sorter* sorter, const Row* row, unsigned char* key);
+static void sort_records(Sorter* sorter);
+static void spill_run(Sorter* sorter);
+static void merge_runs(Sorter* sorter, uint32_t num_runs);
+static void merge_start(Merge* merge, const Sorter* sorter, FILE** runs, uint32_t num_runs, bool with_memory);
+static unsigned char* merge_next(Merge* merge);
+static void merge_free(Merge* merge);
+
+
+void sort_set_memory_limit(uint64_t bytes)
+{
+	memory_limit = bytes;
+}
+
+uint64_t sort_memory_limit(void)
+{
+	return memory_limit;
+}
+
+Sorter* sorter_new(Column column, bool descending)
+{
+	Sorter* sorter = calloc(1, sizeof(Sorter));
+	if (!sorter)
+	{
+		perror("calloc error");
+		exit(EXIT_FAILURE);
+	}
+
+	sorter->column = column;
+	sorter->descending = descending;
+	if (column == COLUMN_USERNAME)
+		sorter->key_size = USERNAME_SIZE + ID_SIZE;
+	else if (column == COLUMN_EMAIL)
+		sorter->key_size = EMAIL_SIZE + ID_SIZE;
+	else
+		sorter->key_size = ID_SIZE;
+	sorter->record_size = sorter->key_size + sizeof(Row);
+
+	// the order and scratch arrays count against the limit too, and a run holds at least one row
+	uint64_t max_records = memory_limit / (sorter->record_size + 2 * sizeof(SortEntry));
+	sorter->max_records = max_records == 0 ? 1 : max_records > UINT32_MAX ? UINT32_MAX : (uint32_t)max_records;
+	return sorter;
+}
+
+void sorter_free(Sorter* sorter)
+{
+	merge_free(&sorter->merge);
+	for (uint32_t i = 0; i < sorter->num_runs; ++i)
+		fclose(sorter->runs[i]);
+	free(sorter->runs);
+	free(sorter->records);
+	free(sorter->order);
+	free(sorter->scratch);
+	free(sorter);
+}
+
+void sorter_add(Sorter* sorter, const Row* row)
+{
+	if (sorter->num_records == sorter->max_records)
+		spill_run(sorter);
+
+	if (sorter->num_records == sorter->capacity)
+	{
+		uint64_t capacity = sorter->capacity ? (uint64_t)sorter->capacity * 2 : SORT_INITIAL_RECORDS;
+		sorter->capacity = capacity > sorter->max_records ? sorter->max_records : (uint32_t)capacity;
+		sorter->records = checked_realloc(sorter->records, (size_t)sorter->capacity * sorter->record_size);
+		sorter->order = checked_realloc(sorter->order, (size_t)sorter->capacity * sizeof(SortEntry));
+		sorter->scratch = checked_realloc(sorter->scratch, (size_t)sorter->capacity * sizeof(SortEntry));
+	}
+
+	unsigned char* record = sorter->records + (size_t)sorter->num_records * sorter->record_size;
+	encode_key(sorter, row, record);
+	memcpy(record + sorter->key_size, row, sizeof(Row));
+	uint64_t prefix = 0;
+	for (uint32_t i = 0; i < sizeof(prefix); ++i)
+		prefix = prefix << 8 | record[i];
+	sorter->order[sorter->num_records] = (SortEntry){prefix, sorter->num_records};
+	sorter->num_records++;
+}
+
+void sorter_finish(Sorter* sorter)
+{
+	if (sorter->num_runs > 0)
+	{
+		// the rows in memory take a merge slot of their own unless they have to make room
+		if (sorter->num_records > 0 && sorter->num_runs >= SORT_MAX_FAN_IN)
+			spill_run(sorter);
+		while (sorter->num_runs > SORT_MAX_FAN_IN)
+			merge_runs(sorter, SORT_MAX_FAN_IN);
+	}
+
+	sort_records(sorter);
+	merge_start(&sorter->merge, sorter, sorter->runs, sorter->num_runs, true);
+}
+
+bool sorter_next(Sorter* sorter, Row* row)
+{
+	unsigned char* record = merge_next(&sorter->merge);
+	if (!record)
+		return false;
+	memcpy(row, record + sorter->key_size, sizeof(Row));
+	return true;
+}
+
+uint32_t sorter_num_runs(const Sorter* sorter)
+{
+	return sorter->runs_spilled;
+}
+
+
+static void* checked_realloc(void* pointer, size_t size)
+{
+	void* resized = realloc(pointer, size);
+	if (!resized)
+	{
+		perror("realloc error");
+		exit(EXIT_FAILURE);
+	}
+	return resized;
+}
+
+// Temporary files are removed when they are closed or the process exits
+static FILE* open_run(void)
+{
+	FILE* file = tmpfile();
+	if (!file)
+	{
+		perror("tmpfile error");
+		exit(EXIT_FAILURE);
+	}
+	setvbuf(file, NULL, _IOFBF, SORT_RUN_BUFFER_SIZE);
+	return file;
+}
+
+static void write_record(FILE* file, const unsigned char* record, uint32_t record_size)
+{
+	if (fwrite(record, record_size, 1, file) != 1)
+	{
+		perror("fwrite error");
+		exit(EXIT_FAILURE);
+	}
+}
+
+static void encode_key(const Sorter* sorter, const Row* row, unsigned char* key)
+{
+	uint32_t value_size = 0;
+	if (sorter->column != COLUMN_ID)
+	{
+		const char* value = sorter->column == COLUMN_USERNAME ? row->username : row->email;
+		value_size = sorter->key_size - ID_SIZE;
+		const char* end = memchr(value, '\0', value_size);
+		size_t length = end ? (size_t)(end - value) : value_size;
+		memcpy(key, value, length);
+		memset(key + length, 0, value_size - length);
+	}
+
+	for (uint32_t i = 0; i < ID_SIZE; ++i)
+		key[value_size + i] = (unsigned char)(row->id >> (8 * (ID_SIZE - 1 - i)));
+
+	// ties on the column stay in ascending id order
+	uint32_t inverted = sorter->column == COLUMN_ID ? ID_SIZE : value_size;
+	if (sorter->descending)
+		for (uint32_t i = 0; i < inverted; ++i)
+			key[i] = (unsigned char)~key[i];
+}
+
+// Every key is at least as long as the prefix
+static inline int compare_entries(const Sorter* sorter, const SortEntry* a, const SortEntry* b)
+{
+	if (a->prefix != b->prefix)
+		return a->prefix < b->prefix ? -1 : 1;
+	return memcmp(sorter->records + (size_t)a->record * sorter->record_size + sizeof(a->prefix),
+		sorter->records + (size_t)b->record * sorter->record_size + sizeof(b->prefix),
+		sorter->key_size - sizeof(a->prefix));
+}
+
+// Bottom-up merge sort of the order array, starting from short runs put in order by insertion
+static void sort_records(Sorter* sorter)
+{
+	uint32_t num_records = sorter->num_records;
+	SortEntry* from = sorter->order;
+	SortEntry* to = sorter->scratch;
+
+	for (uint32_t low = 0; low < num_records; low += SORT_INSERTION_WIDTH)
+	{
+		uint32_t high = num_records - low < SORT_INSERTION_WIDTH ? num_records : low + SORT_INSERTION_WIDTH;
+		for (uint32_t i = low + 1; i < high; ++i)
+		{
+			SortEntry entry = from[i];
+			uint32_t j = i;
+			for (; j > low && compare_entries(sorter, &from[j - 1], &entry) > 0; --j)
+				from[j] = from[j - 1];
+			from[j] = entry;
+		}
+	}
+
+	for (uint64_t width = SORT_INSERTION_WIDTH; width < num_records; width *= 2)
+	{
+		for (uint64_t low = 0; low < num_records; low += 2 * width)
+		{
+			uint32_t middle = (uint32_t)(low + width < num_records ? low + width : num_records);
+			uint32_t high = (uint32_t)(low + 2 * width < num_records ? low + 2 * width : num_records);
+			uint32_t left = (uint32_t)low, right = middle, out = (uint32_t)low;
+			while (left < middle && right < high)
+				to[out++] = compare_entries(sorter, &from[right], &from[left]) < 0 ? from[right++] : from[left++];
+			while (left < middle)
+				to[out++] = from[left++];
+			while (right < high)
+				to[out++] = from[right++];
+		}
+		SortEntry* swap = from;
+		from = to;
+		to = swap;
+	}
+
+	sorter->order = from;
+	sorter->scratch = to;
+}
+
+static void spill_run(Sorter* sorter)
+{
+	sort_records(sorter);
+	FILE* run = open_run();
+	for (uint32_t i = 0; i < sorter->num_records; ++i)
+		write_record(run, sorter->records + (size_t)sorter->order[i].record * sorter->record_size, sorter->record_size);
+
+	sorter->runs = checked_realloc(sorter->runs, (sorter->num_runs + 1) * sizeof(FILE*));
+	sorter->runs[sorter->num_runs++] = run;
+	sorter->runs_spilled++;
+	sorter->num_records = 0;
+	stats_increment(STAT_SORT_RUNS);
+}
+
+// Replaces the first num_runs runs with one run holding all their rows
+static void merge_runs(Sorter* sorter, uint32_t num_runs)
+{
+	Merge merge = {0};
+	merge_start(&merge, sorter, sorter->runs, num_runs, false);
+
+	FILE* run = open_run();
+	unsigned char* record;
+	while ((record = merge_next(&merge)))
+		write_record(run, record, sorter->record_size);
+	merge_free(&merge);
+
+	for (uint32_t i = 0; i < num_runs; ++i)
+		fclose(sorter->runs[i]);
+	memmove(sorter->runs, sorter->runs + num_runs, (sorter->num_runs - num_runs) * sizeof(FILE*));
+	sorter->num_runs -= num_runs;
+	sorter->runs[sorter->num_runs++] = run;
+	sorter->runs_spilled++;
+	stats_increment(STAT_SORT_RUNS);
+}
+
+static void source_advance(const Merge* merge, MergeSource* source)
+{
+	const Sorter* sorter = merge->sorter;
+	if (!source->file)
+	{
+		// rows in memory are read in random order, so fetch the next few ahead of time
+		if (source->end - source->next > SORT_PREFETCH_DISTANCE)
+			PREFETCH(sorter->records + (size_t)source->next[SORT_PREFETCH_DISTANCE].record * sorter->record_size);
+		source->record = source->next < source->end
+			? sorter->records + (size_t)(source->next++)->record * sorter->record_size
+			: NULL;
+		return;
+	}
+
+	if (fread(source->buffer, sorter->record_size, 1, source->file) == 1)
+		source->record = source->buffer;
+	else if (ferror(source->file))
+	{
+		perror("fread error");
+		exit(EXIT_FAILURE);
+	}
+	else
+		source->record = NULL;
+}
+
+// An exhausted source loses every match
+static inline bool beats(const Merge* merge, uint32_t a, uint32_t b)
+{
+	const unsigned char* first = merge->sources[a].record;
+	const unsigned char* second = merge->sources[b].record;
+	if (!first || !second)
+		return first != NULL;
+	return memcmp(first, second, merge->sorter->key_size) < 0;
+}
+
+// Plays the matches below node and returns the winner; the sources are the leaves
+// num_sources to 2 * num_sources - 1 of a complete binary tree
+static uint32_t build_tree(Merge* merge, uint32_t node)
+{
+	if (node >= merge->num_sources)
+		return node - merge->num_sources;
+
+	uint32_t left = build_tree(merge, 2 * node);
+	uint32_t right = build_tree(merge, 2 * node + 1);
+	if (beats(merge, right, left))
+	{
+		merge->tree[node] = left;
+		return right;
+	}
+	merge->tree[node] = right;
+	return left;
+}
+
+static void merge_start(Merge* merge, const Sorter* sorter, FILE** runs, uint32_t num_runs, bool with_memory)
+{
+	merge->sorter = sorter;
+	merge->started = false;
+	merge->num_sources = num_runs + (with_memory && sorter->num_records > 0);
+	if (merge->num_sources == 0)
+		return;
+
+	merge->sources = calloc(merge->num_sources, sizeof(MergeSource));
+	merge->tree = calloc(merge->num_sources, sizeof(uint32_t));
+	if (!merge->sources || !merge->tree)
+	{
+		perror("calloc error");
+		exit(EXIT_FAILURE);
+	}
+
+	for (uint32_t i = 0; i < merge->num_sources; ++i)
+	{
+		MergeSource* source = &merge->sources[i];
+		if (i < num_runs)
+		{
+			source->file = runs[i];
+			rewind(source->file);
+			source->buffer = malloc(sorter->record_size);
+			if (!source->buffer)
+			{
+				perror("malloc error");
+				exit(EXIT_FAILURE);
+			}
+		}
+		else
+		{
+			source->next = sorter->order;
+			source->end = sorter->order + sorter->num_records;
+		}
+		source_advance(merge, source);
+	}
+	merge->tree[0] = build_tree(merge, 1);
+}
+
+// The record returned stays valid until the next call
+static unsigned char* merge_next(Merge* merge)
+{
+	if (merge->num_sources == 0)
+		return NULL;
+
+	uint32_t winner = merge->tree[0];
+	if (merge->started)
+	{
+		// only the matches on the path from the winner's leaf to the root can change
+		source_advance(merge, &merge->sources[winner]);
+		for (uint32_t node = (winner + merge->num_sources) / 2; node > 0; node /= 2)
+		{
+			if (beats(merge, merge->tree[node], winner))
+			{
+				uint32_t loser = winner;
+				winner = merge->tree[node];
+				merge->tree[node] = loser;
+			}
+		}
+		merge->tree[0] = winner;
+	}
+	merge->started = true;
+	return merge->sources[winner].record;
+}
+
+static void merge_free(Merge* merge)
+{
+	if (merge->sources)
+		for (uint32_t i = 0; i < merge->num_sources; ++i)
+			free(merge->sources[i].buffer);
+	free(merge->sources);
+	free(merge->tree);
+	merge->sources = NULL;
+	merge->tree = NULL;
+	merge->num_sources = 0;
+}
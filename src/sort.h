@@ -0,0 +1,37 @@
+#ifndef SORT_H
+#define SORT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "table.h"
+
+// External merge sort for orders the tree does not keep. Each row is stored
+// behind a normalized key, a byte string whose memcmp order is the requested
+// order: strings zero padded to their column width, then the id big-endian to
+// break ties, with the column bytes inverted for a descending sort. Rows are
+// buffered until the sort memory limit is reached, then sorted and written to a
+// temporary file as a run; reading the result merges the runs and the rows
+// still in memory through a loser tree.
+
+#define SORT_DEFAULT_MEMORY (64u << 20)
+// Runs merged at once; more than this are first merged into longer runs
+#define SORT_MAX_FAN_IN 64
+#define SORT_RUN_BUFFER_SIZE (64 * 1024)
+
+typedef struct Sorter Sorter;
+
+// Shared by every sort; bytes of rows a sort holds in memory before spilling a run
+void sort_set_memory_limit(uint64_t bytes);
+uint64_t sort_memory_limit(void);
+
+Sorter* sorter_new(Column column, bool descending);
+void sorter_free(Sorter* sorter);
+void sorter_add(Sorter* sorter, const Row* row);
+// Ends the input; the rows then come back in order from sorter_next
+void sorter_finish(Sorter* sorter);
+bool sorter_next(Sorter* sorter, Row* row);
+// Runs written to temporary files so far
+uint32_t sorter_num_runs(const Sorter* sorter);
+
+#endif // SORT_H
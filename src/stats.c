@@ -0,0 +1,266 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "stats.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+
+
+THREAD_LOCAL StatsBlock* stats_thread_block = NULL;
+
+static Mutex stats_lock = MUTEX_INITIALIZER;
+static StatsBlock* live_blocks = NULL;
+static StatsBlock retired;
+
+static const char* counter_names[] = {
+	[STAT_PAGE_HITS] = "page_hits",
+	[STAT_PAGE_MISSES] = "page_misses",
+	[STAT_PAGES_READ] = "pages_read",
+	[STAT_PAGES_WRITTEN] = "pages_written",
+	[STAT_PAGER_FLUSHES] = "pager_flushes",
+	[STAT_LEAF_SPLITS] = "leaf_splits",
+	[STAT_INTERNAL_SPLITS] = "internal_splits",
+	[STAT_CURSORS] = "cursors",
+	[STAT_ROWS_EXAMINED] = "rows_examined",
+	[STAT_ROWS_RETURNED] = "rows_returned",
+	[STAT_KEY_FILTER_SKIPS] = "key_filter_skips",
+	[STAT_HASH_INDEX_HITS] = "hash_index_hits",
+	[STAT_APPEND_HITS] = "append_hits",
+	[STAT_SORT_RUNS] = "sort_runs",
+	[STAT_JOIN_PARTITIONS] = "join_partitions",
+	[STAT_MEMTABLE_MERGES] = "memtable_merges",
+};
+
+static const char* histogram_names[] = {
+	[STAT_TIME_SELECT] = "select",
+	[STAT_TIME_INSERT] = "insert",
+	[STAT_TIME_UPDATE] = "update",
+	[STAT_TIME_DELETE] = "delete",
+	[STAT_TIME_CREATE_TABLE] = "create_table",
+	[STAT_TIME_DROP_TABLE] = "drop_table",
+	[STAT_TIME_VACUUM] = "vacuum",
+	[STAT_TIME_PAGE_READ] = "page_read",
+	[STAT_TIME_PREPARE] = "prepare",
+};
+
+static void add_block(StatsBlock* total, const StatsBlock* block);
+static uint32_t bucket_index(uint64_t value);
+static uint64_t bucket_lower_bound(uint32_t index);
+
+
+StatsBlock* stats_register_thread(void)
+{
+	StatsBlock* block = calloc(1, sizeof(StatsBlock));
+	if (!block)
+	{
+		perror("calloc error");
+		exit(EXIT_FAILURE);
+	}
+
+	mutex_lock(&stats_lock);
+	block->next = live_blocks;
+	live_blocks = block;
+	mutex_unlock(&stats_lock);
+
+	stats_thread_block = block;
+	return block;
+}
+
+void stats_thread_exit(void)
+{
+	StatsBlock* block = stats_thread_block;
+	if (!block)
+		return;
+
+	mutex_lock(&stats_lock);
+	add_block(&retired, block);
+	for (StatsBlock** link = &live_blocks; *link; link = &(*link)->next)
+	{
+		if (*link == block)
+		{
+			*link = block->next;
+			break;
+		}
+	}
+	mutex_unlock(&stats_lock);
+
+	free(block);
+	stats_thread_block = NULL;
+}
+
+uint64_t stats_now_ns(void)
+{
+#ifdef _WIN32
+	static LARGE_INTEGER frequency;
+	LARGE_INTEGER counter;
+	if (frequency.QuadPart == 0)
+		QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&counter);
+	return (uint64_t)(counter.QuadPart / frequency.QuadPart) * 1000000000ull
+		+ (uint64_t)(counter.QuadPart % frequency.QuadPart) * 1000000000ull / (uint64_t)frequency.QuadPart;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+void histogram_record(Histogram* histogram, uint64_t value)
+{
+	histogram->count++;
+	histogram->total += value;
+	if (value > histogram->max)
+		histogram->max = value;
+	histogram->buckets[bucket_index(value)]++;
+}
+
+// Returns the lower bound of the bucket holding the given percentile (0-100)
+uint64_t histogram_percentile(const Histogram* histogram, double percentile)
+{
+	if (histogram->count == 0)
+		return 0;
+
+	uint64_t rank = (uint64_t)(percentile / 100.0 * (double)histogram->count);
+	if (rank >= histogram->count)
+		rank = histogram->count - 1;
+
+	uint64_t seen = 0;
+	for (uint32_t i = 0; i < HISTOGRAM_BUCKETS; ++i)
+	{
+		seen += histogram->buckets[i];
+		if (seen > rank)
+			return bucket_lower_bound(i);
+	}
+	return histogram->max;
+}
+
+static uint32_t bucket_index(uint64_t value)
+{
+	if (value < HISTOGRAM_SUB_BUCKETS)
+		return (uint32_t)value;
+
+	uint32_t magnitude = 63;
+	while (!(value >> magnitude))
+		magnitude--;
+
+	uint32_t shift = magnitude - HISTOGRAM_SUB_BUCKET_BITS;
+	uint32_t sub_bucket = (uint32_t)(value >> shift) - HISTOGRAM_SUB_BUCKETS;
+	return HISTOGRAM_SUB_BUCKETS + shift * HISTOGRAM_SUB_BUCKETS + sub_bucket;
+}
+
+static uint64_t bucket_lower_bound(uint32_t index)
+{
+	if (index < HISTOGRAM_SUB_BUCKETS)
+		return index;
+
+	uint32_t shift = (index - HISTOGRAM_SUB_BUCKETS) / HISTOGRAM_SUB_BUCKETS;
+	uint64_t sub_bucket = (index - HISTOGRAM_SUB_BUCKETS) % HISTOGRAM_SUB_BUCKETS;
+	return (HISTOGRAM_SUB_BUCKETS + sub_bucket) << shift;
+}
+
+static void add_block(StatsBlock* total, const StatsBlock* block)
+{
+	for (uint32_t i = 0; i < STAT_COUNTER_COUNT; ++i)
+		total->counters[i] += block->counters[i];
+
+	for (uint32_t i = 0; i < STAT_HISTOGRAM_COUNT; ++i)
+	{
+		Histogram* destination = &total->histograms[i];
+		const Histogram* source = &block->histograms[i];
+		destination->count += source->count;
+		destination->total += source->total;
+		if (source->max > destination->max)
+			destination->max = source->max;
+		for (uint32_t j = 0; j < HISTOGRAM_BUCKETS; ++j)
+			destination->buckets[j] += source->buckets[j];
+	}
+}
+
+void stats_snapshot(StatsBlock* snapshot)
+{
+	memset(snapshot, 0, sizeof(StatsBlock));
+
+	mutex_lock(&stats_lock);
+	add_block(snapshot, &retired);
+	for (StatsBlock* block = live_blocks; block; block = block->next)
+		add_block(snapshot, block);
+	mutex_unlock(&stats_lock);
+
+	snapshot->next = NULL;
+}
+
+void stats_snapshot_counters(uint64_t counters[STAT_COUNTER_COUNT])
+{
+	memset(counters, 0, STAT_COUNTER_COUNT * sizeof(uint64_t));
+
+	mutex_lock(&stats_lock);
+	for (uint32_t i = 0; i < STAT_COUNTER_COUNT; ++i)
+		counters[i] = retired.counters[i];
+	for (StatsBlock* block = live_blocks; block; block = block->next)
+		for (uint32_t i = 0; i < STAT_COUNTER_COUNT; ++i)
+			counters[i] += block->counters[i];
+	mutex_unlock(&stats_lock);
+}
+
+void stats_reset(void)
+{
+	mutex_lock(&stats_lock);
+	for (StatsBlock* block = live_blocks; block; block = block->next)
+	{
+		StatsBlock* next = block->next;
+		memset(block, 0, sizeof(StatsBlock));
+		block->next = next;
+	}
+	memset(&retired, 0, sizeof(StatsBlock));
+	mutex_unlock(&stats_lock);
+}
+
+void stats_print(bool json)
+{
+	StatsBlock* snapshot = malloc(sizeof(StatsBlock));
+	if (!snapshot)
+	{
+		perror("malloc error");
+		exit(EXIT_FAILURE);
+	}
+	stats_snapshot(snapshot);
+
+	if (json)
+	{
+		printf("{\"counters\": {");
+		for (uint32_t i = 0; i < STAT_COUNTER_COUNT; ++i)
+			printf("%s\"%s\": %" PRIu64, i ? ", " : "", counter_names[i], snapshot->counters[i]);
+		printf("}, \"latency_ns\": {");
+		for (uint32_t i = 0; i < STAT_HISTOGRAM_COUNT; ++i)
+		{
+			const Histogram* histogram = &snapshot->histograms[i];
+			printf("%s\"%s\": {\"count\": %" PRIu64 ", \"total\": %" PRIu64 ", \"p50\": %" PRIu64
+				", \"p90\": %" PRIu64 ", \"p99\": %" PRIu64 ", \"max\": %" PRIu64 "}",
+				i ? ", " : "", histogram_names[i], histogram->count, histogram->total,
+				histogram_percentile(histogram, 50), histogram_percentile(histogram, 90),
+				histogram_percentile(histogram, 99), histogram->max);
+		}
+		printf("}}\n");
+	}
+	else
+	{
+		for (uint32_t i = 0; i < STAT_COUNTER_COUNT; ++i)
+			printf("%s: %" PRIu64 "\n", counter_names[i], snapshot->counters[i]);
+		for (uint32_t i = 0; i < STAT_HISTOGRAM_COUNT; ++i)
+		{
+			const Histogram* histogram = &snapshot->histograms[i];
+			if (histogram->count == 0)
+				continue;
+			printf("%s: count %" PRIu64 ", p50 %" PRIu64 "ns, p90 %" PRIu64 "ns, p99 %" PRIu64 "ns, max %" PRIu64 "ns\n",
+				histogram_names[i], histogram->count, histogram_percentile(histogram, 50),
+				histogram_percentile(histogram, 90), histogram_percentile(histogram, 99), histogram->max);
+		}
+	}
+
+	free(snapshot);
+}
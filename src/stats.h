@@ -0,0 +1,109 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "thread.h"
+
+// Engine counters and latency histograms. Each thread updates its own block
+// without locking; readers sum the blocks of live threads plus the totals that
+// exited threads folded in. Reads of another thread's block are not
+// synchronized, so a snapshot taken while a query runs is approximate.
+
+typedef enum
+{
+	STAT_PAGE_HITS,
+	STAT_PAGE_MISSES,
+	STAT_PAGES_READ,
+	STAT_PAGES_WRITTEN,
+	STAT_PAGER_FLUSHES,
+	STAT_LEAF_SPLITS,
+	STAT_INTERNAL_SPLITS,
+	STAT_CURSORS,
+	STAT_ROWS_EXAMINED,
+	STAT_ROWS_RETURNED,
+	STAT_KEY_FILTER_SKIPS,
+	STAT_HASH_INDEX_HITS,
+	STAT_APPEND_HITS,
+	STAT_SORT_RUNS,
+	STAT_JOIN_PARTITIONS,
+	STAT_MEMTABLE_MERGES,
+	STAT_COUNTER_COUNT
+} StatCounter;
+
+typedef enum
+{
+	STAT_TIME_SELECT,
+	STAT_TIME_INSERT,
+	STAT_TIME_UPDATE,
+	STAT_TIME_DELETE,
+	STAT_TIME_CREATE_TABLE,
+	STAT_TIME_DROP_TABLE,
+	STAT_TIME_VACUUM,
+	STAT_TIME_PAGE_READ,
+	STAT_TIME_PREPARE,
+	STAT_HISTOGRAM_COUNT
+} StatHistogram;
+
+// Log-linear buckets in the style of HDR histograms: values below 16 get a
+// bucket each, every power of two above that is split into 16 linear buckets,
+// so any recorded value is within 1/16 of its bucket's lower bound.
+#define HISTOGRAM_SUB_BUCKET_BITS 4
+#define HISTOGRAM_SUB_BUCKETS (1u << HISTOGRAM_SUB_BUCKET_BITS)
+#define HISTOGRAM_BUCKETS (HISTOGRAM_SUB_BUCKETS + (64 - HISTOGRAM_SUB_BUCKET_BITS) * HISTOGRAM_SUB_BUCKETS)
+
+typedef struct
+{
+	uint64_t count;
+	uint64_t total;
+	uint64_t max;
+	uint64_t buckets[HISTOGRAM_BUCKETS];
+} Histogram;
+
+typedef struct StatsBlock
+{
+	uint64_t counters[STAT_COUNTER_COUNT];
+	Histogram histograms[STAT_HISTOGRAM_COUNT];
+	struct StatsBlock* next;
+} StatsBlock;
+
+extern THREAD_LOCAL StatsBlock* stats_thread_block;
+
+StatsBlock* stats_register_thread(void);
+// Folds the calling thread's block into the retired totals
+void stats_thread_exit(void);
+
+static inline StatsBlock* stats_block(void)
+{
+	StatsBlock* block = stats_thread_block;
+	return block ? block : stats_register_thread();
+}
+
+static inline void stats_increment(StatCounter counter)
+{
+	stats_block()->counters[counter]++;
+}
+
+static inline void stats_add(StatCounter counter, uint64_t amount)
+{
+	stats_block()->counters[counter] += amount;
+}
+
+uint64_t stats_now_ns(void);
+void histogram_record(Histogram* histogram, uint64_t value);
+uint64_t histogram_percentile(const Histogram* histogram, double percentile);
+
+static inline void stats_record_time(StatHistogram histogram, uint64_t start_ns)
+{
+	histogram_record(&stats_block()->histograms[histogram], stats_now_ns() - start_ns);
+}
+
+// Sums all threads into snapshot (next is left NULL)
+void stats_snapshot(StatsBlock* snapshot);
+// Counters only, which is cheap enough to take around a single statement
+void stats_snapshot_counters(uint64_t counters[STAT_COUNTER_COUNT]);
+void stats_reset(void);
+void stats_print(bool json);
+
+#endif // STATS_H
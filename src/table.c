@@ -1,9 +1,143 @@
+#if !defined(_WIN32)
+#define _FILE_OFFSET_BITS 64
+#define _POSIX_C_SOURCE 200809L
+#endif
+
 #include "table.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <stdarg.h>
 #include <string.h>
+#include <inttypes.h>
+#include <time.h>
+
+#include "catalog.h"
+#include "checksum.h"
+#include "compress.h"
+#include "migrate.h"
+#include "search.h"
+#include "stats.h"
+#include "thread.h"
+
+#ifdef _WIN32
+#include <io.h>
+#define file_seek _fseeki64
+#define file_tell _ftelli64
+#define file_truncate(file_ptr, length) _chsize_s(_fileno(file_ptr), (int64_t)(length))
+#else
+#include <unistd.h>
+#define file_seek fseeko
+#define file_tell ftello
+#define file_truncate(file_ptr, length) ftruncate(fileno(file_ptr), (off_t)(length))
+#endif
+
+
+// PAX columns are stored in row order, so a column's row offset is also
+// the per-cell size of the columns stored ahead of it.
+typedef struct
+{
+	uint32_t row_offset;
+	uint32_t size;
+} ColumnLayout;
+
+static const ColumnLayout column_layouts[] = {
+	[COLUMN_ID] = {ID_OFFSET, ID_SIZE},
+	[COLUMN_USERNAME] = {USERNAME_OFFSET, USERNAME_SIZE},
+	[COLUMN_EMAIL] = {EMAIL_OFFSET, EMAIL_SIZE},
+};
+
+static void* row_column(Row* row, Column column);
+
+typedef struct
+{
+	uint64_t page_num;
+	uint64_t parent_page_num;
+	bool has_lower_bound;
+	uint64_t lower_bound;
+	bool has_upper_bound;
+	uint64_t upper_bound;
+	// Which child of its parent this is, and how many rows the parent counts for it
+	uint32_t child_index;
+	uint64_t row_count;
+} CheckSubtree;
+
+typedef struct
+{
+	CheckSubtree* subtrees;
+	uint64_t count;
+	uint64_t capacity;
+} SubtreeList;
+
+typedef struct
+{
+	uint32_t problems;
+	uint32_t corrupt_pages;
+	uint64_t first_leaf;
+	uint64_t previous_leaf;
+	uint64_t previous_next_leaf; // the next leaf previous_leaf links to
+	bool seen_leaf;
+	uint64_t* visited; // one bit per page
+	// Held around file reads, which share the pager's file position
+	Mutex* file_lock;
+	// Set while the top levels are checked; children go here instead of being descended into
+	SubtreeList* children;
+	// Workers keep their reports for the calling thread to print in key order
+	bool buffered;
+	char* output;
+	size_t output_length;
+	size_t output_capacity;
+} TreeCheck;
+
+typedef struct
+{
+	Table tree;
+	CheckSubtree* subtrees;
+	uint64_t num_subtrees;
+	TreeCheck check;
+} CheckWorker;
+
+static void pager_reserve(Pager* pager, uint64_t num_pages);
+static uint32_t* stored_page_checksum(void* page);
+static uint64_t page_fingerprint(Pager* pager, void* page);
+static uint64_t new_id(Pager* pager);
+static bool read_page(Pager* pager, uint64_t page_num, void* page);
+static void write_compressed_page(Pager* pager, uint64_t page_num);
+static uint64_t read_file_header(Pager* pager);
+static void write_file_header(Pager* pager);
+static void read_page_map(Pager* pager);
+static void write_page_map(Pager* pager);
+static void read_change_map(Pager* pager);
+static void write_change_map(Pager* pager);
+static void read_key_filter(Pager* pager, uint64_t length);
+static void write_key_filter(Pager* pager);
+static Cursor* new_cursor(Table* table, uint64_t page_num, uint32_t cell_num);
+static Cursor* find_append_position(Table* table, uint64_t key);
+static Cursor* find_after_previous(Table* table, uint64_t page_num, uint64_t key);
+static void hash_index_move_cells(Table* table, uint64_t page_num);
+static bool is_rightmost_node(Pager* pager, uint64_t page_num);
+static uint64_t previous_leaf(Pager* pager, uint64_t page_num);
+static uint32_t internal_node_child_index(void* parent, uint64_t child_page_num, uint64_t key);
+static uint64_t node_row_count(void* node);
+static void add_row_counts(Pager* pager, uint64_t page_num, uint64_t key, int64_t delta);
+static void refresh_row_count(Pager* pager, void* parent, uint64_t child_page_num);
+static bool row_is_blank(Row* row);
+
+static void report_problem(TreeCheck* check, uint64_t page_num, const char* format, ...);
+static void check_tree(Pager* pager, TreeCheck* check, uint64_t root_page_num, uint32_t num_threads);
+static void check_subtrees(void* worker_ptr);
+static void merge_check(Pager* pager, TreeCheck* check, TreeCheck* part);
+static void check_free_pages(Pager* pager, TreeCheck* check);
+static void check_node(Table* table, TreeCheck* check, const CheckSubtree* subtree);
+static bool visit_subtree(Pager* pager, TreeCheck* check, const CheckSubtree* subtree);
+static void check_node_page(Table* table, TreeCheck* check, const CheckSubtree* subtree, void* node);
+static void check_row_count(TreeCheck* check, const CheckSubtree* subtree, void* node);
+static void* check_read_page(Pager* pager, TreeCheck* check, uint64_t page_num);
+static void check_release_page(Pager* pager, uint64_t page_num, void* page);
+static uint64_t* new_visited_pages(Pager* pager);
+static bool visit_page(uint64_t* visited, uint64_t page_num);
+static void subtree_list_push(SubtreeList* list, CheckSubtree subtree);
 
 
 void serialize_row(Row* source, void* destination)
@@ -21,7 +155,7 @@ void deserialize_row(void* source, Row* destination)
 }
 
 
-Pager* pager_open(const char* filename)
+Pager* pager_open(const char* filename, bool compress_pages, uint32_t page_size)
 {
 	FILE* file_ptr = fopen(filename, "r+b");
 	if (!file_ptr)
@@ -34,9 +168,17 @@ Pager* pager_open(const char* filename)
 		}
 	}
 
-	fseek(file_ptr, 0, SEEK_END);
-	long file_length = ftell(file_ptr);
-	rewind(file_ptr);
+	if (file_seek(file_ptr, 0, SEEK_END) != 0)
+	{
+		perror("fseek error");
+		exit(EXIT_FAILURE);
+	}
+	int64_t file_length = file_tell(file_ptr);
+	if (file_length < 0)
+	{
+		perror("ftell error");
+		exit(EXIT_FAILURE);
+	}
 
 	Pager* pager = malloc(sizeof(Pager));
 	if (!pager)
@@ -46,62 +188,144 @@ Pager* pager_open(const char* filename)
 	}
 
 	pager->file_ptr = file_ptr;
+	pager->page_size = page_size;
 	pager->file_length = file_length;
-	pager->num_pages = (file_length / PAGE_SIZE);
-	if (file_length % PAGE_SIZE != 0)
+	pager->num_pages = 0;
+	pager->pages_capacity = 0;
+	pager->pages = NULL;
+	pager->compressed = false;
+	pager->map_offset = 0;
+	pager->map_capacity = 0;
+	pager->extents = NULL;
+	pager->free_page_head = 0;
+	pager->catalog_root_page = 0;
+	pager->file_id = 0;
+	pager->session_id = 0;
+	pager->opened_session_id = 0;
+	pager->opened_change_counter = 0;
+	pager->change_counter = 0;
+	pager->page_changes = NULL;
+	pager->page_fingerprints = NULL;
+	pager->fingerprint_seed = new_id(pager);
+	pager->change_map_offset = 0;
+	pager->change_map_capacity = 0;
+	pager->key_filter_offset = 0;
+	pager->key_filter_capacity = 0;
+	bloom_init(&pager->key_filter, 0);
+	hash_index_init(&pager->hash_index, HASH_INDEX_DEFAULT_ENTRIES);
+	pager->append_root_page_num = 0;
+	pager->append_page_num = 0;
+	pager->append_max_key = 0;
+	memtable_init(&pager->memtable, 0, ROW_SIZE);
+	pager->page_error = NULL;
+	pager->corrupt_page_num = 0;
+
+	uint64_t key_filter_length = 0;
+	if (file_length == 0)
 	{
-		fprintf(stderr, "Error: DB file is not a whole number of pages. Corrupt file.\n");
-		exit(EXIT_FAILURE);
+		// page 0 is the file header, which is only written on close
+		pager->compressed = compress_pages;
+		pager->num_pages = 1;
+		if (compress_pages)
+			pager->file_length = page_size;
+	}
+	else
+	{
+		key_filter_length = read_file_header(pager);
 	}
 
-	for (uint32_t i = 0; i < TABLE_MAX_PAGES; ++i)
-		pager->pages[i] = NULL;
+	pager_reserve(pager, pager->num_pages);
+	if (pager->compressed && file_length > 0)
+		read_page_map(pager);
+	if (file_length > 0)
+		read_key_filter(pager, key_filter_length);
+	if (pager->change_map_offset != 0)
+		read_change_map(pager);
+
+	// files from before change tracking get an id the first time they are opened
+	if (pager->file_id == 0)
+		pager->file_id = new_id(pager);
 
 	return pager;
 }
 
-void* get_page(Pager* pager, uint32_t page_num)
+static void pager_reserve(Pager* pager, uint64_t num_pages)
+{
+	if (num_pages <= pager->pages_capacity)
+		return;
+
+	uint64_t capacity = pager->pages_capacity ? pager->pages_capacity : 16;
+	while (capacity < num_pages)
+		capacity *= 2;
+
+	void** pages = realloc(pager->pages, capacity * sizeof(void*));
+	PageExtent* extents = realloc(pager->extents, capacity * sizeof(PageExtent));
+	uint64_t* page_changes = realloc(pager->page_changes, capacity * sizeof(uint64_t));
+	uint64_t* page_fingerprints = realloc(pager->page_fingerprints, capacity * sizeof(uint64_t));
+	if (!pages || !extents || !page_changes || !page_fingerprints)
+	{
+		perror("realloc error");
+		exit(EXIT_FAILURE);
+	}
+
+	uint64_t added = capacity - pager->pages_capacity;
+	memset(pages + pager->pages_capacity, 0, added * sizeof(void*));
+	memset(extents + pager->pages_capacity, 0, added * sizeof(PageExtent));
+	memset(page_changes + pager->pages_capacity, 0, added * sizeof(uint64_t));
+
+	pager->pages = pages;
+	pager->extents = extents;
+	pager->page_changes = page_changes;
+	pager->page_fingerprints = page_fingerprints;
+	pager->pages_capacity = capacity;
+}
+
+void* get_page(Pager* pager, uint64_t page_num)
 {
-	if (page_num > TABLE_MAX_PAGES)
+	if (page_num == FILE_HEADER_PAGE_NUM || page_num == INVALID_PAGE_NUM)
 	{
-		fprintf(stderr, "Error: Tried to fetch page number out of bounds: %d\n", TABLE_MAX_PAGES);
+		fprintf(stderr, "Error: Tried to fetch invalid page number %" PRIu64 "\n", page_num);
 		exit(EXIT_FAILURE);
 	}
 
+	pager_reserve(pager, page_num + 1);
+
 	if (!pager->pages[page_num])
 	{
-		void* page = malloc(PAGE_SIZE);
-		uint32_t num_pages = pager->file_length / PAGE_SIZE;
-		
-		if (pager->file_length % PAGE_SIZE)
-			num_pages++;
+		stats_increment(STAT_PAGE_MISSES);
+		void* page = calloc(1, pager->page_size);
+		if (!page)
+		{
+			perror("calloc error");
+			exit(EXIT_FAILURE);
+		}
 
-		if (page_num <= num_pages)
+		bool stored = read_page(pager, page_num, page);
+		if (stored && page_checksum(page, pager->page_size) != *stored_page_checksum(page))
 		{
-            if (fseek(pager->file_ptr, page_num * PAGE_SIZE, SEEK_SET) != 0)
-            {
-				perror("fseek error");
-				exit(EXIT_FAILURE);
-            }
-
-            size_t bytes_read = fread(page, 1, PAGE_SIZE, pager->file_ptr);
-            if (bytes_read < PAGE_SIZE && ferror(pager->file_ptr))
-            {
-				perror("fread error");
-				exit(EXIT_FAILURE);
-            }
+			// the page is not cached, so every later use of it fails the same way
+			free(page);
+			pager->corrupt_page_num = page_num;
+			if (pager->page_error)
+				longjmp(*pager->page_error, 1);
+			fprintf(stderr, "Error: Checksum mismatch on page %" PRIu64 ". Corrupt file.\n", page_num);
+			exit(EXIT_FAILURE);
 		}
 
 		pager->pages[page_num] = page;
+		// a page the file does not have yet counts as changed the first time changes are recorded
+		pager->page_fingerprints[page_num] = page_fingerprint(pager, page) + !stored;
 
 		if (page_num >= pager->num_pages)
 			pager->num_pages = page_num + 1;
 	}
+	else
+		stats_increment(STAT_PAGE_HITS);
 
 	return pager->pages[page_num];
 }
 
-void pager_flush(Pager* pager, uint32_t page_num)
+void pager_flush(Pager* pager, uint64_t page_num)
 {
     if (!pager->pages[page_num])
     {
@@ -109,107 +333,1280 @@ void pager_flush(Pager* pager, uint32_t page_num)
 		exit(EXIT_FAILURE);
     }
 
-    if (fseek(pager->file_ptr, page_num * PAGE_SIZE, SEEK_SET) != 0)
+	*stored_page_checksum(pager->pages[page_num]) = page_checksum(pager->pages[page_num], pager->page_size);
+	stats_increment(STAT_PAGER_FLUSHES);
+	stats_increment(STAT_PAGES_WRITTEN);
+
+	if (pager->compressed)
+	{
+		write_compressed_page(pager, page_num);
+		return;
+	}
+
+    if (file_seek(pager->file_ptr, (int64_t)page_num * pager->page_size, SEEK_SET) != 0)
     {
 		perror("fseek error");
 		exit(EXIT_FAILURE);
     }
 
-    size_t bytes_written = fwrite(pager->pages[page_num], 1, PAGE_SIZE, pager->file_ptr);
-    if (bytes_written < PAGE_SIZE)
+    size_t bytes_written = fwrite(pager->pages[page_num], 1, pager->page_size, pager->file_ptr);
+    if (bytes_written < pager->page_size)
     {
 		perror("fwrite error");
 		exit(EXIT_FAILURE);
     }
 }
 
-uint32_t get_unused_page_num(Pager* pager)
+uint64_t get_unused_page_num(Pager* pager)
+{
+	if (pager->free_page_head != 0)
+	{
+		uint64_t page_num = pager->free_page_head;
+		pager->free_page_head = *free_page_next(get_page(pager, page_num));
+		return page_num;
+	}
+	return pager->num_pages;
+}
+
+void pager_free_page(Pager* pager, uint64_t page_num)
+{
+	void* page = get_page(pager, page_num);
+	memset(page, 0, pager->page_size);
+	set_node_type(page, NODE_FREE);
+	*free_page_next(page) = pager->free_page_head;
+	pager->free_page_head = page_num;
+	hash_index_clear(&pager->hash_index);
+	pager->append_page_num = 0;
+}
+
+// Entries come in key order, so each one usually belongs in the leaf the one before it went into
+void pager_merge_memtable(Pager* pager)
+{
+	Memtable* memtable = &pager->memtable;
+	if (memtable->num_entries == 0)
+		return;
+	stats_increment(STAT_MEMTABLE_MERGES);
+
+	Table table = {pager, 0};
+	uint64_t page_num = 0; // leaf of the previous entry in the same tree
+	Row row;
+	for (MemtableEntry* entry = memtable_first(memtable); entry; entry = entry->next[0])
+	{
+		if (entry->root_page_num != table.root_page_num)
+		{
+			table.root_page_num = entry->root_page_num;
+			page_num = 0;
+		}
+
+		Cursor* cursor = page_num ? find_after_previous(&table, page_num, entry->key) : NULL;
+		if (!cursor)
+			cursor = table_find(&table, entry->key);
+
+		deserialize_row(memtable_entry_value(entry), &row);
+		void* node = get_page(pager, cursor->page_num);
+		if (cursor->cell_num < *leaf_node_num_cells(node) && *leaf_node_key(node, cursor->cell_num) == entry->key)
+		{
+			// the tree had the key before it was buffered, deleted or not
+			if (entry->replace)
+				cursor_write_row(cursor, &row);
+		}
+		else
+			leaf_node_insert(cursor, entry->key, &row);
+
+		page_num = cursor->page_num;
+		free(cursor);
+	}
+	memtable_clear(memtable);
+}
+
+void pager_load_all(Pager* pager)
+{
+	for (uint64_t i = FILE_HEADER_PAGE_NUM + 1; i < pager->num_pages; ++i)
+		get_page(pager, i);
+}
+
+// Pages are only written on close, so a page can only have changed while it is cached. Its
+// fingerprint, unlike its CRC, is seeded per open, so no edit can be chosen to leave it alone.
+uint64_t pager_record_changes(Pager* pager)
+{
+	bool changed = false;
+	for (uint64_t i = FILE_HEADER_PAGE_NUM + 1; i < pager->num_pages; ++i)
+	{
+		void* page = pager->pages[i];
+		if (!page)
+			continue;
+
+		uint64_t fingerprint = page_fingerprint(pager, page);
+		if (fingerprint == pager->page_fingerprints[i])
+			continue;
+
+		if (!changed)
+		{
+			pager->change_counter++;
+			changed = true;
+		}
+		if (pager->session_id == pager->opened_session_id)
+			pager->session_id = new_id(pager);
+		*stored_page_checksum(page) = page_checksum(page, pager->page_size);
+		pager->page_fingerprints[i] = fingerprint;
+		pager->page_changes[i] = pager->change_counter;
+	}
+	return pager->change_counter;
+}
+
+void pager_copy_page(Pager* pager, uint64_t page_num, void* page)
+{
+	if (pager->pages[page_num])
+		memcpy(page, pager->pages[page_num], pager->page_size);
+	else if (!read_page(pager, page_num, page))
+		memset(page, 0, pager->page_size);
+	*stored_page_checksum(page) = page_checksum(page, pager->page_size);
+}
+
+static bool read_page(Pager* pager, uint64_t page_num, void* page)
+{
+	uint64_t start = stats_now_ns();
+	if (pager->compressed)
+	{
+		PageExtent* extent = &pager->extents[page_num];
+		if (extent->length == 0)
+			return false;
+
+		uint8_t buffer[COMPRESSED_PAGE_MAX_SIZE(MAX_PAGE_SIZE)];
+		if (extent->length > sizeof(buffer) || file_seek(pager->file_ptr, (int64_t)extent->offset, SEEK_SET) != 0
+			|| fread(buffer, 1, extent->length, pager->file_ptr) < extent->length)
+		{
+			fprintf(stderr, "Error: Could not read extent of page %" PRIu64 ". Corrupt file.\n", page_num);
+			exit(EXIT_FAILURE);
+		}
+
+		if (!page_decompress(buffer, extent->length, page, pager->page_size))
+		{
+			fprintf(stderr, "Error: Could not decompress page %" PRIu64 ". Corrupt file.\n", page_num);
+			exit(EXIT_FAILURE);
+		}
+		stats_increment(STAT_PAGES_READ);
+		stats_record_time(STAT_TIME_PAGE_READ, start);
+		return true;
+	}
+
+	if (page_num >= pager->file_length / pager->page_size)
+		return false;
+
+	if (file_seek(pager->file_ptr, (int64_t)page_num * pager->page_size, SEEK_SET) != 0)
+	{
+		perror("fseek error");
+		exit(EXIT_FAILURE);
+	}
+
+	if (fread(page, 1, pager->page_size, pager->file_ptr) < pager->page_size)
+	{
+		perror("fread error");
+		exit(EXIT_FAILURE);
+	}
+	stats_increment(STAT_PAGES_READ);
+	stats_record_time(STAT_TIME_PAGE_READ, start);
+	return true;
+}
+
+static void write_compressed_page(Pager* pager, uint64_t page_num)
+{
+	uint8_t buffer[COMPRESSED_PAGE_MAX_SIZE(MAX_PAGE_SIZE)];
+	uint32_t length = (uint32_t)page_compress(pager->pages[page_num], pager->page_size, buffer);
+
+	// pages that no longer fit their extent move to the end of the file
+	PageExtent* extent = &pager->extents[page_num];
+	if (length > extent->capacity)
+	{
+		extent->offset = pager->file_length;
+		extent->capacity = length;
+		pager->file_length += length;
+	}
+	extent->length = length;
+
+	if (file_seek(pager->file_ptr, (int64_t)extent->offset, SEEK_SET) != 0)
+	{
+		perror("fseek error");
+		exit(EXIT_FAILURE);
+	}
+
+	if (fwrite(buffer, 1, length, pager->file_ptr) < length)
+	{
+		perror("fwrite error");
+		exit(EXIT_FAILURE);
+	}
+}
+
+static uint64_t read_file_header(Pager* pager)
+{
+	FileHeader header;
+
+	if (pager->file_length < MIN_PAGE_SIZE || file_seek(pager->file_ptr, PAGE_HEADER_SIZE, SEEK_SET) != 0
+		|| fread(&header, sizeof(header), 1, pager->file_ptr) != 1)
+	{
+		fprintf(stderr, "Error: Could not read DB file header. Corrupt file.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	if (header.magic != FILE_MAGIC)
+	{
+		fprintf(stderr, "Error: Not a DB file.\n");
+		exit(EXIT_FAILURE);
+	}
+	if (header.format_version != FILE_FORMAT_VERSION)
+	{
+		fprintf(stderr, "Error: Unsupported DB file format version %" PRIu32 ".\n", header.format_version);
+		exit(EXIT_FAILURE);
+	}
+	if (!is_valid_page_size(header.page_size) || pager->file_length < header.page_size)
+	{
+		fprintf(stderr, "Error: Invalid page size %" PRIu32 " in DB file header. Corrupt file.\n", header.page_size);
+		exit(EXIT_FAILURE);
+	}
+
+	pager->page_size = header.page_size;
+	uint8_t* page = malloc(pager->page_size);
+	if (!page)
+	{
+		perror("malloc error");
+		exit(EXIT_FAILURE);
+	}
+
+	rewind(pager->file_ptr);
+	if (fread(page, 1, pager->page_size, pager->file_ptr) < pager->page_size)
+	{
+		perror("fread error");
+		exit(EXIT_FAILURE);
+	}
+	if (page_checksum(page, pager->page_size) != *stored_page_checksum(page))
+	{
+		fprintf(stderr, "Error: Checksum mismatch on the file header. Corrupt file.\n");
+		exit(EXIT_FAILURE);
+	}
+	free(page);
+
+	pager->compressed = (header.flags & FILE_FLAG_COMPRESSED) != 0;
+	pager->num_pages = header.num_pages;
+	pager->map_offset = header.map_offset;
+	pager->map_capacity = header.map_capacity;
+	pager->free_page_head = header.free_page_head;
+	pager->catalog_root_page = header.catalog_root_page;
+	pager->file_id = header.file_id;
+	pager->session_id = header.session_id;
+	pager->opened_session_id = header.session_id;
+	pager->opened_change_counter = header.change_counter;
+	pager->change_counter = header.change_counter;
+	pager->change_map_offset = header.change_map_offset;
+	pager->change_map_capacity = header.change_map_capacity;
+	pager->key_filter_offset = header.key_filter_offset;
+	pager->key_filter_capacity = header.key_filter_capacity;
+
+	if (pager->num_pages == 0 || (!pager->compressed && pager->num_pages > pager->file_length / pager->page_size))
+	{
+		fprintf(stderr, "Error: DB file is shorter than its header says. Corrupt file.\n");
+		exit(EXIT_FAILURE);
+	}
+	return header.key_filter_length;
+}
+
+static void write_file_header(Pager* pager)
+{
+	FileHeader header;
+	pager_file_header(pager, &header);
+	write_header_page(pager->file_ptr, &header, pager->page_size);
+}
+
+void pager_replace_pages(Pager* pager, void** pages, uint64_t num_pages)
+{
+	for (uint64_t i = 0; i < pager->num_pages; ++i)
+	{
+		free(pager->pages[i]);
+		pager->pages[i] = NULL;
+	}
+
+	pager_reserve(pager, num_pages);
+	for (uint64_t i = FILE_HEADER_PAGE_NUM + 1; i < num_pages; ++i)
+	{
+		pager->pages[i] = pages[i];
+		pager->page_fingerprints[i] = page_fingerprint(pager, pages[i]) + 1;
+	}
+	memset(pager->page_changes + num_pages, 0, (pager->pages_capacity - num_pages) * sizeof(uint64_t));
+	pager->num_pages = num_pages;
+	pager->free_page_head = 0;
+	hash_index_clear(&pager->hash_index);
+	pager->append_page_num = 0;
+
+	// every page is cached now, so the old file contents are never read again
+	if (pager->compressed)
+	{
+		memset(pager->extents, 0, pager->pages_capacity * sizeof(PageExtent));
+		pager->file_length = pager->page_size;
+		pager->map_offset = 0;
+		pager->map_capacity = 0;
+		pager->change_map_offset = 0;
+		pager->change_map_capacity = 0;
+		pager->key_filter_offset = 0;
+		pager->key_filter_capacity = 0;
+	}
+	else if (pager->file_length > num_pages * pager->page_size)
+		pager->file_length = num_pages * pager->page_size;
+}
+
+void pager_file_header(Pager* pager, FileHeader* header)
+{
+	*header = (FileHeader){
+		.magic = FILE_MAGIC,
+		.format_version = FILE_FORMAT_VERSION,
+		.flags = pager->compressed ? FILE_FLAG_COMPRESSED : 0,
+		.page_size = pager->page_size,
+		.num_pages = pager->num_pages,
+		.map_offset = pager->map_offset,
+		.map_capacity = pager->map_capacity,
+		.free_page_head = pager->free_page_head,
+		.catalog_root_page = pager->catalog_root_page,
+		.file_id = pager->file_id,
+		.change_counter = pager->change_counter,
+		.change_map_offset = pager->change_map_offset,
+		.change_map_capacity = pager->change_map_capacity,
+		.key_filter_offset = pager->key_filter_offset,
+		.key_filter_length = bloom_serialized_size(&pager->key_filter),
+		.key_filter_capacity = pager->key_filter_capacity,
+		.session_id = pager->session_id,
+	};
+}
+
+void write_header_page(FILE* file_ptr, const FileHeader* header, uint32_t page_size)
+{
+	uint8_t* page = calloc(1, page_size);
+	if (!page)
+	{
+		perror("calloc error");
+		exit(EXIT_FAILURE);
+	}
+
+	memcpy(page + PAGE_HEADER_SIZE, header, sizeof(*header));
+	*stored_page_checksum(page) = page_checksum(page, page_size);
+
+	if (file_seek(file_ptr, 0, SEEK_SET) != 0 || fwrite(page, 1, page_size, file_ptr) < page_size)
+	{
+		perror("file header write error");
+		exit(EXIT_FAILURE);
+	}
+	free(page);
+}
+
+static void read_page_map(Pager* pager)
+{
+	uint64_t map_length = pager->num_pages * sizeof(PageExtent);
+	if (pager->num_pages > pager->file_length / sizeof(PageExtent) || map_length > pager->map_capacity
+		|| pager->map_offset + map_length > pager->file_length)
+	{
+		fprintf(stderr, "Error: Invalid page map in compressed DB file. Corrupt file.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	if (file_seek(pager->file_ptr, (int64_t)pager->map_offset, SEEK_SET) != 0
+		|| fread(pager->extents, sizeof(PageExtent), pager->num_pages, pager->file_ptr) < pager->num_pages)
+	{
+		perror("page map read error");
+		exit(EXIT_FAILURE);
+	}
+}
+
+static void write_page_map(Pager* pager)
+{
+	uint64_t map_length = pager->num_pages * sizeof(PageExtent);
+	if (map_length > pager->map_capacity)
+	{
+		pager->map_offset = pager->file_length;
+		pager->map_capacity = map_length;
+		pager->file_length += map_length;
+	}
+
+	if (file_seek(pager->file_ptr, (int64_t)pager->map_offset, SEEK_SET) != 0
+		|| fwrite(pager->extents, sizeof(PageExtent), pager->num_pages, pager->file_ptr) < pager->num_pages)
+	{
+		perror("page map write error");
+		exit(EXIT_FAILURE);
+	}
+}
+
+static void read_change_map(Pager* pager)
+{
+	uint64_t map_length = pager->num_pages * sizeof(uint64_t);
+	uint64_t pages_end = pager->num_pages * pager->page_size;
+	if (map_length > pager->change_map_capacity || pager->change_map_offset + map_length > pager->file_length
+		|| (!pager->compressed && pager->change_map_offset < pages_end))
+	{
+		fprintf(stderr, "Error: Invalid change map in DB file. Corrupt file.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	if (file_seek(pager->file_ptr, (int64_t)pager->change_map_offset, SEEK_SET) != 0
+		|| fread(pager->page_changes, sizeof(uint64_t), pager->num_pages, pager->file_ptr) < pager->num_pages)
+	{
+		perror("change map read error");
+		exit(EXIT_FAILURE);
+	}
+
+	// the map trails the pages of an uncompressed file, and new pages must not be read from it
+	if (!pager->compressed)
+		pager->file_length = pages_end;
+}
+
+static void write_change_map(Pager* pager)
+{
+	uint64_t map_length = pager->num_pages * sizeof(uint64_t);
+	if (!pager->compressed)
+	{
+		pager->change_map_offset = pager->num_pages * pager->page_size;
+		pager->change_map_capacity = map_length;
+	}
+	else if (map_length > pager->change_map_capacity)
+	{
+		pager->change_map_offset = pager->file_length;
+		pager->change_map_capacity = map_length;
+		pager->file_length += map_length;
+	}
+
+	if (file_seek(pager->file_ptr, (int64_t)pager->change_map_offset, SEEK_SET) != 0
+		|| fwrite(pager->page_changes, sizeof(uint64_t), pager->num_pages, pager->file_ptr) < pager->num_pages)
+	{
+		perror("change map write error");
+		exit(EXIT_FAILURE);
+	}
+}
+
+// Files written before the filter existed, or whose filter cannot be read, keep
+// an invalid one that sends every lookup to the tree until a vacuum rebuilds it
+static void read_key_filter(Pager* pager, uint64_t length)
+{
+	if (length == 0 || length > pager->key_filter_capacity || pager->key_filter_offset + length > pager->file_length)
+	{
+		bloom_invalidate(&pager->key_filter);
+		return;
+	}
+
+	void* buffer = malloc(length);
+	if (!buffer)
+	{
+		perror("malloc error");
+		exit(EXIT_FAILURE);
+	}
+
+	if (file_seek(pager->file_ptr, (int64_t)pager->key_filter_offset, SEEK_SET) != 0
+		|| fread(buffer, 1, length, pager->file_ptr) < length)
+	{
+		perror("key filter read error");
+		exit(EXIT_FAILURE);
+	}
+	bloom_deserialize(&pager->key_filter, buffer, length);
+	free(buffer);
+}
+
+// An uncompressed file keeps the filter after its change map
+static void write_key_filter(Pager* pager)
+{
+	uint64_t length = bloom_serialized_size(&pager->key_filter);
+	if (!pager->compressed)
+	{
+		pager->key_filter_offset = pager->change_map_offset + pager->change_map_capacity;
+		pager->key_filter_capacity = length;
+	}
+	else if (length > pager->key_filter_capacity)
+	{
+		pager->key_filter_offset = pager->file_length;
+		pager->key_filter_capacity = length;
+		pager->file_length += length;
+	}
+	if (length == 0)
+		return;
+
+	void* buffer = malloc(length);
+	if (!buffer)
+	{
+		perror("malloc error");
+		exit(EXIT_FAILURE);
+	}
+
+	bloom_serialize(&pager->key_filter, buffer);
+	if (file_seek(pager->file_ptr, (int64_t)pager->key_filter_offset, SEEK_SET) != 0
+		|| fwrite(buffer, 1, length, pager->file_ptr) < length)
+	{
+		perror("key filter write error");
+		exit(EXIT_FAILURE);
+	}
+	free(buffer);
+}
+
+uint32_t page_checksum(void* page, uint32_t page_size)
+{
+	return crc32c((uint8_t*)page + PAGE_HEADER_SIZE, page_size - PAGE_HEADER_SIZE);
+}
+
+static uint32_t* stored_page_checksum(void* page)
+{
+	return (uint32_t*)((uint8_t*)page + PAGE_CHECKSUM_OFFSET);
+}
+
+static uint64_t page_fingerprint(Pager* pager, void* page)
+{
+	const uint8_t* data = (uint8_t*)page + PAGE_HEADER_SIZE;
+	uint32_t length = pager->page_size - PAGE_HEADER_SIZE;
+	uint64_t hash = pager->fingerprint_seed;
+	uint32_t offset = 0;
+	for (; offset + sizeof(uint64_t) <= length; offset += sizeof(uint64_t))
+	{
+		uint64_t word;
+		memcpy(&word, data + offset, sizeof(word));
+		hash = (hash ^ word) * 0x9E3779B97F4A7C15ULL;
+		hash ^= hash >> 32;
+	}
+	for (; offset < length; ++offset)
+		hash = (hash ^ data[offset]) * 0x9E3779B97F4A7C15ULL;
+	return hash ^ (hash >> 29);
+}
+
+static uint64_t new_id(Pager* pager)
+{
+	return (stats_now_ns() ^ (uint64_t)time(NULL) << 32 ^ (uint64_t)(uintptr_t)pager) | 1;
+}
+
+
+bool is_valid_page_size(uint32_t page_size)
+{
+	return page_size >= MIN_PAGE_SIZE && page_size <= MAX_PAGE_SIZE && (page_size & (page_size - 1)) == 0;
+}
+
+Table* db_open(const char* filename)
+{
+	DbOptions options = {0};
+	return db_open_with_options(filename, &options);
+}
+
+Table* db_open_with_options(const char* filename, DbOptions* options)
+{
+	uint32_t page_size = options->page_size ? options->page_size : DEFAULT_PAGE_SIZE;
+	if (!is_valid_page_size(page_size))
+	{
+		fprintf(stderr, "Error: Page size must be a power of two from %d to %d.\n", MIN_PAGE_SIZE, MAX_PAGE_SIZE);
+		exit(EXIT_FAILURE);
+	}
+
+	if (legacy_file_detect(filename))
+		legacy_file_migrate(filename, options);
+
+	Pager* pager = pager_open(filename, options->compress_pages, page_size);
+	Table* table = malloc(sizeof(Table));
+	if (!table)
+	{
+		perror("Malloc failed");
+		exit(EXIT_FAILURE);
+	}
+
+	table->pager = pager;
+	table->root_page_num = FILE_HEADER_PAGE_NUM + 1;
+
+	if (pager->num_pages == FILE_HEADER_PAGE_NUM + 1)
+	{
+		void* root_node = get_page(pager, table->root_page_num);
+		initialize_node(root_node, NODE_LEAF, pager->page_size);
+		set_node_root(root_node, true);
+		*leaf_node_layout(root_node) = options->leaf_layout;
+	}
+
+	return table;
+}
+
+void db_close(Table* table)
+{
+	Pager* pager = table->pager;
+	pager_merge_memtable(pager);
+	pager_record_changes(pager);
+
+	for (uint64_t i = 0; i < pager->num_pages; ++i)
+	{
+		if (pager->pages[i] == NULL)
+			continue;
+
+		pager_flush(pager, i);
+		free(pager->pages[i]);
+		pager->pages[i] = NULL;
+	}
+
+	if (pager->compressed)
+		write_page_map(pager);
+	write_change_map(pager);
+	write_key_filter(pager);
+	write_file_header(pager);
+
+	// drops whatever a vacuum left past the end
+	uint64_t file_length = pager->compressed ? pager->file_length : pager->key_filter_offset + pager->key_filter_capacity;
+	if (fflush(pager->file_ptr) != 0 || file_truncate(pager->file_ptr, file_length) != 0)
+	{
+		perror("truncate error");
+		exit(EXIT_FAILURE);
+	}
+
+	if (fclose(pager->file_ptr))
+	{
+		perror("fclose error");
+		exit(EXIT_FAILURE);
+	}
+
+	free(pager->pages);
+	free(pager->extents);
+	free(pager->page_changes);
+	free(pager->page_fingerprints);
+	bloom_free(&pager->key_filter);
+	hash_index_free(&pager->hash_index);
+	memtable_free(&pager->memtable);
+	free(pager);
+	free(table);
+}
+
+uint32_t table_check(Table* table)
+{
+	return table_parallel_check(table, cpu_count());
+}
+
+uint32_t table_parallel_check(Table* table, uint32_t num_threads)
+{
+	Pager* pager = table->pager;
+	if (num_threads == 0)
+		num_threads = 1;
+	if (num_threads > MAX_CHECK_THREADS)
+		num_threads = MAX_CHECK_THREADS;
+
+	// the catalog caches its pages, which are dropped again afterwards
+	uint64_t* cached = new_visited_pages(pager);
+	for (uint64_t i = FILE_HEADER_PAGE_NUM + 1; i < pager->num_pages; ++i)
+		if (pager->pages[i])
+			visit_page(cached, i);
+
+	Mutex file_lock;
+	mutex_init(&file_lock);
+	TreeCheck check = {0};
+	check.visited = new_visited_pages(pager);
+	check.file_lock = &file_lock;
+
+	check_tree(pager, &check, table->root_page_num, num_threads);
+
+	if (pager->catalog_root_page != 0)
+	{
+		check_tree(pager, &check, pager->catalog_root_page, num_threads);
+
+		// table roots are only trusted once the catalog itself is sound
+		if (check.problems == 0)
+		{
+			CatalogEntry* entries;
+			uint32_t num_tables = catalog_list_tables(table, &entries);
+			for (uint32_t i = 0; i < num_tables; ++i)
+				check_tree(pager, &check, entries[i].root_page_num, num_threads);
+			free(entries);
+		}
+	}
+
+	check_free_pages(pager, &check);
+
+	// whatever hangs below a corrupt page cannot be reached, so it is not reported again
+	if (check.corrupt_pages == 0)
+	{
+		for (uint64_t i = FILE_HEADER_PAGE_NUM + 1; i < pager->num_pages; ++i)
+			if (!visit_page(check.visited, i))
+				report_problem(&check, i, "page is neither in a tree nor free");
+	}
+
+	for (uint64_t i = FILE_HEADER_PAGE_NUM + 1; i < pager->num_pages; ++i)
+	{
+		if (pager->pages[i] && !visit_page(cached, i))
+		{
+			free(pager->pages[i]);
+			pager->pages[i] = NULL;
+		}
+	}
+
+	mutex_destroy(&file_lock);
+	free(cached);
+	free(check.visited);
+	return check.problems;
+}
+
+// The top levels are checked here until they fan out into enough subtrees, and
+// each worker checks a contiguous run of them. The runs are stitched back
+// together in key order: reports, visited pages and the leaf chain.
+static void check_tree(Pager* pager, TreeCheck* check, uint64_t root_page_num, uint32_t num_threads)
+{
+	Table tree = {pager, root_page_num};
+	check->seen_leaf = false;
+
+	SubtreeList level = {0};
+	subtree_list_push(&level, (CheckSubtree){root_page_num, root_page_num, false, 0, false, 0, 0, 0});
+	bool expanded = true;
+	while (expanded && level.count < (uint64_t)num_threads * CHECK_SUBTREES_PER_THREAD)
+	{
+		SubtreeList next = {0};
+		expanded = false;
+		check->children = &next;
+		for (uint64_t i = 0; i < level.count; ++i)
+		{
+			// leaves and broken pages are left for the workers to check and report
+			CheckSubtree* subtree = &level.subtrees[i];
+			void* node = NULL;
+			if (subtree->page_num != FILE_HEADER_PAGE_NUM && subtree->page_num < pager->num_pages)
+				node = check_read_page(pager, check, subtree->page_num);
+			if (node && get_node_type(node) == NODE_INTERNAL)
+			{
+				if (visit_subtree(pager, check, subtree))
+					check_node_page(&tree, check, subtree, node);
+				expanded = true;
+			}
+			else
+				subtree_list_push(&next, *subtree);
+			if (node)
+				check_release_page(pager, subtree->page_num, node);
+		}
+		check->children = NULL;
+		free(level.subtrees);
+		level = next;
+	}
+
+	uint32_t num_workers = level.count < num_threads ? (uint32_t)level.count : num_threads;
+	CheckWorker workers[MAX_CHECK_THREADS];
+	Thread threads[MAX_CHECK_THREADS];
+	for (uint32_t i = 0; i < num_workers; ++i)
+	{
+		uint64_t first = level.count * i / num_workers;
+		uint64_t last = level.count * (i + 1) / num_workers;
+		workers[i] = (CheckWorker){tree, level.subtrees + first, last - first, {0}};
+		workers[i].check.visited = new_visited_pages(pager);
+		workers[i].check.file_lock = check->file_lock;
+		workers[i].check.buffered = true;
+		// the calling thread takes the first run itself
+		if (i > 0)
+			thread_start(&threads[i], check_subtrees, &workers[i]);
+	}
+	if (num_workers > 0)
+		check_subtrees(&workers[0]);
+
+	for (uint32_t i = 0; i < num_workers; ++i)
+	{
+		if (i > 0)
+			thread_join(threads[i]);
+		merge_check(pager, check, &workers[i].check);
+	}
+	free(level.subtrees);
+
+	if (check->seen_leaf && check->previous_next_leaf != 0)
+		report_problem(check, check->previous_leaf, "rightmost leaf has a next leaf");
+}
+
+static void check_subtrees(void* worker_ptr)
+{
+	CheckWorker* worker = worker_ptr;
+	for (uint64_t i = 0; i < worker->num_subtrees; ++i)
+		check_node(&worker->tree, &worker->check, &worker->subtrees[i]);
+}
+
+// Folds a worker's run into the check after the runs before it
+static void merge_check(Pager* pager, TreeCheck* check, TreeCheck* part)
+{
+	// the link into the run comes before anything in it
+	if (part->seen_leaf)
+	{
+		if (check->seen_leaf && check->previous_next_leaf != part->first_leaf)
+			report_problem(check, check->previous_leaf, "next leaf is not %" PRIu64, part->first_leaf);
+		check->previous_leaf = part->previous_leaf;
+		check->previous_next_leaf = part->previous_next_leaf;
+		check->seen_leaf = true;
+	}
+
+	if (part->output_length > 0)
+		fwrite(part->output, 1, part->output_length, stdout);
+	check->problems += part->problems;
+	check->corrupt_pages += part->corrupt_pages;
+
+	// a page in two runs, or in a run and somewhere checked before, has more than one parent
+	for (uint64_t word = 0; word < (pager->num_pages + 63) / 64; ++word)
+	{
+		uint64_t repeated = check->visited[word] & part->visited[word];
+		for (uint32_t bit = 0; repeated != 0; ++bit, repeated >>= 1)
+			if (repeated & 1)
+				report_problem(check, word * 64 + bit, "page is reached more than once");
+		check->visited[word] |= part->visited[word];
+	}
+
+	free(part->visited);
+	free(part->output);
+}
+
+static void check_free_pages(Pager* pager, TreeCheck* check)
+{
+	uint64_t previous_page_num = FILE_HEADER_PAGE_NUM;
+	uint64_t page_num = pager->free_page_head;
+
+	while (page_num != 0)
+	{
+		if (page_num >= pager->num_pages || visit_page(check->visited, page_num))
+		{
+			report_problem(check, previous_page_num, "invalid or repeated free page %" PRIu64, page_num);
+			return;
+		}
+
+		void* page = check_read_page(pager, check, page_num);
+		if (!page)
+		{
+			report_problem(check, page_num, "checksum mismatch");
+			check->corrupt_pages++;
+			return;
+		}
+		if (get_node_type(page) != NODE_FREE)
+			report_problem(check, page_num, "free page has node type %d", get_node_type(page));
+
+		previous_page_num = page_num;
+		uint64_t next_page_num = *free_page_next(page);
+		check_release_page(pager, page_num, page);
+		page_num = next_page_num;
+	}
+}
+
+// Pages the cache does not hold are read from the file into a buffer of their own and verified
+// there, so the check leaves the cache as it found it; NULL when the checksum does not match
+static void* check_read_page(Pager* pager, TreeCheck* check, uint64_t page_num)
+{
+	if (pager->pages[page_num])
+		return pager->pages[page_num];
+
+	void* page = calloc(1, pager->page_size);
+	if (!page)
+	{
+		perror("calloc error");
+		exit(EXIT_FAILURE);
+	}
+
+	mutex_lock(check->file_lock);
+	bool stored = read_page(pager, page_num, page);
+	mutex_unlock(check->file_lock);
+	if (stored && page_checksum(page, pager->page_size) != *stored_page_checksum(page))
+	{
+		free(page);
+		return NULL;
+	}
+	return page;
+}
+
+static void check_release_page(Pager* pager, uint64_t page_num, void* page)
+{
+	if (page != pager->pages[page_num])
+		free(page);
+}
+
+static void report_problem(TreeCheck* check, uint64_t page_num, const char* format, ...)
+{
+	check->problems++;
+	va_list args;
+	va_start(args, format);
+	if (!check->buffered)
+	{
+		printf("- page %" PRIu64 ": ", page_num);
+		vprintf(format, args);
+		printf("\n");
+		va_end(args);
+		return;
+	}
+
+	char message[256];
+	int prefix_length = snprintf(message, sizeof(message), "- page %" PRIu64 ": ", page_num);
+	vsnprintf(message + prefix_length, sizeof(message) - prefix_length - 1, format, args);
+	va_end(args);
+	strcat(message, "\n");
+
+	size_t length = strlen(message);
+	if (check->output_length + length > check->output_capacity)
+	{
+		check->output_capacity = (check->output_length + length) * 2;
+		check->output = realloc(check->output, check->output_capacity);
+		if (!check->output)
+		{
+			perror("realloc error");
+			exit(EXIT_FAILURE);
+		}
+	}
+	memcpy(check->output + check->output_length, message, length);
+	check->output_length += length;
+}
+
+static uint64_t* new_visited_pages(Pager* pager)
+{
+	uint64_t* visited = calloc((pager->num_pages + 63) / 64, sizeof(uint64_t));
+	if (!visited)
+	{
+		perror("calloc error");
+		exit(EXIT_FAILURE);
+	}
+	return visited;
+}
+
+// Marks the page and returns whether it already was
+static bool visit_page(uint64_t* visited, uint64_t page_num)
+{
+	uint64_t bit = 1ull << (page_num % 64);
+	bool seen = (visited[page_num / 64] & bit) != 0;
+	visited[page_num / 64] |= bit;
+	return seen;
+}
+
+static void subtree_list_push(SubtreeList* list, CheckSubtree subtree)
+{
+	if (list->count == list->capacity)
+	{
+		list->capacity = list->capacity ? list->capacity * 2 : 64;
+		list->subtrees = realloc(list->subtrees, list->capacity * sizeof(CheckSubtree));
+		if (!list->subtrees)
+		{
+			perror("realloc error");
+			exit(EXIT_FAILURE);
+		}
+	}
+	list->subtrees[list->count++] = subtree;
+}
+
+static void check_node(Table* table, TreeCheck* check, const CheckSubtree* subtree)
+{
+	uint64_t page_num = subtree->page_num;
+	if (!visit_subtree(table->pager, check, subtree))
+		return;
+
+	void* node = check_read_page(table->pager, check, page_num);
+	if (!node)
+	{
+		report_problem(check, page_num, "checksum mismatch");
+		check->corrupt_pages++;
+		return;
+	}
+	check_node_page(table, check, subtree, node);
+	check_release_page(table->pager, page_num, node);
+}
+
+// Marks the subtree's page visited, or reports why it cannot be
+static bool visit_subtree(Pager* pager, TreeCheck* check, const CheckSubtree* subtree)
+{
+	uint64_t page_num = subtree->page_num;
+	if (page_num == FILE_HEADER_PAGE_NUM || page_num >= pager->num_pages || visit_page(check->visited, page_num))
+	{
+		report_problem(check, subtree->parent_page_num, "invalid or repeated child page %" PRIu64, page_num);
+		return false;
+	}
+	return true;
+}
+
+// Checks a page that visit_subtree has marked
+static void check_node_page(Table* table, TreeCheck* check, const CheckSubtree* subtree, void* node)
+{
+	uint64_t page_num = subtree->page_num;
+	uint64_t parent_page_num = subtree->parent_page_num;
+	bool has_lower_bound = subtree->has_lower_bound;
+	uint64_t lower_bound = subtree->lower_bound;
+	bool has_upper_bound = subtree->has_upper_bound;
+	uint64_t upper_bound = subtree->upper_bound;
+
+	bool is_root = (page_num == table->root_page_num);
+	if (is_node_root(node) != is_root)
+		report_problem(check, page_num, "root flag is %d", is_node_root(node));
+
+	if (get_node_type(node) != NODE_LEAF && get_node_type(node) != NODE_INTERNAL)
+	{
+		report_problem(check, page_num, "unexpected node type %d", get_node_type(node));
+		return;
+	}
+
+	uint32_t page_size = table->pager->page_size;
+	uint32_t max_cells = (get_node_type(node) == NODE_LEAF) ? LEAF_NODE_MAX_CELLS(page_size) : INTERNAL_NODE_MAX_CELLS(page_size);
+	if (*node_max_cells(node) != max_cells)
+	{
+		report_problem(check, page_num, "capacity is %d, expected %d", *node_max_cells(node), max_cells);
+		return;
+	}
+	if (!is_root && *node_parent(node) != parent_page_num)
+		report_problem(check, page_num, "parent is %" PRIu64 ", expected %" PRIu64, *node_parent(node), parent_page_num);
+
+	switch (get_node_type(node))
+	{
+	case NODE_LEAF:
+	{
+		uint32_t num_cells = *leaf_node_num_cells(node);
+		if (num_cells > max_cells)
+		{
+			report_problem(check, page_num, "%d cells exceed the maximum of %d", num_cells, max_cells);
+			return;
+		}
+		check_row_count(check, subtree, node);
+
+		for (uint32_t i = 0; i < num_cells; ++i)
+		{
+			uint64_t key = *leaf_node_key(node, i);
+			if (i > 0 && key <= *leaf_node_key(node, i - 1))
+				report_problem(check, page_num, "key %" PRIu64 " at cell %d is out of order", key, i);
+			if ((has_lower_bound && key <= lower_bound) || (has_upper_bound && key > upper_bound))
+				report_problem(check, page_num, "key %" PRIu64 " is outside of its parent's range", key);
+		}
+
+		if (check->seen_leaf && check->previous_next_leaf != page_num)
+			report_problem(check, check->previous_leaf, "next leaf is not %" PRIu64, page_num);
+
+		if (!check->seen_leaf)
+			check->first_leaf = page_num;
+		check->previous_leaf = page_num;
+		check->previous_next_leaf = *leaf_node_next_leaf(node);
+		check->seen_leaf = true;
+		break;
+	}
+	case NODE_INTERNAL:
+	{
+		uint32_t num_keys = *internal_node_num_keys(node);
+		if (num_keys == 0)
+		{
+			report_problem(check, page_num, "internal node has no keys");
+			return;
+		}
+		check_row_count(check, subtree, node);
+
+		for (uint32_t i = 0; i < num_keys; ++i)
+		{
+			uint64_t key = *internal_node_key(node, i);
+			if (i > 0 && key <= *internal_node_key(node, i - 1))
+				report_problem(check, page_num, "key %" PRIu64 " at cell %d is out of order", key, i);
+			if ((has_lower_bound && key <= lower_bound) || (has_upper_bound && key > upper_bound))
+				report_problem(check, page_num, "key %" PRIu64 " is outside of its parent's range", key);
+		}
+
+		for (uint32_t i = 0; i <= num_keys; ++i)
+		{
+			CheckSubtree child = {
+				*internal_node_child(node, i), page_num,
+				(i > 0) || has_lower_bound, (i > 0) ? *internal_node_key(node, i - 1) : lower_bound,
+				(i < num_keys) || has_upper_bound, (i < num_keys) ? *internal_node_key(node, i) : upper_bound,
+				i, *internal_node_child_count(node, i),
+			};
+			if (check->children)
+				subtree_list_push(check->children, child);
+			else
+				check_node(table, check, &child);
+		}
+		break;
+	}
+	default:
+		report_problem(check, page_num, "unknown node type %d", get_node_type(node));
+		break;
+	}
+}
+
+// Each child compares its rows with its parent's count, so no page is read twice
+static void check_row_count(TreeCheck* check, const CheckSubtree* subtree, void* node)
+{
+	if (subtree->page_num == subtree->parent_page_num)
+		return;
+
+	uint64_t num_rows = node_row_count(node);
+	if (subtree->row_count != num_rows)
+		report_problem(check, subtree->parent_page_num, "child %d counts %" PRIu64 " rows, expected %" PRIu64,
+			subtree->child_index, subtree->row_count, num_rows);
+}
+
+
+Cursor* table_start(Table* table)
+{
+	Cursor* cursor = table_find(table, 0);
+	
+	void* node = get_page(table->pager, cursor->page_num);
+	uint32_t num_cells = *leaf_node_num_cells(node);
+	cursor->end_of_table = (num_cells == 0);
+	return cursor;
+}
+
+Cursor* table_find(Table* table, uint64_t key)
+{
+	Pager* pager = table->pager;
+	Cursor* cursor = find_append_position(table, key);
+	if (cursor)
+		return cursor;
+
+	HashIndexEntry* entry = hash_index_find(&pager->hash_index, table->root_page_num, key);
+	void* node = entry && entry->page_num < pager->num_pages ? get_page(pager, entry->page_num) : NULL;
+	if (node && get_node_type(node) == NODE_LEAF)
+	{
+		// inserts shift cells within a leaf, so a key that left its slot is searched for in the rest of the leaf
+		uint32_t num_cells = *leaf_node_num_cells(node);
+		uint32_t cell_num = entry->cell_num;
+		if (cell_num >= num_cells || *leaf_node_key(node, cell_num) != key)
+			cell_num = key_lower_bound(leaf_node_key(node, 0), num_cells, key);
+
+		if (cell_num < num_cells && *leaf_node_key(node, cell_num) == key)
+		{
+			stats_increment(STAT_HASH_INDEX_HITS);
+			entry->cell_num = cell_num;
+			return new_cursor(table, entry->page_num, cell_num);
+		}
+	}
+	if (entry)
+		hash_index_remove(entry);
+
+	cursor = table_descend(table, key);
+	node = get_page(pager, cursor->page_num);
+	uint32_t num_cells = *leaf_node_num_cells(node);
+	if (cursor->cell_num < num_cells && *leaf_node_key(node, cursor->cell_num) == key)
+		hash_index_record(&pager->hash_index, table->root_page_num, key, cursor->page_num, cursor->cell_num);
+	else if (cursor->cell_num == num_cells && *leaf_node_next_leaf(node) == 0)
+	{
+		pager->append_root_page_num = table->root_page_num;
+		pager->append_page_num = cursor->page_num;
+		pager->append_max_key = num_cells > 0 ? *leaf_node_key(node, num_cells - 1) : 0;
+	}
+	return cursor;
+}
+
+// A key past the end of the rightmost leaf belongs at its end. The leaf stops
+// being the rightmost one when it splits, or when it is a root that splits.
+static Cursor* find_append_position(Table* table, uint64_t key)
+{
+	Pager* pager = table->pager;
+	if (pager->append_page_num == 0 || pager->append_root_page_num != table->root_page_num || key <= pager->append_max_key)
+		return NULL;
+
+	void* node = get_page(pager, pager->append_page_num);
+	if (get_node_type(node) != NODE_LEAF || *leaf_node_next_leaf(node) != 0)
+	{
+		pager->append_page_num = 0;
+		return NULL;
+	}
+
+	uint32_t num_cells = *leaf_node_num_cells(node);
+	if (num_cells > 0)
+		pager->append_max_key = *leaf_node_key(node, num_cells - 1);
+	if (key <= pager->append_max_key)
+		return NULL;
+
+	stats_increment(STAT_APPEND_HITS);
+	return new_cursor(table, pager->append_page_num, num_cells);
+}
+
+Cursor* table_descend(Table* table, uint64_t key)
+{
+	void* root_node = get_page(table->pager, table->root_page_num);
+	if (get_node_type(root_node) == NODE_LEAF)
+		return leaf_node_find(table, table->root_page_num, key);
+	else	
+		return internal_node_find(table, table->root_page_num, key);
+}
+
+Cursor* table_find_last(Table* table, uint64_t key)
 {
-	return pager->num_pages;
+	Cursor* cursor = table_descend(table, key);
+	void* node = get_page(table->pager, cursor->page_num);
+	if (cursor->cell_num == *leaf_node_num_cells(node) || *leaf_node_key(node, cursor->cell_num) != key)
+		cursor_retreat(cursor);
+	return cursor;
 }
 
-
-Table* db_open(const char* filename)
+Cursor* table_find_row(Table* table, uint64_t row_num)
 {
-	Pager* pager = pager_open(filename);
-	Table* table = malloc(sizeof(Table));
-	if (!table)
+	Pager* pager = table->pager;
+	uint64_t page_num = table->root_page_num;
+	void* node = get_page(pager, page_num);
+	while (get_node_type(node) == NODE_INTERNAL)
 	{
-		perror("Malloc failed");
-		exit(EXIT_FAILURE);
+		uint32_t num_keys = *internal_node_num_keys(node);
+		uint32_t child = 0;
+		while (child < num_keys && row_num >= *internal_node_child_count(node, child))
+			row_num -= *internal_node_child_count(node, child++);
+		node = get_page(pager, page_num = *internal_node_child(node, child));
 	}
 
-	table->pager = pager;
-	table->root_page_num = 0;
+	Cursor* cursor = new_cursor(table, page_num, 0);
+	for (; cursor->cell_num < *leaf_node_num_cells(node); ++cursor->cell_num)
+		if (!leaf_node_is_deleted(node, cursor->cell_num) && row_num-- == 0)
+			return cursor;
+	cursor->end_of_table = true;
+	return cursor;
+}
 
-	if (pager->num_pages == 0)
+uint64_t table_rank(Table* table, uint64_t key)
+{
+	Pager* pager = table->pager;
+	void* node = get_page(pager, table->root_page_num);
+	uint64_t rank = 0;
+	while (get_node_type(node) == NODE_INTERNAL)
 	{
-		void* root_node = get_page(pager, 0);
-		initialize_node(root_node, NODE_LEAF);
-		set_node_root(root_node, true);
+		uint32_t child = internal_node_find_child(node, key);
+		for (uint32_t i = 0; i < child; ++i)
+			rank += *internal_node_child_count(node, i);
+		node = get_page(pager, *internal_node_child(node, child));
 	}
 
-	return table;
+	uint32_t cell_num = key_lower_bound(leaf_node_key(node, 0), *leaf_node_num_cells(node), key);
+	for (uint32_t i = 0; i < cell_num; ++i)
+		rank += !leaf_node_is_deleted(node, i);
+	return rank;
 }
 
-void db_close(Table* table)
+uint64_t table_row_count(Table* table)
 {
-	Pager* pager = table->pager;
-
-	for (uint32_t i = 0; i < pager->num_pages; ++i)
-	{
-		if (pager->pages[i] == NULL)
-			continue;
-
-		pager_flush(pager, i);
-		free(pager->pages[i]);
-		pager->pages[i] = NULL;
-	}
+	return node_row_count(get_page(table->pager, table->root_page_num));
+}
 
-	if (fclose(pager->file_ptr))
-	{
-		perror("fclose error");
-		exit(EXIT_FAILURE);
-	}
+bool table_may_contain(Table* table, uint64_t key)
+{
+	if (bloom_may_contain(&table->pager->key_filter, bloom_hash(table->root_page_num, key)))
+		return true;
+	stats_increment(STAT_KEY_FILTER_SKIPS);
+	return false;
+}
 
-	for (uint32_t i = 0; i < TABLE_MAX_PAGES; ++i)
+uint32_t table_depth(Table* table)
+{
+	uint32_t depth = 1;
+	void* node = get_page(table->pager, table->root_page_num);
+	while (get_node_type(node) == NODE_INTERNAL)
 	{
-		void* page = pager->pages[i];
-		if (page)
-		{
-			free(page);
-			pager->pages[i] = NULL;
-		}
+		node = get_page(table->pager, *internal_node_child(node, 0));
+		depth++;
 	}
+	return depth;
+}
 
-	free(pager);
-	free(table);
+void* cursor_value(Cursor* cursor)
+{
+	void* page = get_page(cursor->table->pager, cursor->page_num);
+	return leaf_node_value(page, cursor->cell_num);
 }
 
+void cursor_read_row(Cursor* cursor, Row* row, uint32_t columns)
+{
+	void* page = get_page(cursor->table->pager, cursor->page_num);
+	leaf_node_read_row(page, cursor->cell_num, row, columns);
+}
 
-Cursor* table_start(Table* table)
+bool cursor_is_deleted(Cursor* cursor)
 {
-	Cursor* cursor = table_find(table, 0);
-	
-	void* node = get_page(table->pager, cursor->page_num);
-	uint8_t num_cells = *leaf_node_num_cells(node);
-	cursor->end_of_table = (num_cells == 0);
-	return cursor;
+	void* page = get_page(cursor->table->pager, cursor->page_num);
+	return leaf_node_is_deleted(page, cursor->cell_num);
 }
 
-Cursor* table_find(Table* table, uint32_t key)
+void cursor_delete(Cursor* cursor)
 {
-	void* root_node = get_page(table->pager, table->root_page_num);
-	if (get_node_type(root_node) == NODE_LEAF)
-		return leaf_node_find(table, table->root_page_num, key);
-	else	
-		return internal_node_find(table, table->root_page_num, key);
+	void* node = get_page(cursor->table->pager, cursor->page_num);
+	if (!leaf_node_is_deleted(node, cursor->cell_num))
+		add_row_counts(cursor->table->pager, cursor->page_num, *leaf_node_key(node, cursor->cell_num), -1);
+	leaf_node_clear_value(node, cursor->cell_num);
 }
 
-void* cursor_value(Cursor* cursor)
+void cursor_write_row(Cursor* cursor, Row* row)
 {
-	void* page = get_page(cursor->table->pager, cursor->page_num);
-	return leaf_node_value(page, cursor->cell_num);
+	void* node = get_page(cursor->table->pager, cursor->page_num);
+	int64_t delta = (int64_t)!row_is_blank(row) - (int64_t)!leaf_node_is_deleted(node, cursor->cell_num);
+	if (delta != 0)
+		add_row_counts(cursor->table->pager, cursor->page_num, *leaf_node_key(node, cursor->cell_num), delta);
+	leaf_node_write_row(node, cursor->cell_num, row);
 }
 
 void cursor_advance(Cursor* cursor)
@@ -219,7 +1616,7 @@ void cursor_advance(Cursor* cursor)
 
 	if (cursor->cell_num >= *leaf_node_num_cells(node))
 	{
-		uint32_t next_page_num = *leaf_node_next_leaf(node);
+		uint64_t next_page_num = *leaf_node_next_leaf(node);
 		if (next_page_num == 0)
 		{
 			cursor->end_of_table = true;
@@ -232,6 +1629,47 @@ void cursor_advance(Cursor* cursor)
 	}
 }
 
+void cursor_retreat(Cursor* cursor)
+{
+	Pager* pager = cursor->table->pager;
+	while (cursor->cell_num == 0)
+	{
+		uint64_t page_num = previous_leaf(pager, cursor->page_num);
+		if (page_num == 0)
+		{
+			cursor->end_of_table = true;
+			return;
+		}
+		cursor->page_num = page_num;
+		cursor->cell_num = *leaf_node_num_cells(get_page(pager, page_num));
+	}
+	cursor->cell_num--;
+}
+
+// Leaves only link forward, so the one before is the rightmost leaf under the
+// left sibling of the nearest ancestor that has one; 0 for the first leaf
+static uint64_t previous_leaf(Pager* pager, uint64_t page_num)
+{
+	void* node = get_page(pager, page_num);
+	uint64_t key = *leaf_node_num_cells(node) > 0 ? *leaf_node_key(node, 0) : 0;
+
+	for (; !is_node_root(node); node = get_page(pager, page_num))
+	{
+		uint64_t parent_page_num = *node_parent(node);
+		void* parent = get_page(pager, parent_page_num);
+		uint32_t child_index = internal_node_child_index(parent, page_num, key);
+		if (child_index > 0)
+		{
+			node = get_page(pager, page_num = *internal_node_child(parent, child_index - 1));
+			while (get_node_type(node) == NODE_INTERNAL)
+				node = get_page(pager, page_num = *internal_node_right_child(node));
+			return page_num;
+		}
+		page_num = parent_page_num;
+	}
+	return 0;
+}
+
 
 NodeType get_node_type(void* node)
 {
@@ -245,22 +1683,43 @@ void set_node_type(void* node, NodeType type)
 }
 
 
-void create_new_root(Table* table, uint32_t right_child_page_num)
+void create_new_root(Table* table, uint64_t right_child_page_num)
 {
-	void* root = get_page(table->pager, table->root_page_num);
-	uint32_t left_child_page_num = get_unused_page_num(table->pager);
-	void* left_child = get_page(table->pager, left_child_page_num);
+	Pager* pager = table->pager;
+	void* root = get_page(pager, table->root_page_num);
+	void* right_child = get_page(pager, right_child_page_num);
+	uint64_t left_child_page_num = get_unused_page_num(pager);
+	void* left_child = get_page(pager, left_child_page_num);
+
+	if (get_node_type(root) == NODE_INTERNAL)
+	{
+		initialize_node(right_child, NODE_INTERNAL, pager->page_size);
+		initialize_node(left_child, NODE_INTERNAL, pager->page_size);
+	}
 
-	memcpy(left_child, root, PAGE_SIZE);
+	memcpy(left_child, root, pager->page_size);
 	set_node_root(left_child, false);
 
-	initialize_node(root, NODE_INTERNAL);
+	if (get_node_type(left_child) == NODE_INTERNAL)
+	{
+		for (uint32_t i = 0; i <= *internal_node_num_keys(left_child); ++i)
+			*node_parent(get_page(pager, *internal_node_child(left_child, i))) = left_child_page_num;
+	}
+	else
+		hash_index_move_cells(table, left_child_page_num);
+
+	initialize_node(root, NODE_INTERNAL, pager->page_size);
 	set_node_root(root, true);
 	*internal_node_num_keys(root) = 1;
 	*internal_node_child(root, 0) = left_child_page_num;
-	uint32_t left_child_max_key = get_node_max_key(left_child);
+	uint64_t left_child_max_key = get_node_max_key(pager, left_child);
 	*internal_node_key(root, 0) = left_child_max_key;
 	*internal_node_right_child(root) = right_child_page_num;
+	*internal_node_child_count(root, 0) = node_row_count(left_child);
+	*internal_node_child_count(root, 1) = node_row_count(right_child);
+
+	*node_parent(left_child) = table->root_page_num;
+	*node_parent(right_child) = table->root_page_num;
 }
 
 bool is_node_root(void* node)
@@ -274,55 +1733,162 @@ void set_node_root(void* node, bool value)
 	*((uint8_t*)node + IS_ROOT_OFFSET) = value;
 }
 
+uint64_t* node_parent(void* node)
+{
+	return (uint64_t*)((uint8_t*)node + PARENT_POINTER_OFFSET);
+}
+
+uint64_t* free_page_next(void* page)
+{
+	return (uint64_t*)((uint8_t*)page + FREE_PAGE_NEXT_OFFSET);
+}
+
+uint32_t* node_max_cells(void* node)
+{
+	return (uint32_t*)((uint8_t*)node + MAX_CELLS_OFFSET);
+}
+
 
-void initialize_node(void* node, NodeType type)
+void initialize_node(void* node, NodeType type, uint32_t page_size)
 {
 	set_node_type(node, type);
 	set_node_root(node, false);
 	switch (type)
 	{
 	case NODE_LEAF:
+		*node_max_cells(node) = LEAF_NODE_MAX_CELLS(page_size);
 		*leaf_node_num_cells(node) = 0;
 		*leaf_node_next_leaf(node) = 0;
+		*leaf_node_layout(node) = LEAF_LAYOUT_ROW;
 		break;
 	case NODE_INTERNAL:
+		*node_max_cells(node) = INTERNAL_NODE_MAX_CELLS(page_size);
 		*internal_node_num_keys(node) = 0;
+		*internal_node_right_child(node) = INVALID_PAGE_NUM;
+		break;
+	case NODE_FREE:
+		*free_page_next(node) = 0;
 		break;
 	}
 }
 
 
-uint8_t* leaf_node_num_cells(void* node)
+uint32_t* leaf_node_num_cells(void* node)
+{
+	return (uint32_t*)((uint8_t*)node + LEAF_NODE_NUM_CELLS_OFFSET);
+}
+
+uint64_t* leaf_node_key(void* node, uint32_t cell_num)
 {
-	return (uint8_t*)node + LEAF_NODE_NUM_CELLS_OFFSET;
+	return (uint64_t*)((uint8_t*)node + LEAF_NODE_KEYS_OFFSET + cell_num * LEAF_NODE_KEY_SIZE);
 }
 
-void* leaf_node_cell(void* node, uint32_t cell_num)
+void* leaf_node_value(void* node, uint32_t cell_num)
 {
-	return (uint8_t*)node + LEAF_NODE_HEADER_SIZE + cell_num * LEAF_NODE_CELL_SIZE;
+	return (uint8_t*)node + LEAF_NODE_VALUES_OFFSET(*node_max_cells(node)) + cell_num * LEAF_NODE_VALUE_SIZE;
 }
 
-uint32_t* leaf_node_key(void* node, uint32_t cell_num)
+uint64_t* leaf_node_next_leaf(void* node)
 {
-	return leaf_node_cell(node, cell_num);
+	return (uint64_t*)((uint8_t*)node + LEAF_NODE_NEXT_LEAF_OFFSET);
 }
 
-void* leaf_node_value(void* node, uint32_t cell_num)
+uint8_t* leaf_node_layout(void* node)
+{
+	return (uint8_t*)node + LEAF_NODE_LAYOUT_OFFSET;
+}
+
+void* leaf_node_column(void* node, uint32_t cell_num, Column column)
+{
+	const ColumnLayout* layout = &column_layouts[column];
+	if (*leaf_node_layout(node) == LEAF_LAYOUT_PAX)
+	{
+		uint32_t max_cells = *node_max_cells(node);
+		return (uint8_t*)node + LEAF_NODE_VALUES_OFFSET(max_cells) + max_cells * layout->row_offset + cell_num * layout->size;
+	}
+	return (uint8_t*)leaf_node_value(node, cell_num) + layout->row_offset;
+}
+
+void leaf_node_read_row(void* node, uint32_t cell_num, Row* row, uint32_t columns)
+{
+	for (Column column = COLUMN_ID; column <= COLUMN_EMAIL; ++column)
+		if (columns & COLUMN_BIT(column))
+			memcpy(row_column(row, column), leaf_node_column(node, cell_num, column), column_layouts[column].size);
+}
+
+void leaf_node_write_row(void* node, uint32_t cell_num, Row* row)
+{
+	for (Column column = COLUMN_ID; column <= COLUMN_EMAIL; ++column)
+		memcpy(leaf_node_column(node, cell_num, column), row_column(row, column), column_layouts[column].size);
+}
+
+void leaf_node_copy_cell(void* destination_node, uint32_t destination_cell, void* source_node, uint32_t source_cell)
+{
+	*leaf_node_key(destination_node, destination_cell) = *leaf_node_key(source_node, source_cell);
+
+	if (*leaf_node_layout(source_node) == LEAF_LAYOUT_ROW)
+	{
+		memcpy(leaf_node_value(destination_node, destination_cell), leaf_node_value(source_node, source_cell), LEAF_NODE_VALUE_SIZE);
+		return;
+	}
+
+	for (Column column = COLUMN_ID; column <= COLUMN_EMAIL; ++column)
+		memcpy(leaf_node_column(destination_node, destination_cell, column),
+			leaf_node_column(source_node, source_cell, column), column_layouts[column].size);
+}
+
+void leaf_node_clear_value(void* node, uint32_t cell_num)
+{
+	for (Column column = COLUMN_ID; column <= COLUMN_EMAIL; ++column)
+		memset(leaf_node_column(node, cell_num, column), 0, column_layouts[column].size);
+}
+
+bool leaf_node_is_deleted(void* node, uint32_t cell_num)
+{
+	static const uint8_t zeros[EMAIL_SIZE] = {0};
+
+	for (Column column = COLUMN_ID; column <= COLUMN_EMAIL; ++column)
+		if (memcmp(leaf_node_column(node, cell_num, column), zeros, column_layouts[column].size) != 0)
+			return false;
+	return true;
+}
+
+static void* row_column(Row* row, Column column)
 {
-	return (uint8_t*)leaf_node_cell(node, cell_num) + LEAF_NODE_KEY_SIZE;
+	switch (column)
+	{
+	case COLUMN_ID:
+		return &row->id;
+	case COLUMN_USERNAME:
+		return row->username;
+	case COLUMN_EMAIL:
+		return row->email;
+	}
+	return NULL;
 }
 
-uint32_t* leaf_node_next_leaf(void* node)
+// A row that is all zeros is stored the same as a deleted one
+static bool row_is_blank(Row* row)
 {
-	return (uint32_t*)((uint8_t*)node + LEAF_NODE_NEXT_LEAF_OFFSET);
+	static const uint8_t zeros[EMAIL_SIZE] = {0};
+
+	for (Column column = COLUMN_ID; column <= COLUMN_EMAIL; ++column)
+		if (memcmp(row_column(row, column), zeros, column_layouts[column].size) != 0)
+			return false;
+	return true;
 }
 
-void leaf_node_insert(Cursor* cursor, uint32_t key, Row* value)
+void leaf_node_insert(Cursor* cursor, uint64_t key, Row* value)
 {
+	bloom_add(&cursor->table->pager->key_filter, bloom_hash(cursor->table->root_page_num, key));
+	// the ancestors count the row before a split moves it, and splits keep their totals
+	if (!row_is_blank(value))
+		add_row_counts(cursor->table->pager, cursor->page_num, key, 1);
+
 	void* node = get_page(cursor->table->pager, cursor->page_num);
 	uint32_t num_cells = *leaf_node_num_cells(node);
 
-	if (num_cells >= LEAF_NODE_MAX_CELLS)
+	if (num_cells >= *node_max_cells(node))
 	{
 		leaf_node_split_and_insert(cursor, key, value);
 		return;
@@ -330,46 +1896,63 @@ void leaf_node_insert(Cursor* cursor, uint32_t key, Row* value)
 
 	if (cursor->cell_num < num_cells)
 		for (uint32_t i = num_cells; i > cursor->cell_num; --i)
-			memcpy(leaf_node_cell(node, i), leaf_node_cell(node, i - 1), LEAF_NODE_CELL_SIZE);
+			leaf_node_copy_cell(node, i, node, i - 1);
 	 
 	*leaf_node_num_cells(node) += 1;
 	*leaf_node_key(node, cursor->cell_num) = key;
-	serialize_row(value, leaf_node_value(node, cursor->cell_num));
+	leaf_node_write_row(node, cursor->cell_num, value);
 }
 
-void leaf_node_split_and_insert(Cursor* cursor, uint32_t key, Row* value)
+void leaf_node_split_and_insert(Cursor* cursor, uint64_t key, Row* value)
 {
+	stats_increment(STAT_LEAF_SPLITS);
 	void* old_node = get_page(cursor->table->pager, cursor->page_num);
-	uint32_t new_page_num = get_unused_page_num(cursor->table->pager);
+	uint64_t old_max = get_node_max_key(cursor->table->pager, old_node);
+	uint64_t new_page_num = get_unused_page_num(cursor->table->pager);
 	void* new_node = get_page(cursor->table->pager, new_page_num);
-	initialize_node(new_node, NODE_LEAF);
+	uint32_t max_cells = *node_max_cells(old_node);
+
+	// an append to the rightmost leaf leaves it full and starts an empty one, so ascending keys pack every leaf
+	bool appending = *leaf_node_next_leaf(old_node) == 0 && cursor->cell_num == max_cells;
+	uint32_t left_split_count = appending ? max_cells : LEAF_NODE_LEFT_SPLIT_COUNT(max_cells);
+
+	initialize_node(new_node, NODE_LEAF, cursor->table->pager->page_size);
+	*leaf_node_layout(new_node) = *leaf_node_layout(old_node);
+	*node_parent(new_node) = *node_parent(old_node);
 	*leaf_node_next_leaf(new_node) = *leaf_node_next_leaf(old_node);
 	*leaf_node_next_leaf(old_node) = new_page_num;
 
-	for (int32_t i = LEAF_NODE_MAX_CELLS; i >= 0; --i)
+	for (uint32_t i = max_cells + 1; i-- > 0;)
 	{
 		void* destination_node;
-		if (i >= LEAF_NODE_LEFT_SPLIT_COUNT)
+		if (i >= left_split_count)
 			destination_node = new_node;
+		else if (i < cursor->cell_num)
+			break; // the cells left of the insert stay where they are
 		else
 			destination_node = old_node;
 
-		uint32_t index_within_node = i % LEAF_NODE_LEFT_SPLIT_COUNT;
-		void* destination = leaf_node_cell(destination_node, index_within_node);
+		uint32_t index_within_node = i >= left_split_count ? i - left_split_count : i;
 
 		if (i == cursor->cell_num)
 		{
-			serialize_row(value, leaf_node_value(destination_node, index_within_node));
+			leaf_node_write_row(destination_node, index_within_node, value);
 			*leaf_node_key(destination_node, index_within_node) = key;
 		}
 		if (i > cursor->cell_num)
-			memcpy(destination, leaf_node_cell(old_node, i - 1), LEAF_NODE_CELL_SIZE);
+			leaf_node_copy_cell(destination_node, index_within_node, old_node, i - 1);
 		if (i < cursor->cell_num)
-			memcpy(destination, leaf_node_cell(old_node, i), LEAF_NODE_CELL_SIZE);
+			leaf_node_copy_cell(destination_node, index_within_node, old_node, i);
 	}
 
-	*leaf_node_num_cells(old_node) = LEAF_NODE_LEFT_SPLIT_COUNT;
-	*leaf_node_num_cells(new_node) = LEAF_NODE_RIGHT_SPLIT_COUNT;
+	*leaf_node_num_cells(old_node) = left_split_count;
+	*leaf_node_num_cells(new_node) = max_cells + 1 - left_split_count;
+	hash_index_move_cells(cursor->table, new_page_num);
+	if (appending)
+	{
+		cursor->table->pager->append_root_page_num = cursor->table->root_page_num;
+		cursor->table->pager->append_page_num = new_page_num;
+	}
 
 	if (is_node_root(old_node))
 	{
@@ -377,64 +1960,75 @@ void leaf_node_split_and_insert(Cursor* cursor, uint32_t key, Row* value)
 	}
 	else
 	{
-		printf("Need to implement updating parent after spliting.\n");
-		exit(EXIT_FAILURE);
+		uint64_t parent_page_num = *node_parent(old_node);
+		uint64_t new_max = get_node_max_key(cursor->table->pager, old_node);
+		void* parent = get_page(cursor->table->pager, parent_page_num);
+
+		update_internal_node_key(parent, old_max, new_max);
+		refresh_row_count(cursor->table->pager, parent, cursor->page_num);
+		internal_node_insert(cursor->table, parent_page_num, new_page_num);
 	}
 }
 
-Cursor* leaf_node_find(Table* table, uint32_t page_num, uint32_t key)
+Cursor* leaf_node_find(Table* table, uint64_t page_num, uint64_t key)
 {
 	void* node = get_page(table->pager, page_num);
 	uint32_t num_cells = *leaf_node_num_cells(node);
+	return new_cursor(table, page_num, key_lower_bound(leaf_node_key(node, 0), num_cells, key));
+}
+
+// A larger key than the last one merged still belongs in its leaf unless it is past the
+// leaf's last key and another leaf follows. The leaf may have become an internal node
+// when it was a root that split.
+static Cursor* find_after_previous(Table* table, uint64_t page_num, uint64_t key)
+{
+	void* node = get_page(table->pager, page_num);
+	if (get_node_type(node) != NODE_LEAF)
+		return NULL;
 
+	uint32_t num_cells = *leaf_node_num_cells(node);
+	if (*leaf_node_next_leaf(node) != 0 && (num_cells == 0 || key > *leaf_node_key(node, num_cells - 1)))
+		return NULL;
+	return leaf_node_find(table, page_num, key);
+}
+
+static Cursor* new_cursor(Table* table, uint64_t page_num, uint32_t cell_num)
+{
 	Cursor* cursor = malloc(sizeof(Cursor));
 	if (!cursor)
 	{
 		perror("malloc error");
 		exit(EXIT_FAILURE);
 	}
+	stats_increment(STAT_CURSORS);
 
 	cursor->table = table;
 	cursor->page_num = page_num;
-
-	uint32_t min_index = 0;
-	uint32_t one_past_max_index = num_cells;
-	while (one_past_max_index != min_index)
-	{
-		uint32_t index = (min_index + one_past_max_index) / 2;
-		uint32_t key_at_index = *leaf_node_key(node, index);
-		if (key == key_at_index)
-		{
-			cursor->cell_num = index;
-			return cursor;
-		}
-		if (key < key_at_index)
-			one_past_max_index = index;
-		if (key > key_at_index)
-			min_index = index + 1;
-	}
-
-	cursor->cell_num = min_index;
+	cursor->cell_num = cell_num;
+	cursor->end_of_table = false;
 	return cursor;
 }
 
-
-uint8_t* internal_node_num_keys(void* node)
+// Points the hash index entries of a leaf's keys at their new slots after a split moved them
+static void hash_index_move_cells(Table* table, uint64_t page_num)
 {
-	return (uint8_t*)node + INTERNAL_NODE_NUM_KEYS_OFFSET;
+	void* node = get_page(table->pager, page_num);
+	for (uint32_t i = 0; i < *leaf_node_num_cells(node); ++i)
+		hash_index_move(&table->pager->hash_index, table->root_page_num, *leaf_node_key(node, i), page_num, i);
 }
 
-uint32_t* internal_node_right_child(void* node)
+
+uint32_t* internal_node_num_keys(void* node)
 {
-	return (uint32_t*)((uint8_t*)node + INTERNAL_NODE_RIGHT_CHILD_OFFSET);
+	return (uint32_t*)((uint8_t*)node + INTERNAL_NODE_NUM_KEYS_OFFSET);
 }
 
-uint32_t* internal_node_cell(void* node, uint32_t cell_num)
+uint64_t* internal_node_right_child(void* node)
 {
-	return (uint32_t*)((uint8_t*)node + INTERNAL_NODE_HEADER_SIZE + cell_num * INTERNAL_NODE_CELL_SIZE);
+	return (uint64_t*)((uint8_t*)node + INTERNAL_NODE_RIGHT_CHILD_OFFSET);
 }
 
-uint32_t* internal_node_child(void* node, uint32_t child_num)
+uint64_t* internal_node_child(void* node, uint32_t child_num)
 {
 	uint32_t num_keys = *internal_node_num_keys(node);
 	if (child_num > num_keys)
@@ -443,38 +2037,43 @@ uint32_t* internal_node_child(void* node, uint32_t child_num)
 		exit(EXIT_FAILURE);
 	}
 	if (child_num == num_keys)
-		return internal_node_right_child(node);
+	{
+		uint64_t* right_child = internal_node_right_child(node);
+		if (*right_child == INVALID_PAGE_NUM)
+		{
+			printf("Tried to access right child of node, but was invalid page.\n");
+			exit(EXIT_FAILURE);
+		}
+		return right_child;
+	}
 	if (child_num < num_keys)
-		return internal_node_cell(node, child_num);
+		return (uint64_t*)((uint8_t*)node + INTERNAL_NODE_CHILDREN_OFFSET(*node_max_cells(node)) + child_num * INTERNAL_NODE_CHILD_SIZE);
 
 	return NULL;
 }
 
-uint32_t* internal_node_key(void* node, uint32_t key_num)
+// Only meaningful in files with row counts, whose internal nodes all have room for them
+uint64_t* internal_node_child_count(void* node, uint32_t child_num)
 {
-	return internal_node_cell(node, key_num) + INTERNAL_NODE_CHILD_SIZE;
+	uint32_t max_cells = *node_max_cells(node);
+	uint32_t slot = child_num == *internal_node_num_keys(node) ? max_cells : child_num;
+	return (uint64_t*)((uint8_t*)node + INTERNAL_NODE_COUNTS_OFFSET(max_cells) + slot * INTERNAL_NODE_COUNT_SIZE);
 }
 
-Cursor* internal_node_find(Table* table, uint32_t page_num, uint32_t key)
+uint64_t* internal_node_key(void* node, uint32_t key_num)
 {
-	void* node = get_page(table->pager, page_num);
-	uint8_t num_keys = *internal_node_num_keys(node);
-
-	uint32_t min_index = 0;
-	uint32_t max_index = num_keys;
-	
-	while (min_index != max_index)
-	{
-		uint8_t index = (min_index + max_index) / 2;
-		uint32_t key_at_right = *internal_node_key(node, index);
+	return (uint64_t*)((uint8_t*)node + INTERNAL_NODE_KEYS_OFFSET + key_num * INTERNAL_NODE_KEY_SIZE);
+}
 
-		if (key_at_right >= key)
-			max_index = index;
-		else
-			min_index = index + 1;
-	}
+uint32_t internal_node_find_child(void* node, uint64_t key)
+{
+	return key_lower_bound(internal_node_key(node, 0), *internal_node_num_keys(node), key);
+}
 
-	uint32_t child_num = *internal_node_child(node, min_index);
+Cursor* internal_node_find(Table* table, uint64_t page_num, uint64_t key)
+{
+	void* node = get_page(table->pager, page_num);
+	uint64_t child_num = *internal_node_child(node, internal_node_find_child(node, key));
 	void* child = get_page(table->pager, child_num);
 	switch (get_node_type(child))
 	{
@@ -482,20 +2081,211 @@ Cursor* internal_node_find(Table* table, uint32_t page_num, uint32_t key)
 		return leaf_node_find(table, child_num, key);
 	case NODE_INTERNAL:
 		return internal_node_find(table, child_num, key);
+	case NODE_FREE:
+		break;
 	}
 
 	return NULL;
 }
 
 
-uint32_t get_node_max_key(void* node)
+void internal_node_insert(Table* table, uint64_t parent_page_num, uint64_t child_page_num)
+{
+	Pager* pager = table->pager;
+	void* parent = get_page(pager, parent_page_num);
+	void* child = get_page(pager, child_page_num);
+	uint64_t child_max_key = get_node_max_key(pager, child);
+	uint32_t index = internal_node_find_child(parent, child_max_key);
+
+	uint32_t original_num_keys = *internal_node_num_keys(parent);
+	if (original_num_keys >= *node_max_cells(parent))
+	{
+		internal_node_split_and_insert(table, parent_page_num, child_page_num);
+		return;
+	}
+
+	uint64_t right_child_page_num = *internal_node_right_child(parent);
+	// an internal node with an invalid right child is empty
+	if (right_child_page_num == INVALID_PAGE_NUM)
+	{
+		*internal_node_right_child(parent) = child_page_num;
+		*internal_node_child_count(parent, 0) = node_row_count(child);
+		return;
+	}
+
+	void* right_child = get_page(pager, right_child_page_num);
+	*internal_node_num_keys(parent) = original_num_keys + 1;
+
+	if (child_max_key > get_node_max_key(pager, right_child))
+	{
+		*internal_node_child(parent, original_num_keys) = right_child_page_num;
+		*internal_node_key(parent, original_num_keys) = get_node_max_key(pager, right_child);
+		*internal_node_right_child(parent) = child_page_num;
+		// the right child's count has its own slot, which the new right child takes over
+		*internal_node_child_count(parent, original_num_keys) = *internal_node_child_count(parent, original_num_keys + 1);
+		*internal_node_child_count(parent, original_num_keys + 1) = node_row_count(child);
+		return;
+	}
+
+	uint32_t cells_to_move = original_num_keys - index;
+	memmove(internal_node_key(parent, index + 1), internal_node_key(parent, index), cells_to_move * INTERNAL_NODE_KEY_SIZE);
+	memmove(internal_node_child(parent, index + 1), internal_node_child(parent, index), cells_to_move * INTERNAL_NODE_CHILD_SIZE);
+	*internal_node_child(parent, index) = child_page_num;
+	*internal_node_key(parent, index) = child_max_key;
+	memmove(internal_node_child_count(parent, index + 1), internal_node_child_count(parent, index), cells_to_move * INTERNAL_NODE_COUNT_SIZE);
+	*internal_node_child_count(parent, index) = node_row_count(child);
+}
+
+void internal_node_split_and_insert(Table* table, uint64_t parent_page_num, uint64_t child_page_num)
+{
+	stats_increment(STAT_INTERNAL_SPLITS);
+	Pager* pager = table->pager;
+	uint64_t old_page_num = parent_page_num;
+	void* old_node = get_page(pager, old_page_num);
+	uint64_t old_max = get_node_max_key(pager, old_node);
+
+	void* child = get_page(pager, child_page_num);
+	uint64_t child_max = get_node_max_key(pager, child);
+	// an append past the right edge moves just the right child, so ascending keys pack every internal node too
+	bool appending = child_max > old_max && is_rightmost_node(pager, old_page_num);
+
+	uint64_t new_page_num = get_unused_page_num(pager);
+	bool splitting_root = is_node_root(old_node);
+
+	void* parent;
+	void* new_node;
+	if (splitting_root)
+	{
+		create_new_root(table, new_page_num);
+		parent = get_page(pager, table->root_page_num);
+		old_page_num = *internal_node_child(parent, 0);
+		old_node = get_page(pager, old_page_num);
+		new_node = get_page(pager, new_page_num);
+	}
+	else
+	{
+		parent = get_page(pager, *node_parent(old_node));
+		new_node = get_page(pager, new_page_num);
+		initialize_node(new_node, NODE_INTERNAL, pager->page_size);
+	}
+
+	// the right child moves first, then every key above the split point
+	uint64_t current_page_num = *internal_node_right_child(old_node);
+	internal_node_insert(table, new_page_num, current_page_num);
+	*node_parent(get_page(pager, current_page_num)) = new_page_num;
+	*internal_node_right_child(old_node) = INVALID_PAGE_NUM;
+
+	uint32_t max_cells = *node_max_cells(old_node);
+	uint32_t split_at = appending ? max_cells - 1 : max_cells / 2;
+	for (uint32_t i = max_cells - 1; i > split_at; --i)
+	{
+		current_page_num = *internal_node_child(old_node, i);
+		internal_node_insert(table, new_page_num, current_page_num);
+		*node_parent(get_page(pager, current_page_num)) = new_page_num;
+		(*internal_node_num_keys(old_node))--;
+	}
+
+	uint32_t num_keys = *internal_node_num_keys(old_node);
+	*internal_node_right_child(old_node) = *internal_node_child(old_node, num_keys - 1);
+	*internal_node_child_count(old_node, num_keys) = *internal_node_child_count(old_node, num_keys - 1);
+	(*internal_node_num_keys(old_node))--;
+
+	uint64_t max_after_split = get_node_max_key(pager, old_node);
+	uint64_t destination_page_num = child_max < max_after_split ? old_page_num : new_page_num;
+	internal_node_insert(table, destination_page_num, child_page_num);
+	*node_parent(child) = destination_page_num;
+
+	update_internal_node_key(parent, old_max, get_node_max_key(pager, old_node));
+	refresh_row_count(pager, parent, old_page_num);
+	if (splitting_root)
+		refresh_row_count(pager, parent, new_page_num);
+
+	if (!splitting_root)
+	{
+		// the parent may split in turn and move new_node, so its pointer is set first
+		*node_parent(new_node) = *node_parent(old_node);
+		internal_node_insert(table, *node_parent(old_node), new_page_num);
+	}
+}
+
+static bool is_rightmost_node(Pager* pager, uint64_t page_num)
+{
+	for (void* node = get_page(pager, page_num); !is_node_root(node); node = get_page(pager, page_num))
+	{
+		uint64_t parent_page_num = *node_parent(node);
+		if (*internal_node_right_child(get_page(pager, parent_page_num)) != page_num)
+			return false;
+		page_num = parent_page_num;
+	}
+	return true;
+}
+
+// key is any key under the child, which usually finds it without scanning the parent
+static uint32_t internal_node_child_index(void* parent, uint64_t child_page_num, uint64_t key)
+{
+	uint32_t index = internal_node_find_child(parent, key);
+	if (*internal_node_child(parent, index) == child_page_num)
+		return index;
+
+	for (index = 0; *internal_node_child(parent, index) != child_page_num; ++index)
+		;
+	return index;
+}
+
+static uint64_t node_row_count(void* node)
+{
+	uint64_t count = 0;
+	if (get_node_type(node) == NODE_LEAF)
+	{
+		for (uint32_t i = 0; i < *leaf_node_num_cells(node); ++i)
+			count += !leaf_node_is_deleted(node, i);
+	}
+	else if (*internal_node_right_child(node) != INVALID_PAGE_NUM)
+	{
+		for (uint32_t i = 0; i <= *internal_node_num_keys(node); ++i)
+			count += *internal_node_child_count(node, i);
+	}
+	return count;
+}
+
+// Adds delta to the count of every node on the path from page_num up to the root
+static void add_row_counts(Pager* pager, uint64_t page_num, uint64_t key, int64_t delta)
+{
+	for (void* node = get_page(pager, page_num); !is_node_root(node); node = get_page(pager, page_num))
+	{
+		uint64_t parent_page_num = *node_parent(node);
+		void* parent = get_page(pager, parent_page_num);
+		*internal_node_child_count(parent, internal_node_child_index(parent, page_num, key)) += delta;
+		page_num = parent_page_num;
+	}
+}
+
+// Recounts a child whose rows a split moved
+static void refresh_row_count(Pager* pager, void* parent, uint64_t child_page_num)
+{
+	void* child = get_page(pager, child_page_num);
+	uint32_t index = internal_node_child_index(parent, child_page_num, get_node_max_key(pager, child));
+	*internal_node_child_count(parent, index) = node_row_count(child);
+}
+
+void update_internal_node_key(void* node, uint64_t old_key, uint64_t new_key)
+{
+	uint32_t old_child_index = internal_node_find_child(node, old_key);
+	if (old_child_index < *internal_node_num_keys(node))
+		*internal_node_key(node, old_child_index) = new_key;
+}
+
+
+uint64_t get_node_max_key(Pager* pager, void* node)
 {
 	switch (get_node_type(node))
 	{
 	case NODE_INTERNAL:
-		return *internal_node_key(node, *internal_node_num_keys(node));
+		return get_node_max_key(pager, get_page(pager, *internal_node_right_child(node)));
 	case NODE_LEAF:
 		return *leaf_node_key(node, *leaf_node_num_cells(node) - 1);
+	case NODE_FREE:
+		break;
 	}
-	return -1;
+	return UINT64_MAX;
 }
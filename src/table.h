@@ -1,10 +1,15 @@
 #ifndef TABLE_H
 #define TABLE_H
 
+#include <setjmp.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdbool.h>
 
+#include "bloom.h"
+#include "hash_index.h"
+#include "memtable.h"
+
 
 #define COLUMN_USERNAME_SIZE 32
 #define COLUMN_EMAIL_SIZE 255
@@ -19,57 +24,210 @@
 #define EMAIL_OFFSET (USERNAME_OFFSET + USERNAME_SIZE)
 #define ROW_SIZE (ID_SIZE + USERNAME_SIZE + EMAIL_SIZE)
 
-#define PAGE_SIZE 4096
-#define TABLE_MAX_PAGES 100
+// Page size is chosen when a database is created and stored in its file header
+#define DEFAULT_PAGE_SIZE 4096
+#define MIN_PAGE_SIZE 4096
+#define MAX_PAGE_SIZE 65536
+#define COMPRESSED_PAGE_MAX_SIZE(page_size) ((page_size) + (page_size) / 128 + 1)
 
 
 typedef struct
 {
-	uint32_t id;
+	uint64_t id;
 	char username[COLUMN_USERNAME_SIZE + 1];
 	char email[COLUMN_EMAIL_SIZE + 1];
 } Row;
 
+typedef enum
+{
+	COLUMN_ID,
+	COLUMN_USERNAME,
+	COLUMN_EMAIL
+} Column;
+
+#define COLUMN_BIT(column) (1u << (column))
+#define ALL_COLUMNS (COLUMN_BIT(COLUMN_ID) | COLUMN_BIT(COLUMN_USERNAME) | COLUMN_BIT(COLUMN_EMAIL))
+
 void serialize_row(Row* source, void* destination);
 void deserialize_row(void* source, Row* destination);
 
 
+// File Header Layout
+// Page 0 holds the file header after the page checksum. Files without one are format version 1.
+// Version 2 always has the node capacities and the per-child row counts described below.
+
+#define FILE_MAGIC 0x46424453
+#define FILE_FORMAT_VERSION 2
+#define FILE_FLAG_COMPRESSED 0x1
+#define FILE_HEADER_PAGE_NUM 0
+
+typedef struct
+{
+	uint32_t magic;
+	uint32_t format_version;
+	uint32_t flags;
+	uint32_t page_size;
+	uint64_t num_pages;
+	uint64_t map_offset;
+	uint64_t map_capacity;
+	uint64_t free_page_head;
+	uint64_t catalog_root_page;
+	uint64_t file_id; // copied into backups so an incremental backup can tell it has the right source
+	uint64_t change_counter;
+	uint64_t change_map_offset; // 0 when the file has no change map
+	uint64_t change_map_capacity;
+	uint64_t key_filter_offset;
+	uint64_t key_filter_length; // 0 when the file has no valid key filter
+	uint64_t key_filter_capacity;
+	uint64_t session_id; // history the change counters belong to, so a backup can tell whether they still apply
+} FileHeader;
+
+
+// Location of a page in a compressed file
+typedef struct
+{
+	uint64_t offset;
+	uint32_t length;
+	uint32_t capacity;
+} PageExtent;
+
 typedef struct
 {
 	FILE* file_ptr;
-	uint32_t file_length;
-	uint32_t num_pages;
-	void* pages[TABLE_MAX_PAGES];
+	uint32_t page_size;
+	uint64_t file_length;
+	uint64_t num_pages;
+	uint64_t pages_capacity;
+	void** pages;
+	bool compressed;
+	uint64_t map_offset;
+	uint64_t map_capacity;
+	PageExtent* extents;
+	uint64_t free_page_head;
+	uint64_t catalog_root_page;
+	uint64_t file_id;
+	// Change counters only live in memory until the file is closed, so after a crash another open
+	// can reach the same counter with different pages. The session id names the history behind the
+	// counters: it comes from the header and is replaced by a fresh one at the first recorded change.
+	uint64_t session_id;
+	uint64_t opened_session_id; // the header's, whose history up to opened_change_counter is in the file
+	uint64_t opened_change_counter;
+	// Bumped whenever changed pages are recorded; each page keeps the value from its last change
+	uint64_t change_counter;
+	uint64_t* page_changes;
+	// Each cached page's fingerprint as of its load or its last recorded change, seeded per open
+	uint64_t* page_fingerprints;
+	uint64_t fingerprint_seed;
+	uint64_t change_map_offset;
+	uint64_t change_map_capacity;
+	// Every key inserted into any tree, hashed with its tree's root page
+	BloomFilter key_filter;
+	uint64_t key_filter_offset;
+	uint64_t key_filter_capacity;
+	// Cleared whenever a page may move to another tree
+	HashIndex hash_index;
+	// Rightmost leaf of the tree last searched past its end, so ascending inserts skip the descent
+	uint64_t append_root_page_num;
+	uint64_t append_page_num; // 0 when unset
+	uint64_t append_max_key;
+	// Rows inserted since the last merge, not yet in any tree; off until max_entries is set
+	Memtable memtable;
+	// Where get_page jumps when a page fails its checksum; without one the mismatch ends the process
+	jmp_buf* page_error;
+	uint64_t corrupt_page_num;
 } Pager;
 
-Pager* pager_open(const char* filename);
-void* get_page(Pager* pager, uint32_t page_num);
-void pager_flush(Pager* pager, uint32_t page_num);
-uint32_t get_unused_page_num(Pager* pager);
+Pager* pager_open(const char* filename, bool compress_pages, uint32_t page_size);
+void* get_page(Pager* pager, uint64_t page_num);
+void pager_flush(Pager* pager, uint64_t page_num);
+uint64_t get_unused_page_num(Pager* pager);
+void pager_free_page(Pager* pager, uint64_t page_num);
+// Moves the buffered rows into their trees in key order and empties the memtable
+void pager_merge_memtable(Pager* pager);
+// Reads every page into the cache; afterwards get_page never touches the pager state
+void pager_load_all(Pager* pager);
+// Stamps cached pages whose content changed since the last call; returns the change counter
+uint64_t pager_record_changes(Pager* pager);
+// Copies the current content of a page with a fresh checksum, without caching it
+void pager_copy_page(Pager* pager, uint64_t page_num, void* page);
+// Swaps in a rebuilt set of pages (index 0 is unused) and drops the free list; the file shrinks to fit on close
+void pager_replace_pages(Pager* pager, void** pages, uint64_t num_pages);
+void pager_file_header(Pager* pager, FileHeader* header);
+void write_header_page(FILE* file_ptr, const FileHeader* header, uint32_t page_size);
+
+uint32_t page_checksum(void* page, uint32_t page_size);
 
 
 typedef struct
 {
 	Pager* pager;
-	uint32_t root_page_num;
+	uint64_t root_page_num;
 } Table;
 
+// Row stores each cell as key + serialized row, PAX stores each column contiguously
+typedef enum
+{
+	LEAF_LAYOUT_ROW,
+	LEAF_LAYOUT_PAX
+} LeafLayout;
+
+// Only used when the database file is created
+typedef struct
+{
+	bool compress_pages;
+	LeafLayout leaf_layout;
+	uint32_t page_size; // 0 selects DEFAULT_PAGE_SIZE
+} DbOptions;
+
+bool is_valid_page_size(uint32_t page_size);
+
 Table* db_open(const char* filename);
+Table* db_open_with_options(const char* filename, DbOptions* options);
 void db_close(Table* table);
 
+#define MAX_CHECK_THREADS 64
+// Many more subtrees than threads, so uneven subtrees still leave the runs about the same size
+#define CHECK_SUBTREES_PER_THREAD 16
+
+uint32_t table_check(Table* table);
+// Checks the trees below their top levels on up to num_threads threads; table_check uses one per CPU
+uint32_t table_parallel_check(Table* table, uint32_t num_threads);
+
 
 typedef struct
 {
 	Table* table;
-	uint32_t page_num;
+	uint64_t page_num;
 	uint32_t cell_num;
 	bool end_of_table;
 } Cursor;
 
 Cursor* table_start(Table* table);
-Cursor* table_find(Table* table, uint32_t key);
+// Tries the hash index before descending, and remembers keys it finds
+Cursor* table_find(Table* table, uint64_t key);
+// Descends from the root without the hash index, so scan threads can share the pager
+Cursor* table_descend(Table* table, uint64_t key);
+// Positions on the last cell with a key no greater than key; UINT64_MAX seeks the end of the table
+Cursor* table_find_last(Table* table, uint64_t key);
+// The row counts in internal nodes lead to the row_num-th live row, counting from 0,
+// without reading the rows before it
+Cursor* table_find_row(Table* table, uint64_t row_num);
+// Number of live rows with keys below key
+uint64_t table_rank(Table* table, uint64_t key);
+uint64_t table_row_count(Table* table);
+// False means the key was never inserted, so there is no need to descend the tree
+bool table_may_contain(Table* table, uint64_t key);
+uint32_t table_depth(Table* table);
 void* cursor_value(Cursor* cursor);
+void cursor_read_row(Cursor* cursor, Row* row, uint32_t columns);
+bool cursor_is_deleted(Cursor* cursor);
+// Leaves a tombstone, keeping the row counts in step
+void cursor_delete(Cursor* cursor);
+// Rewrites the row in place, which also revives a deleted one
+void cursor_write_row(Cursor* cursor, Row* row);
 void cursor_advance(Cursor* cursor);
+// Steps back one cell, setting end_of_table before the first one
+void cursor_retreat(Cursor* cursor);
 
 
 // B-Tree implementation
@@ -77,83 +235,134 @@ void cursor_advance(Cursor* cursor);
 typedef enum
 {
 	NODE_INTERNAL,
-	NODE_LEAF
+	NODE_LEAF,
+	NODE_FREE
 } NodeType;
 
+#define INVALID_PAGE_NUM UINT64_MAX
+
+// Page Header Layout
+
+#define PAGE_CHECKSUM_SIZE sizeof(uint32_t)
+#define PAGE_CHECKSUM_OFFSET 0
+#define PAGE_HEADER_SIZE PAGE_CHECKSUM_SIZE
+
 // Common Node Layout
 
 #define NODE_TYPE_SIZE sizeof(uint8_t)
-#define NODE_TYPE_OFFSET 0
+#define NODE_TYPE_OFFSET PAGE_HEADER_SIZE
 #define IS_ROOT_SIZE sizeof(uint8_t)
-#define IS_ROOT_OFFSET IS_ROOT_SIZE
-#define PARENT_POINTER_SIZE sizeof(uint32_t)
+#define IS_ROOT_OFFSET (NODE_TYPE_OFFSET + NODE_TYPE_SIZE)
+#define PARENT_POINTER_SIZE sizeof(uint64_t)
 #define PARENT_POINTER_OFFSET (IS_ROOT_OFFSET + IS_ROOT_SIZE)
-#define COMMON_NODE_HEADER_SIZE (NODE_TYPE_SIZE + IS_ROOT_SIZE + PARENT_POINTER_SIZE)
+#define MAX_CELLS_SIZE sizeof(uint32_t)
+#define MAX_CELLS_OFFSET (PARENT_POINTER_OFFSET + PARENT_POINTER_SIZE)
+#define COMMON_NODE_HEADER_SIZE (PAGE_HEADER_SIZE + NODE_TYPE_SIZE + IS_ROOT_SIZE + PARENT_POINTER_SIZE + MAX_CELLS_SIZE)
 
 // Leaf Node Header Layout
 
 #define LEAF_NODE_NUM_CELLS_SIZE sizeof(uint32_t)
 #define LEAF_NODE_NUM_CELLS_OFFSET COMMON_NODE_HEADER_SIZE
-#define LEAF_NODE_NEXT_LEAF_SIZE sizeof(uint32_t)
+#define LEAF_NODE_NEXT_LEAF_SIZE sizeof(uint64_t)
 #define LEAF_NODE_NEXT_LEAF_OFFSET (LEAF_NODE_NUM_CELLS_OFFSET + LEAF_NODE_NUM_CELLS_SIZE)
-#define LEAF_NODE_HEADER_SIZE (COMMON_NODE_HEADER_SIZE + LEAF_NODE_NUM_CELLS_SIZE + LEAF_NODE_NEXT_LEAF_SIZE)
+#define LEAF_NODE_LAYOUT_SIZE sizeof(uint8_t)
+#define LEAF_NODE_LAYOUT_OFFSET (LEAF_NODE_NEXT_LEAF_OFFSET + LEAF_NODE_NEXT_LEAF_SIZE)
+#define LEAF_NODE_HEADER_SIZE (COMMON_NODE_HEADER_SIZE + LEAF_NODE_NUM_CELLS_SIZE + LEAF_NODE_NEXT_LEAF_SIZE + LEAF_NODE_LAYOUT_SIZE)
 
 // Leaf Node Body Layout
+// Keys are stored contiguously ahead of the values so they can be searched as an array.
+// The value offsets depend on the node's capacity, which every node records in its header.
+
+#define KEY_ALIGN(offset) (((offset) + sizeof(uint64_t) - 1) & ~(sizeof(uint64_t) - 1))
 
-#define LEAF_NODE_KEY_SIZE sizeof(uint32_t)
-#define LEAF_NODE_KEY_OFFSET 0
+#define LEAF_NODE_KEY_SIZE sizeof(uint64_t)
 #define LEAF_NODE_VALUE_SIZE ROW_SIZE
-#define LEAF_NODE_VALUE_OFFSET (LEAF_NODE_KEY_OFFSET + LEAF_NODE_VALUE_SIZE)
 #define LEAF_NODE_CELL_SIZE (LEAF_NODE_KEY_SIZE + LEAF_NODE_VALUE_SIZE)
-#define LEAF_NODE_SPACE_FOR_CELLS (PAGE_SIZE - LEAF_NODE_HEADER_SIZE)
-#define LEAF_NODE_MAX_CELLS (LEAF_NODE_SPACE_FOR_CELLS / LEAF_NODE_CELL_SIZE)
+#define LEAF_NODE_KEYS_OFFSET KEY_ALIGN(LEAF_NODE_HEADER_SIZE)
+#define LEAF_NODE_SPACE_FOR_CELLS(page_size) ((page_size) - LEAF_NODE_KEYS_OFFSET)
+#define LEAF_NODE_MAX_CELLS(page_size) (LEAF_NODE_SPACE_FOR_CELLS(page_size) / LEAF_NODE_CELL_SIZE)
+#define LEAF_NODE_VALUES_OFFSET(max_cells) (LEAF_NODE_KEYS_OFFSET + (max_cells) * LEAF_NODE_KEY_SIZE)
 
-#define LEAF_NODE_RIGHT_SPLIT_COUNT ((LEAF_NODE_MAX_CELLS + 1) / 2)
-#define LEAF_NODE_LEFT_SPLIT_COUNT ((LEAF_NODE_MAX_CELLS + 1) - LEAF_NODE_RIGHT_SPLIT_COUNT)
+#define LEAF_NODE_RIGHT_SPLIT_COUNT(max_cells) (((max_cells) + 1) / 2)
+#define LEAF_NODE_LEFT_SPLIT_COUNT(max_cells) (((max_cells) + 1) - LEAF_NODE_RIGHT_SPLIT_COUNT(max_cells))
+
+// PAX Leaf Node Body Layout
+// Each column is an array of max_cells values, in column order, starting at the values offset.
 
 // Internal Node Header Layout
 
-#define INTERNAL_NODE_NUM_KEYS_SIZE sizeof(uint8_t)
+#define INTERNAL_NODE_NUM_KEYS_SIZE sizeof(uint32_t)
 #define INTERNAL_NODE_NUM_KEYS_OFFSET COMMON_NODE_HEADER_SIZE
-#define INTERNAL_NODE_RIGHT_CHILD_SIZE sizeof(uint32_t)
+#define INTERNAL_NODE_RIGHT_CHILD_SIZE sizeof(uint64_t)
 #define INTERNAL_NODE_RIGHT_CHILD_OFFSET (INTERNAL_NODE_NUM_KEYS_OFFSET + INTERNAL_NODE_NUM_KEYS_SIZE)
 #define INTERNAL_NODE_HEADER_SIZE (COMMON_NODE_HEADER_SIZE + INTERNAL_NODE_NUM_KEYS_SIZE + INTERNAL_NODE_RIGHT_CHILD_SIZE)
 
 // Internal Node Body Layout
 
-#define INTERNAL_NODE_KEY_SIZE sizeof(uint32_t)
-#define INTERNAL_NODE_CHILD_SIZE sizeof(uint32_t)
-#define INTERNAL_NODE_CELL_SIZE (INTERNAL_NODE_KEY_SIZE + INTERNAL_NODE_CHILD_SIZE)
+// Each child's count of live rows follows the children, with the right child's in the last slot.
+
+#define INTERNAL_NODE_KEY_SIZE sizeof(uint64_t)
+#define INTERNAL_NODE_CHILD_SIZE sizeof(uint64_t)
+#define INTERNAL_NODE_COUNT_SIZE sizeof(uint64_t)
+#define INTERNAL_NODE_CELL_SIZE (INTERNAL_NODE_KEY_SIZE + INTERNAL_NODE_CHILD_SIZE + INTERNAL_NODE_COUNT_SIZE)
+#define INTERNAL_NODE_KEYS_OFFSET KEY_ALIGN(INTERNAL_NODE_HEADER_SIZE)
+#define INTERNAL_NODE_SPACE_FOR_CELLS(page_size) ((page_size) - INTERNAL_NODE_KEYS_OFFSET - INTERNAL_NODE_COUNT_SIZE)
+// Can be lowered at build time to exercise internal node splits
+#ifndef INTERNAL_NODE_MAX_CELLS
+#define INTERNAL_NODE_MAX_CELLS(page_size) (INTERNAL_NODE_SPACE_FOR_CELLS(page_size) / INTERNAL_NODE_CELL_SIZE)
+#endif
+#define INTERNAL_NODE_CHILDREN_OFFSET(max_cells) (INTERNAL_NODE_KEYS_OFFSET + (max_cells) * INTERNAL_NODE_KEY_SIZE)
+#define INTERNAL_NODE_COUNTS_OFFSET(max_cells) (INTERNAL_NODE_CHILDREN_OFFSET(max_cells) + (max_cells) * INTERNAL_NODE_CHILD_SIZE)
+
+// Free Page Layout
+// Freed pages are chained from the file header and reused before the file grows.
+
+#define FREE_PAGE_NEXT_SIZE sizeof(uint64_t)
+#define FREE_PAGE_NEXT_OFFSET COMMON_NODE_HEADER_SIZE
 
 
 NodeType get_node_type(void* node);
 void set_node_type(void* node, NodeType type);
 
-void create_new_root(Table* table, uint32_t right_child_page_num);
+void create_new_root(Table* table, uint64_t right_child_page_num);
 bool is_node_root(void* node);
 void set_node_root(void* node, bool value);
+uint64_t* node_parent(void* node);
+uint32_t* node_max_cells(void* node);
+uint64_t* free_page_next(void* page);
 
-void initialize_node(void* node, NodeType type);
+void initialize_node(void* node, NodeType type, uint32_t page_size);
 
-uint8_t* leaf_node_num_cells(void* node);
-void* leaf_node_cell(void* node, uint32_t cell_num);
-uint32_t* leaf_node_key(void* node, uint32_t cell_num);
+uint32_t* leaf_node_num_cells(void* node);
+uint64_t* leaf_node_key(void* node, uint32_t cell_num);
 void* leaf_node_value(void* node, uint32_t cell_num);
-uint32_t* leaf_node_next_leaf(void* node);
-
-void leaf_node_insert(Cursor* cursor, uint32_t key, Row* value);
-void leaf_node_split_and_insert(Cursor* cursor, uint32_t key, Row* value);
-Cursor* leaf_node_find(Table* table, uint32_t page_num, uint32_t key);
-
-uint8_t* internal_node_num_keys(void* node);
-uint32_t* internal_node_right_child(void* node);
-uint32_t* internal_node_cell(void* node, uint32_t cell_num);
-uint32_t* internal_node_child(void* node, uint32_t child_num);
-uint32_t* internal_node_key(void* node, uint32_t key_num);
-
-Cursor* internal_node_find(Table* table, uint32_t page_num, uint32_t key);
-
-uint32_t get_node_max_key(void* node);
+uint64_t* leaf_node_next_leaf(void* node);
+uint8_t* leaf_node_layout(void* node);
+
+void* leaf_node_column(void* node, uint32_t cell_num, Column column);
+void leaf_node_read_row(void* node, uint32_t cell_num, Row* row, uint32_t columns);
+void leaf_node_write_row(void* node, uint32_t cell_num, Row* row);
+void leaf_node_copy_cell(void* destination_node, uint32_t destination_cell, void* source_node, uint32_t source_cell);
+void leaf_node_clear_value(void* node, uint32_t cell_num);
+bool leaf_node_is_deleted(void* node, uint32_t cell_num);
+
+void leaf_node_insert(Cursor* cursor, uint64_t key, Row* value);
+void leaf_node_split_and_insert(Cursor* cursor, uint64_t key, Row* value);
+Cursor* leaf_node_find(Table* table, uint64_t page_num, uint64_t key);
+
+uint32_t* internal_node_num_keys(void* node);
+uint64_t* internal_node_right_child(void* node);
+uint64_t* internal_node_child(void* node, uint32_t child_num);
+uint64_t* internal_node_child_count(void* node, uint32_t child_num);
+uint64_t* internal_node_key(void* node, uint32_t key_num);
+
+uint32_t internal_node_find_child(void* node, uint64_t key);
+Cursor* internal_node_find(Table* table, uint64_t page_num, uint64_t key);
+void internal_node_insert(Table* table, uint64_t parent_page_num, uint64_t child_page_num);
+void internal_node_split_and_insert(Table* table, uint64_t parent_page_num, uint64_t child_page_num);
+void update_internal_node_key(void* node, uint64_t old_key, uint64_t new_key);
+
+uint64_t get_node_max_key(Pager* pager, void* node);
 
 
 #endif // TABLE_H	
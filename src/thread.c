@@ -0,0 +1,135 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "thread.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#include "stats.h"
+
+
+typedef struct
+{
+	ThreadFunction function;
+	void* argument;
+} ThreadStart;
+
+#ifdef _WIN32
+static BOOL CALLBACK once_main(PINIT_ONCE once, PVOID function_ptr, PVOID* context)
+{
+	(void)once;
+	(void)context;
+	(*(OnceFunction*)function_ptr)();
+	return TRUE;
+}
+#endif
+
+#ifdef _WIN32
+static DWORD WINAPI thread_main(LPVOID start_ptr)
+#else
+static void* thread_main(void* start_ptr)
+#endif
+{
+	ThreadStart start = *(ThreadStart*)start_ptr;
+	free(start_ptr);
+	start.function(start.argument);
+	stats_thread_exit();
+	return 0;
+}
+
+void thread_start(Thread* thread, ThreadFunction function, void* argument)
+{
+	ThreadStart* start = malloc(sizeof(ThreadStart));
+	if (!start)
+	{
+		perror("malloc error");
+		exit(EXIT_FAILURE);
+	}
+	start->function = function;
+	start->argument = argument;
+
+#ifdef _WIN32
+	*thread = CreateThread(NULL, 0, thread_main, start, 0, NULL);
+	if (!*thread)
+#else
+	if (pthread_create(thread, NULL, thread_main, start) != 0)
+#endif
+	{
+		fprintf(stderr, "Error: Could not start thread.\n");
+		exit(EXIT_FAILURE);
+	}
+}
+
+void thread_join(Thread thread)
+{
+#ifdef _WIN32
+	WaitForSingleObject(thread, INFINITE);
+	CloseHandle(thread);
+#else
+	pthread_join(thread, NULL);
+#endif
+}
+
+void mutex_init(Mutex* mutex)
+{
+#ifdef _WIN32
+	InitializeSRWLock(mutex);
+#else
+	pthread_mutex_init(mutex, NULL);
+#endif
+}
+
+void mutex_lock(Mutex* mutex)
+{
+#ifdef _WIN32
+	AcquireSRWLockExclusive(mutex);
+#else
+	pthread_mutex_lock(mutex);
+#endif
+}
+
+void mutex_unlock(Mutex* mutex)
+{
+#ifdef _WIN32
+	ReleaseSRWLockExclusive(mutex);
+#else
+	pthread_mutex_unlock(mutex);
+#endif
+}
+
+void mutex_destroy(Mutex* mutex)
+{
+#ifdef _WIN32
+	(void)mutex; // SRW locks hold no resources
+#else
+	pthread_mutex_destroy(mutex);
+#endif
+}
+
+void thread_once(Once* once, OnceFunction function)
+{
+#ifdef _WIN32
+	// the function goes by address, as a function pointer cannot become a PVOID
+	InitOnceExecuteOnce(once, once_main, &function, NULL);
+#else
+	pthread_once(once, function);
+#endif
+}
+
+uint32_t cpu_count(void)
+{
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwNumberOfProcessors;
+#else
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+	return count > 0 ? (uint32_t)count : 1;
+#endif
+}
@@ -0,0 +1,47 @@
+#ifndef THREAD_H
+#define THREAD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Minimal threads, mutexes and one-time initialization over Win32 or pthreads.
+
+#ifdef _WIN32
+#include <Windows.h>
+typedef HANDLE Thread;
+typedef SRWLOCK Mutex;
+#define MUTEX_INITIALIZER SRWLOCK_INIT
+typedef INIT_ONCE Once;
+#define ONCE_INITIALIZER INIT_ONCE_STATIC_INIT
+#else
+#include <pthread.h>
+typedef pthread_t Thread;
+typedef pthread_mutex_t Mutex;
+#define MUTEX_INITIALIZER PTHREAD_MUTEX_INITIALIZER
+typedef pthread_once_t Once;
+#define ONCE_INITIALIZER PTHREAD_ONCE_INIT
+#endif
+
+#ifdef _MSC_VER
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL _Thread_local
+#endif
+
+typedef void (*ThreadFunction)(void* argument);
+typedef void (*OnceFunction)(void);
+
+void thread_start(Thread* thread, ThreadFunction function, void* argument);
+void thread_join(Thread thread);
+
+void mutex_init(Mutex* mutex);
+void mutex_lock(Mutex* mutex);
+void mutex_unlock(Mutex* mutex);
+void mutex_destroy(Mutex* mutex);
+
+// Runs function exactly once per flag; every caller returns after it has finished
+void thread_once(Once* once, OnceFunction function);
+
+uint32_t cpu_count(void);
+
+#endif // THREAD_H
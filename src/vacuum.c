@@ -0,0 +1,235 @@
+#include "vacuum.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "catalog.h"
+
+
+typedef struct
+{
+	uint64_t page_num;
+	uint64_t max_key;
+	uint64_t num_rows;
+} NodeRef;
+
+typedef struct
+{
+	Pager* pager;
+	void** pages; // rebuilt pages by their new page number
+	uint64_t num_pages;
+	uint64_t capacity;
+	uint32_t leaf_cells;
+	uint32_t internal_keys;
+	BloomFilter key_filter; // keys of the rebuilt trees, hashed with their new roots
+} Rebuild;
+
+static uint64_t rebuild_tree(Rebuild* rebuild, uint64_t root_page_num, bool keep_deleted);
+static uint64_t rebuild_leaves(Rebuild* rebuild, Table* tree, bool keep_deleted, uint64_t root_page_num, NodeRef** leaves);
+static uint64_t rebuild_level(Rebuild* rebuild, NodeRef* children, uint64_t num_children, uint64_t root_page_num, NodeRef** parents);
+static void* rebuild_leaf(Rebuild* rebuild, void* previous, uint64_t page_num, LeafLayout layout);
+static uint64_t rebuild_page(Rebuild* rebuild);
+
+
+void table_vacuum(Table* table, uint32_t fill_percent)
+{
+	Pager* pager = table->pager;
+	uint32_t max_leaf_cells = LEAF_NODE_MAX_CELLS(pager->page_size);
+	uint32_t max_internal_keys = INTERNAL_NODE_MAX_CELLS(pager->page_size);
+
+	// with room for three children, spreading them evenly never leaves a node with just one
+	Rebuild rebuild = {.pager = pager, .num_pages = FILE_HEADER_PAGE_NUM + 1};
+	rebuild.leaf_cells = max_leaf_cells * fill_percent / 100;
+	rebuild.internal_keys = max_internal_keys * fill_percent / 100;
+	if (rebuild.leaf_cells < 1)
+		rebuild.leaf_cells = 1;
+	if (rebuild.internal_keys < 2)
+		rebuild.internal_keys = max_internal_keys < 2 ? max_internal_keys : 2;
+
+	// no tree holds more keys than the old pages have room for, so the filter gets a single layer
+	bloom_init(&rebuild.key_filter, pager->num_pages * max_leaf_cells);
+
+	// the default table keeps page 1 as its root, since it is not listed in the catalog
+	rebuild_tree(&rebuild, table->root_page_num, false);
+
+	CatalogEntry* entries;
+	uint32_t num_tables = catalog_list_tables(table, &entries);
+	for (uint32_t i = 0; i < num_tables; ++i)
+		entries[i].root_page_num = rebuild_tree(&rebuild, entries[i].root_page_num, false);
+
+	uint64_t catalog_root_page = 0;
+	if (pager->catalog_root_page != 0)
+		catalog_root_page = rebuild_tree(&rebuild, pager->catalog_root_page, true);
+
+	pager_replace_pages(pager, rebuild.pages, rebuild.num_pages);
+	pager->catalog_root_page = catalog_root_page;
+	bloom_free(&pager->key_filter);
+	pager->key_filter = rebuild.key_filter;
+	for (uint32_t i = 0; i < num_tables; ++i)
+		catalog_set_table_root(table, entries[i].name, entries[i].root_page_num);
+
+	free(entries);
+	free(rebuild.pages);
+}
+
+static uint64_t rebuild_tree(Rebuild* rebuild, uint64_t root_page_num, bool keep_deleted)
+{
+	Table tree = {rebuild->pager, root_page_num};
+	uint64_t new_root_page_num = rebuild_page(rebuild);
+
+	NodeRef* nodes;
+	uint64_t num_nodes = rebuild_leaves(rebuild, &tree, keep_deleted, new_root_page_num, &nodes);
+	while (num_nodes > 1)
+	{
+		NodeRef* parents;
+		uint64_t num_parents = rebuild_level(rebuild, nodes, num_nodes, new_root_page_num, &parents);
+		free(nodes);
+		nodes = parents;
+		num_nodes = num_parents;
+	}
+	free(nodes);
+
+	set_node_root(rebuild->pages[new_root_page_num], true);
+	return new_root_page_num;
+}
+
+// A tree that fits in one leaf is built straight into its root page
+static uint64_t rebuild_leaves(Rebuild* rebuild, Table* tree, bool keep_deleted, uint64_t root_page_num, NodeRef** leaves)
+{
+	Cursor* cursor = table_start(tree);
+	uint64_t first_leaf = cursor->page_num;
+	LeafLayout layout = *leaf_node_layout(get_page(tree->pager, first_leaf));
+	free(cursor);
+
+	uint64_t num_cells = 0;
+	for (uint64_t page_num = first_leaf; page_num != 0; )
+	{
+		void* node = get_page(tree->pager, page_num);
+		for (uint32_t i = 0; i < *leaf_node_num_cells(node); ++i)
+			num_cells += keep_deleted || !leaf_node_is_deleted(node, i);
+		page_num = *leaf_node_next_leaf(node);
+	}
+
+	// cells are spread evenly, so the last leaf is not left nearly empty
+	uint64_t num_leaves = num_cells == 0 ? 1 : (num_cells + rebuild->leaf_cells - 1) / rebuild->leaf_cells;
+	*leaves = malloc(num_leaves * sizeof(NodeRef));
+	if (!*leaves)
+	{
+		perror("malloc error");
+		exit(EXIT_FAILURE);
+	}
+
+	uint64_t leaf = 0;
+	void* new_node = NULL;
+	uint32_t leaf_target = 0;
+	for (uint64_t page_num = first_leaf; page_num != 0; page_num = *leaf_node_next_leaf(get_page(tree->pager, page_num)))
+	{
+		void* node = get_page(tree->pager, page_num);
+		for (uint32_t i = 0; i < *leaf_node_num_cells(node); ++i)
+		{
+			if (!keep_deleted && leaf_node_is_deleted(node, i))
+				continue;
+
+			if (!new_node || *leaf_node_num_cells(new_node) == leaf_target)
+			{
+				uint64_t new_page_num = num_leaves == 1 ? root_page_num : rebuild_page(rebuild);
+				new_node = rebuild_leaf(rebuild, new_node, new_page_num, layout);
+				leaf_target = (uint32_t)(num_cells / num_leaves + (leaf < num_cells % num_leaves));
+				(*leaves)[leaf++] = (NodeRef){new_page_num, 0, 0};
+			}
+
+			uint32_t new_cell = (*leaf_node_num_cells(new_node))++;
+			leaf_node_copy_cell(new_node, new_cell, node, i);
+			bloom_add(&rebuild->key_filter, bloom_hash(root_page_num, *leaf_node_key(node, i)));
+			(*leaves)[leaf - 1].max_key = *leaf_node_key(node, i);
+			(*leaves)[leaf - 1].num_rows += !leaf_node_is_deleted(node, i);
+		}
+	}
+
+	if (!new_node)
+	{
+		rebuild_leaf(rebuild, NULL, root_page_num, layout);
+		(*leaves)[0] = (NodeRef){root_page_num, 0, 0};
+	}
+	return num_leaves;
+}
+
+static void* rebuild_leaf(Rebuild* rebuild, void* previous, uint64_t page_num, LeafLayout layout)
+{
+	void* node = rebuild->pages[page_num];
+	initialize_node(node, NODE_LEAF, rebuild->pager->page_size);
+	*leaf_node_layout(node) = layout;
+	if (previous)
+		*leaf_node_next_leaf(previous) = page_num;
+	return node;
+}
+
+// Children are spread evenly, and a level with a single node is built straight into the root page
+static uint64_t rebuild_level(Rebuild* rebuild, NodeRef* children, uint64_t num_children, uint64_t root_page_num, NodeRef** parents)
+{
+	uint64_t fanout = rebuild->internal_keys + 1;
+	uint64_t num_parents = (num_children + fanout - 1) / fanout;
+	*parents = malloc(num_parents * sizeof(NodeRef));
+	if (!*parents)
+	{
+		perror("malloc error");
+		exit(EXIT_FAILURE);
+	}
+
+	uint64_t child = 0;
+	for (uint64_t i = 0; i < num_parents; ++i)
+	{
+		uint64_t page_num = num_parents == 1 ? root_page_num : rebuild_page(rebuild);
+		void* node = rebuild->pages[page_num];
+		initialize_node(node, NODE_INTERNAL, rebuild->pager->page_size);
+
+		uint64_t count = num_children / num_parents + (i < num_children % num_parents);
+		uint64_t num_rows = 0;
+		for (uint64_t j = 0; j < count; ++j, ++child)
+		{
+			*node_parent(rebuild->pages[children[child].page_num]) = page_num;
+			num_rows += children[child].num_rows;
+			if (j + 1 == count)
+			{
+				*internal_node_right_child(node) = children[child].page_num;
+				*internal_node_child_count(node, *internal_node_num_keys(node)) = children[child].num_rows;
+				break;
+			}
+
+			uint32_t key = (*internal_node_num_keys(node))++;
+			*internal_node_child(node, key) = children[child].page_num;
+			*internal_node_key(node, key) = children[child].max_key;
+			*internal_node_child_count(node, key) = children[child].num_rows;
+		}
+
+		(*parents)[i] = (NodeRef){page_num, children[child].max_key, num_rows};
+		child++;
+	}
+	return num_parents;
+}
+
+static uint64_t rebuild_page(Rebuild* rebuild)
+{
+	if (rebuild->num_pages >= rebuild->capacity)
+	{
+		rebuild->capacity = rebuild->capacity ? rebuild->capacity * 2 : 64;
+		void** pages = realloc(rebuild->pages, rebuild->capacity * sizeof(void*));
+		if (!pages)
+		{
+			perror("realloc error");
+			exit(EXIT_FAILURE);
+		}
+		rebuild->pages = pages;
+	}
+
+	void* page = calloc(1, rebuild->pager->page_size);
+	if (!page)
+	{
+		perror("calloc error");
+		exit(EXIT_FAILURE);
+	}
+	rebuild->pages[rebuild->num_pages] = page;
+	return rebuild->num_pages++;
+}
@@ -0,0 +1,20 @@
+#ifndef VACUUM_H
+#define VACUUM_H
+
+#include <stdint.h>
+
+#include "table.h"
+
+// Rebuilds every tree bottom-up into a fresh, gap-free set of pages. Each tree
+// gets its root first, then its leaves in key order on consecutive pages, then
+// its internal levels. Deleted rows are dropped, except in the catalog, whose
+// keys must not be reused. The key filter is rebuilt from the surviving keys,
+// the free list is emptied and the file is truncated when the database is closed.
+
+#define VACUUM_DEFAULT_FILL_PERCENT 90
+#define VACUUM_MIN_FILL_PERCENT 10
+
+// fill_percent is how full the rebuilt nodes are, leaving room for later inserts
+void table_vacuum(Table* table, uint32_t fill_percent);
+
+#endif // VACUUM_H
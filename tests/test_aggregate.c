@@ -0,0 +1,170 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+#include <unity.h>
+
+#include "aggregate.h"
+#include "parser.h"
+#include "stats.h"
+#include "table.h"
+
+
+static Table* table;
+
+void setUp(void)
+{
+#ifdef _WIN32
+    char temp_path[MAX_PATH];
+    char temp_file_name[MAX_PATH];
+
+    if (!GetTempPathA(MAX_PATH, temp_path))
+    {
+        fprintf(stderr, "GetTempPathA error\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (!GetTempFileNameA(temp_path, "tmpfile", 0, temp_file_name))
+    {
+        fprintf(stderr, "GetTempFileNameA error\n");
+        exit(EXIT_FAILURE);
+    }
+#endif
+
+    table = db_open(temp_file_name);
+}
+
+void tearDown(void)
+{
+    db_close(table);
+}
+
+static void insert(uint64_t id)
+{
+    Statement statement = {0};
+    statement.type = STATEMENT_INSERT;
+    statement.row_to_insert.id = id;
+    sprintf(statement.row_to_insert.username, "user%u", (unsigned)id);
+    sprintf(statement.row_to_insert.email, "user%u@example.com", (unsigned)id);
+    TEST_ASSERT_EQUAL_INT(EXECUTE_SUCCESS, execute_statement(&statement, table));
+}
+
+static void delete(uint64_t id)
+{
+    Statement statement = {0};
+    statement.type = STATEMENT_DELETE;
+    statement.id_to_delete = id;
+    TEST_ASSERT_EQUAL_INT(EXECUTE_SUCCESS, execute_statement(&statement, table));
+}
+
+static void aggregates_empty_table(void)
+{
+    AggregateFunction functions[] = {AGGREGATE_COUNT, AGGREGATE_MIN, AGGREGATE_MAX, AGGREGATE_SUM};
+    TableAggregates result;
+    table_aggregate(table, functions, 4, &result);
+
+    TEST_ASSERT_EQUAL_INT(0, result.count);
+    TEST_ASSERT_EQUAL_INT(0, result.sum);
+    TEST_ASSERT_FALSE(result.has_rows);
+}
+
+static void aggregates_multi_level_tree(void)
+{
+    for (uint64_t id = 500; id >= 1; --id)
+        insert(id * 3);
+    TEST_ASSERT_TRUE(table_depth(table) > 1);
+
+    uint64_t count, sum, key;
+    table_count_and_sum(table, &count, &sum);
+    TEST_ASSERT_EQUAL_INT(500, count);
+    TEST_ASSERT_EQUAL_INT(3 * 500 * 501 / 2, sum);
+    TEST_ASSERT_TRUE(table_min_key(table, &key));
+    TEST_ASSERT_EQUAL_INT(3, key);
+    TEST_ASSERT_TRUE(table_max_key(table, &key));
+    TEST_ASSERT_EQUAL_INT(1500, key);
+}
+
+static void aggregates_skip_deleted_rows(void)
+{
+    for (uint64_t id = 1; id <= 100; ++id)
+        insert(id);
+
+    // empty out the whole rightmost leaf and the first few rows
+    for (uint64_t id = 1; id <= 3; ++id)
+        delete(id);
+    for (uint64_t id = 85; id <= 100; ++id)
+        delete(id);
+
+    AggregateFunction functions[] = {AGGREGATE_MIN, AGGREGATE_MAX, AGGREGATE_COUNT, AGGREGATE_SUM};
+    TableAggregates result;
+    table_aggregate(table, functions, 4, &result);
+
+    TEST_ASSERT_TRUE(result.has_rows);
+    TEST_ASSERT_EQUAL_INT(4, result.min);
+    TEST_ASSERT_EQUAL_INT(84, result.max);
+    TEST_ASSERT_EQUAL_INT(81, result.count);
+    TEST_ASSERT_EQUAL_INT(84 * 85 / 2 - 6, result.sum);
+}
+
+static uint64_t rows_examined(void)
+{
+    uint64_t counters[STAT_COUNTER_COUNT];
+    stats_snapshot_counters(counters);
+    return counters[STAT_ROWS_EXAMINED];
+}
+
+static void count_reads_row_counts_without_a_walk(void)
+{
+    for (uint64_t id = 1; id <= 2000; ++id)
+        insert(id);
+    for (uint64_t id = 1; id <= 2000; id += 7)
+        delete(id);
+    TEST_ASSERT_TRUE(table_depth(table) > 1);
+
+    AggregateFunction functions[] = {AGGREGATE_COUNT};
+    TableAggregates result;
+    uint64_t examined = rows_examined();
+    table_aggregate(table, functions, 1, &result);
+
+    TEST_ASSERT_TRUE(result.has_rows);
+    TEST_ASSERT_EQUAL_INT(2000 - 286, result.count);
+    TEST_ASSERT_EQUAL_INT(examined, rows_examined());
+}
+
+static void max_steps_back_over_deleted_leaves(void)
+{
+    for (uint64_t id = 1; id <= 1000; ++id)
+        insert(id);
+    for (uint64_t id = 700; id <= 1000; ++id)
+        delete(id);
+
+    // only the deleted cells and the live one before them are read
+    uint64_t key;
+    uint64_t examined = rows_examined();
+    TEST_ASSERT_TRUE(table_max_key(table, &key));
+    TEST_ASSERT_EQUAL_INT(699, key);
+    TEST_ASSERT_EQUAL_INT(302, rows_examined() - examined);
+
+    for (uint64_t id = 1; id < 700; ++id)
+        delete(id);
+    TEST_ASSERT_FALSE(table_max_key(table, &key));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(aggregates_empty_table);
+    RUN_TEST(aggregates_multi_level_tree);
+    RUN_TEST(aggregates_skip_deleted_rows);
+    RUN_TEST(count_reads_row_counts_without_a_walk);
+    RUN_TEST(max_steps_back_over_deleted_leaves);
+    return UNITY_END();
+}
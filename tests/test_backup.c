@@ -0,0 +1,279 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+#include <unity.h>
+
+#include "aggregate.h"
+#include "backup.h"
+#include "parser.h"
+#include "table.h"
+#include "vacuum.h"
+
+
+#define NUM_ROWS 500
+
+static Table* table;
+static char db_file_name[512];
+static char backup_file_name[512];
+
+void setUp(void)
+{
+#ifdef _WIN32
+    char temp_path[MAX_PATH];
+    char temp_file_name[MAX_PATH];
+
+    if (!GetTempPathA(MAX_PATH, temp_path))
+    {
+        fprintf(stderr, "GetTempPathA error\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (!GetTempFileNameA(temp_path, "tmpfile", 0, temp_file_name))
+    {
+        fprintf(stderr, "GetTempFileNameA error\n");
+        exit(EXIT_FAILURE);
+    }
+#endif
+
+    strcpy(db_file_name, temp_file_name);
+    sprintf(backup_file_name, "%s.bak", temp_file_name);
+    remove(backup_file_name);
+
+    table = db_open(db_file_name);
+    for (uint64_t id = 1; id <= NUM_ROWS; ++id)
+    {
+        Statement statement = {0};
+        statement.type = STATEMENT_INSERT;
+        statement.row_to_insert.id = id;
+        sprintf(statement.row_to_insert.username, "user%u", (unsigned)id);
+        sprintf(statement.row_to_insert.email, "user%u@example.com", (unsigned)id);
+        execute_statement(&statement, table);
+    }
+}
+
+void tearDown(void)
+{
+    db_close(table);
+    remove(backup_file_name);
+}
+
+static void rename_user(uint64_t id, const char* username)
+{
+    Statement statement = {0};
+    statement.type = STATEMENT_UPDATE;
+    statement.where = (IdFilter){true, COMPARE_EQUAL, id};
+    statement.update_columns = COLUMN_BIT(COLUMN_USERNAME);
+    strcpy(statement.update_values.username, username);
+    TEST_ASSERT_EQUAL_INT(EXECUTE_SUCCESS, execute_statement(&statement, table));
+}
+
+static void delete_user(uint64_t id)
+{
+    Statement statement = {0};
+    statement.type = STATEMENT_DELETE;
+    statement.id_to_delete = id;
+    TEST_ASSERT_EQUAL_INT(EXECUTE_SUCCESS, execute_statement(&statement, table));
+}
+
+// Drops the open database without writing anything back, the way a crash would; its memory is leaked
+static void crash_and_reopen(void)
+{
+    fclose(table->pager->file_ptr);
+    table = db_open(db_file_name);
+}
+
+static long file_size(const char* filename)
+{
+    FILE* file_ptr = fopen(filename, "rb");
+    TEST_ASSERT_NOT_NULL(file_ptr);
+    fseek(file_ptr, 0, SEEK_END);
+    long size = ftell(file_ptr);
+    fclose(file_ptr);
+    return size;
+}
+
+// Flips some of the 64 bits at bytes so the page checksum is back to checksum, which a CRC
+// allows for any edit; false if those bits cannot reach it
+static bool restore_checksum(void* page, uint8_t* bytes, uint32_t checksum)
+{
+    uint32_t page_size = table->pager->page_size;
+    uint32_t current = page_checksum(page, page_size);
+    uint32_t basis[32] = {0};
+    uint64_t combinations[32] = {0};
+
+    // the checksum change of any set of flips is the xor of the changes of its single flips
+    for (uint32_t bit = 0; bit < 64; ++bit)
+    {
+        bytes[bit / 8] ^= 1u << (bit % 8);
+        uint32_t change = page_checksum(page, page_size) ^ current;
+        bytes[bit / 8] ^= 1u << (bit % 8);
+
+        uint64_t combination = 1ull << bit;
+        for (int b = 31; b >= 0 && change; --b)
+        {
+            if (!(change >> b & 1))
+                continue;
+            if (!basis[b])
+            {
+                basis[b] = change;
+                combinations[b] = combination;
+                break;
+            }
+            change ^= basis[b];
+            combination ^= combinations[b];
+        }
+    }
+
+    uint32_t target = current ^ checksum;
+    uint64_t flips = 0;
+    for (int b = 31; b >= 0; --b)
+    {
+        if (!(target >> b & 1))
+            continue;
+        if (!basis[b])
+            return false;
+        target ^= basis[b];
+        flips ^= combinations[b];
+    }
+    for (uint32_t bit = 0; bit < 64; ++bit)
+        if (flips >> bit & 1)
+            bytes[bit / 8] ^= 1u << (bit % 8);
+    return page_checksum(page, page_size) == checksum;
+}
+
+static void assert_backup_user(uint64_t id, const char* username)
+{
+    Table* copy = db_open(backup_file_name);
+    TEST_ASSERT_EQUAL_INT(0, table_check(copy));
+
+    uint64_t count, sum;
+    table_count_and_sum(copy, &count, &sum);
+    TEST_ASSERT_EQUAL_INT(NUM_ROWS, count);
+
+    Row row;
+    Cursor* cursor = table_find(copy, id);
+    cursor_read_row(cursor, &row, ALL_COLUMNS);
+    TEST_ASSERT_EQUAL_STRING(username, row.username);
+    free(cursor);
+    db_close(copy);
+}
+
+static void copies_whole_database(void)
+{
+    uint64_t pages_copied = table_backup(table, backup_file_name);
+    TEST_ASSERT_TRUE(pages_copied == table->pager->num_pages - 1);
+    assert_backup_user(NUM_ROWS, "user500");
+}
+
+static void copies_only_changed_pages(void)
+{
+    table_backup(table, backup_file_name);
+    TEST_ASSERT_TRUE(table_backup(table, backup_file_name) == 0);
+
+    rename_user(7, "seven");
+    TEST_ASSERT_TRUE(table_backup(table, backup_file_name) == 1);
+    assert_backup_user(7, "seven");
+
+    // change counters survive a restart
+    db_close(table);
+    table = db_open(db_file_name);
+    TEST_ASSERT_TRUE(table_backup(table, backup_file_name) == 0);
+    rename_user(NUM_ROWS, "last");
+    TEST_ASSERT_TRUE(table_backup(table, backup_file_name) == 1);
+    assert_backup_user(NUM_ROWS, "last");
+}
+
+static void recopies_pages_changed_during_backup(void)
+{
+    Backup* backup = backup_start(table, backup_file_name);
+    uint64_t num_pages = table->pager->num_pages;
+    while (backup->next_page < num_pages)
+        TEST_ASSERT_FALSE(backup_step(backup, 1));
+
+    rename_user(1, "first");
+    uint64_t pages_copied = backup_finish(backup);
+    TEST_ASSERT_TRUE(pages_copied == num_pages);
+    assert_backup_user(1, "first");
+}
+
+static void recopies_everything_after_a_crash(void)
+{
+    db_close(table);
+    table = db_open(db_file_name);
+    table_backup(table, backup_file_name);
+
+    // the backup gets a change the file never does
+    rename_user(7, "lost");
+    TEST_ASSERT_TRUE(table_backup(table, backup_file_name) == 1);
+    crash_and_reopen();
+
+    // a different change takes the counter back to where the backup stopped
+    rename_user(NUM_ROWS, "last");
+    TEST_ASSERT_TRUE(table_backup(table, backup_file_name) == table->pager->num_pages - 1);
+    assert_backup_user(7, "user7");
+    assert_backup_user(NUM_ROWS, "last");
+}
+
+static void copies_a_change_that_keeps_the_page_checksum(void)
+{
+    table_backup(table, backup_file_name);
+
+    Cursor* cursor = table_find(table, 7);
+    void* page = get_page(table->pager, cursor->page_num);
+    uint32_t checksum = page_checksum(page, table->pager->page_size);
+    rename_user(7, "seven");
+
+    // bits past the end of the email string take the checksum back to the old one
+    uint8_t* spare = (uint8_t*)cursor_value(cursor) + EMAIL_OFFSET + EMAIL_SIZE - 16;
+    TEST_ASSERT_TRUE(restore_checksum(page, spare, checksum));
+    free(cursor);
+
+    TEST_ASSERT_TRUE(table_backup(table, backup_file_name) == 1);
+    assert_backup_user(7, "seven");
+}
+
+static void truncates_a_longer_backup(void)
+{
+    table_backup(table, backup_file_name);
+    long full_size = file_size(backup_file_name);
+
+    for (uint64_t id = 2; id <= NUM_ROWS; ++id)
+        delete_user(id);
+    table_vacuum(table, VACUUM_DEFAULT_FILL_PERCENT);
+    table_backup(table, backup_file_name);
+
+    // the same size as a backup into a new file
+    char fresh_file_name[sizeof(backup_file_name) + 8];
+    sprintf(fresh_file_name, "%s.fresh", backup_file_name);
+    remove(fresh_file_name);
+    table_backup(table, fresh_file_name);
+    TEST_ASSERT_TRUE(file_size(backup_file_name) < full_size);
+    TEST_ASSERT_EQUAL_INT(file_size(fresh_file_name), file_size(backup_file_name));
+    remove(fresh_file_name);
+
+    Table* copy = db_open(backup_file_name);
+    TEST_ASSERT_EQUAL_INT(0, table_check(copy));
+    TEST_ASSERT_EQUAL_INT(1, table_row_count(copy));
+    db_close(copy);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(copies_whole_database);
+    RUN_TEST(copies_only_changed_pages);
+    RUN_TEST(recopies_pages_changed_during_backup);
+    RUN_TEST(recopies_everything_after_a_crash);
+    RUN_TEST(copies_a_change_that_keeps_the_page_checksum);
+    RUN_TEST(truncates_a_longer_backup);
+    return UNITY_END();
+}
@@ -0,0 +1,184 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+#include <unity.h>
+
+#include "batch.h"
+#include "parser.h"
+#include "table.h"
+
+
+#define NUM_ROWS 2500
+
+static Table* table;
+
+void setUp(void)
+{
+#ifdef _WIN32
+    char temp_path[MAX_PATH];
+    char temp_file_name[MAX_PATH];
+
+    if (!GetTempPathA(MAX_PATH, temp_path))
+    {
+        fprintf(stderr, "GetTempPathA error\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (!GetTempFileNameA(temp_path, "tmpfile", 0, temp_file_name))
+    {
+        fprintf(stderr, "GetTempFileNameA error\n");
+        exit(EXIT_FAILURE);
+    }
+#endif
+
+    table = db_open(temp_file_name);
+    for (uint64_t id = 1; id <= NUM_ROWS; ++id)
+    {
+        Statement statement = {0};
+        statement.type = STATEMENT_INSERT;
+        statement.row_to_insert.id = id;
+        sprintf(statement.row_to_insert.username, "user%u", (unsigned)id);
+        sprintf(statement.row_to_insert.email, "user%u@example.com", (unsigned)id);
+        execute_statement(&statement, table);
+    }
+}
+
+void tearDown(void)
+{
+    db_close(table);
+}
+
+static void scans_column_batches(void)
+{
+    RowBatch* batch = batch_new(ALL_COLUMNS);
+    BatchScan scan;
+    batch_scan_start(&scan, table);
+
+    uint32_t num_batches = 0;
+    uint64_t expected_id = 1;
+    while (batch_scan_next(&scan, batch))
+    {
+        TEST_ASSERT_TRUE(batch->num_rows <= BATCH_SIZE);
+        TEST_ASSERT_EQUAL_INT(batch->num_rows, batch->num_selected);
+        for (uint32_t i = 0; i < batch->num_selected; ++i)
+        {
+            uint32_t row = batch->selection[i];
+            char username[COLUMN_USERNAME_SIZE + 1];
+            sprintf(username, "user%u", (unsigned)expected_id);
+            TEST_ASSERT_TRUE(batch->ids[row] == expected_id);
+            TEST_ASSERT_EQUAL_STRING(username, batch->usernames[row]);
+            expected_id++;
+        }
+        num_batches++;
+    }
+
+    TEST_ASSERT_EQUAL_INT(3, num_batches);
+    TEST_ASSERT_TRUE(expected_id == NUM_ROWS + 1);
+    batch_free(batch);
+}
+
+static void filters_and_aggregates_batches(void)
+{
+    Statement statement = {0};
+    statement.type = STATEMENT_DELETE;
+    statement.id_to_delete = 2000;
+    execute_statement(&statement, table);
+
+    IdFilter filter = {true, COMPARE_GREATER, 1000};
+    RowBatch* batch = batch_new(0);
+    TEST_ASSERT_NULL(batch->usernames);
+    TableAggregates aggregates = {0};
+    BatchScan scan;
+    batch_scan_start(&scan, table);
+
+    while (batch_scan_next(&scan, batch))
+    {
+        batch_filter(batch, &filter);
+        batch_aggregate(batch, &aggregates);
+    }
+
+    TEST_ASSERT_TRUE(aggregates.has_rows);
+    TEST_ASSERT_EQUAL_INT(NUM_ROWS - 1000 - 1, aggregates.count);
+    TEST_ASSERT_EQUAL_INT(1001, aggregates.min);
+    TEST_ASSERT_EQUAL_INT(NUM_ROWS, aggregates.max);
+    TEST_ASSERT_TRUE(aggregates.sum == (uint64_t)NUM_ROWS * (NUM_ROWS + 1) / 2 - 1000 * 1001 / 2 - 2000);
+    batch_free(batch);
+}
+
+static void scans_key_ranges(void)
+{
+    RowBatch* batch = batch_new(0);
+    BatchScan scan;
+    uint64_t first_key, last_key;
+
+    IdFilter filter = {true, COMPARE_LESS_EQUAL, 1500};
+    TEST_ASSERT_TRUE(id_filter_range(&filter, &first_key, &last_key));
+    batch_scan_start_range(&scan, table, 1000, 1500);
+    uint64_t expected_id = 1000;
+    while (batch_scan_next(&scan, batch))
+        for (uint32_t i = 0; i < batch->num_selected; ++i)
+            TEST_ASSERT_TRUE(batch->ids[batch->selection[i]] == expected_id++);
+    TEST_ASSERT_TRUE(expected_id == 1501);
+
+    // starting past the last key yields nothing
+    batch_scan_start_range(&scan, table, NUM_ROWS + 1, UINT64_MAX);
+    TEST_ASSERT_FALSE(batch_scan_next(&scan, batch));
+
+    filter.op = COMPARE_LESS;
+    filter.value = 0;
+    TEST_ASSERT_FALSE(id_filter_range(&filter, &first_key, &last_key));
+    filter.op = COMPARE_GREATER;
+    filter.value = 7;
+    TEST_ASSERT_TRUE(id_filter_range(&filter, &first_key, &last_key));
+    TEST_ASSERT_TRUE(first_key == 8 && last_key == UINT64_MAX);
+    batch_free(batch);
+}
+
+static void filters_every_operator(void)
+{
+    static const uint32_t expected[] = {
+        [COMPARE_EQUAL] = 1,
+        [COMPARE_NOT_EQUAL] = NUM_ROWS - 1,
+        [COMPARE_LESS] = 9,
+        [COMPARE_LESS_EQUAL] = 10,
+        [COMPARE_GREATER] = NUM_ROWS - 10,
+        [COMPARE_GREATER_EQUAL] = NUM_ROWS - 9,
+    };
+
+    RowBatch* batch = batch_new(COLUMN_BIT(COLUMN_ID));
+    for (CompareOperator op = COMPARE_EQUAL; op <= COMPARE_GREATER_EQUAL; ++op)
+    {
+        IdFilter filter = {true, op, 10};
+        uint32_t selected = 0;
+        BatchScan scan;
+        batch_scan_start(&scan, table);
+        while (batch_scan_next(&scan, batch))
+        {
+            batch_filter(batch, &filter);
+            for (uint32_t i = 0; i < batch->num_selected; ++i)
+                TEST_ASSERT_TRUE(id_filter_matches(&filter, batch->ids[batch->selection[i]]));
+            selected += batch->num_selected;
+        }
+        TEST_ASSERT_EQUAL_INT(expected[op], selected);
+    }
+    batch_free(batch);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(scans_column_batches);
+    RUN_TEST(filters_and_aggregates_batches);
+    RUN_TEST(scans_key_ranges);
+    RUN_TEST(filters_every_operator);
+    return UNITY_END();
+}
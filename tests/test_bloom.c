@@ -0,0 +1,211 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+#include <unity.h>
+
+#include "bloom.h"
+#include "parser.h"
+#include "stats.h"
+#include "table.h"
+#include "vacuum.h"
+
+
+#define NUM_KEYS 100000
+#define NUM_ROWS 1000
+
+static Table* table;
+static char db_file_name[512];
+
+void setUp(void)
+{
+#ifdef _WIN32
+    char temp_path[MAX_PATH];
+    char temp_file_name[MAX_PATH];
+
+    if (!GetTempPathA(MAX_PATH, temp_path))
+    {
+        fprintf(stderr, "GetTempPathA error\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (!GetTempFileNameA(temp_path, "tmpfile", 0, temp_file_name))
+    {
+        fprintf(stderr, "GetTempFileNameA error\n");
+        exit(EXIT_FAILURE);
+    }
+#endif
+
+    strcpy(db_file_name, temp_file_name);
+    table = db_open(db_file_name);
+}
+
+void tearDown(void)
+{
+    db_close(table);
+}
+
+static ExecuteResult execute(Statement* statement)
+{
+    return execute_statement(statement, table);
+}
+
+static void insert(uint64_t id)
+{
+    Statement statement = {0};
+    statement.type = STATEMENT_INSERT;
+    statement.row_to_insert.id = id;
+    sprintf(statement.row_to_insert.username, "user%u", (unsigned)id);
+    sprintf(statement.row_to_insert.email, "user%u@example.com", (unsigned)id);
+    TEST_ASSERT_EQUAL_INT(EXECUTE_SUCCESS, execute(&statement));
+}
+
+static uint64_t pages_touched(void)
+{
+    uint64_t counters[STAT_COUNTER_COUNT];
+    stats_snapshot_counters(counters);
+    return counters[STAT_PAGE_HITS] + counters[STAT_PAGE_MISSES];
+}
+
+static void has_no_false_negatives_and_few_false_positives(void)
+{
+    BloomFilter filter;
+    bloom_init(&filter, 0);
+    for (uint64_t key = 0; key < NUM_KEYS; ++key)
+        bloom_add(&filter, bloom_hash(1, key * 2));
+
+    // the first layer fills up, so later keys land in bigger ones
+    TEST_ASSERT_TRUE(filter.num_layers > 1);
+    for (uint64_t key = 0; key < NUM_KEYS; ++key)
+        TEST_ASSERT_TRUE(bloom_may_contain(&filter, bloom_hash(1, key * 2)));
+
+    uint32_t false_positives = 0;
+    for (uint64_t key = 0; key < NUM_KEYS; ++key)
+    {
+        false_positives += bloom_may_contain(&filter, bloom_hash(1, key * 2 + 1));
+        false_positives += bloom_may_contain(&filter, bloom_hash(2, key * 2));
+    }
+    TEST_ASSERT_TRUE(false_positives < 2 * NUM_KEYS / 100);
+
+    bloom_free(&filter);
+}
+
+static void round_trips_through_serialization(void)
+{
+    BloomFilter filter;
+    bloom_init(&filter, 0);
+    for (uint64_t key = 0; key < NUM_KEYS; ++key)
+        bloom_add(&filter, bloom_hash(1, key));
+
+    size_t size = bloom_serialized_size(&filter);
+    void* buffer = malloc(size);
+    bloom_serialize(&filter, buffer);
+
+    BloomFilter copy;
+    TEST_ASSERT_TRUE(bloom_deserialize(&copy, buffer, size));
+    TEST_ASSERT_EQUAL_UINT32(filter.num_layers, copy.num_layers);
+    for (uint64_t key = 0; key < NUM_KEYS; ++key)
+        TEST_ASSERT_TRUE(bloom_may_contain(&copy, bloom_hash(1, key)));
+    bloom_free(&copy);
+
+    // a truncated filter cannot rule anything out
+    TEST_ASSERT_FALSE(bloom_deserialize(&copy, buffer, size - 1));
+    TEST_ASSERT_FALSE(copy.valid);
+    TEST_ASSERT_TRUE(bloom_may_contain(&copy, bloom_hash(3, 0)));
+    TEST_ASSERT_EQUAL_UINT64(0, bloom_serialized_size(&copy));
+
+    free(buffer);
+    bloom_free(&filter);
+}
+
+static void skips_the_tree_for_missing_keys(void)
+{
+    for (int compressed = 0; compressed <= 1; ++compressed)
+    {
+        db_close(table);
+        remove(db_file_name);
+        DbOptions options = {0};
+        options.compress_pages = compressed;
+        table = db_open_with_options(db_file_name, &options);
+
+        for (uint64_t id = 1; id <= NUM_ROWS; id += 2)
+            insert(id);
+        db_close(table);
+        table = db_open(db_file_name);
+
+        for (uint64_t id = 1; id <= NUM_ROWS; id += 2)
+            TEST_ASSERT_TRUE(table_may_contain(table, id));
+
+        uint32_t false_positives = 0;
+        for (uint64_t id = 2; id <= NUM_ROWS; id += 2)
+            false_positives += table_may_contain(table, id);
+        TEST_ASSERT_TRUE(false_positives < NUM_ROWS / 100);
+
+        // absent ids are refused without reading a page
+        uint64_t id = 2;
+        while (table_may_contain(table, id))
+            id += 2;
+        uint64_t touched = pages_touched();
+
+        Statement statement = {0};
+        statement.type = STATEMENT_DELETE;
+        statement.id_to_delete = id;
+        TEST_ASSERT_EQUAL_INT(EXECUTE_ID_NOT_FOUND, execute(&statement));
+
+        statement = (Statement){0};
+        statement.type = STATEMENT_UPDATE;
+        statement.where = (IdFilter){true, COMPARE_EQUAL, id};
+        statement.update_columns = COLUMN_BIT(COLUMN_USERNAME);
+        TEST_ASSERT_EQUAL_INT(EXECUTE_ID_NOT_FOUND, execute(&statement));
+        TEST_ASSERT_TRUE(pages_touched() == touched);
+
+        insert(id);
+        TEST_ASSERT_TRUE(table_may_contain(table, id));
+    }
+}
+
+static void is_rebuilt_by_vacuum(void)
+{
+    for (uint64_t id = 1; id <= NUM_ROWS; ++id)
+        insert(id);
+
+    // a database written without the filter has to search the tree for every key
+    bloom_invalidate(&table->pager->key_filter);
+    db_close(table);
+    table = db_open(db_file_name);
+    TEST_ASSERT_FALSE(table->pager->key_filter.valid);
+    TEST_ASSERT_TRUE(table_may_contain(table, NUM_ROWS + 1));
+
+    Statement statement = {0};
+    statement.type = STATEMENT_DELETE;
+    statement.id_to_delete = 1;
+    TEST_ASSERT_EQUAL_INT(EXECUTE_SUCCESS, execute(&statement));
+
+    table_vacuum(table, 100);
+    TEST_ASSERT_TRUE(table->pager->key_filter.valid);
+    TEST_ASSERT_EQUAL_INT(0, table_check(table));
+    for (uint64_t id = 2; id <= NUM_ROWS; ++id)
+        TEST_ASSERT_TRUE(table_may_contain(table, id));
+
+    // the deleted row's key is gone with it, so the id can be reused
+    insert(1);
+    TEST_ASSERT_TRUE(table_may_contain(table, 1));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(has_no_false_negatives_and_few_false_positives);
+    RUN_TEST(round_trips_through_serialization);
+    RUN_TEST(skips_the_tree_for_missing_keys);
+    RUN_TEST(is_rebuilt_by_vacuum);
+    return UNITY_END();
+}
@@ -0,0 +1,134 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+#include <unity.h>
+
+#include "catalog.h"
+#include "parser.h"
+#include "table.h"
+
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+static ExecuteResult insert_into(Table* table, const char* name, uint64_t id)
+{
+    Statement statement = {0};
+    statement.type = STATEMENT_INSERT;
+    strcpy(statement.table_name, name);
+    statement.row_to_insert.id = id;
+    sprintf(statement.row_to_insert.username, "user%u", (unsigned)id);
+    sprintf(statement.row_to_insert.email, "user%u@example.com", (unsigned)id);
+    return execute_statement(&statement, table);
+}
+
+static void creates_and_persists_tables(void)
+{
+#ifdef _WIN32
+    char temp_path[MAX_PATH];
+    char temp_file_name[MAX_PATH];
+
+    if (!GetTempPathA(MAX_PATH, temp_path))
+    {
+        fprintf(stderr, "GetTempPathA error\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (!GetTempFileNameA(temp_path, "tmpfile", 0, temp_file_name))
+    {
+        fprintf(stderr, "GetTempFileNameA error\n");
+        exit(EXIT_FAILURE);
+    }
+#endif
+
+    Table* table = db_open(temp_file_name);
+    TEST_ASSERT_TRUE(catalog_create_table(table, "users"));
+    TEST_ASSERT_TRUE(catalog_create_table(table, "orders"));
+    TEST_ASSERT_FALSE(catalog_create_table(table, "users"));
+
+    for (uint64_t id = 1; id <= 50; ++id)
+        TEST_ASSERT_EQUAL_INT(EXECUTE_SUCCESS, insert_into(table, "users", id));
+    TEST_ASSERT_EQUAL_INT(EXECUTE_SUCCESS, insert_into(table, "orders", 7));
+    TEST_ASSERT_EQUAL_INT(EXECUTE_TABLE_NOT_FOUND, insert_into(table, "missing", 1));
+    db_close(table);
+
+    table = db_open(temp_file_name);
+    TEST_ASSERT_EQUAL_INT(0, table_check(table));
+
+    CatalogEntry* entries;
+    TEST_ASSERT_EQUAL_INT(2, catalog_list_tables(table, &entries));
+    TEST_ASSERT_EQUAL_STRING("users", entries[0].name);
+    TEST_ASSERT_EQUAL_STRING("orders", entries[1].name);
+    free(entries);
+
+    Table users;
+    TEST_ASSERT_TRUE(catalog_find_table(table, "users", &users));
+    TEST_ASSERT_EQUAL_INT(NODE_INTERNAL, get_node_type(get_page(table->pager, users.root_page_num)));
+
+    // the default table stays empty
+    TEST_ASSERT_EQUAL_INT(0, *leaf_node_num_cells(get_page(table->pager, table->root_page_num)));
+    db_close(table);
+}
+
+static void reuses_pages_of_dropped_tables(void)
+{
+#ifdef _WIN32
+    char temp_path[MAX_PATH];
+    char temp_file_name[MAX_PATH];
+
+    if (!GetTempPathA(MAX_PATH, temp_path))
+    {
+        fprintf(stderr, "GetTempPathA error\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (!GetTempFileNameA(temp_path, "tmpfile", 0, temp_file_name))
+    {
+        fprintf(stderr, "GetTempFileNameA error\n");
+        exit(EXIT_FAILURE);
+    }
+#endif
+
+    Table* table = db_open(temp_file_name);
+    TEST_ASSERT_TRUE(catalog_create_table(table, "scratch"));
+    for (uint64_t id = 1; id <= 100; ++id)
+        insert_into(table, "scratch", id);
+    uint64_t num_pages = table->pager->num_pages;
+
+    TEST_ASSERT_TRUE(catalog_drop_table(table, "scratch"));
+    TEST_ASSERT_FALSE(catalog_drop_table(table, "scratch"));
+    TEST_ASSERT_NOT_EQUAL(0, table->pager->free_page_head);
+    TEST_ASSERT_EQUAL_INT(0, table_check(table));
+
+    TEST_ASSERT_TRUE(catalog_create_table(table, "scratch"));
+    for (uint64_t id = 1; id <= 100; ++id)
+        insert_into(table, "scratch", id);
+    TEST_ASSERT_EQUAL_INT(num_pages, table->pager->num_pages);
+    db_close(table);
+
+    table = db_open(temp_file_name);
+    TEST_ASSERT_EQUAL_INT(0, table_check(table));
+    db_close(table);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(creates_and_persists_tables);
+    RUN_TEST(reuses_pages_of_dropped_tables);
+    return UNITY_END();
+}
@@ -0,0 +1,153 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+#include <unity.h>
+
+#include "checksum.h"
+#include "parser.h"
+#include "table.h"
+
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+static void computes_known_crc32c_values(void)
+{
+    uint8_t zeros[32] = {0};
+    uint8_t ones[32];
+    memset(ones, 0xFF, sizeof(ones));
+
+    TEST_ASSERT_EQUAL_INT(0, crc32c("", 0));
+    TEST_ASSERT_EQUAL_INT(0xE3069283, crc32c("123456789", 9));
+    TEST_ASSERT_EQUAL_INT(0x8A9136AA, crc32c(zeros, sizeof(zeros)));
+    TEST_ASSERT_EQUAL_INT(0x62A8AB43, crc32c(ones, sizeof(ones)));
+}
+
+static void detects_corrupt_page(void)
+{
+#ifdef _WIN32
+    char temp_path[MAX_PATH];
+    char temp_file_name[MAX_PATH];
+
+    if (!GetTempPathA(MAX_PATH, temp_path))
+    {
+        fprintf(stderr, "GetTempPathA error\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (!GetTempFileNameA(temp_path, "tmpfile", 0, temp_file_name))
+    {
+        fprintf(stderr, "GetTempFileNameA error\n");
+        exit(EXIT_FAILURE);
+    }
+#endif
+
+    Table* table = db_open(temp_file_name);
+    Statement statement = {0};
+    statement.type = STATEMENT_INSERT;
+    statement.row_to_insert.id = 1;
+    strcpy(statement.row_to_insert.username, "foo");
+    strcpy(statement.row_to_insert.email, "foo@example.com");
+    execute_statement(&statement, table);
+    db_close(table);
+
+    table = db_open(temp_file_name);
+    TEST_ASSERT_EQUAL_INT(0, table_check(table));
+
+    uint8_t byte;
+    fseek(table->pager->file_ptr, table->root_page_num * DEFAULT_PAGE_SIZE + LEAF_NODE_HEADER_SIZE + 8, SEEK_SET);
+    fread(&byte, 1, 1, table->pager->file_ptr);
+    byte ^= 0x01;
+    fseek(table->pager->file_ptr, table->root_page_num * DEFAULT_PAGE_SIZE + LEAF_NODE_HEADER_SIZE + 8, SEEK_SET);
+    fwrite(&byte, 1, 1, table->pager->file_ptr);
+    fflush(table->pager->file_ptr);
+
+    // the check reads the page without caching it, and a statement that needs it fails instead of exiting
+    TEST_ASSERT_EQUAL_INT(1, table_check(table));
+    TEST_ASSERT_NULL(table->pager->pages[table->root_page_num]);
+    statement.type = STATEMENT_SELECT;
+    TEST_ASSERT_EQUAL_INT(EXECUTE_CORRUPT_PAGE, execute_statement(&statement, table));
+    TEST_ASSERT_EQUAL_INT(table->root_page_num, table->pager->corrupt_page_num);
+    TEST_ASSERT_EQUAL_INT(1, table_check(table));
+    db_close(table);
+}
+
+static void parallel_check_finds_the_same_problems(void)
+{
+#ifdef _WIN32
+    char temp_path[MAX_PATH];
+    char temp_file_name[MAX_PATH];
+
+    if (!GetTempPathA(MAX_PATH, temp_path))
+    {
+        fprintf(stderr, "GetTempPathA error\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (!GetTempFileNameA(temp_path, "tmpfile", 0, temp_file_name))
+    {
+        fprintf(stderr, "GetTempFileNameA error\n");
+        exit(EXIT_FAILURE);
+    }
+#endif
+
+    Table* table = db_open(temp_file_name);
+    Statement statement = {0};
+    statement.type = STATEMENT_INSERT;
+    for (uint64_t id = 1; id <= 20000; ++id)
+    {
+        statement.row_to_insert.id = id;
+        sprintf(statement.row_to_insert.username, "user%u", (unsigned)id);
+        strcpy(statement.row_to_insert.email, "user@example.com");
+        execute_statement(&statement, table);
+    }
+    TEST_ASSERT_TRUE(table_depth(table) >= 3);
+    TEST_ASSERT_EQUAL_INT(0, table_parallel_check(table, 1));
+    TEST_ASSERT_EQUAL_INT(0, table_parallel_check(table, 8));
+
+    // every seventh leaf skips its neighbour, so some of the broken links cross from one worker's run to the next
+    uint32_t broken_links = 0;
+    Cursor* cursor = table_start(table);
+    uint64_t page_num = cursor->page_num;
+    free(cursor);
+    for (uint32_t i = 0; page_num != 0; ++i)
+    {
+        uint64_t* next_leaf = leaf_node_next_leaf(get_page(table->pager, page_num));
+        uint64_t skipped = *next_leaf != 0 ? *leaf_node_next_leaf(get_page(table->pager, *next_leaf)) : 0;
+        if (i % 7 == 0 && skipped != 0)
+        {
+            *next_leaf = skipped;
+            broken_links++;
+        }
+        page_num = *next_leaf;
+    }
+    TEST_ASSERT_TRUE(broken_links > 100);
+
+    TEST_ASSERT_EQUAL_INT(broken_links, table_parallel_check(table, 1));
+    TEST_ASSERT_EQUAL_INT(broken_links, table_parallel_check(table, 3));
+    TEST_ASSERT_EQUAL_INT(broken_links, table_parallel_check(table, MAX_CHECK_THREADS));
+    db_close(table);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(computes_known_crc32c_values);
+    RUN_TEST(detects_corrupt_page);
+    RUN_TEST(parallel_check_finds_the_same_problems);
+    return UNITY_END();
+}
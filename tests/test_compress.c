@@ -0,0 +1,133 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+#include <unity.h>
+
+#include "compress.h"
+#include "parser.h"
+#include "table.h"
+
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+static void compresses_zero_page(void)
+{
+    uint8_t page[DEFAULT_PAGE_SIZE] = {0};
+    uint8_t compressed[COMPRESSED_PAGE_MAX_SIZE(DEFAULT_PAGE_SIZE)];
+    uint8_t decompressed[DEFAULT_PAGE_SIZE];
+
+    size_t length = page_compress(page, DEFAULT_PAGE_SIZE, compressed);
+
+    TEST_ASSERT_EQUAL_INT(2 * DEFAULT_PAGE_SIZE / 128, length);
+    TEST_ASSERT_NOT_EQUAL_INT(0, page_decompress(compressed, length, decompressed, DEFAULT_PAGE_SIZE));
+    TEST_ASSERT_EQUAL_INT(0, memcmp(page, decompressed, DEFAULT_PAGE_SIZE));
+}
+
+static void round_trips_mixed_page(void)
+{
+    uint8_t page[DEFAULT_PAGE_SIZE];
+    uint8_t compressed[COMPRESSED_PAGE_MAX_SIZE(DEFAULT_PAGE_SIZE)];
+    uint8_t decompressed[DEFAULT_PAGE_SIZE];
+
+    srand(42);
+    for (uint32_t i = 0; i < DEFAULT_PAGE_SIZE; ++i)
+        page[i] = (i / 300) % 2 ? 0 : (uint8_t)rand();
+
+    size_t length = page_compress(page, DEFAULT_PAGE_SIZE, compressed);
+
+    TEST_ASSERT_NOT_EQUAL_INT(0, page_decompress(compressed, length, decompressed, DEFAULT_PAGE_SIZE));
+    TEST_ASSERT_EQUAL_INT(0, memcmp(page, decompressed, DEFAULT_PAGE_SIZE));
+}
+
+static void rejects_truncated_input(void)
+{
+    uint8_t page[DEFAULT_PAGE_SIZE] = {0};
+    uint8_t compressed[COMPRESSED_PAGE_MAX_SIZE(DEFAULT_PAGE_SIZE)];
+    uint8_t decompressed[DEFAULT_PAGE_SIZE];
+
+    size_t length = page_compress(page, DEFAULT_PAGE_SIZE, compressed);
+
+    TEST_ASSERT_EQUAL_INT(0, page_decompress(compressed, length - 1, decompressed, DEFAULT_PAGE_SIZE));
+}
+
+static void reopens_compressed_table(void)
+{
+#ifdef _WIN32
+    char temp_path[MAX_PATH];
+    char temp_file_name[MAX_PATH];
+
+    if (!GetTempPathA(MAX_PATH, temp_path))
+    {
+        fprintf(stderr, "GetTempPathA error\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (!GetTempFileNameA(temp_path, "tmpfile", 0, temp_file_name))
+    {
+        fprintf(stderr, "GetTempFileNameA error\n");
+        exit(EXIT_FAILURE);
+    }
+#endif
+
+    DbOptions options = {0};
+    options.compress_pages = true;
+    Table* table = db_open_with_options(temp_file_name, &options);
+
+    for (uint32_t i = 1; i <= 10; ++i)
+    {
+        Statement statement = {0};
+        statement.type = STATEMENT_INSERT;
+        statement.row_to_insert.id = i;
+        strcpy(statement.row_to_insert.username, "user");
+        strcpy(statement.row_to_insert.email, "user@example.com");
+        TEST_ASSERT_EQUAL_INT(EXECUTE_SUCCESS, execute_statement(&statement, table));
+    }
+    db_close(table);
+
+    table = db_open(temp_file_name);
+    TEST_ASSERT_NOT_EQUAL_INT(0, table->pager->compressed);
+    // the file header page is stored uncompressed
+    TEST_ASSERT_LESS_THAN(DEFAULT_PAGE_SIZE + DEFAULT_PAGE_SIZE / 2, table->pager->file_length);
+    TEST_ASSERT_EQUAL_INT(0, table_check(table));
+
+    Cursor* cursor = table_start(table);
+    uint32_t rows = 0;
+    while (!cursor->end_of_table)
+    {
+        Row row;
+        deserialize_row(cursor_value(cursor), &row);
+        TEST_ASSERT_EQUAL_INT(rows + 1, row.id);
+        TEST_ASSERT_EQUAL_STRING("user@example.com", row.email);
+        rows++;
+        cursor_advance(cursor);
+    }
+    TEST_ASSERT_EQUAL_INT(10, rows);
+
+    free(cursor);
+    db_close(table);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(compresses_zero_page);
+    RUN_TEST(round_trips_mixed_page);
+    RUN_TEST(rejects_truncated_input);
+    RUN_TEST(reopens_compressed_table);
+    return UNITY_END();
+}
@@ -0,0 +1,176 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+#include <unity.h>
+
+#include "catalog.h"
+#include "parser.h"
+#include "stats.h"
+#include "table.h"
+
+
+#define NUM_ROWS 2000
+
+static Table* table;
+
+void setUp(void)
+{
+#ifdef _WIN32
+    char temp_path[MAX_PATH];
+    char temp_file_name[MAX_PATH];
+
+    if (!GetTempPathA(MAX_PATH, temp_path))
+    {
+        fprintf(stderr, "GetTempPathA error\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (!GetTempFileNameA(temp_path, "tmpfile", 0, temp_file_name))
+    {
+        fprintf(stderr, "GetTempFileNameA error\n");
+        exit(EXIT_FAILURE);
+    }
+#endif
+
+    table = db_open(temp_file_name);
+}
+
+void tearDown(void)
+{
+    db_close(table);
+}
+
+static void insert(const char* table_name, uint64_t id)
+{
+    Statement statement = {0};
+    statement.type = STATEMENT_INSERT;
+    statement.row_to_insert.id = id;
+    sprintf(statement.row_to_insert.username, "user%u", (unsigned)id);
+    sprintf(statement.row_to_insert.email, "user%u@example.com", (unsigned)id);
+    strcpy(statement.table_name, table_name);
+    TEST_ASSERT_EQUAL_INT(EXECUTE_SUCCESS, execute_statement(&statement, table));
+}
+
+static uint64_t hash_index_hits(void)
+{
+    uint64_t counters[STAT_COUNTER_COUNT];
+    stats_snapshot_counters(counters);
+    return counters[STAT_HASH_INDEX_HITS];
+}
+
+// Returns whether the lookup was answered by the hash index
+static bool find(Table* tree, uint64_t key)
+{
+    uint64_t hits = hash_index_hits();
+    Cursor* cursor = table_find(tree, key);
+    Cursor* expected = table_descend(tree, key);
+    TEST_ASSERT_TRUE(cursor->page_num == expected->page_num);
+    TEST_ASSERT_EQUAL_UINT32(expected->cell_num, cursor->cell_num);
+    free(cursor);
+    free(expected);
+    return hash_index_hits() > hits;
+}
+
+static uint64_t num_entries(void)
+{
+    HashIndex* index = &table->pager->hash_index;
+    uint64_t count = 0;
+    for (uint64_t i = 0; i < hash_index_capacity(index); ++i)
+        count += index->entries[i].page_num != 0;
+    return count;
+}
+
+static void answers_repeated_lookups_from_the_index(void)
+{
+    for (uint64_t id = 1; id <= NUM_ROWS; ++id)
+        insert("", id);
+
+    TEST_ASSERT_FALSE(find(table, 500));
+    TEST_ASSERT_TRUE(find(table, 500));
+
+    // keys that are not in the tree are never remembered
+    TEST_ASSERT_FALSE(find(table, NUM_ROWS + 1));
+    TEST_ASSERT_FALSE(find(table, NUM_ROWS + 1));
+}
+
+static void follows_cells_moved_by_inserts_and_splits(void)
+{
+    for (uint64_t id = 1; id <= NUM_ROWS; id += 2)
+        insert("", id);
+    for (uint64_t id = 1; id <= NUM_ROWS; id += 2)
+        find(table, id);
+
+    // every leaf shifts and splits while the even keys go in between
+    for (uint64_t id = 2; id <= NUM_ROWS; id += 2)
+        insert("", id);
+
+    uint32_t hits = 0;
+    for (uint64_t id = 1; id <= NUM_ROWS; id += 2)
+        hits += find(table, id);
+    TEST_ASSERT_TRUE(hits > NUM_ROWS / 2 * 9 / 10);
+}
+
+static void keeps_hot_keys_through_one_off_lookups(void)
+{
+    hash_index_free(&table->pager->hash_index);
+    hash_index_init(&table->pager->hash_index, 256);
+    TEST_ASSERT_TRUE(hash_index_capacity(&table->pager->hash_index) == 256);
+
+    for (uint64_t id = 1; id <= NUM_ROWS; ++id)
+        insert("", id);
+    for (uint32_t round = 0; round < 10; ++round)
+        for (uint64_t id = 100; id <= 800; id += 100)
+            find(table, id);
+
+    for (uint64_t id = 1; id <= NUM_ROWS; ++id)
+        if (id % 100 != 0)
+            find(table, id);
+    TEST_ASSERT_TRUE(num_entries() <= 256);
+
+    for (uint64_t id = 100; id <= 800; id += 100)
+        TEST_ASSERT_TRUE(find(table, id));
+}
+
+static void forgets_pages_that_leave_a_tree(void)
+{
+    Statement statement = {0};
+    statement.type = STATEMENT_CREATE_TABLE;
+    strcpy(statement.table_name, "dropped");
+    TEST_ASSERT_EQUAL_INT(EXECUTE_SUCCESS, execute_statement(&statement, table));
+
+    Table dropped;
+    TEST_ASSERT_TRUE(catalog_find_table(table, "dropped", &dropped));
+    for (uint64_t id = 1; id <= NUM_ROWS; ++id)
+        insert("dropped", id);
+    find(&dropped, 1);
+    TEST_ASSERT_TRUE(find(&dropped, 1));
+
+    statement.type = STATEMENT_DROP_TABLE;
+    TEST_ASSERT_EQUAL_INT(EXECUTE_SUCCESS, execute_statement(&statement, table));
+    TEST_ASSERT_TRUE(num_entries() == 0);
+
+    // the freed pages go to the default table, which must not see the dropped rows
+    for (uint64_t id = NUM_ROWS; id >= 1; --id)
+        insert("", id);
+    TEST_ASSERT_FALSE(find(table, 1));
+    TEST_ASSERT_EQUAL_INT(0, table_check(table));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(answers_repeated_lookups_from_the_index);
+    RUN_TEST(follows_cells_moved_by_inserts_and_splits);
+    RUN_TEST(keeps_hot_keys_through_one_off_lookups);
+    RUN_TEST(forgets_pages_that_leave_a_tree);
+    return UNITY_END();
+}
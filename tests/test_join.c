@@ -0,0 +1,216 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+#include <unity.h>
+
+#include "catalog.h"
+#include "join.h"
+#include "parser.h"
+#include "stats.h"
+#include "table.h"
+
+
+#define NUM_LEFT_ROWS 3000
+#define NUM_RIGHT_ROWS 2000
+
+static Table* table;
+static Table left;
+static Table right;
+
+typedef struct
+{
+    Column left_column;
+    Column right_column;
+    uint64_t num_pairs;
+    uint64_t checksum;
+} JoinResult;
+
+static void left_name(uint64_t id, char* name)
+{
+    sprintf(name, "name%u", (unsigned)(id % 500));
+}
+
+static void right_name(uint64_t id, char* name)
+{
+    sprintf(name, "name%u", (unsigned)(id % 700));
+}
+
+static void insert_into(const char* name, uint64_t id, const char* username)
+{
+    Statement statement = {0};
+    statement.type = STATEMENT_INSERT;
+    strcpy(statement.table_name, name);
+    statement.row_to_insert.id = id;
+    strcpy(statement.row_to_insert.username, username);
+    sprintf(statement.row_to_insert.email, "%s@example.com", username);
+    TEST_ASSERT_EQUAL_INT(EXECUTE_SUCCESS, execute_statement(&statement, table));
+}
+
+void setUp(void)
+{
+#ifdef _WIN32
+    char temp_path[MAX_PATH];
+    char temp_file_name[MAX_PATH];
+
+    if (!GetTempPathA(MAX_PATH, temp_path))
+    {
+        fprintf(stderr, "GetTempPathA error\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (!GetTempFileNameA(temp_path, "tmpfile", 0, temp_file_name))
+    {
+        fprintf(stderr, "GetTempFileNameA error\n");
+        exit(EXIT_FAILURE);
+    }
+#endif
+
+    table = db_open(temp_file_name);
+    TEST_ASSERT_TRUE(catalog_create_table(table, "left_side"));
+    TEST_ASSERT_TRUE(catalog_create_table(table, "right_side"));
+
+    char name[COLUMN_USERNAME_SIZE + 1];
+    for (uint64_t id = 1; id <= NUM_LEFT_ROWS; ++id)
+    {
+        left_name(id, name);
+        insert_into("left_side", id, name);
+    }
+    // every third id, so the index join finds gaps
+    for (uint64_t id = 3; id <= 3 * NUM_RIGHT_ROWS; id += 3)
+    {
+        right_name(id, name);
+        insert_into("right_side", id, name);
+    }
+    TEST_ASSERT_TRUE(catalog_find_table(table, "left_side", &left));
+    TEST_ASSERT_TRUE(catalog_find_table(table, "right_side", &right));
+}
+
+void tearDown(void)
+{
+    join_set_memory_limit(JOIN_DEFAULT_MEMORY);
+    db_close(table);
+}
+
+static void collect_pair(const Row* left_row, const Row* right_row, void* context)
+{
+    JoinResult* result = context;
+    if (result->left_column == COLUMN_ID)
+        TEST_ASSERT_TRUE(left_row->id == right_row->id);
+    else
+        TEST_ASSERT_EQUAL_STRING(left_row->username, right_row->username);
+    result->num_pairs++;
+    result->checksum += left_row->id * 7919 + right_row->id;
+}
+
+static JoinResult reference_name_join(void)
+{
+    JoinResult result = {COLUMN_USERNAME, COLUMN_USERNAME, 0, 0};
+    char left_value[COLUMN_USERNAME_SIZE + 1], right_value[COLUMN_USERNAME_SIZE + 1];
+    for (uint64_t left_id = 1; left_id <= NUM_LEFT_ROWS; ++left_id)
+    {
+        left_name(left_id, left_value);
+        for (uint64_t right_id = 3; right_id <= 3 * NUM_RIGHT_ROWS; right_id += 3)
+        {
+            right_name(right_id, right_value);
+            if (strcmp(left_value, right_value) == 0)
+            {
+                result.num_pairs++;
+                result.checksum += left_id * 7919 + right_id;
+            }
+        }
+    }
+    return result;
+}
+
+static uint64_t join_partitions(void)
+{
+    uint64_t counters[STAT_COUNTER_COUNT];
+    stats_snapshot_counters(counters);
+    return counters[STAT_JOIN_PARTITIONS];
+}
+
+static JoinResult name_join(void)
+{
+    JoinResult result = {COLUMN_USERNAME, COLUMN_USERNAME, 0, 0};
+    IdFilter no_filter = {0};
+    hash_join(&left, &right, &no_filter, COLUMN_USERNAME, COLUMN_USERNAME, COLUMN_BIT(COLUMN_ID), collect_pair, &result);
+    return result;
+}
+
+static void hash_joins_in_memory(void)
+{
+    JoinResult expected = reference_name_join();
+    uint64_t partitions = join_partitions();
+    JoinResult result = name_join();
+
+    TEST_ASSERT_TRUE(expected.num_pairs > 0);
+    TEST_ASSERT_TRUE(expected.num_pairs == result.num_pairs);
+    TEST_ASSERT_TRUE(expected.checksum == result.checksum);
+    TEST_ASSERT_TRUE(join_partitions() == partitions);
+}
+
+static void hash_join_spills_partitions_past_the_memory_limit(void)
+{
+    JoinResult expected = reference_name_join();
+    join_set_memory_limit(50 * 1024);
+    uint64_t partitions = join_partitions();
+    JoinResult result = name_join();
+
+    TEST_ASSERT_TRUE(expected.num_pairs == result.num_pairs);
+    TEST_ASSERT_TRUE(expected.checksum == result.checksum);
+    TEST_ASSERT_TRUE(join_partitions() > partitions);
+}
+
+static void hash_joins_skewed_keys_a_load_at_a_time(void)
+{
+    // one key no number of splits can divide
+    TEST_ASSERT_TRUE(catalog_create_table(table, "skewed"));
+    for (uint64_t id = 1; id <= 200; ++id)
+        insert_into("skewed", id, "name7");
+    Table skewed;
+    TEST_ASSERT_TRUE(catalog_find_table(table, "skewed", &skewed));
+
+    join_set_memory_limit(0);
+    JoinResult result = {COLUMN_USERNAME, COLUMN_USERNAME, 0, 0};
+    IdFilter filter = {true, COMPARE_LESS_EQUAL, 1000};
+    hash_join(&left, &skewed, &filter, COLUMN_USERNAME, COLUMN_USERNAME, 0, collect_pair, &result);
+
+    // ids 7, 507 and 1007 share the key, and the filter drops 1007
+    TEST_ASSERT_TRUE(result.num_pairs == 2 * 200);
+}
+
+static void index_join_skips_missing_and_deleted_rows(void)
+{
+    Statement statement = {0};
+    statement.type = STATEMENT_DELETE;
+    strcpy(statement.table_name, "right_side");
+    statement.id_to_delete = 300;
+    TEST_ASSERT_EQUAL_INT(EXECUTE_SUCCESS, execute_statement(&statement, table));
+
+    JoinResult result = {COLUMN_ID, COLUMN_ID, 0, 0};
+    IdFilter filter = {true, COMPARE_LESS, 601};
+    index_join(&left, &right, &filter, ALL_COLUMNS, collect_pair, &result);
+
+    // the multiples of three up to 600, less the deleted one
+    TEST_ASSERT_TRUE(result.num_pairs == 199);
+    TEST_ASSERT_TRUE(result.checksum == 7920ull * (3 * 200 * 201 / 2 - 300));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(hash_joins_in_memory);
+    RUN_TEST(hash_join_spills_partitions_past_the_memory_limit);
+    RUN_TEST(hash_joins_skewed_keys_a_load_at_a_time);
+    RUN_TEST(index_join_skips_missing_and_deleted_rows);
+    return UNITY_END();
+}
@@ -0,0 +1,181 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+#include <unity.h>
+
+#include "memtable.h"
+#include "parser.h"
+#include "stats.h"
+#include "table.h"
+
+
+#define NUM_ROWS 5000
+#define MEMTABLE_ENTRIES 1000
+
+static Table* table;
+
+static ExecuteResult insert(uint64_t id, const char* username, bool replace)
+{
+    Statement statement = {0};
+    statement.type = STATEMENT_INSERT;
+    statement.insert_or_replace = replace;
+    statement.row_to_insert.id = id;
+    strcpy(statement.row_to_insert.username, username);
+    sprintf(statement.row_to_insert.email, "%s@example.com", username);
+    return execute_statement(&statement, table);
+}
+
+static void use_memtable(uint64_t max_entries)
+{
+    memtable_free(&table->pager->memtable);
+    memtable_init(&table->pager->memtable, max_entries, ROW_SIZE);
+}
+
+static uint64_t memtable_merges(void)
+{
+    uint64_t counters[STAT_COUNTER_COUNT];
+    stats_snapshot_counters(counters);
+    return counters[STAT_MEMTABLE_MERGES];
+}
+
+void setUp(void)
+{
+#ifdef _WIN32
+    char temp_path[MAX_PATH];
+    char temp_file_name[MAX_PATH];
+
+    if (!GetTempPathA(MAX_PATH, temp_path))
+    {
+        fprintf(stderr, "GetTempPathA error\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (!GetTempFileNameA(temp_path, "tmpfile", 0, temp_file_name))
+    {
+        fprintf(stderr, "GetTempFileNameA error\n");
+        exit(EXIT_FAILURE);
+    }
+#endif
+
+    table = db_open(temp_file_name);
+}
+
+void tearDown(void)
+{
+    db_close(table);
+}
+
+static void memtable_orders_entries_by_tree_and_key(void)
+{
+    Memtable memtable;
+    memtable_init(&memtable, 100000, sizeof(uint64_t));
+
+    // a permutation of the keys, for two trees
+    for (uint64_t i = 0; i < 20000; ++i)
+    {
+        uint64_t key = i * 7919 % 20000;
+        uint64_t value = key * 3;
+        TEST_ASSERT_TRUE(memtable_put(&memtable, 2 + i % 2, key, &value, false));
+    }
+    uint64_t value = 0;
+    TEST_ASSERT_FALSE(memtable_put(&memtable, 3, 7919 % 20000, &value, false));
+    TEST_ASSERT_TRUE(memtable_put(&memtable, 3, 7919 % 20000, &value, true));
+    TEST_ASSERT_TRUE(memtable.num_entries == 20000);
+
+    uint64_t previous_root = 0, previous_key = 0, count = 0;
+    for (MemtableEntry* entry = memtable_first(&memtable); entry; entry = entry->next[0], ++count)
+    {
+        TEST_ASSERT_TRUE(entry->root_page_num > previous_root
+            || (entry->root_page_num == previous_root && (count == 0 || entry->key > previous_key)));
+        uint64_t stored;
+        memcpy(&stored, memtable_entry_value(entry), sizeof(stored));
+        TEST_ASSERT_TRUE(stored == (entry->replace ? 0 : entry->key * 3));
+        previous_root = entry->root_page_num;
+        previous_key = entry->key;
+    }
+    TEST_ASSERT_TRUE(count == 20000);
+    TEST_ASSERT_NOT_NULL(memtable_find(&memtable, 2, 7919 * 2 % 20000));
+    TEST_ASSERT_NULL(memtable_find(&memtable, 2, 7919 % 20000));
+
+    memtable_clear(&memtable);
+    TEST_ASSERT_NULL(memtable_first(&memtable));
+    TEST_ASSERT_NULL(memtable_find(&memtable, 3, 7919 % 20000));
+    memtable_free(&memtable);
+}
+
+static void merges_buffered_rows_into_the_tree_in_key_order(void)
+{
+    use_memtable(MEMTABLE_ENTRIES);
+    uint64_t merges = memtable_merges();
+
+    char name[COLUMN_USERNAME_SIZE + 1];
+    for (uint64_t i = 0; i < NUM_ROWS; ++i)
+    {
+        uint64_t id = 1 + i * 2861 % NUM_ROWS;
+        sprintf(name, "user%u", (unsigned)id);
+        TEST_ASSERT_EQUAL_INT(EXECUTE_SUCCESS, insert(id, name, false));
+    }
+    TEST_ASSERT_TRUE(memtable_merges() - merges == NUM_ROWS / MEMTABLE_ENTRIES);
+    TEST_ASSERT_TRUE(table->pager->memtable.num_entries == 0);
+
+    TEST_ASSERT_TRUE(table_check(table) == 0);
+    TEST_ASSERT_TRUE(table_row_count(table) == NUM_ROWS);
+
+    Cursor* cursor = table_start(table);
+    Row row;
+    for (uint64_t id = 1; id <= NUM_ROWS; ++id)
+    {
+        TEST_ASSERT_FALSE(cursor->end_of_table);
+        cursor_read_row(cursor, &row, ALL_COLUMNS);
+        sprintf(name, "user%u", (unsigned)id);
+        TEST_ASSERT_TRUE(row.id == id);
+        TEST_ASSERT_EQUAL_STRING(name, row.username);
+        cursor_advance(cursor);
+    }
+    TEST_ASSERT_TRUE(cursor->end_of_table);
+    free(cursor);
+}
+
+static void buffered_inserts_see_duplicates_in_the_tree_and_the_memtable(void)
+{
+    TEST_ASSERT_EQUAL_INT(EXECUTE_SUCCESS, insert(10, "tree", false));
+    use_memtable(MEMTABLE_ENTRIES);
+
+    TEST_ASSERT_EQUAL_INT(EXECUTE_DUPLICATE_KEY, insert(10, "again", false));
+    TEST_ASSERT_EQUAL_INT(EXECUTE_SUCCESS, insert(20, "buffered", false));
+    TEST_ASSERT_EQUAL_INT(EXECUTE_DUPLICATE_KEY, insert(20, "again", false));
+    TEST_ASSERT_EQUAL_INT(EXECUTE_SUCCESS, insert(10, "replaced", true));
+    TEST_ASSERT_TRUE(table->pager->memtable.num_entries == 2);
+
+    pager_merge_memtable(table->pager);
+    TEST_ASSERT_TRUE(table_row_count(table) == 2);
+
+    Row row;
+    Cursor* cursor = table_find(table, 10);
+    cursor_read_row(cursor, &row, ALL_COLUMNS);
+    TEST_ASSERT_EQUAL_STRING("replaced", row.username);
+    free(cursor);
+
+    cursor = table_find(table, 20);
+    cursor_read_row(cursor, &row, ALL_COLUMNS);
+    TEST_ASSERT_EQUAL_STRING("buffered", row.username);
+    free(cursor);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(memtable_orders_entries_by_tree_and_key);
+    RUN_TEST(merges_buffered_rows_into_the_tree_in_key_order);
+    RUN_TEST(buffered_inserts_see_duplicates_in_the_tree_and_the_memtable);
+    return UNITY_END();
+}
@@ -65,12 +65,17 @@ static void handles_unrecognized_meta_command(void)
 
 static void defines_correct_constants(void)
 {
-	TEST_ASSERT_EQUAL_INT(293, ROW_SIZE);
-	TEST_ASSERT_EQUAL_INT(6, COMMON_NODE_HEADER_SIZE);
-	TEST_ASSERT_EQUAL_INT(14, LEAF_NODE_HEADER_SIZE);
-	TEST_ASSERT_EQUAL_INT(297, LEAF_NODE_CELL_SIZE);
-	TEST_ASSERT_EQUAL_INT(4082, LEAF_NODE_SPACE_FOR_CELLS);
-	TEST_ASSERT_EQUAL_INT(13, LEAF_NODE_MAX_CELLS);
+	TEST_ASSERT_EQUAL_INT(297, ROW_SIZE);
+	TEST_ASSERT_EQUAL_INT(4, PAGE_HEADER_SIZE);
+	TEST_ASSERT_EQUAL_INT(18, COMMON_NODE_HEADER_SIZE);
+	TEST_ASSERT_EQUAL_INT(31, LEAF_NODE_HEADER_SIZE);
+	TEST_ASSERT_EQUAL_INT(305, LEAF_NODE_CELL_SIZE);
+	TEST_ASSERT_EQUAL_INT(4064, LEAF_NODE_SPACE_FOR_CELLS(DEFAULT_PAGE_SIZE));
+	TEST_ASSERT_EQUAL_INT(13, LEAF_NODE_MAX_CELLS(DEFAULT_PAGE_SIZE));
+	TEST_ASSERT_EQUAL_INT(30, INTERNAL_NODE_HEADER_SIZE);
+	TEST_ASSERT_EQUAL_INT(169, INTERNAL_NODE_MAX_CELLS(DEFAULT_PAGE_SIZE));
+	TEST_ASSERT_EQUAL_INT(214, LEAF_NODE_MAX_CELLS(MAX_PAGE_SIZE));
+	TEST_ASSERT_EQUAL_INT(2729, INTERNAL_NODE_MAX_CELLS(MAX_PAGE_SIZE));
 }
 
 int main(void)
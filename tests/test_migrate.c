@@ -0,0 +1,105 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+#include <unity.h>
+
+#include "migrate.h"
+#include "table.h"
+
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+// A format 1 leaf: node type, is_root, parent, num_cells, next_leaf, then key + row cells
+static void write_legacy_leaf(const char* filename, const uint32_t* ids, uint32_t num_ids)
+{
+    uint8_t page[4096] = {0};
+    page[0] = NODE_LEAF;
+    page[1] = 1;
+    page[6] = (uint8_t)num_ids;
+
+    for (uint32_t i = 0; i < num_ids; ++i)
+    {
+        uint8_t* cell = page + 14 + i * 297;
+        memcpy(cell, &ids[i], sizeof(uint32_t));
+        memcpy(cell + 4, &ids[i], sizeof(uint32_t));
+        sprintf((char*)cell + 8, "user%u", ids[i]);
+        sprintf((char*)cell + 41, "user%u@example.com", ids[i]);
+    }
+
+    FILE* file_ptr = fopen(filename, "wb");
+    TEST_ASSERT_NOT_NULL(file_ptr);
+    fwrite(page, 1, sizeof(page), file_ptr);
+    fclose(file_ptr);
+}
+
+static void migrates_format_1_file(void)
+{
+#ifdef _WIN32
+    char temp_path[MAX_PATH];
+    char temp_file_name[MAX_PATH];
+
+    if (!GetTempPathA(MAX_PATH, temp_path))
+    {
+        fprintf(stderr, "GetTempPathA error\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (!GetTempFileNameA(temp_path, "tmpfile", 0, temp_file_name))
+    {
+        fprintf(stderr, "GetTempFileNameA error\n");
+        exit(EXIT_FAILURE);
+    }
+#endif
+
+    const uint32_t ids[] = {2, 3, 5, 8};
+    write_legacy_leaf(temp_file_name, ids, 4);
+    TEST_ASSERT_TRUE(legacy_file_detect(temp_file_name));
+
+    Table* table = db_open(temp_file_name);
+    TEST_ASSERT_EQUAL_INT(0, table_check(table));
+
+    Cursor* cursor = table_start(table);
+    for (uint32_t i = 0; i < 4; ++i)
+    {
+        Row row;
+        char email[COLUMN_EMAIL_SIZE + 1];
+        sprintf(email, "user%u@example.com", ids[i]);
+
+        TEST_ASSERT_FALSE(cursor->end_of_table);
+        cursor_read_row(cursor, &row, ALL_COLUMNS);
+        TEST_ASSERT_EQUAL_INT(ids[i], row.id);
+        TEST_ASSERT_EQUAL_STRING(email, row.email);
+        cursor_advance(cursor);
+    }
+    TEST_ASSERT_TRUE(cursor->end_of_table);
+    free(cursor);
+    db_close(table);
+
+    TEST_ASSERT_FALSE(legacy_file_detect(temp_file_name));
+
+    char backup_file_name[FILENAME_MAX];
+    sprintf(backup_file_name, "%s.v1", temp_file_name);
+    TEST_ASSERT_EQUAL_INT(0, remove(backup_file_name));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(migrates_format_1_file);
+    return UNITY_END();
+}
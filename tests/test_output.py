@@ -1,3 +1,4 @@
+import json
 import os
 import sys
 import subprocess
@@ -25,7 +26,7 @@ insert 15 user15 user15@example.com\n
         expected = """
 Tree:
 - internal (size 1)
-  - leaf (size 7)
+  - leaf (size 13)
     - 1
     - 2
     - 3
@@ -33,14 +34,14 @@ Tree:
     - 5
     - 6
     - 7
-  - key 7
-  - leaf (size 7)
     - 8
     - 9
     - 10
     - 11
     - 12
     - 13
+  - key 13
+  - leaf (size 1)
     - 14
 database> database> Executed."""
 
@@ -57,16 +58,19 @@ database> database> Executed."""
         os.remove(temp_file_path)
         self.assertEqual(expected.strip(), extract_output(process.stdout))
 
-    def test_allows_inserting_max_rows(self):
+    def test_allows_inserting_past_former_page_limit(self):
         def extract_output(output: str):
-            start_index = output.rfind("database> Executed.")
-            return output[start_index:].strip()
-            
+            start_index = output.find("Check:")
+            end_index = output[start_index:].find("database>")
+            return output[start_index:start_index + end_index].strip()
+
         input = "".join([f"insert {i} user{i} person{i}@example.com\n" for i in range(1, 1401)])
+        input += ".check\n"
+        input += ".exit\n"
 
         expected = """
-database> Executed.
-database> Need to implement updating parent after spliting."""
+Check:
+ok"""
         
         with tempfile.NamedTemporaryFile(delete=False) as tmp:
             temp_file_path = tmp.name
@@ -79,6 +83,7 @@ database> Need to implement updating parent after spliting."""
         )
 
         os.remove(temp_file_path)
+        self.assertEqual("", process.stderr)
         self.assertEqual(expected.strip(), extract_output(process.stdout))
 
     def test_prints_all_rows_in_multi_level_tree(self):
@@ -122,6 +127,222 @@ database>"""
         os.remove(temp_file_path)
         self.assertEqual(expected.strip(), extract_output(process.stdout.strip()))
 
+    def test_check_passes_on_multi_level_tree(self):
+        def extract_output(output: str):
+            start_index = output.find("Check:")
+            end_index = output[start_index:].find("database>")
+            return output[start_index:start_index + end_index].strip()
+
+        input = "".join(f"insert {i} user{i} person{i}@example.com\n" for i in range(1, 16))
+        input += ".check\n"
+        input += ".exit\n"
+
+        expected = """
+Check:
+ok"""
+
+        with tempfile.NamedTemporaryFile(delete=False) as tmp:
+            temp_file_path = tmp.name
+
+        process = subprocess.run(
+            [path, temp_file_path],
+            input=input,
+            text=True,
+            capture_output=True
+        )
+
+        os.remove(temp_file_path)
+        self.assertEqual(expected.strip(), extract_output(process.stdout))
+
+    def test_stats_json_is_machine_readable(self):
+        def extract_output(output: str):
+            start_index = output.find("{")
+            end_index = output[start_index:].find("\n")
+            return output[start_index:start_index + end_index].strip()
+
+        input = "".join(f"insert {i} user{i} person{i}@example.com\n" for i in range(1, 16))
+        input += ".stats json\n"
+        input += ".exit\n"
+
+        with tempfile.NamedTemporaryFile(delete=False) as tmp:
+            temp_file_path = tmp.name
+
+        process = subprocess.run(
+            [path, temp_file_path],
+            input=input,
+            text=True,
+            capture_output=True
+        )
+
+        os.remove(temp_file_path)
+        stats = json.loads(extract_output(process.stdout))
+        self.assertEqual(1, stats["counters"]["leaf_splits"])
+        self.assertEqual(15, stats["latency_ns"]["insert"]["count"])
+        self.assertEqual(15, stats["latency_ns"]["prepare"]["count"])
+
+    def test_explain_reports_access_path_and_costs(self):
+        input = "".join(f"insert {i} user{i} person{i}@example.com\n" for i in range(1, 16))
+        input += "explain select where id > 10\n"
+        input += "explain analyze select where id > 10\n"
+        input += ".exit\n"
+
+        with tempfile.NamedTemporaryFile(delete=False) as tmp:
+            temp_file_path = tmp.name
+
+        process = subprocess.run(
+            [path, temp_file_path],
+            input=input,
+            text=True,
+            capture_output=True
+        )
+
+        os.remove(temp_file_path)
+        lines = process.stdout.split("\n")
+        self.assertEqual(2, sum("Plan: range scan of default for id > 10" in line for line in lines))
+        self.assertIn("Rows: 5 examined, 5 returned", lines)
+        self.assertFalse(any("user11" in line for line in lines))
+
+    def test_select_newest_rows_in_reverse(self):
+        input = "".join(f"insert {i} user{i} person{i}@example.com\n" for i in range(1, 101))
+        input += "delete 99\n"
+        input += "select id order by id desc limit 3\n"
+        input += "select id where id < 50 order by id desc limit 2\n"
+        input += "select id limit 2\n"
+        input += "explain analyze select order by id desc limit 3\n"
+        input += ".exit\n"
+
+        with tempfile.NamedTemporaryFile(delete=False) as tmp:
+            temp_file_path = tmp.name
+
+        process = subprocess.run(
+            [path, temp_file_path],
+            input=input,
+            text=True,
+            capture_output=True
+        )
+
+        os.remove(temp_file_path)
+        lines = process.stdout.split("\n")
+        rows = [line.replace("database> ", "") for line in lines if line.startswith("database> (")]
+        self.assertEqual(["(100)", "(49)", "(1)"], rows)
+        self.assertIn("(98)", lines)
+        self.assertIn("(48)", lines)
+        self.assertIn("(2)", lines)
+        self.assertIn("database> Plan: reverse full scan of default, limit 3", lines)
+        self.assertIn("Rows: 4 examined, 3 returned", lines)
+
+    def test_offset_seeks_past_skipped_rows(self):
+        input = "".join(f"insert {i} user{i} person{i}@example.com\n" for i in range(1, 1001))
+        input += "select id limit 2 offset 900\n"
+        input += "select id where id != 950 order by id desc limit 2 offset 50\n"
+        input += "explain analyze select limit 5 offset 900\n"
+        input += ".exit\n"
+
+        with tempfile.NamedTemporaryFile(delete=False) as tmp:
+            temp_file_path = tmp.name
+
+        process = subprocess.run(
+            [path, temp_file_path],
+            input=input,
+            text=True,
+            capture_output=True
+        )
+
+        os.remove(temp_file_path)
+        lines = process.stdout.split("\n")
+        rows = [line.replace("database> ", "") for line in lines if line.startswith("database> (")]
+        self.assertEqual(["(901)", "(949)"], rows)
+        self.assertIn("(902)", lines)
+        self.assertIn("(948)", lines)
+        self.assertIn("database> Plan: full scan of default, limit 5, offset 900", lines)
+        self.assertIn("Rows: 5 examined, 5 returned", lines)
+
+    def test_order_by_column_spills_sorted_runs(self):
+        names = {i: f"user{i * 37 % 200:03d}" for i in range(1, 201)}
+        input = "".join(f"insert {i} {names[i]} person{i}@example.com\n" for i in range(1, 201))
+        input += ".sortmemory 20000\n"
+        input += "select id, username where id > 10 order by username desc limit 3 offset 1\n"
+        input += "explain analyze select order by email\n"
+        input += ".exit\n"
+
+        with tempfile.NamedTemporaryFile(delete=False) as tmp:
+            temp_file_path = tmp.name
+
+        process = subprocess.run(
+            [path, temp_file_path],
+            input=input,
+            text=True,
+            capture_output=True
+        )
+
+        os.remove(temp_file_path)
+        lines = process.stdout.split("\n")
+        expected = sorted((i for i in names if i > 10), key=lambda i: names[i], reverse=True)[1:4]
+        self.assertIn("database> Sort memory: 20000 bytes.", lines)
+        self.assertIn(f"database> ({expected[0]}, {names[expected[0]]})", lines)
+        self.assertEqual([f"({i}, {names[i]})" for i in expected[1:]], lines[lines.index(f"database> ({expected[0]}, {names[expected[0]]})") + 1:][:2])
+        self.assertIn("database> Plan: full scan of default, external sort by email", lines)
+        self.assertTrue(any(line.startswith("Sort: ") and not line.startswith("Sort: 0 ") for line in lines))
+
+    def test_join_tables(self):
+        input = "create table users\ncreate table orders\n"
+        input += "".join(f"insert into users {i} user{i} user{i}@example.com\n" for i in range(1, 11))
+        input += "".join(f"insert into orders {100 + i} user{i % 4} order{i}@example.com\n" for i in range(1, 9))
+        input += "select id, username from orders join users on username = username\n"
+        input += "select id from users join orders on id = id\n"
+        input += "explain select from orders join users on username = username where id > 104\n"
+        input += "explain select from users join orders on id = id\n"
+        input += ".exit\n"
+
+        with tempfile.NamedTemporaryFile(delete=False) as tmp:
+            temp_file_path = tmp.name
+
+        process = subprocess.run(
+            [path, temp_file_path],
+            input=input,
+            text=True,
+            capture_output=True
+        )
+
+        os.remove(temp_file_path)
+        lines = [line.replace("database> ", "") for line in process.stdout.split("\n")]
+        pairs = sorted(line for line in lines if line.startswith("(1"))
+        self.assertEqual(["(101, user1, 1, user1)", "(102, user2, 2, user2)", "(103, user3, 3, user3)",
+                          "(105, user1, 1, user1)", "(106, user2, 2, user2)", "(107, user3, 3, user3)"], pairs)
+        self.assertIn("Plan: hash join of orders with users on username = username, filter id > 104", lines)
+        self.assertIn("Plan: index join of users with orders on id = id", lines)
+
+    def test_memtable_buffers_inserts(self):
+        input = ".memtable 3\n"
+        input += "".join(f"insert {i} user{i} user{i}@example.com\n" for i in (5, 2, 4, 1))
+        input += "select where id = 1\n"
+        input += "insert 1 again again@example.com\n"
+        input += "insert or replace 1 again again@example.com\n"
+        input += "select where id = 1\n"
+        input += ".stats json\n"
+        input += "select\n"
+        input += ".exit\n"
+
+        with tempfile.NamedTemporaryFile(delete=False) as tmp:
+            temp_file_path = tmp.name
+
+        process = subprocess.run(
+            [path, temp_file_path],
+            input=input,
+            text=True,
+            capture_output=True
+        )
+
+        os.remove(temp_file_path)
+        lines = [line.replace("database> ", "") for line in process.stdout.split("\n")]
+        self.assertIn("Memtable: 3 entries.", lines)
+        self.assertIn("Error: Duplicate key.", lines)
+        rows = [line for line in lines if line.startswith("(")]
+        self.assertEqual(["(1, user1, user1@example.com)", "(1, again, again@example.com)",
+                          "(1, again, again@example.com)", "(2, user2, user2@example.com)",
+                          "(4, user4, user4@example.com)", "(5, user5, user5@example.com)"], rows)
+        self.assertIn('"memtable_merges": 1', process.stdout)
+
 
 if __name__ == "__main__":
     unittest.main(argv=[""], exit=False)
@@ -13,6 +13,7 @@
 
 #include "parser.h"
 #include "table.h"
+#include "vacuum.h"
 
 
 void setUp(void)
@@ -23,7 +24,7 @@ void tearDown(void)
 {
 }
 
-static Table* create_temp_table(void)
+static Table* create_temp_table_with_options(DbOptions* options)
 {
 #ifdef _WIN32
     char temp_path[MAX_PATH];
@@ -42,7 +43,13 @@ static Table* create_temp_table(void)
     }
 #endif
 
-    return db_open(temp_file_name);
+    return db_open_with_options(temp_file_name, options);
+}
+
+static Table* create_temp_table(void)
+{
+    DbOptions options = {0};
+    return create_temp_table_with_options(&options);
 }
 
 static InputBuffer* create_input_buffer_with_data(const char* data)
@@ -161,6 +168,358 @@ static void handles_valid_delete_input(void)
     free_input_buffer(input_buffer1);
 }
 
+static void handles_table_name_input(void)
+{
+    Statement statement = {0};
+    InputBuffer* input_buffer = create_input_buffer_with_data("create table users");
+    TEST_ASSERT_EQUAL_INT(PREPARE_SUCCESS, prepare_statement(input_buffer, &statement));
+    TEST_ASSERT_EQUAL_INT(STATEMENT_CREATE_TABLE, statement.type);
+    TEST_ASSERT_EQUAL_STRING("users", statement.table_name);
+    free_input_buffer(input_buffer);
+
+    Statement insert_statement = {0};
+    input_buffer = create_input_buffer_with_data("insert into users 1 foo foo@foo.com");
+    TEST_ASSERT_EQUAL_INT(PREPARE_SUCCESS, prepare_statement(input_buffer, &insert_statement));
+    TEST_ASSERT_EQUAL_STRING("users", insert_statement.table_name);
+    TEST_ASSERT_EQUAL_INT(1, insert_statement.row_to_insert.id);
+    free_input_buffer(input_buffer);
+
+    Statement select_statement = {0};
+    input_buffer = create_input_buffer_with_data("select id, email from users");
+    TEST_ASSERT_EQUAL_INT(PREPARE_SUCCESS, prepare_statement(input_buffer, &select_statement));
+    TEST_ASSERT_EQUAL_STRING("users", select_statement.table_name);
+    free_input_buffer(input_buffer);
+
+    Statement drop_statement = {0};
+    input_buffer = create_input_buffer_with_data("drop table users");
+    TEST_ASSERT_EQUAL_INT(PREPARE_SUCCESS, prepare_statement(input_buffer, &drop_statement));
+    TEST_ASSERT_EQUAL_INT(STATEMENT_DROP_TABLE, drop_statement.type);
+    free_input_buffer(input_buffer);
+}
+
+static void handles_invalid_table_name_input(void)
+{
+    Statement statement = {0};
+    InputBuffer* input_buffer = create_input_buffer_with_data("create users");
+    TEST_ASSERT_EQUAL_INT(PREPARE_SYNTAX_ERROR, prepare_statement(input_buffer, &statement));
+    free_input_buffer(input_buffer);
+
+    input_buffer = create_input_buffer_with_data("drop table bad-name");
+    TEST_ASSERT_EQUAL_INT(PREPARE_SYNTAX_ERROR, prepare_statement(input_buffer, &statement));
+    free_input_buffer(input_buffer);
+
+    input_buffer = create_input_buffer_with_data("select from");
+    TEST_ASSERT_EQUAL_INT(PREPARE_SYNTAX_ERROR, prepare_statement(input_buffer, &statement));
+    free_input_buffer(input_buffer);
+
+    input_buffer = create_input_buffer_with_data("create table aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa");
+    TEST_ASSERT_EQUAL_INT(PREPARE_STRING_TOO_LONG, prepare_statement(input_buffer, &statement));
+    free_input_buffer(input_buffer);
+}
+
+static void handles_aggregate_select_input(void)
+{
+    Statement statement = {0};
+    InputBuffer* input_buffer = create_input_buffer_with_data("select count(*), max(id) from users");
+    TEST_ASSERT_EQUAL_INT(PREPARE_SUCCESS, prepare_statement(input_buffer, &statement));
+    TEST_ASSERT_EQUAL_INT(2, statement.num_aggregates);
+    TEST_ASSERT_EQUAL_INT(AGGREGATE_COUNT, statement.aggregates[0]);
+    TEST_ASSERT_EQUAL_INT(AGGREGATE_MAX, statement.aggregates[1]);
+    free_input_buffer(input_buffer);
+
+    Statement mixed_statement = {0};
+    input_buffer = create_input_buffer_with_data("select id, sum(id)");
+    TEST_ASSERT_EQUAL_INT(PREPARE_SYNTAX_ERROR, prepare_statement(input_buffer, &mixed_statement));
+    free_input_buffer(input_buffer);
+
+    Statement unknown_statement = {0};
+    input_buffer = create_input_buffer_with_data("select avg(id)");
+    TEST_ASSERT_EQUAL_INT(PREPARE_SYNTAX_ERROR, prepare_statement(input_buffer, &unknown_statement));
+    free_input_buffer(input_buffer);
+}
+
+static void handles_where_clause_input(void)
+{
+    Statement statement = {0};
+    InputBuffer* input_buffer = create_input_buffer_with_data("select id from users where id >= 42");
+    TEST_ASSERT_EQUAL_INT(PREPARE_SUCCESS, prepare_statement(input_buffer, &statement));
+    TEST_ASSERT_TRUE(statement.where.active);
+    TEST_ASSERT_EQUAL_INT(COMPARE_GREATER_EQUAL, statement.where.op);
+    TEST_ASSERT_EQUAL_INT(42, statement.where.value);
+    free_input_buffer(input_buffer);
+
+    Statement bad_column_statement = {0};
+    input_buffer = create_input_buffer_with_data("select where email = 1");
+    TEST_ASSERT_EQUAL_INT(PREPARE_SYNTAX_ERROR, prepare_statement(input_buffer, &bad_column_statement));
+    free_input_buffer(input_buffer);
+
+    Statement bad_operator_statement = {0};
+    input_buffer = create_input_buffer_with_data("select where id => 1");
+    TEST_ASSERT_EQUAL_INT(PREPARE_SYNTAX_ERROR, prepare_statement(input_buffer, &bad_operator_statement));
+    free_input_buffer(input_buffer);
+}
+
+static void handles_order_and_limit_input(void)
+{
+    Statement statement = {0};
+    InputBuffer* input_buffer = create_input_buffer_with_data("select id from users where id < 100 order by id desc limit 5");
+    TEST_ASSERT_EQUAL_INT(PREPARE_SUCCESS, prepare_statement(input_buffer, &statement));
+    TEST_ASSERT_TRUE(statement.where.active);
+    TEST_ASSERT_TRUE(statement.order_descending);
+    TEST_ASSERT_TRUE(statement.has_limit);
+    TEST_ASSERT_EQUAL_INT(5, statement.limit);
+    TEST_ASSERT_EQUAL_INT(0, statement.offset);
+    free_input_buffer(input_buffer);
+
+    Statement offset_statement = {0};
+    input_buffer = create_input_buffer_with_data("select limit 10 offset 20");
+    TEST_ASSERT_EQUAL_INT(PREPARE_SUCCESS, prepare_statement(input_buffer, &offset_statement));
+    TEST_ASSERT_EQUAL_INT(10, offset_statement.limit);
+    TEST_ASSERT_EQUAL_INT(20, offset_statement.offset);
+    free_input_buffer(input_buffer);
+
+    Statement ascending_statement = {0};
+    input_buffer = create_input_buffer_with_data("select order by id asc");
+    TEST_ASSERT_EQUAL_INT(PREPARE_SUCCESS, prepare_statement(input_buffer, &ascending_statement));
+    TEST_ASSERT_FALSE(ascending_statement.order_descending);
+    TEST_ASSERT_FALSE(ascending_statement.has_limit);
+    free_input_buffer(input_buffer);
+
+    Statement sorted_statement = {0};
+    input_buffer = create_input_buffer_with_data("select id from users order by email desc limit 3");
+    TEST_ASSERT_EQUAL_INT(PREPARE_SUCCESS, prepare_statement(input_buffer, &sorted_statement));
+    TEST_ASSERT_EQUAL_INT(COLUMN_EMAIL, sorted_statement.order_column);
+    TEST_ASSERT_TRUE(sorted_statement.order_descending);
+    TEST_ASSERT_EQUAL_INT(3, sorted_statement.limit);
+    free_input_buffer(input_buffer);
+
+    Statement bad_column_statement = {0};
+    input_buffer = create_input_buffer_with_data("select order by name desc");
+    TEST_ASSERT_EQUAL_INT(PREPARE_SYNTAX_ERROR, prepare_statement(input_buffer, &bad_column_statement));
+    free_input_buffer(input_buffer);
+
+    Statement parallel_statement = {0};
+    input_buffer = create_input_buffer_with_data("select order by username parallel 2");
+    TEST_ASSERT_EQUAL_INT(PREPARE_SYNTAX_ERROR, prepare_statement(input_buffer, &parallel_statement));
+    free_input_buffer(input_buffer);
+
+    Statement aggregate_statement = {0};
+    input_buffer = create_input_buffer_with_data("select count(*) limit 1");
+    TEST_ASSERT_EQUAL_INT(PREPARE_SYNTAX_ERROR, prepare_statement(input_buffer, &aggregate_statement));
+    free_input_buffer(input_buffer);
+}
+
+static void handles_join_input(void)
+{
+    Statement statement = {0};
+    InputBuffer* input_buffer = create_input_buffer_with_data("select id from orders join users on username = email where id > 5");
+    TEST_ASSERT_EQUAL_INT(PREPARE_SUCCESS, prepare_statement(input_buffer, &statement));
+    TEST_ASSERT_EQUAL_STRING("orders", statement.table_name);
+    TEST_ASSERT_EQUAL_STRING("users", statement.join_table_name);
+    TEST_ASSERT_EQUAL_INT(COLUMN_USERNAME, statement.join_left_column);
+    TEST_ASSERT_EQUAL_INT(COLUMN_EMAIL, statement.join_right_column);
+    TEST_ASSERT_TRUE(statement.where.active);
+    free_input_buffer(input_buffer);
+
+    Statement id_statement = {0};
+    input_buffer = create_input_buffer_with_data("select join users on id = username");
+    TEST_ASSERT_EQUAL_INT(PREPARE_SYNTAX_ERROR, prepare_statement(input_buffer, &id_statement));
+    free_input_buffer(input_buffer);
+
+    Statement missing_statement = {0};
+    input_buffer = create_input_buffer_with_data("select join users on id");
+    TEST_ASSERT_EQUAL_INT(PREPARE_SYNTAX_ERROR, prepare_statement(input_buffer, &missing_statement));
+    free_input_buffer(input_buffer);
+
+    Statement limit_statement = {0};
+    input_buffer = create_input_buffer_with_data("select join users on id = id limit 5");
+    TEST_ASSERT_EQUAL_INT(PREPARE_SYNTAX_ERROR, prepare_statement(input_buffer, &limit_statement));
+    free_input_buffer(input_buffer);
+}
+
+static void retreats_through_multi_level_tree(void)
+{
+    Table* table = create_temp_table();
+    for (uint32_t i = 1; i <= 5000; ++i)
+    {
+        Statement insert_statement = create_insert_statement(i * 2, "user", "user@example.com");
+        TEST_ASSERT_EQUAL_INT(EXECUTE_SUCCESS, execute_statement(&insert_statement, table));
+    }
+    TEST_ASSERT_TRUE(table_depth(table) > 2);
+
+    // every key comes back in reverse, across every leaf and internal node boundary
+    Cursor* cursor = table_find_last(table, UINT64_MAX);
+    for (uint32_t i = 5000; i >= 1; --i)
+    {
+        TEST_ASSERT_FALSE(cursor->end_of_table);
+        TEST_ASSERT_EQUAL_UINT64(i * 2, *leaf_node_key(get_page(table->pager, cursor->page_num), cursor->cell_num));
+        cursor_retreat(cursor);
+    }
+    TEST_ASSERT_TRUE(cursor->end_of_table);
+    free(cursor);
+
+    // keys between and before the stored ones land on the one below
+    cursor = table_find_last(table, 5001);
+    TEST_ASSERT_EQUAL_UINT64(5000, *leaf_node_key(get_page(table->pager, cursor->page_num), cursor->cell_num));
+    free(cursor);
+    cursor = table_find_last(table, 1);
+    TEST_ASSERT_TRUE(cursor->end_of_table);
+    free(cursor);
+    db_close(table);
+}
+
+static void finds_rows_by_position(void)
+{
+    Table* table = create_temp_table();
+    for (uint32_t i = 0; i < 5000; ++i)
+    {
+        // scattered inserts split leaves and internal nodes in the middle of the tree
+        Statement insert_statement = create_insert_statement((i * 7919 % 5000 + 1) * 2, "user", "user@example.com");
+        TEST_ASSERT_EQUAL_INT(EXECUTE_SUCCESS, execute_statement(&insert_statement, table));
+    }
+    for (uint32_t id = 3; id <= 5000; id += 3)
+    {
+        Statement delete_statement = {0};
+        delete_statement.type = STATEMENT_DELETE;
+        delete_statement.id_to_delete = id * 2;
+        TEST_ASSERT_EQUAL_INT(EXECUTE_SUCCESS, execute_statement(&delete_statement, table));
+    }
+    TEST_ASSERT_EQUAL_INT(0, table_check(table));
+
+    uint64_t row_num = 0;
+    for (uint32_t id = 1; id <= 5000; ++id)
+    {
+        if (id % 3 == 0)
+            continue;
+        TEST_ASSERT_EQUAL_UINT64(row_num, table_rank(table, id * 2));
+        Cursor* cursor = table_find_row(table, row_num++);
+        TEST_ASSERT_FALSE(cursor->end_of_table);
+        TEST_ASSERT_EQUAL_UINT64(id * 2, *leaf_node_key(get_page(table->pager, cursor->page_num), cursor->cell_num));
+        free(cursor);
+    }
+    TEST_ASSERT_EQUAL_UINT64(row_num, table_row_count(table));
+    Cursor* cursor = table_find_row(table, row_num);
+    TEST_ASSERT_TRUE(cursor->end_of_table);
+    free(cursor);
+    db_close(table);
+}
+
+static void handles_update_input(void)
+{
+    Statement statement = {0};
+    InputBuffer* input_buffer = create_input_buffer_with_data("update users set email=new@example.com, username = bob where id = 7");
+    TEST_ASSERT_EQUAL_INT(PREPARE_SUCCESS, prepare_statement(input_buffer, &statement));
+    TEST_ASSERT_EQUAL_INT(STATEMENT_UPDATE, statement.type);
+    TEST_ASSERT_EQUAL_STRING("users", statement.table_name);
+    TEST_ASSERT_EQUAL_STRING("new@example.com", statement.update_values.email);
+    TEST_ASSERT_EQUAL_STRING("bob", statement.update_values.username);
+    TEST_ASSERT_EQUAL_INT(7, statement.where.value);
+    free_input_buffer(input_buffer);
+
+    Statement id_statement = {0};
+    input_buffer = create_input_buffer_with_data("update set id=3 where id = 7");
+    TEST_ASSERT_EQUAL_INT(PREPARE_SYNTAX_ERROR, prepare_statement(input_buffer, &id_statement));
+    free_input_buffer(input_buffer);
+
+    Statement range_statement = {0};
+    input_buffer = create_input_buffer_with_data("update set email=x where id > 7");
+    TEST_ASSERT_EQUAL_INT(PREPARE_SYNTAX_ERROR, prepare_statement(input_buffer, &range_statement));
+    free_input_buffer(input_buffer);
+
+    Statement replace_statement = {0};
+    input_buffer = create_input_buffer_with_data("insert or replace into users 1 foo foo@foo.com");
+    TEST_ASSERT_EQUAL_INT(PREPARE_SUCCESS, prepare_statement(input_buffer, &replace_statement));
+    TEST_ASSERT_TRUE(replace_statement.insert_or_replace);
+    TEST_ASSERT_EQUAL_STRING("users", replace_statement.table_name);
+    free_input_buffer(input_buffer);
+}
+
+static void handles_explain_input(void)
+{
+    Statement statement = {0};
+    InputBuffer* input_buffer = create_input_buffer_with_data("explain select id from users where id >= 5");
+    TEST_ASSERT_EQUAL_INT(PREPARE_SUCCESS, prepare_statement(input_buffer, &statement));
+    TEST_ASSERT_EQUAL_INT(EXPLAIN_PLAN, statement.explain);
+    TEST_ASSERT_EQUAL_INT(STATEMENT_SELECT, statement.type);
+    TEST_ASSERT_EQUAL_STRING("users", statement.table_name);
+    TEST_ASSERT_EQUAL_INT(COMPARE_GREATER_EQUAL, statement.where.op);
+    free_input_buffer(input_buffer);
+
+    Statement analyze_statement = {0};
+    input_buffer = create_input_buffer_with_data("explain analyze insert 1 foo foo@foo.com");
+    TEST_ASSERT_EQUAL_INT(PREPARE_SUCCESS, prepare_statement(input_buffer, &analyze_statement));
+    TEST_ASSERT_EQUAL_INT(EXPLAIN_ANALYZE, analyze_statement.explain);
+    TEST_ASSERT_EQUAL_INT(STATEMENT_INSERT, analyze_statement.type);
+    TEST_ASSERT_EQUAL_STRING("foo", analyze_statement.row_to_insert.username);
+    free_input_buffer(input_buffer);
+
+    Statement nested_statement = {0};
+    input_buffer = create_input_buffer_with_data("explain explain select");
+    TEST_ASSERT_EQUAL_INT(PREPARE_SYNTAX_ERROR, prepare_statement(input_buffer, &nested_statement));
+    free_input_buffer(input_buffer);
+}
+
+static void handles_vacuum_input(void)
+{
+    Statement statement = {0};
+    InputBuffer* input_buffer = create_input_buffer_with_data("vacuum");
+    TEST_ASSERT_EQUAL_INT(PREPARE_SUCCESS, prepare_statement(input_buffer, &statement));
+    TEST_ASSERT_EQUAL_INT(STATEMENT_VACUUM, statement.type);
+    TEST_ASSERT_EQUAL_INT(VACUUM_DEFAULT_FILL_PERCENT, statement.fill_percent);
+    free_input_buffer(input_buffer);
+
+    Statement fill_statement = {0};
+    input_buffer = create_input_buffer_with_data("vacuum 70");
+    TEST_ASSERT_EQUAL_INT(PREPARE_SUCCESS, prepare_statement(input_buffer, &fill_statement));
+    TEST_ASSERT_EQUAL_INT(70, fill_statement.fill_percent);
+    free_input_buffer(input_buffer);
+
+    Statement invalid_statement = {0};
+    input_buffer = create_input_buffer_with_data("vacuum 101");
+    TEST_ASSERT_EQUAL_INT(PREPARE_SYNTAX_ERROR, prepare_statement(input_buffer, &invalid_statement));
+    free_input_buffer(input_buffer);
+}
+
+static void handles_update_command(void)
+{
+    Table* table = create_temp_table();
+    for (uint32_t id = 1; id <= 30; ++id)
+    {
+        Statement insert_statement = create_insert_statement(id, "person", "person@example.com");
+        execute_statement(&insert_statement, table);
+    }
+
+    Statement update_statement = {0};
+    update_statement.type = STATEMENT_UPDATE;
+    update_statement.where = (IdFilter){true, COMPARE_EQUAL, 20};
+    strcpy(update_statement.update_values.email, "new@example.com");
+    update_statement.update_columns = COLUMN_BIT(COLUMN_EMAIL);
+    TEST_ASSERT_EQUAL_INT(EXECUTE_SUCCESS, execute_statement(&update_statement, table));
+
+    Row row;
+    Cursor* cursor = table_find(table, 20);
+    cursor_read_row(cursor, &row, ALL_COLUMNS);
+    TEST_ASSERT_EQUAL_STRING("person", row.username);
+    TEST_ASSERT_EQUAL_STRING("new@example.com", row.email);
+    free(cursor);
+
+    update_statement.where.value = 31;
+    TEST_ASSERT_EQUAL_INT(EXECUTE_ID_NOT_FOUND, execute_statement(&update_statement, table));
+
+    Statement replace_statement = create_insert_statement(5, "replaced", "replaced@example.com");
+    TEST_ASSERT_EQUAL_INT(EXECUTE_DUPLICATE_KEY, execute_statement(&replace_statement, table));
+    replace_statement.insert_or_replace = true;
+    TEST_ASSERT_EQUAL_INT(EXECUTE_SUCCESS, execute_statement(&replace_statement, table));
+
+    cursor = table_find(table, 5);
+    cursor_read_row(cursor, &row, ALL_COLUMNS);
+    TEST_ASSERT_EQUAL_STRING("replaced", row.username);
+    free(cursor);
+
+    TEST_ASSERT_EQUAL_INT(0, table_check(table));
+    db_close(table);
+}
+
 static void handles_maximum_insert_input_sizes(void)
 {
     Table* table = create_temp_table();
@@ -185,6 +544,127 @@ static void handles_maximum_insert_input_sizes(void)
     db_close(table);
 }
 
+static void handles_select_columns_input(void)
+{
+    Statement statement = {0};
+    InputBuffer* input_buffer = create_input_buffer_with_data("select id, email");
+    TEST_ASSERT_EQUAL_INT(PREPARE_SUCCESS, prepare_statement(input_buffer, &statement));
+    TEST_ASSERT_EQUAL_INT(COLUMN_BIT(COLUMN_ID) | COLUMN_BIT(COLUMN_EMAIL), statement.select_columns);
+    free_input_buffer(input_buffer);
+
+    input_buffer = create_input_buffer_with_data("select phone");
+    TEST_ASSERT_EQUAL_INT(PREPARE_SYNTAX_ERROR, prepare_statement(input_buffer, &statement));
+    free_input_buffer(input_buffer);
+}
+
+static void handles_pax_leaf_layout(void)
+{
+    DbOptions options = {0};
+    options.leaf_layout = LEAF_LAYOUT_PAX;
+    Table* table = create_temp_table_with_options(&options);
+
+    for (uint32_t i = 20; i > 0; --i)
+    {
+        Statement insert_statement = create_insert_statement(i, "user", "user@example.com");
+        TEST_ASSERT_EQUAL_INT(EXECUTE_SUCCESS, execute_statement(&insert_statement, table));
+    }
+
+    Statement delete_statement = {0};
+    delete_statement.type = STATEMENT_DELETE;
+    delete_statement.id_to_delete = 5;
+    TEST_ASSERT_EQUAL_INT(EXECUTE_SUCCESS, execute_statement(&delete_statement, table));
+
+    Cursor* cursor = table_start(table);
+    uint32_t expected_id = 1;
+    while (!cursor->end_of_table)
+    {
+        if (expected_id == 5)
+        {
+            TEST_ASSERT_NOT_EQUAL_INT(0, cursor_is_deleted(cursor));
+        }
+        else
+        {
+            Row row = {0};
+            cursor_read_row(cursor, &row, ALL_COLUMNS);
+            TEST_ASSERT_EQUAL_INT(expected_id, row.id);
+            TEST_ASSERT_EQUAL_STRING("user@example.com", row.email);
+        }
+        expected_id++;
+        cursor_advance(cursor);
+    }
+    TEST_ASSERT_EQUAL_INT(21, expected_id);
+    TEST_ASSERT_EQUAL_INT(0, table_check(table));
+
+    free(cursor);
+    db_close(table);
+}
+
+static void handles_larger_page_size(void)
+{
+    DbOptions options = {0};
+    options.page_size = 16384;
+    Table* table = create_temp_table_with_options(&options);
+
+    for (uint32_t i = 1; i <= 100; ++i)
+    {
+        Statement insert_statement = create_insert_statement(i, "user", "user@example.com");
+        TEST_ASSERT_EQUAL_INT(EXECUTE_SUCCESS, execute_statement(&insert_statement, table));
+    }
+
+    void* root = get_page(table->pager, table->root_page_num);
+    TEST_ASSERT_EQUAL_INT(NODE_INTERNAL, get_node_type(root));
+    TEST_ASSERT_EQUAL_INT(INTERNAL_NODE_MAX_CELLS(16384), *node_max_cells(root));
+    // ascending inserts fill each leaf before starting the next
+    TEST_ASSERT_EQUAL_INT(1, *internal_node_num_keys(root));
+    TEST_ASSERT_EQUAL_INT(LEAF_NODE_MAX_CELLS(16384), *internal_node_key(root, 0));
+
+    Cursor* cursor = table_start(table);
+    uint32_t expected_id = 1;
+    while (!cursor->end_of_table)
+    {
+        Row row = {0};
+        cursor_read_row(cursor, &row, ALL_COLUMNS);
+        TEST_ASSERT_EQUAL_INT(expected_id, row.id);
+        expected_id++;
+        cursor_advance(cursor);
+    }
+    TEST_ASSERT_EQUAL_INT(101, expected_id);
+    TEST_ASSERT_EQUAL_INT(0, table_check(table));
+
+    free(cursor);
+    db_close(table);
+}
+
+static void packs_leaves_under_ascending_inserts(void)
+{
+    Table* ascending = create_temp_table();
+    Table* descending = create_temp_table();
+    for (uint32_t i = 1; i <= 1000; ++i)
+    {
+        Statement insert_statement = create_insert_statement(i, "user", "user@example.com");
+        TEST_ASSERT_EQUAL_INT(EXECUTE_SUCCESS, execute_statement(&insert_statement, ascending));
+        insert_statement = create_insert_statement(1001 - i, "user", "user@example.com");
+        TEST_ASSERT_EQUAL_INT(EXECUTE_SUCCESS, execute_statement(&insert_statement, descending));
+    }
+
+    // every leaf but the last one is full
+    Cursor* cursor = table_start(ascending);
+    for (uint64_t page_num = cursor->page_num; page_num != 0; )
+    {
+        void* node = get_page(ascending->pager, page_num);
+        page_num = *leaf_node_next_leaf(node);
+        if (page_num != 0)
+            TEST_ASSERT_EQUAL_INT(LEAF_NODE_MAX_CELLS(DEFAULT_PAGE_SIZE), *leaf_node_num_cells(node));
+    }
+    free(cursor);
+
+    TEST_ASSERT_TRUE(ascending->pager->num_pages * 10 < descending->pager->num_pages * 6);
+    TEST_ASSERT_EQUAL_INT(0, table_check(ascending));
+    TEST_ASSERT_EQUAL_INT(0, table_check(descending));
+    db_close(ascending);
+    db_close(descending);
+}
+
 static void handles_missing_id_in_insert_input(void)
 {
     Statement statement = {0};
@@ -286,6 +766,22 @@ int main(void)
     RUN_TEST(handles_valid_insert_input);
     RUN_TEST(handles_valid_select_input);
     RUN_TEST(handles_valid_delete_input);
+    RUN_TEST(handles_select_columns_input);
+    RUN_TEST(handles_pax_leaf_layout);
+    RUN_TEST(handles_larger_page_size);
+    RUN_TEST(packs_leaves_under_ascending_inserts);
+    RUN_TEST(handles_table_name_input);
+    RUN_TEST(handles_invalid_table_name_input);
+    RUN_TEST(handles_aggregate_select_input);
+    RUN_TEST(handles_where_clause_input);
+    RUN_TEST(handles_order_and_limit_input);
+    RUN_TEST(handles_join_input);
+    RUN_TEST(retreats_through_multi_level_tree);
+    RUN_TEST(finds_rows_by_position);
+    RUN_TEST(handles_update_input);
+    RUN_TEST(handles_update_command);
+    RUN_TEST(handles_explain_input);
+    RUN_TEST(handles_vacuum_input);
 
     RUN_TEST(handles_missing_id_in_insert_input);
     RUN_TEST(handles_missing_username_in_insert_input);
@@ -0,0 +1,161 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+#include <unity.h>
+
+#include "parser.h"
+#include "scan.h"
+#include "table.h"
+#include "thread.h"
+
+
+#define NUM_ROWS 3000
+
+typedef struct
+{
+    Mutex lock;
+    uint64_t keys[NUM_ROWS];
+    uint32_t num_keys;
+} ScanResult;
+
+static Table* table;
+
+void setUp(void)
+{
+#ifdef _WIN32
+    char temp_path[MAX_PATH];
+    char temp_file_name[MAX_PATH];
+
+    if (!GetTempPathA(MAX_PATH, temp_path))
+    {
+        fprintf(stderr, "GetTempPathA error\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (!GetTempFileNameA(temp_path, "tmpfile", 0, temp_file_name))
+    {
+        fprintf(stderr, "GetTempFileNameA error\n");
+        exit(EXIT_FAILURE);
+    }
+#endif
+
+    table = db_open(temp_file_name);
+    for (uint64_t i = 0; i < NUM_ROWS; ++i)
+    {
+        // every other key, inserted out of order
+        uint64_t id = ((i * 7919) % NUM_ROWS) * 2 + 2;
+        Statement statement = {0};
+        statement.type = STATEMENT_INSERT;
+        statement.row_to_insert.id = id;
+        sprintf(statement.row_to_insert.username, "user%u", (unsigned)id);
+        sprintf(statement.row_to_insert.email, "user%u@example.com", (unsigned)id);
+        execute_statement(&statement, table);
+    }
+}
+
+void tearDown(void)
+{
+    db_close(table);
+}
+
+static void collect_keys(Row* rows, uint32_t num_rows, void* context)
+{
+    ScanResult* result = context;
+    mutex_lock(&result->lock);
+    for (uint32_t i = 0; i < num_rows; ++i)
+        result->keys[result->num_keys++] = rows[i].id;
+    mutex_unlock(&result->lock);
+}
+
+static int compare_keys(const void* a, const void* b)
+{
+    uint64_t left = *(const uint64_t*)a;
+    uint64_t right = *(const uint64_t*)b;
+    return (left > right) - (left < right);
+}
+
+static void partitions_cover_key_space(void)
+{
+    ScanRange ranges[MAX_SCAN_THREADS];
+    uint32_t num_ranges = table_partition(table, 8, ranges);
+
+    TEST_ASSERT_EQUAL_INT(8, num_ranges);
+    TEST_ASSERT_EQUAL_INT(0, ranges[0].first_key);
+    TEST_ASSERT_TRUE(ranges[num_ranges - 1].last_key == UINT64_MAX);
+    for (uint32_t i = 1; i < num_ranges; ++i)
+    {
+        TEST_ASSERT_TRUE(ranges[i].first_key == ranges[i - 1].last_key + 1);
+        TEST_ASSERT_TRUE(ranges[i].first_key <= ranges[i].last_key);
+    }
+}
+
+static void ordered_scan_returns_keys_in_order(void)
+{
+    for (uint32_t threads = 1; threads <= 8; ++threads)
+    {
+        static ScanResult result;
+        result.num_keys = 0;
+        mutex_init(&result.lock);
+        table_parallel_scan(table, threads, COLUMN_BIT(COLUMN_ID), true, collect_keys, &result);
+        mutex_destroy(&result.lock);
+
+        TEST_ASSERT_EQUAL_INT(NUM_ROWS, result.num_keys);
+        for (uint32_t i = 0; i < NUM_ROWS; ++i)
+            TEST_ASSERT_TRUE(result.keys[i] == (uint64_t)i * 2 + 2);
+    }
+}
+
+static void unordered_scan_returns_every_live_row(void)
+{
+    Statement statement = {0};
+    statement.type = STATEMENT_DELETE;
+    statement.id_to_delete = 10;
+    TEST_ASSERT_EQUAL_INT(EXECUTE_SUCCESS, execute_statement(&statement, table));
+
+    static ScanResult result;
+    mutex_init(&result.lock);
+    table_parallel_scan(table, 6, COLUMN_BIT(COLUMN_ID), false, collect_keys, &result);
+    mutex_destroy(&result.lock);
+
+    TEST_ASSERT_EQUAL_INT(NUM_ROWS - 1, result.num_keys);
+    qsort(result.keys, result.num_keys, sizeof(uint64_t), compare_keys);
+    for (uint32_t i = 0; i < result.num_keys; ++i)
+        TEST_ASSERT_TRUE(result.keys[i] == (uint64_t)(i < 4 ? i : i + 1) * 2 + 2);
+}
+
+static void scans_single_leaf_table(void)
+{
+    ScanRange ranges[MAX_SCAN_THREADS];
+    Table small = *table;
+    small.root_page_num = get_unused_page_num(table->pager);
+    initialize_node(get_page(table->pager, small.root_page_num), NODE_LEAF, table->pager->page_size);
+    set_node_root(get_page(table->pager, small.root_page_num), true);
+
+    TEST_ASSERT_EQUAL_INT(1, table_partition(&small, 4, ranges));
+
+    static ScanResult result;
+    result.num_keys = 0;
+    mutex_init(&result.lock);
+    table_parallel_scan(&small, 4, ALL_COLUMNS, true, collect_keys, &result);
+    mutex_destroy(&result.lock);
+    TEST_ASSERT_EQUAL_INT(0, result.num_keys);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(partitions_cover_key_space);
+    RUN_TEST(ordered_scan_returns_keys_in_order);
+    RUN_TEST(unordered_scan_returns_every_live_row);
+    RUN_TEST(scans_single_leaf_table);
+    return UNITY_END();
+}
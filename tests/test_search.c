@@ -0,0 +1,80 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include <stdlib.h>
+
+#include <unity.h>
+
+#include "search.h"
+
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+static uint32_t reference_lower_bound(const uint64_t* keys, uint32_t num_keys, uint64_t key)
+{
+    uint32_t i = 0;
+    while (i < num_keys && keys[i] < key)
+        ++i;
+    return i;
+}
+
+static void finds_keys_in_empty_and_small_arrays(void)
+{
+    uint64_t keys[] = {3, 5, 7};
+
+    TEST_ASSERT_EQUAL_INT(0, key_lower_bound(keys, 0, 5));
+    TEST_ASSERT_EQUAL_INT(0, key_lower_bound(keys, 3, 1));
+    TEST_ASSERT_EQUAL_INT(1, key_lower_bound(keys, 3, 5));
+    TEST_ASSERT_EQUAL_INT(2, key_lower_bound(keys, 3, 6));
+    TEST_ASSERT_EQUAL_INT(3, key_lower_bound(keys, 3, 8));
+}
+
+static void compares_keys_as_unsigned(void)
+{
+    uint64_t keys[] = {1, 0xFFFFFFFF, 0x7FFFFFFFFFFFFFFF, 0x8000000000000000, 0x8000000000000001,
+        0xFFFFFFFFFFFFFFFE, UINT64_MAX, UINT64_MAX, UINT64_MAX, UINT64_MAX};
+    uint32_t num_keys = sizeof(keys) / sizeof(keys[0]);
+
+    TEST_ASSERT_EQUAL_INT(2, key_lower_bound(keys, num_keys, 0x100000000));
+    TEST_ASSERT_EQUAL_INT(3, key_lower_bound(keys, num_keys, 0x8000000000000000));
+    TEST_ASSERT_EQUAL_INT(5, key_lower_bound(keys, num_keys, 0x8000000000000002));
+    TEST_ASSERT_EQUAL_INT(6, key_lower_bound(keys, num_keys, UINT64_MAX));
+}
+
+static void matches_reference_on_random_arrays(void)
+{
+    static uint64_t keys[600];
+
+    // keys straddle the 32-bit boundary
+    const uint64_t first_key = 0xFFFFFC00;
+
+    srand(7);
+    for (uint32_t num_keys = 0; num_keys < sizeof(keys) / sizeof(keys[0]); num_keys += 13)
+    {
+        uint64_t key = first_key;
+        for (uint32_t i = 0; i < num_keys; ++i)
+        {
+            key += 1 + rand() % 5;
+            keys[i] = key;
+        }
+
+        for (uint64_t probe = first_key - 1; probe <= key + 1; probe += 1 + rand() % 3)
+            TEST_ASSERT_EQUAL_INT(reference_lower_bound(keys, num_keys, probe), key_lower_bound(keys, num_keys, probe));
+    }
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(finds_keys_in_empty_and_small_arrays);
+    RUN_TEST(compares_keys_as_unsigned);
+    RUN_TEST(matches_reference_on_random_arrays);
+    return UNITY_END();
+}
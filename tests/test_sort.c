@@ -0,0 +1,143 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <unity.h>
+
+#include "sort.h"
+#include "table.h"
+
+
+#define NUM_ROWS 10000
+
+void setUp(void)
+{
+    srand(7);
+}
+
+void tearDown(void)
+{
+    sort_set_memory_limit(SORT_DEFAULT_MEMORY);
+}
+
+static void random_row(Row* row, uint64_t id)
+{
+    memset(row, 0, sizeof(*row));
+    row->id = id;
+    // short names share prefixes, so the padding decides some comparisons
+    uint32_t length = 1 + rand() % 4;
+    for (uint32_t i = 0; i < length; ++i)
+        row->username[i] = (char)('a' + rand() % 3);
+    sprintf(row->email, "%c%u@example.com", 'a' + rand() % 26, (unsigned)(rand() % 1000));
+}
+
+static int compare_rows(const Row* a, const Row* b, Column column)
+{
+    if (column == COLUMN_USERNAME)
+        return strcmp(a->username, b->username);
+    if (column == COLUMN_EMAIL)
+        return strcmp(a->email, b->email);
+    return a->id < b->id ? -1 : a->id > b->id;
+}
+
+// Sorts NUM_ROWS random rows and checks that every row comes back once, in order
+static void check_sort(Column column, bool descending)
+{
+    Sorter* sorter = sorter_new(column, descending);
+    for (uint64_t id = 1; id <= NUM_ROWS; ++id)
+    {
+        Row row;
+        random_row(&row, id * 7919 % NUM_ROWS + 1);
+        sorter_add(sorter, &row);
+    }
+    sorter_finish(sorter);
+
+    bool* seen = calloc(NUM_ROWS + 1, sizeof(bool));
+    Row previous, row;
+    uint32_t num_rows = 0;
+    while (sorter_next(sorter, &row))
+    {
+        TEST_ASSERT_TRUE(row.id >= 1 && row.id <= NUM_ROWS);
+        TEST_ASSERT_FALSE(seen[row.id]);
+        seen[row.id] = true;
+        if (num_rows > 0)
+        {
+            int order = compare_rows(&previous, &row, column);
+            TEST_ASSERT_TRUE(descending ? order >= 0 : order <= 0);
+            // equal values keep ascending ids
+            if (order == 0)
+                TEST_ASSERT_TRUE(previous.id < row.id);
+        }
+        previous = row;
+        num_rows++;
+    }
+    TEST_ASSERT_EQUAL_UINT32(NUM_ROWS, num_rows);
+    TEST_ASSERT_FALSE(sorter_next(sorter, &row));
+
+    free(seen);
+    sorter_free(sorter);
+}
+
+static uint32_t runs_spilled(Column column)
+{
+    Sorter* sorter = sorter_new(column, false);
+    Row row;
+    for (uint64_t id = 1; id <= NUM_ROWS; ++id)
+    {
+        random_row(&row, id);
+        sorter_add(sorter, &row);
+    }
+    sorter_finish(sorter);
+    uint32_t num_runs = sorter_num_runs(sorter);
+    sorter_free(sorter);
+    return num_runs;
+}
+
+static void sorts_in_memory_within_the_limit(void)
+{
+    check_sort(COLUMN_USERNAME, false);
+    check_sort(COLUMN_ID, true);
+    TEST_ASSERT_EQUAL_UINT32(0, runs_spilled(COLUMN_USERNAME));
+}
+
+static void merges_runs_spilled_past_the_limit(void)
+{
+    // room for a few hundred rows, so the sort writes dozens of runs
+    sort_set_memory_limit(100 * 1024);
+    check_sort(COLUMN_EMAIL, false);
+    check_sort(COLUMN_USERNAME, true);
+    uint32_t num_runs = runs_spilled(COLUMN_EMAIL);
+    TEST_ASSERT_TRUE(num_runs > 1 && num_runs <= SORT_MAX_FAN_IN);
+}
+
+static void merges_in_passes_past_the_fan_in(void)
+{
+    // one row per run; the first passes merge runs into longer runs
+    sort_set_memory_limit(0);
+    check_sort(COLUMN_USERNAME, false);
+    check_sort(COLUMN_EMAIL, true);
+    TEST_ASSERT_TRUE(runs_spilled(COLUMN_ID) > NUM_ROWS);
+}
+
+static void returns_nothing_from_an_empty_sort(void)
+{
+    Sorter* sorter = sorter_new(COLUMN_USERNAME, false);
+    sorter_finish(sorter);
+    Row row;
+    TEST_ASSERT_FALSE(sorter_next(sorter, &row));
+    sorter_free(sorter);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(sorts_in_memory_within_the_limit);
+    RUN_TEST(merges_runs_spilled_past_the_limit);
+    RUN_TEST(merges_in_passes_past_the_fan_in);
+    RUN_TEST(returns_nothing_from_an_empty_sort);
+    return UNITY_END();
+}
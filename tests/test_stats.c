@@ -0,0 +1,130 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+#include <unity.h>
+
+#include "parser.h"
+#include "stats.h"
+#include "table.h"
+#include "thread.h"
+
+
+static StatsBlock snapshot;
+
+void setUp(void)
+{
+    stats_reset();
+}
+
+void tearDown(void)
+{
+}
+
+static void histogram_percentiles_are_close(void)
+{
+    static Histogram histogram;
+    for (uint64_t value = 1; value <= 100000; ++value)
+        histogram_record(&histogram, value);
+
+    TEST_ASSERT_EQUAL_INT(100000, histogram.count);
+    TEST_ASSERT_EQUAL_INT(100000, histogram.max);
+
+    uint64_t p50 = histogram_percentile(&histogram, 50);
+    uint64_t p99 = histogram_percentile(&histogram, 99);
+    TEST_ASSERT_TRUE(p50 <= 50001 && p50 >= 50000 - 50000 / 16);
+    TEST_ASSERT_TRUE(p99 <= 99001 && p99 >= 99000 - 99000 / 16);
+    TEST_ASSERT_EQUAL_INT(1, histogram_percentile(&histogram, 0));
+}
+
+static void counts_pager_and_tree_events(void)
+{
+#ifdef _WIN32
+    char temp_path[MAX_PATH];
+    char temp_file_name[MAX_PATH];
+
+    if (!GetTempPathA(MAX_PATH, temp_path))
+    {
+        fprintf(stderr, "GetTempPathA error\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (!GetTempFileNameA(temp_path, "tmpfile", 0, temp_file_name))
+    {
+        fprintf(stderr, "GetTempFileNameA error\n");
+        exit(EXIT_FAILURE);
+    }
+#endif
+
+    Table* table = db_open(temp_file_name);
+    for (uint64_t id = 1; id <= 100; ++id)
+    {
+        Statement statement = {0};
+        statement.type = STATEMENT_INSERT;
+        statement.row_to_insert.id = id;
+        strcpy(statement.row_to_insert.username, "user");
+        strcpy(statement.row_to_insert.email, "user@example.com");
+        execute_statement(&statement, table);
+    }
+    db_close(table);
+
+    stats_snapshot(&snapshot);
+    TEST_ASSERT_EQUAL_INT(100, snapshot.histograms[STAT_TIME_INSERT].count);
+    TEST_ASSERT_TRUE(snapshot.counters[STAT_LEAF_SPLITS] >= 100 / LEAF_NODE_MAX_CELLS(DEFAULT_PAGE_SIZE));
+    TEST_ASSERT_EQUAL_INT(0, snapshot.counters[STAT_INTERNAL_SPLITS]);
+    TEST_ASSERT_TRUE(snapshot.counters[STAT_CURSORS] >= 100);
+    TEST_ASSERT_TRUE(snapshot.counters[STAT_PAGE_HITS] > 0);
+    TEST_ASSERT_EQUAL_INT(snapshot.counters[STAT_PAGER_FLUSHES], snapshot.counters[STAT_PAGES_WRITTEN]);
+
+    stats_reset();
+    table = db_open(temp_file_name);
+    Statement select_statement = {0};
+    select_statement.type = STATEMENT_SELECT;
+    select_statement.select_columns = COLUMN_BIT(COLUMN_ID);
+    select_statement.where = (IdFilter){true, COMPARE_EQUAL, 0};
+    execute_statement(&select_statement, table);
+
+    stats_snapshot(&snapshot);
+    TEST_ASSERT_EQUAL_INT(snapshot.counters[STAT_PAGE_MISSES], snapshot.counters[STAT_PAGES_READ]);
+    TEST_ASSERT_EQUAL_INT(snapshot.counters[STAT_PAGES_READ], snapshot.histograms[STAT_TIME_PAGE_READ].count);
+    TEST_ASSERT_EQUAL_INT(1, snapshot.histograms[STAT_TIME_SELECT].count);
+    TEST_ASSERT_EQUAL_INT(0, snapshot.counters[STAT_PAGES_WRITTEN]);
+    db_close(table);
+}
+
+static void bump_counters(void* argument)
+{
+    for (uint32_t i = 0; i < 1000; ++i)
+        stats_increment(STAT_CURSORS);
+    (void)argument;
+}
+
+static void keeps_counts_of_exited_threads(void)
+{
+    Thread threads[4];
+    for (uint32_t i = 0; i < 4; ++i)
+        thread_start(&threads[i], bump_counters, NULL);
+    for (uint32_t i = 0; i < 4; ++i)
+        thread_join(threads[i]);
+    bump_counters(NULL);
+
+    stats_snapshot(&snapshot);
+    TEST_ASSERT_EQUAL_INT(5000, snapshot.counters[STAT_CURSORS]);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(histogram_percentiles_are_close);
+    RUN_TEST(counts_pager_and_tree_events);
+    RUN_TEST(keeps_counts_of_exited_threads);
+    return UNITY_END();
+}
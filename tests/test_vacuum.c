@@ -0,0 +1,236 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+#include <unity.h>
+
+#include "aggregate.h"
+#include "catalog.h"
+#include "parser.h"
+#include "table.h"
+#include "vacuum.h"
+
+
+#define NUM_ROWS 1000
+
+static Table* table;
+static char db_file_name[512];
+
+void setUp(void)
+{
+#ifdef _WIN32
+    char temp_path[MAX_PATH];
+    char temp_file_name[MAX_PATH];
+
+    if (!GetTempPathA(MAX_PATH, temp_path))
+    {
+        fprintf(stderr, "GetTempPathA error\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (!GetTempFileNameA(temp_path, "tmpfile", 0, temp_file_name))
+    {
+        fprintf(stderr, "GetTempFileNameA error\n");
+        exit(EXIT_FAILURE);
+    }
+#endif
+
+    strcpy(db_file_name, temp_file_name);
+    table = db_open(db_file_name);
+}
+
+void tearDown(void)
+{
+    db_close(table);
+}
+
+static void execute(Statement* statement)
+{
+    TEST_ASSERT_EQUAL_INT(EXECUTE_SUCCESS, execute_statement(statement, table));
+}
+
+static void insert(const char* table_name, uint64_t id)
+{
+    Statement statement = {0};
+    statement.type = STATEMENT_INSERT;
+    statement.row_to_insert.id = id;
+    sprintf(statement.row_to_insert.username, "user%u", (unsigned)id);
+    sprintf(statement.row_to_insert.email, "user%u@example.com", (unsigned)id);
+    strcpy(statement.table_name, table_name);
+    execute(&statement);
+}
+
+static void delete(uint64_t id)
+{
+    Statement statement = {0};
+    statement.type = STATEMENT_DELETE;
+    statement.id_to_delete = id;
+    execute(&statement);
+}
+
+static void table_statement(StatementType type, const char* table_name)
+{
+    Statement statement = {0};
+    statement.type = type;
+    strcpy(statement.table_name, table_name);
+    execute(&statement);
+}
+
+static long file_size(void)
+{
+    FILE* file_ptr = fopen(db_file_name, "rb");
+    fseek(file_ptr, 0, SEEK_END);
+    long size = ftell(file_ptr);
+    fclose(file_ptr);
+    return size;
+}
+
+// Descending inserts split off a new leaf for almost every page's worth of rows
+static void rebuilds_leaves_in_key_order(void)
+{
+    for (uint64_t id = NUM_ROWS; id >= 1; --id)
+        insert("", id);
+    for (uint64_t id = 2; id <= NUM_ROWS; id += 2)
+        delete(id);
+
+    table_vacuum(table, 100);
+    TEST_ASSERT_EQUAL_INT(0, table_check(table));
+    TEST_ASSERT_TRUE(table->pager->free_page_head == 0);
+
+    Cursor* cursor = table_start(table);
+    uint64_t page_num = cursor->page_num;
+    free(cursor);
+
+    uint64_t expected_id = 1;
+    while (page_num != 0)
+    {
+        void* node = get_page(table->pager, page_num);
+        for (uint32_t i = 0; i < *leaf_node_num_cells(node); ++i)
+        {
+            TEST_ASSERT_FALSE(leaf_node_is_deleted(node, i));
+            TEST_ASSERT_TRUE(*leaf_node_key(node, i) == expected_id);
+            expected_id += 2;
+        }
+
+        uint64_t next_leaf = *leaf_node_next_leaf(node);
+        TEST_ASSERT_TRUE(next_leaf == 0 || next_leaf == page_num + 1);
+        page_num = next_leaf;
+    }
+    TEST_ASSERT_TRUE(expected_id == NUM_ROWS + 1);
+}
+
+static void keeps_named_tables_and_shrinks_file(void)
+{
+    table_statement(STATEMENT_CREATE_TABLE, "dropped");
+    table_statement(STATEMENT_CREATE_TABLE, "kept");
+    for (uint64_t id = 1; id <= NUM_ROWS; ++id)
+    {
+        insert("dropped", id);
+        insert("kept", id);
+    }
+    table_statement(STATEMENT_DROP_TABLE, "dropped");
+    db_close(table);
+    long size_before = file_size();
+
+    table = db_open(db_file_name);
+    table_vacuum(table, 100);
+    TEST_ASSERT_EQUAL_INT(0, table_check(table));
+    db_close(table);
+    TEST_ASSERT_TRUE(file_size() < size_before);
+
+    table = db_open(db_file_name);
+    TEST_ASSERT_EQUAL_INT(0, table_check(table));
+    Table kept;
+    TEST_ASSERT_TRUE(catalog_find_table(table, "kept", &kept));
+    uint64_t count, sum;
+    table_count_and_sum(&kept, &count, &sum);
+    TEST_ASSERT_EQUAL_INT(NUM_ROWS, count);
+
+    // table ids are not reused after a vacuum
+    table_statement(STATEMENT_CREATE_TABLE, "added");
+    CatalogEntry* entries;
+    TEST_ASSERT_EQUAL_INT(2, catalog_list_tables(table, &entries));
+    free(entries);
+    Table added;
+    TEST_ASSERT_TRUE(catalog_find_table(table, "added", &added));
+    TEST_ASSERT_TRUE(added.root_page_num == table->pager->num_pages - 1);
+}
+
+static void leaves_room_for_inserts(void)
+{
+    for (uint64_t id = 1; id <= NUM_ROWS; id += 2)
+        insert("", id);
+
+    table_vacuum(table, 50);
+    TEST_ASSERT_EQUAL_INT(0, table_check(table));
+    Cursor* cursor = table_start(table);
+    void* node = get_page(table->pager, cursor->page_num);
+    TEST_ASSERT_TRUE(*leaf_node_num_cells(node) <= LEAF_NODE_MAX_CELLS(table->pager->page_size) / 2);
+    free(cursor);
+
+    // every leaf can take a row between each pair of its keys without splitting
+    uint64_t num_pages = table->pager->num_pages;
+    for (uint64_t id = 2; id <= NUM_ROWS; id += 2)
+        insert("", id);
+    TEST_ASSERT_TRUE(table->pager->num_pages == num_pages);
+    TEST_ASSERT_EQUAL_INT(0, table_check(table));
+}
+
+static void moves_a_table_with_the_longest_column_definitions(void)
+{
+    // the root starts with one digit and the rebuilt default table pushes it past nine
+    table_statement(STATEMENT_CREATE_TABLE, "wide");
+    Table wide;
+    TEST_ASSERT_TRUE(catalog_find_table(table, "wide", &wide));
+    TEST_ASSERT_TRUE(wide.root_page_num < 10);
+    for (uint64_t id = 1; id <= NUM_ROWS; ++id)
+        insert("", id);
+    insert("wide", 1);
+
+    // the column definitions fill every byte the page number leaves
+    Table catalog = {table->pager, table->pager->catalog_root_page};
+    Cursor* cursor = table_start(&catalog);
+    Row row;
+    cursor_read_row(cursor, &row, ALL_COLUMNS);
+    TEST_ASSERT_EQUAL_STRING("wide", row.username);
+    int prefix_length = sprintf(row.email, "%u ", (unsigned)wide.root_page_num);
+    memset(row.email + prefix_length, 'c', COLUMN_EMAIL_SIZE - prefix_length);
+    row.email[COLUMN_EMAIL_SIZE] = '\0';
+    cursor_write_row(cursor, &row);
+    free(cursor);
+
+    table_vacuum(table, 100);
+    TEST_ASSERT_EQUAL_INT(0, table_check(table));
+    TEST_ASSERT_TRUE(catalog_find_table(table, "wide", &wide));
+    TEST_ASSERT_TRUE(wide.root_page_num >= 10);
+    uint64_t count, sum;
+    table_count_and_sum(&wide, &count, &sum);
+    TEST_ASSERT_EQUAL_INT(1, count);
+
+    // the definitions lose the characters the longer page number took
+    CatalogEntry* entries;
+    TEST_ASSERT_EQUAL_INT(1, catalog_list_tables(table, &entries));
+    TEST_ASSERT_TRUE(entries[0].root_page_num == wide.root_page_num);
+    size_t expected_length = COLUMN_EMAIL_SIZE - (wide.root_page_num >= 100 ? 4 : 3);
+    TEST_ASSERT_EQUAL_INT(expected_length, strlen(entries[0].columns));
+    TEST_ASSERT_TRUE(strspn(entries[0].columns, "c") == expected_length);
+    free(entries);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(rebuilds_leaves_in_key_order);
+    RUN_TEST(keeps_named_tables_and_shrinks_file);
+    RUN_TEST(leaves_room_for_inserts);
+    RUN_TEST(moves_a_table_with_the_longest_column_definitions);
+    return UNITY_END();
+}